@@ -1,14 +1,137 @@
 #include "graphics/asynchronous_loader.hpp"
 #include "graphics/renderer.hpp"
 
+#include "foundation/file.hpp"
+#include "foundation/numerics.hpp"
 #include "foundation/time.hpp"
 
 #include "external/stb_image.h"
 
 #include "external/tracy/tracy/Tracy.hpp"
 
+#include <string.h>
+
 namespace raptor
 {
+// Files are read on the IO and task threads, while the heap allocators are used by the main thread.
+static MallocAllocator      file_allocator;
+
+static const sizet          k_staging_alignment     = 16;
+static const u32            k_max_streamed_mips     = 16;
+
+// Texture mips ///////////////////////////////////////////////////////////
+
+static sizet get_mip_size( u32 width, u32 height, u32 mip ) {
+    return ( sizet )raptor::max( width >> mip, 1u ) * raptor::max( height >> mip, 1u ) * 4;
+}
+
+static sizet get_mips_size( u32 width, u32 height, u32 first_mip, u32 mip_count ) {
+    sizet size = 0;
+    for ( u32 mip = first_mip; mip < first_mip + mip_count; ++mip ) {
+        size += get_mip_size( width, height, mip );
+    }
+    return size;
+}
+
+// 2x2 box filter, the last row and column are repeated for odd sizes.
+static void downsample_mip( const u8* source, u32 source_width, u32 source_height, u8* destination, u32 width, u32 height ) {
+    for ( u32 y = 0; y < height; ++y ) {
+        const u8* row_0 = source + ( sizet )raptor::min( y * 2, source_height - 1 ) * source_width * 4;
+        const u8* row_1 = source + ( sizet )raptor::min( y * 2 + 1, source_height - 1 ) * source_width * 4;
+
+        for ( u32 x = 0; x < width; ++x ) {
+            const u32 x_0 = raptor::min( x * 2, source_width - 1 ) * 4;
+            const u32 x_1 = raptor::min( x * 2 + 1, source_width - 1 ) * 4;
+
+            for ( u32 c = 0; c < 4; ++c ) {
+                *destination++ = ( u8 )( ( row_0[ x_0 + c ] + row_0[ x_1 + c ] + row_1[ x_0 + c ] + row_1[ x_1 + c ] + 2 ) / 4 );
+            }
+        }
+    }
+}
+
+// Writes mip_count mips from first_mip of image, packed one after the other.
+static void write_texture_mips( const u8* image, u32 width, u32 height, u32 first_mip, u32 mip_count, u8* out_mips ) {
+    // Mips before first_mip are only used to filter the next ones.
+    const sizet scratch_size = first_mip > 1 ? get_mips_size( width, height, 1, first_mip - 1 ) : 0;
+    u8* scratch = scratch_size ? ( u8* )malloc( scratch_size ) : nullptr;
+
+    const u8* source = image;
+    u8* scratch_mip = scratch;
+    u8* out_mip = out_mips;
+
+    for ( u32 mip = 0; mip < first_mip + mip_count; ++mip ) {
+        const sizet mip_size = get_mip_size( width, height, mip );
+        u8* destination = mip >= first_mip ? out_mip : scratch_mip;
+
+        if ( mip == 0 ) {
+            if ( first_mip == 0 ) {
+                memcpy( destination, image, mip_size );
+                out_mip += mip_size;
+            }
+            continue;
+        }
+
+        downsample_mip( source, raptor::max( width >> ( mip - 1 ), 1u ), raptor::max( height >> ( mip - 1 ), 1u ), destination,
+                        raptor::max( width >> mip, 1u ), raptor::max( height >> mip, 1u ) );
+        source = destination;
+
+        if ( mip >= first_mip ) {
+            out_mip += mip_size;
+        } else {
+            scratch_mip += mip_size;
+        }
+    }
+
+    free( scratch );
+}
+
+// TextureDecodeTask //////////////////////////////////////////////////////
+
+void TextureDecodeTask::ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) {
+    ZoneScoped;
+
+    decode_start_time = time_now();
+
+    int x, y, comp;
+
+    // Streamed mips are filtered from the decoded image, that cannot go to the staging memory.
+    const bool stream_mips = request.mip_count > 0;
+
+    image_decode_set_target( stream_mips ? nullptr : staging_data, image_size );
+    texture_data = file.success ? stbi_load_from_memory( file.data, ( int )file.size, &x, &y, &comp, 4 ) : nullptr;
+    image_decode_set_target( nullptr, 0 );
+
+    file_io->release( file );
+
+    decoded_in_place = texture_data != nullptr && texture_data == staging_data;
+
+    if ( texture_data && ( ( u32 )x != width || ( u32 )y != height ) ) {
+        rprint( "File %s is %dx%d, different from its texture\n", request.path, x, y );
+        if ( !decoded_in_place ) {
+            free( texture_data );
+        }
+        texture_data = nullptr;
+        decoded_in_place = false;
+    }
+
+    if ( texture_data && stream_mips ) {
+        u8* mips_data = staging_data ? staging_data : ( u8* )malloc( image_size );
+        write_texture_mips( texture_data, width, height, request.first_mip, request.mip_count, mips_data );
+
+        free( texture_data );
+        texture_data = mips_data;
+    }
+    // The decoder used another allocation for its output, copy it to the reserved staging memory.
+    else if ( texture_data && staging_data && !decoded_in_place ) {
+        memcpy( staging_data, texture_data, image_size );
+        free( texture_data );
+        texture_data = staging_data;
+    }
+
+    decode_end_time = time_now();
+}
+
 // AsynchonousLoader //////////////////////////////////////////////////////
 
 void AsynchronousLoader::init( Renderer* renderer_, enki::TaskScheduler* task_scheduler_, Allocator* resident_allocator ) {
@@ -17,11 +140,21 @@ void AsynchronousLoader::init( Renderer* renderer_, enki::TaskScheduler* task_sc
     allocator = resident_allocator;
 
     file_load_requests.init( allocator, 16 );
+    cancelled_textures.init( allocator, 16 );
     upload_requests.init( allocator, 16 );
 
-    texture_ready.index = k_invalid_texture.index;
-    cpu_buffer_ready.index = k_invalid_buffer.index;
-    gpu_buffer_ready.index = k_invalid_buffer.index;
+    submitted_requests.init( allocator, 16 );
+    textures_ready.init( allocator, 16 );
+
+    telemetry.init();
+
+    // Each decode task has one read at most.
+    FileIoCreation file_io_creation;
+    file_io_creation.allocator = &file_allocator;
+    file_io_creation.backend = file_io_backend;
+    file_io_creation.queue_depth = k_max_texture_decode_tasks;
+    file_io.init( file_io_creation );
+    rprint( "Asynchronous loader reads files with %s\n", FileIoBackend::names[ file_io.backend ] );
 
     using namespace raptor;
 
@@ -32,7 +165,8 @@ void AsynchronousLoader::init( Renderer* renderer_, enki::TaskScheduler* task_sc
 
     staging_buffer = renderer->gpu->access_buffer( staging_buffer_handle );
 
-    staging_buffer_offset = 0;
+    staging_ring.init( allocator, staging_buffer->size, k_staging_alignment );
+    transfer_submitted_value = 0;
 
     for ( u32 i = 0; i < k_max_frames; ++i) {
         VkCommandPoolCreateInfo cmd_pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr };
@@ -58,14 +192,40 @@ void AsynchronousLoader::init( Renderer* renderer_, enki::TaskScheduler* task_sc
     VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
     fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     vkCreateFence( renderer->gpu->vulkan_device, &fence_info, renderer->gpu->vulkan_allocation_callbacks, &transfer_fence );
+
+    // With a timeline multiple transfers can be in flight, otherwise the fence allows only one.
+    if ( renderer->gpu->timeline_semaphore_extension_present ) {
+        VkSemaphoreTypeCreateInfo semaphore_type_info{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+        semaphore_type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphore_info.pNext = &semaphore_type_info;
+
+        vkCreateSemaphore( renderer->gpu->vulkan_device, &semaphore_info, renderer->gpu->vulkan_allocation_callbacks, &transfer_timeline_semaphore );
+    }
 }
 
 void AsynchronousLoader::shutdown() {
 
+    if ( telemetry_report_path && !telemetry.write_report( telemetry_report_path, allocator ) ) {
+        rprint( "Cannot write loader telemetry to %s\n", telemetry_report_path );
+    }
+
     renderer->gpu->destroy_buffer( staging_buffer->handle );
 
+    file_io.shutdown();
+
     file_load_requests.shutdown();
+    cancelled_textures.shutdown();
     upload_requests.shutdown();
+    submitted_requests.shutdown();
+    textures_ready.shutdown();
+    staging_ring.shutdown();
+
+    // The task scheduler is shut down first, all decodes are complete.
+    for ( u32 t = 0; t < k_max_texture_decode_tasks; ++t ) {
+        if ( texture_decode_tasks[ t ].texture_data && !texture_decode_tasks[ t ].staging_data ) {
+            free( texture_decode_tasks[ t ].texture_data );
+        }
+    }
 
     for ( u32 i = 0; i < k_max_frames; ++i ) {
         vkDestroyCommandPool( renderer->gpu->vulkan_device, command_pools[ i ], renderer->gpu->vulkan_allocation_callbacks );
@@ -73,159 +233,607 @@ void AsynchronousLoader::shutdown() {
     }
 
     vkDestroySemaphore( renderer->gpu->vulkan_device, transfer_complete_semaphore, renderer->gpu->vulkan_allocation_callbacks );
+    if ( transfer_timeline_semaphore != VK_NULL_HANDLE ) {
+        vkDestroySemaphore( renderer->gpu->vulkan_device, transfer_timeline_semaphore, renderer->gpu->vulkan_allocation_callbacks );
+    }
     vkDestroyFence( renderer->gpu->vulkan_device, transfer_fence, renderer->gpu->vulkan_allocation_callbacks );
 }
 
+// Staging buffer memory still needed by a request, 0 for buffer to buffer copies.
+static sizet get_staging_size( GpuDevice* gpu, const UploadRequest& request ) {
+    if ( request.texture.index != k_invalid_texture.index ) {
+        Texture* texture = gpu->access_texture( request.texture );
+        if ( request.mip_count > 0 ) {
+            return memory_align( get_mips_size( texture->width, texture->height, request.first_mip + request.uploaded, request.mip_count - request.uploaded ), k_staging_alignment );
+        }
+
+        const u32 k_texture_channels = 4;
+        return memory_align( ( sizet )texture->width * ( texture->height - request.uploaded ) * k_texture_channels, k_staging_alignment );
+    }
+
+    if ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index == k_invalid_buffer.index ) {
+        Buffer* buffer = gpu->access_buffer( request.cpu_buffer );
+        return memory_align( buffer->size - request.uploaded, k_staging_alignment );
+    }
+
+    return 0;
+}
+
+// Bytes delivered to the gpu by a request.
+static sizet get_upload_size( GpuDevice* gpu, const UploadRequest& request ) {
+    if ( request.texture.index != k_invalid_texture.index ) {
+        Texture* texture = gpu->access_texture( request.texture );
+        return request.mip_count > 0 ? get_mips_size( texture->width, texture->height, request.first_mip, request.mip_count ) : ( sizet )texture->width * texture->height * 4;
+    }
+
+    const BufferHandle buffer = request.gpu_buffer.index != k_invalid_buffer.index ? request.gpu_buffer : request.cpu_buffer;
+    return gpu->access_buffer( buffer )->size;
+}
+
+// Removes the first count requests, keeping the order of the others.
+template <typename T>
+static void remove_front( Array<T>& requests, u32 count ) {
+    if ( count == 0 ) {
+        return;
+    }
+
+    memmove( requests.data, requests.data + count, sizeof( T ) * ( requests.size - count ) );
+    requests.set_size( requests.size - count );
+}
+
+// Removes a request keeping the order of the others, so equal priorities are served first come first served.
+template <typename T>
+static void remove_request( Array<T>& requests, u32 index ) {
+    memmove( requests.data + index, requests.data + index + 1, sizeof( T ) * ( requests.size - index - 1 ) );
+    requests.set_size( requests.size - 1 );
+}
+
+// The oldest of the requests with the highest priority.
+static u32 get_highest_priority_request( const Array<FileLoadRequest>& requests ) {
+    u32 highest = 0;
+    for ( u32 i = 1; i < requests.size; ++i ) {
+        if ( requests[ i ].priority > requests[ highest ].priority ) {
+            highest = i;
+        }
+    }
+    return highest;
+}
+
+u64 AsynchronousLoader::get_completed_transfer_value() {
+    GpuDevice* gpu = renderer->gpu;
+
+    if ( transfer_timeline_semaphore != VK_NULL_HANDLE ) {
+        u64 completed_value = 0;
+        vkGetSemaphoreCounterValue( gpu->vulkan_device, transfer_timeline_semaphore, &completed_value );
+        return completed_value;
+    }
+
+    // Only one transfer is in flight without a timeline.
+    const bool transfer_idle = vkGetFenceStatus( gpu->vulkan_device, transfer_fence ) == VK_SUCCESS;
+    return transfer_idle ? transfer_submitted_value : transfer_submitted_value - 1;
+}
+
+// Records as many chunks of the request as the staging ring can hold. Returns true when the request is fully recorded.
+static bool record_upload_request( GpuDevice* gpu, CommandBuffer* cb, Buffer* staging_buffer, StagingRing& staging_ring, u64 completion_value, UploadRequest& request ) {
+    if ( request.texture.index != k_invalid_texture.index && request.mip_count > 0 ) {
+        Texture* texture = gpu->access_texture( request.texture );
+
+        // Decoded in its reserved staging memory, the mips are packed one after the other.
+        if ( request.staged ) {
+            sizet staging_offsets[ k_max_streamed_mips ];
+            sizet mip_offset = request.staging_offset;
+            for ( u32 m = 0; m < request.mip_count; ++m ) {
+                staging_offsets[ m ] = mip_offset;
+                mip_offset += get_mip_size( texture->width, texture->height, request.first_mip + m );
+            }
+
+            cb->upload_texture_mips( request.texture, staging_buffer->handle, staging_offsets, request.first_mip, request.mip_count );
+            staging_ring.set_completion_value( request.staging_offset, completion_value );
+
+            request.uploaded = request.mip_count;
+        }
+
+        // Mips decoded on the heap are copied one at a time.
+        sizet data_offset = get_mips_size( texture->width, texture->height, request.first_mip, request.uploaded );
+        while ( request.uploaded < request.mip_count ) {
+            const u32 mip = request.first_mip + request.uploaded;
+            const sizet mip_size = get_mip_size( texture->width, texture->height, mip );
+            if ( mip_size > staging_ring.get_max_allocation_size() ) {
+                return false;
+            }
+
+            sizet staging_offset = 0;
+            const bool allocated = staging_ring.allocate( mip_size, completion_value, staging_offset );
+            RASSERT( allocated );
+
+            memcpy( staging_buffer->mapped_data + staging_offset, ( u8* )request.data + data_offset, mip_size );
+            cb->upload_texture_mips( request.texture, staging_buffer->handle, &staging_offset, mip, 1 );
+
+            data_offset += mip_size;
+            ++request.uploaded;
+        }
+
+        free( request.data );
+    }
+    else if ( request.texture.index != k_invalid_texture.index ) {
+        Texture* texture = gpu->access_texture( request.texture );
+        const u32 row_size = texture->width * 4;
+
+        // Decoded in its reserved staging memory, only the copy to the image is left.
+        if ( request.staged ) {
+            cb->upload_texture_data( request.texture, nullptr, staging_buffer->handle, request.staging_offset );
+            staging_ring.set_completion_value( request.staging_offset, completion_value );
+
+            request.uploaded = texture->height;
+        }
+
+        while ( request.uploaded < texture->height ) {
+            const u32 row_count = raptor::min<u32>( texture->height - request.uploaded, ( u32 )( staging_ring.get_max_allocation_size() / row_size ) );
+            if ( row_count == 0 ) {
+                return false;
+            }
+
+            sizet staging_offset = 0;
+            const bool allocated = staging_ring.allocate( ( sizet )row_count * row_size, completion_value, staging_offset );
+            RASSERT( allocated );
+
+            cb->upload_texture_data( request.texture, request.data, staging_buffer->handle, staging_offset, request.uploaded, row_count );
+            request.uploaded += row_count;
+        }
+
+        free( request.data );
+    }
+    else if ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index != k_invalid_buffer.index ) {
+        cb->upload_buffer_data( request.cpu_buffer, request.gpu_buffer );
+    }
+    else if ( request.cpu_buffer.index != k_invalid_buffer.index ) {
+        Buffer* buffer = gpu->access_buffer( request.cpu_buffer );
+
+        while ( request.uploaded < buffer->size ) {
+            const u32 chunk_size = raptor::min<u32>( buffer->size - request.uploaded, ( u32 )staging_ring.get_max_allocation_size() );
+            if ( chunk_size == 0 ) {
+                return false;
+            }
+
+            sizet staging_offset = 0;
+            const bool allocated = staging_ring.allocate( chunk_size, completion_value, staging_offset );
+            RASSERT( allocated );
+
+            cb->upload_buffer_data( request.cpu_buffer, request.data, staging_buffer->handle, staging_offset, request.uploaded, chunk_size );
+            request.uploaded += chunk_size;
+        }
+
+        free( request.data );
+    }
+
+    // Data has been copied to the staging buffer.
+    request.data = nullptr;
+    return true;
+}
+
+//
+// Records upload requests into the transfer command buffer, see staging_ring_record_requests.
+struct UploadRecorder {
+
+    // Decoded in their reserved staging memory, or copied between buffers: no staging memory is allocated.
+    bool                    holds_staging( const UploadRequest& request ) const {
+        return request.staged || ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index != k_invalid_buffer.index );
+    }
+
+    bool                    record( UploadRequest& request ) {
+        const sizet used_staging_size = staging_ring->used_size;
+        const bool request_recorded = record_upload_request( gpu, cb, staging_buffer, *staging_ring, completion_value, request );
+        recorded = recorded || request_recorded || staging_ring->used_size != used_staging_size;
+
+        // A partially recorded request continues in the next submit.
+        if ( request_recorded ) {
+            request.completion_value = completion_value;
+            request.times.staged = time_now();
+            submitted_requests->push( request );
+        }
+        return request_recorded;
+    }
+
+    GpuDevice*              gpu                 = nullptr;
+    CommandBuffer*          cb                  = nullptr;
+    Buffer*                 staging_buffer      = nullptr;
+    StagingRing*            staging_ring        = nullptr;
+    Array<UploadRequest>*   submitted_requests  = nullptr;
+    u64                     completion_value    = 0;
+    bool                    recorded            = false;    // Anything, even part of a request.
+
+}; // struct UploadRecorder
+
 void AsynchronousLoader::update( Allocator* scratch_allocator ) {
     using namespace raptor;
 
-    // If a texture was processed in the previous commands, signal the renderer
-    if ( texture_ready.index != k_invalid_texture.index ) {
-        // Add update request.
-        // This method is multithreaded_safe
-        renderer->add_texture_to_update( texture_ready );
-    }
+    GpuDevice* gpu = renderer->gpu;
+
+    process_cancelled_textures();
+
+    // Release the staging memory and complete the requests of the finished transfers.
+    const u64 completed_value = get_completed_transfer_value();
+    staging_ring.release( completed_value );
+
+    u32 completed_requests = 0;
+    for ( ; completed_requests < submitted_requests.size; ++completed_requests ) {
+        UploadRequest& request = submitted_requests[ completed_requests ];
+        if ( request.completion_value > completed_value ) {
+            break;
+        }
+
+        if ( !request.cancelled ) {
+            request.times.gpu_complete = time_now();
+            telemetry.add_request( request.times, get_upload_size( gpu, request ) );
+        }
 
-    if ( cpu_buffer_ready.index != k_invalid_buffer.index && gpu_buffer_ready.index != k_invalid_buffer.index ) {
-        // TODO(marco): free cpu buffer
-        renderer->gpu->destroy_buffer( cpu_buffer_ready );
+        if ( request.texture.index != k_invalid_texture.index ) {
+            if ( !request.cancelled ) {
+                TextureUpdate texture_update;
+                texture_update.texture = request.texture;
+                texture_update.first_mip = request.first_mip;
+                texture_update.mip_count = request.mip_count;
+                textures_ready.push( texture_update );
+            }
+        }
+        else if ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index != k_invalid_buffer.index ) {
+            gpu->destroy_buffer( request.cpu_buffer );
 
-        Buffer* buffer = renderer->gpu->access_buffer( gpu_buffer_ready );
-        buffer->ready = true;
+            Buffer* buffer = gpu->access_buffer( request.gpu_buffer );
+            buffer->ready = true;
+        }
+    }
+    remove_front( submitted_requests, completed_requests );
 
-        gpu_buffer_ready.index = k_invalid_buffer.index;
-        cpu_buffer_ready.index = k_invalid_buffer.index;
+    // Signal the renderer, that accepts a limited amount of textures per frame. The others wait for the next update.
+    while ( textures_ready.size && renderer->add_texture_to_update( textures_ready.back().texture, textures_ready.back().first_mip, textures_ready.back().mip_count ) ) {
+        textures_ready.pop();
     }
 
-    texture_ready.index = k_invalid_texture.index;
+    // Command buffers are used in turn, the next one is free once the transfer it recorded k_max_frames submits ago completed.
+    const u64 next_value = transfer_submitted_value + 1;
+    const bool command_buffer_free = transfer_timeline_semaphore != VK_NULL_HANDLE ? completed_value + k_max_frames >= next_value : completed_value == transfer_submitted_value;
 
-    // Process upload requests
-    if ( upload_requests.size ) {
+    // Record the requests in order, as much as the staging ring can hold, then submit them at once.
+    // Requests decoded in staging memory are recorded even behind a request waiting for staging memory, as their
+    // pending reservations could be what it waits for.
+    if ( command_buffer_free && upload_requests.size ) {
         ZoneScoped;
 
-        // Wait for transfer fence to be finished
-        if ( vkGetFenceStatus( renderer->gpu->vulkan_device, transfer_fence ) != VK_SUCCESS ) {
-            return;
+        CommandBuffer* cb = &command_buffers[ next_value % k_max_frames ];
+        cb->begin();
+
+        UploadRecorder recorder;
+        recorder.gpu = gpu;
+        recorder.cb = cb;
+        recorder.staging_buffer = staging_buffer;
+        recorder.staging_ring = &staging_ring;
+        recorder.submitted_requests = &submitted_requests;
+        recorder.completion_value = next_value;
+        staging_ring_record_requests( upload_requests, recorder );
+
+        cb->end();
+
+        if ( recorder.recorded ) {
+            transfer_submitted_value = next_value;
+
+            VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cb->vk_command_buffer;
+
+            VkQueue used_queue = gpu->vulkan_transfer_queue;
+
+            if ( transfer_timeline_semaphore != VK_NULL_HANDLE ) {
+                VkTimelineSemaphoreSubmitInfo semaphore_info{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+                semaphore_info.signalSemaphoreValueCount = 1;
+                semaphore_info.pSignalSemaphoreValues = &transfer_submitted_value;
+
+                submitInfo.pNext = &semaphore_info;
+                submitInfo.signalSemaphoreCount = 1;
+                submitInfo.pSignalSemaphores = &transfer_timeline_semaphore;
+
+                vkQueueSubmit( used_queue, 1, &submitInfo, VK_NULL_HANDLE );
+            } else {
+                vkResetFences( gpu->vulkan_device, 1, &transfer_fence );
+                vkQueueSubmit( used_queue, 1, &submitInfo, transfer_fence );
+            }
         }
-        // Reset if file requests are present.
-        vkResetFences( renderer->gpu->vulkan_device, 1, &transfer_fence );
+    }
 
-        // Get last request
-        UploadRequest request = upload_requests.back();
-        upload_requests.pop();
+    // Decode the files read, the ones of cancelled requests are dropped.
+    FileIoCompletion file_completions[ k_max_texture_decode_tasks ];
+    const u32 file_completion_count = file_io.poll( file_completions, k_max_texture_decode_tasks );
+    for ( u32 c = 0; c < file_completion_count; ++c ) {
+        TextureDecodeTask* decode_task = ( TextureDecodeTask* )file_completions[ c ].user_data;
+        decode_task->reading = false;
 
-        CommandBuffer* cb = &command_buffers[ renderer->gpu->current_frame ];
-        cb->begin();
+        if ( decode_task->cancelled ) {
+            file_io.release( file_completions[ c ] );
+            continue;
+        }
 
-        if ( request.texture.index != k_invalid_texture.index ) {
-            Texture* texture = renderer->gpu->access_texture( request.texture );
-            const u32 k_texture_channels = 4;
-            const u32 k_texture_alignment = 4;
-            const sizet aligned_image_size = memory_align( texture->width * texture->height * k_texture_channels, k_texture_alignment );
-            // Request place in buffer
-            const sizet current_offset = std::atomic_fetch_add( &staging_buffer_offset, aligned_image_size );
+        decode_task->file = file_completions[ c ];
+        task_scheduler->AddTaskSetToPipe( decode_task );
+    }
+
+    // Queue the finished decodes for upload.
+    for ( u32 t = 0; t < k_max_texture_decode_tasks; ++t ) {
+        TextureDecodeTask& decode_task = texture_decode_tasks[ t ];
+        if ( !decode_task.active || decode_task.reading || !decode_task.GetIsComplete() ) {
+            continue;
+        }
 
-            cb->upload_texture_data( texture->handle, request.data, staging_buffer->handle, current_offset );
+        decode_task.active = false;
+        decoding_size -= decode_task.decoded_size;
 
-            free( request.data );
+        if ( decode_task.cancelled || !decode_task.texture_data ) {
+            if ( decode_task.staging_data ) {
+                release_staging( decode_task.staging_offset );
+            } else {
+                free( decode_task.texture_data );
+            }
+            decode_task.texture_data = nullptr;
         }
-        else if ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index != k_invalid_buffer.index ) {
-            Buffer* src = renderer->gpu->access_buffer( request.cpu_buffer );
-            Buffer* dst = renderer->gpu->access_buffer( request.gpu_buffer );
 
-            cb->upload_buffer_data( src->handle, dst->handle );
+        if ( decode_task.texture_data ) {
+            rprint( "File %s read in %f ms\n", decode_task.request.path, time_delta_milliseconds( decode_task.decode_start_time, decode_task.decode_end_time ) );
+
+            UploadRequest upload_request;
+            upload_request.staged = decode_task.staging_data != nullptr;
+            upload_request.staging_offset = decode_task.staging_offset;
+            upload_request.data = upload_request.staged ? nullptr : decode_task.texture_data;
+            upload_request.texture = decode_task.request.texture;
+            upload_request.first_mip = decode_task.request.first_mip;
+            upload_request.mip_count = decode_task.request.mip_count;
+            upload_request.times.enqueue = decode_task.request.enqueue_time;
+            upload_request.times.decode_start = decode_task.decode_start_time;
+            upload_request.times.decode_end = decode_task.decode_end_time;
+            upload_requests.push( upload_request );
+
+            decode_task.texture_data = nullptr;
+        }
+        else if ( !decode_task.cancelled ) {
+            rprint( "Error reading file %s\n", decode_task.request.path );
         }
-        else if ( request.cpu_buffer.index != k_invalid_buffer.index ) {
-            Buffer* buffer = renderer->gpu->access_buffer( request.cpu_buffer );
-            // TODO: proper alignment
-            const sizet aligned_image_size = memory_align( buffer->size, 64 );
-            const sizet current_offset = std::atomic_fetch_add( &staging_buffer_offset, aligned_image_size );
-            cb->upload_buffer_data( buffer->handle, request.data, staging_buffer->handle, current_offset );
+    }
+
+    // Dispatch file requests while the decoded pixels not yet uploaded fit in the budget.
+    // One decode is always allowed, so textures bigger than the budget still load.
+    sizet pending_decoded_size = decoding_size;
+    for ( u32 i = 0; i < upload_requests.size; ++i ) {
+        pending_decoded_size += get_staging_size( gpu, upload_requests[ i ] );
+    }
+
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
 
-            free( request.data );
+    u32 free_task = 0;
+    while ( file_load_requests.size ) {
+        while ( free_task < k_max_texture_decode_tasks && texture_decode_tasks[ free_task ].active ) {
+            ++free_task;
+        }
+        if ( free_task == k_max_texture_decode_tasks || !file_io.can_read() ) {
+            break;
         }
 
-        cb->end();
+        TextureDecodeTask& decode_task = texture_decode_tasks[ free_task ];
 
-        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &cb->vk_command_buffer;
-        VkPipelineStageFlags wait_flag[] { VK_PIPELINE_STAGE_TRANSFER_BIT };
-        VkSemaphore wait_semaphore[] { transfer_complete_semaphore };
-        submitInfo.pWaitSemaphores = wait_semaphore;
-        submitInfo.pWaitDstStageMask = wait_flag;
+        const u32 request_index = get_highest_priority_request( file_load_requests );
+        const FileLoadRequest& load_request = file_load_requests[ request_index ];
 
-        VkQueue used_queue = renderer->gpu->vulkan_transfer_queue;
-        vkQueueSubmit( used_queue, 1, &submitInfo, transfer_fence );
+        // A request made again after its dispatch is already being served.
+        if ( is_texture_loading( load_request ) ) {
+            remove_request( file_load_requests, request_index );
+            continue;
+        }
 
-        // TODO(marco): better management for state machine. We need to account for file -> buffer,
-        // buffer -> texture and buffer -> buffer. One the CPU buffer has been used it should be freed.
-        if ( request.texture.index != k_invalid_index ) {
-            RASSERT( texture_ready.index == k_invalid_texture.index );
-            texture_ready = request.texture;
+        // Textures are created with their final size before the data is requested.
+        Texture* texture = gpu->access_texture( load_request.texture );
+        const bool stream_mips = load_request.mip_count > 0;
+        const sizet texture_size = ( sizet )texture->width * texture->height * 4;
+        const sizet image_size = stream_mips ? get_mips_size( texture->width, texture->height, load_request.first_mip, load_request.mip_count ) : texture_size;
+
+        // Streamed mips are copied one at a time when they do not fit together.
+        if ( stream_mips && get_mip_size( texture->width, texture->height, load_request.first_mip ) > staging_ring.capacity ) {
+            rprint( "Mip %u of %s does not fit the staging buffer\n", load_request.first_mip, load_request.path );
+            remove_request( file_load_requests, request_index );
+            continue;
         }
-        else if ( request.cpu_buffer.index != k_invalid_buffer.index && request.gpu_buffer.index != k_invalid_buffer.index ) {
-            RASSERT( cpu_buffer_ready.index == k_invalid_index );
-            RASSERT( gpu_buffer_ready.index == k_invalid_index );
 
-            cpu_buffer_ready = request.cpu_buffer;
-            gpu_buffer_ready = request.gpu_buffer;
+        const sizet decoded_size = memory_align( stream_mips ? texture_size + image_size : texture_size, k_staging_alignment );
+        if ( pending_decoded_size > 0 && pending_decoded_size + decoded_size > decode_memory_budget ) {
+            break;
         }
-        else if ( request.cpu_buffer.index != k_invalid_index ) {
-            RASSERT( cpu_buffer_ready.index == k_invalid_index );
-            cpu_buffer_ready = request.cpu_buffer;
+
+        // Reserve the staging memory the image is decoded to. Images bigger than the staging buffer are decoded on the heap and uploaded in chunks.
+        // Decoders allocate one more byte than the image.
+        const sizet staging_size = stream_mips ? image_size : image_size + 1;
+        sizet staging_offset = 0;
+        const bool fits_staging = staging_size <= staging_ring.capacity;
+        if ( fits_staging && !staging_ring.allocate( staging_size, k_staging_ring_pending, staging_offset ) ) {
+            break;
         }
+
+        decode_task.request = load_request;
+        decode_task.decoded_size = decoded_size;
+        decode_task.image_size = image_size;
+        decode_task.width = texture->width;
+        decode_task.height = texture->height;
+        decode_task.staging_data = fits_staging ? staging_buffer->mapped_data + staging_offset : nullptr;
+        decode_task.staging_offset = staging_offset;
+        decode_task.texture_data = nullptr;
+        decode_task.file_io = &file_io;
+        decode_task.active = true;
+        decode_task.reading = true;
+        decode_task.cancelled = false;
+        remove_request( file_load_requests, request_index );
+
+        decoding_size += decoded_size;
+        pending_decoded_size += decoded_size;
+
+        // Decoded once read.
+        const bool read_queued = file_io.read( decode_task.request.path, &decode_task );
+        RASSERT( read_queued );
     }
 
-    // Process a file request
-    if ( file_load_requests.size ) {
-        FileLoadRequest load_request = file_load_requests.back();
-        file_load_requests.pop();
+    u32 queue_depths[ LoaderQueueDepth::Count ]{ file_load_requests.size, file_io.in_flight, 0, upload_requests.size, submitted_requests.size };
+    for ( u32 t = 0; t < k_max_texture_decode_tasks; ++t ) {
+        queue_depths[ LoaderQueueDepth::Decoding ] += texture_decode_tasks[ t ].active && !texture_decode_tasks[ t ].reading ? 1 : 0;
+    }
+    telemetry.set_queue_depths( queue_depths );
+}
 
-        i64 start_reading_file = time_now();
-        // Process request
-        int x, y, comp;
-        u8* texture_data = stbi_load( load_request.path, &x, &y, &comp, 4 );
+void AsynchronousLoader::release_staging( sizet staging_offset ) {
+    // Nothing reads it, it can be reused once the transfers already submitted complete.
+    staging_ring.set_completion_value( staging_offset, transfer_submitted_value );
+}
 
-        if ( texture_data ) {
-            rprint( "File %s read in %f ms\n", load_request.path, time_from_milliseconds( start_reading_file ) );
+bool AsynchronousLoader::is_texture_loading( const FileLoadRequest& request ) {
+    for ( u32 t = 0; t < k_max_texture_decode_tasks; ++t ) {
+        const TextureDecodeTask& decode_task = texture_decode_tasks[ t ];
+        if ( decode_task.active && !decode_task.cancelled && decode_task.request.texture.index == request.texture.index && decode_task.request.first_mip == request.first_mip &&
+             decode_task.request.mip_count == request.mip_count && strcmp( decode_task.request.path, request.path ) == 0 ) {
+            return true;
+        }
+    }
+
+    for ( u32 i = 0; i < upload_requests.size; ++i ) {
+        const UploadRequest& upload_request = upload_requests[ i ];
+        if ( upload_request.texture.index == request.texture.index && upload_request.first_mip == request.first_mip && upload_request.mip_count == request.mip_count &&
+             !upload_request.cancelled ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+u32 AsynchronousLoader::get_file_request_count() {
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
+    return file_load_requests.size;
+}
 
-            UploadRequest& upload_request = upload_requests.push_use();
-            upload_request.data = texture_data;
-            upload_request.texture = load_request.texture;
-            upload_request.cpu_buffer = k_invalid_buffer;
+void AsynchronousLoader::process_cancelled_textures() {
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
+
+    for ( u32 c = 0; c < cancelled_textures.size; ++c ) {
+        const TextureHandle texture = cancelled_textures[ c ];
+
+        for ( u32 t = 0; t < k_max_texture_decode_tasks; ++t ) {
+            TextureDecodeTask& decode_task = texture_decode_tasks[ t ];
+            if ( decode_task.active && decode_task.request.texture.index == texture.index ) {
+                decode_task.cancelled = true;
+            }
         }
-        else {
-            rprint( "Error reading file %s\n", load_request.path );
+
+        // Uploads not started yet are dropped, the others complete to leave the texture in a valid state.
+        for ( u32 i = 0; i < upload_requests.size; ++i ) {
+            UploadRequest& request = upload_requests[ i ];
+            if ( request.texture.index != texture.index ) {
+                continue;
+            }
+
+            if ( request.uploaded == 0 ) {
+                if ( request.staged ) {
+                    release_staging( request.staging_offset );
+                }
+                free( request.data );
+                remove_request( upload_requests, i );
+                --i;
+            } else {
+                request.cancelled = true;
+            }
+        }
+
+        for ( u32 i = 0; i < submitted_requests.size; ++i ) {
+            if ( submitted_requests[ i ].texture.index == texture.index ) {
+                submitted_requests[ i ].cancelled = true;
+            }
+        }
+
+        for ( u32 i = 0; i < textures_ready.size; ++i ) {
+            if ( textures_ready[ i ].texture.index == texture.index ) {
+                textures_ready.delete_swap( i );
+                --i;
+            }
         }
     }
 
-    staging_buffer_offset = 0;
+    cancelled_textures.clear();
+}
+
+void AsynchronousLoader::request_texture_data( cstring filename, TextureHandle texture, f32 priority ) {
+    request_texture_mips( filename, texture, 0, 0, priority );
 }
 
-void AsynchronousLoader::request_texture_data( cstring filename, TextureHandle texture ) {
+void AsynchronousLoader::request_texture_mips( cstring filename, TextureHandle texture, u32 first_mip, u32 mip_count, f32 priority ) {
+    RASSERT( mip_count <= k_max_streamed_mips );
+
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
+
+    // A queued request is replaced, mips are streamed one range at a time per texture.
+    for ( u32 i = 0; i < file_load_requests.size; ++i ) {
+        FileLoadRequest& request = file_load_requests[ i ];
+        if ( request.texture.index == texture.index && strcmp( request.path, filename ) == 0 ) {
+            request.priority = priority;
+            request.first_mip = ( u16 )first_mip;
+            request.mip_count = ( u16 )mip_count;
+            return;
+        }
+    }
 
     FileLoadRequest& request = file_load_requests.push_use();
     strcpy( request.path, filename );
     request.texture = texture;
     request.buffer = k_invalid_buffer;
+    request.priority = priority;
+    request.enqueue_time = time_now();
+    request.first_mip = ( u16 )first_mip;
+    request.mip_count = ( u16 )mip_count;
+}
+
+void AsynchronousLoader::cancel_texture_request( TextureHandle texture ) {
+
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
+
+    for ( u32 i = 0; i < file_load_requests.size; ++i ) {
+        if ( file_load_requests[ i ].texture.index == texture.index ) {
+            remove_request( file_load_requests, i );
+            --i;
+        }
+    }
+
+    // Decodes and uploads belong to the loader thread.
+    cancelled_textures.push( texture );
+}
+
+void AsynchronousLoader::set_texture_priorities( const f32* priorities, u32 count ) {
+
+    std::lock_guard<std::mutex> guard( file_requests_mutex );
+
+    for ( u32 i = 0; i < file_load_requests.size; ++i ) {
+        FileLoadRequest& request = file_load_requests[ i ];
+        if ( request.texture.index < count ) {
+            request.priority = priorities[ request.texture.index ];
+        }
+    }
 }
 
 void AsynchronousLoader::request_buffer_upload( void* data, BufferHandle buffer ) {
 
-    UploadRequest& upload_request = upload_requests.push_use();
+    UploadRequest upload_request;
     upload_request.data = data;
     upload_request.cpu_buffer = buffer;
-    upload_request.texture = k_invalid_texture;
+    upload_request.times.enqueue = time_now();
+    upload_requests.push( upload_request );
 }
 
 void AsynchronousLoader::request_buffer_copy( BufferHandle src, BufferHandle dst ) {
 
-    UploadRequest& upload_request = upload_requests.push_use();
-    upload_request.data = nullptr;
+    UploadRequest upload_request;
     upload_request.cpu_buffer = src;
     upload_request.gpu_buffer = dst;
-    upload_request.texture = k_invalid_texture;
+    upload_request.times.enqueue = time_now();
+    upload_requests.push( upload_request );
 
     Buffer* buffer = renderer->gpu->access_buffer( dst );
     buffer->ready = false;
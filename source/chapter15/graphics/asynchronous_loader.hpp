@@ -1,17 +1,22 @@
 #pragma once
 
 #include "foundation/array.hpp"
+#include "foundation/file_io.hpp"
 #include "foundation/platform.hpp"
 
 #include "graphics/command_buffer.hpp"
 #include "graphics/gpu_device.hpp"
 #include "graphics/gpu_resources.hpp"
+#include "graphics/image_decode.hpp"
+#include "graphics/loader_telemetry.hpp"
+#include "graphics/renderer.hpp"
+#include "graphics/staging_ring.hpp"
 
 #include "external/cglm/types-struct.h"
+#include "external/enkiTS/TaskScheduler.h"
 
 #include <atomic>
-
-namespace enki { class TaskScheduler; }
+#include <mutex>
 
 namespace raptor
 {
@@ -29,6 +34,11 @@ namespace raptor
         char                                    path[ 512 ];
         TextureHandle                           texture     = k_invalid_texture;
         BufferHandle                            buffer      = k_invalid_buffer;
+        f32                                     priority    = 0.f;  // Higher loads first, e.g. screen-space size.
+        i64                                     enqueue_time = 0;
+        // Mips streamed to a sparse texture, 0 to upload mip 0 and generate the others.
+        u16                                     first_mip   = 0;
+        u16                                     mip_count   = 0;
     }; // struct FileLoadRequest
 
     //
@@ -39,8 +49,43 @@ namespace raptor
         TextureHandle                           texture     = k_invalid_texture;
         BufferHandle                            cpu_buffer  = k_invalid_buffer;
         BufferHandle                            gpu_buffer  = k_invalid_buffer;
+        u32                                     uploaded    = 0;    // Rows or mips for textures, bytes for buffers, recorded in previous submits.
+        u64                                     completion_value = 0;
+        bool                                    cancelled   = false;    // Uploaded, but not handed to the renderer.
+        bool                                    staged      = false;    // Decoded at staging_offset, data is unused.
+        sizet                                   staging_offset = 0;
+        u16                                     first_mip   = 0;
+        u16                                     mip_count   = 0;
+        LoaderRequestTimes                      times;
     }; // struct UploadRequest
 
+    static const u32                            k_max_texture_decode_tasks = 16;
+
+    //
+    // Decodes a texture file on a worker thread, once read.
+    struct TextureDecodeTask : public enki::ITaskSet {
+
+        void                                    ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) override;
+
+        FileLoadRequest                         request;
+        FileIo*                                 file_io         = nullptr;
+        FileIoCompletion                        file;           // Released by the task once decoded.
+        u8*                                     texture_data    = nullptr;
+        // Reserved staging memory the image is decoded to, nullptr to decode on the heap.
+        u8*                                     staging_data    = nullptr;
+        sizet                                   staging_offset  = 0;
+        sizet                                   image_size      = 0;    // Of all the streamed mips when streaming mips.
+        u32                                     width           = 0;
+        u32                                     height          = 0;
+        bool                                    decoded_in_place = false;
+        sizet                                   decoded_size    = 0;    // Estimated at dispatch, counted in the decode budget.
+        i64                                     decode_start_time = 0;
+        i64                                     decode_end_time = 0;
+        bool                                    active          = false;
+        bool                                    reading         = false;    // Added to the task scheduler when read.
+        bool                                    cancelled       = false;
+    }; // struct TextureDecodeTask
+
     //
     //
     struct AsynchronousLoader {
@@ -49,28 +94,64 @@ namespace raptor
         void                                    update( Allocator* scratch_allocator );
         void                                    shutdown();
 
-        void                                    request_texture_data( cstring filename, TextureHandle texture );
+        // Requests for the same file and texture are coalesced, keeping the latest priority.
+        void                                    request_texture_data( cstring filename, TextureHandle texture, f32 priority = 0.f );
+        // Decodes the file and uploads mip_count mips from first_mip, filtered on the cpu. Used by sparse textures.
+        void                                    request_texture_mips( cstring filename, TextureHandle texture, u32 first_mip, u32 mip_count, f32 priority = 0.f );
+        // Drops the queued or in flight work for texture. An upload already started still completes, but the texture is not updated.
+        void                                    cancel_texture_request( TextureHandle texture );
+        // Updates the priority of the queued requests, indexed by texture handle index.
+        void                                    set_texture_priorities( const f32* priorities, u32 count );
         void                                    request_buffer_upload( void* data, BufferHandle buffer );
         void                                    request_buffer_copy( BufferHandle src, BufferHandle dst );
 
+        u64                                     get_completed_transfer_value();
+        // Queued file requests, safe to call from any thread.
+        u32                                     get_file_request_count();
+        bool                                    is_texture_loading( const FileLoadRequest& request );
+        void                                    process_cancelled_textures();
+        void                                    release_staging( sizet staging_offset );
+
         Allocator*                              allocator       = nullptr;
         Renderer*                               renderer        = nullptr;
         enki::TaskScheduler*                    task_scheduler  = nullptr;
 
+        // Written by the main thread and read by the loader thread, both guarded by file_requests_mutex.
         Array<FileLoadRequest>                  file_load_requests;
+        Array<TextureHandle>                    cancelled_textures;
+        std::mutex                              file_requests_mutex;
+
         Array<UploadRequest>                    upload_requests;
+        // Recorded in submits still in flight, in submit order.
+        Array<UploadRequest>                    submitted_requests;
+        // Uploaded textures waiting for the renderer to accept them.
+        Array<TextureUpdate>                    textures_ready;
 
         Buffer*                                 staging_buffer  = nullptr;
 
-        std::atomic_size_t                      staging_buffer_offset;
-        TextureHandle                           texture_ready;
-        BufferHandle                            cpu_buffer_ready;
-        BufferHandle                            gpu_buffer_ready;
+        // Decodes run in parallel while the decoded pixels not yet uploaded fit in the budget.
+        TextureDecodeTask                       texture_decode_tasks[ k_max_texture_decode_tasks ];
+        sizet                                   decode_memory_budget    = rmega( 256 );
+        sizet                                   decoding_size           = 0;
+
+        // Files of the decode tasks are read asynchronously, io_uring where available.
+        FileIo                                  file_io;
+        FileIoBackend::Enum                     file_io_backend         = FileIoBackend::IoUring;
+
+        LoaderTelemetry                         telemetry;
+        // Written at shutdown.
+        cstring                                 telemetry_report_path   = "loader_telemetry.json";
+
+        // Staging memory is released when the transfer that read it completes.
+        StagingRing                             staging_ring;
 
         VkCommandPool                           command_pools[ k_max_frames ];
         CommandBuffer                           command_buffers[ k_max_frames ];
         VkSemaphore                             transfer_complete_semaphore;
         VkFence                                 transfer_fence;
+        // Signaled with the submit value of each transfer. Without timeline semaphores one transfer at a time uses transfer_fence.
+        VkSemaphore                             transfer_timeline_semaphore = VK_NULL_HANDLE;
+        u64                                     transfer_submitted_value    = 0;
 
     }; // struct AsynchonousLoader
 
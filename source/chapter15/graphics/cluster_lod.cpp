@@ -0,0 +1,522 @@
+#include "graphics/cluster_lod.hpp"
+
+#include "foundation/numerics.hpp"
+
+#include "external/cglm/struct/vec3.h"
+
+#include "external/tracy/tracy/Tracy.hpp"
+#include "external/meshoptimizer/meshoptimizer.h"
+
+#include <float.h>
+#include <string.h>
+
+namespace raptor {
+
+static const u32        k_cluster_max_vertices      = 64;
+static const u32        k_cluster_max_triangles     = 124;
+static const f32        k_cluster_cone_weight       = 0.0f;
+// Clusters simplified together: halving their triangles gives back about half the clusters.
+static const u32        k_cluster_group_size        = 4;
+// Groups whose simplification removes less triangles than this are left as roots.
+static const f32        k_cluster_min_reduction     = 0.85f;
+
+static const u32        k_position_shared           = u32_max - 1;
+
+//
+// Scratch memory used while building, sized for the source mesh.
+struct ClusterLodScratch {
+
+    void                init( Allocator* allocator, u32 vertex_count, u32 index_count );
+    void                shutdown();
+
+    Array<meshopt_Meshlet> meshlets;
+    Array<u32>          meshlet_vertices;
+    Array<u8>           meshlet_triangles;
+
+    // Vertices with the same position share an id: locking and adjacency follow positions, not attribute seams.
+    Array<u32>          position_ids;
+    Array<u32>          position_group;     // Group using the position, k_position_shared when used by more.
+    Array<u8>           position_frozen;    // Used by a root cluster: must never move again.
+    Array<u32>          position_last_cluster;
+
+    // Pending clusters using each position.
+    Array<u32>          position_cluster_offsets;
+    Array<u32>          position_clusters;
+
+    Array<u32>          pending;
+    Array<u32>          next_pending;
+    Array<u32>          pending_group;
+    Array<u32>          shared_counts;
+    Array<u32>          touched;
+    Array<u32>          group_members;      // Pending clusters of the group being grown.
+
+    // Clusters of each group, contiguous.
+    Array<u32>          group_offsets;
+    Array<u32>          group_clusters;
+
+    // Group local mesh given to the simplifier.
+    Array<u32>          global_to_local;
+    Array<u32>          local_to_global;
+    Array<f32>          local_positions;
+    Array<u32>          local_indices;
+    Array<u32>          simplified_indices;
+
+}; // struct ClusterLodScratch
+
+void ClusterLodScratch::init( Allocator* allocator, u32 vertex_count, u32 index_count ) {
+    const u32 max_meshlets = ( u32 )meshopt_buildMeshletsBound( index_count, k_cluster_max_vertices, k_cluster_max_triangles );
+
+    meshlets.init( allocator, max_meshlets, max_meshlets );
+    meshlet_vertices.init( allocator, max_meshlets * k_cluster_max_vertices, max_meshlets * k_cluster_max_vertices );
+    meshlet_triangles.init( allocator, max_meshlets * k_cluster_max_triangles * 3, max_meshlets * k_cluster_max_triangles * 3 );
+
+    position_ids.init( allocator, vertex_count, vertex_count );
+    position_group.init( allocator, vertex_count, vertex_count );
+    position_frozen.init( allocator, vertex_count, vertex_count );
+    position_last_cluster.init( allocator, vertex_count, vertex_count );
+    position_cluster_offsets.init( allocator, vertex_count + 1, vertex_count + 1 );
+    position_clusters.init( allocator, index_count );
+
+    pending.init( allocator, max_meshlets );
+    next_pending.init( allocator, max_meshlets );
+    pending_group.init( allocator, max_meshlets );
+    shared_counts.init( allocator, max_meshlets );
+    touched.init( allocator, k_cluster_group_size * k_cluster_max_vertices );
+    group_members.init( allocator, k_cluster_group_size );
+    group_offsets.init( allocator, max_meshlets + 1 );
+    group_clusters.init( allocator, max_meshlets );
+
+    global_to_local.init( allocator, vertex_count, vertex_count );
+    local_to_global.init( allocator, k_cluster_group_size * k_cluster_max_vertices );
+    local_positions.init( allocator, k_cluster_group_size * k_cluster_max_vertices * 3 * 3 );
+    local_indices.init( allocator, k_cluster_group_size * k_cluster_max_triangles * 3 );
+    simplified_indices.init( allocator, k_cluster_group_size * k_cluster_max_triangles * 3 );
+
+    memset( position_group.data, 0xff, position_group.size_in_bytes() );
+    memset( position_frozen.data, 0, position_frozen.size_in_bytes() );
+    memset( global_to_local.data, 0xff, global_to_local.size_in_bytes() );
+}
+
+void ClusterLodScratch::shutdown() {
+    meshlets.shutdown();
+    meshlet_vertices.shutdown();
+    meshlet_triangles.shutdown();
+
+    position_ids.shutdown();
+    position_group.shutdown();
+    position_frozen.shutdown();
+    position_last_cluster.shutdown();
+    position_cluster_offsets.shutdown();
+    position_clusters.shutdown();
+
+    pending.shutdown();
+    next_pending.shutdown();
+    pending_group.shutdown();
+    shared_counts.shutdown();
+    touched.shutdown();
+    group_members.shutdown();
+    group_offsets.shutdown();
+    group_clusters.shutdown();
+
+    global_to_local.shutdown();
+    local_to_global.shutdown();
+    local_positions.shutdown();
+    local_indices.shutdown();
+    simplified_indices.shutdown();
+}
+
+// Smallest sphere centered on the average center that encloses all the spheres.
+static vec4s merge_bounds( const ClusterLod& lod, const u32* cluster_indices, u32 count ) {
+    vec3s center{ 0.f, 0.f, 0.f };
+    for ( u32 i = 0; i < count; ++i ) {
+        const vec4s& bounds = lod.clusters[ cluster_indices[ i ] ].bounds;
+        center = glms_vec3_add( center, vec3s{ bounds.x, bounds.y, bounds.z } );
+    }
+    center = glms_vec3_divs( center, ( f32 )count );
+
+    f32 radius = 0.f;
+    for ( u32 i = 0; i < count; ++i ) {
+        const vec4s& bounds = lod.clusters[ cluster_indices[ i ] ].bounds;
+        radius = raptor::max( radius, glms_vec3_distance( center, vec3s{ bounds.x, bounds.y, bounds.z } ) + bounds.w );
+    }
+
+    return vec4s{ center.x, center.y, center.z, radius };
+}
+
+// Split a triangle list into clusters. Source clusters have their own bounds, the others share the ones of their group.
+// Group triangles are in group local vertex space, and vertex_remap brings them back to source vertices.
+static void append_clusters( ClusterLod& lod, ClusterLodScratch& scratch, const f32* positions, u32 vertex_count, u32 position_stride,
+                             const u32* indices, u32 index_count, const u32* vertex_remap, u32 level, const vec4s* group_bounds, f32 error ) {
+
+    const sizet meshlet_count = meshopt_buildMeshlets( scratch.meshlets.data, scratch.meshlet_vertices.data, scratch.meshlet_triangles.data, indices, index_count,
+                                                       positions, vertex_count, position_stride, k_cluster_max_vertices, k_cluster_max_triangles, k_cluster_cone_weight );
+
+    for ( u32 m = 0; m < meshlet_count; ++m ) {
+        const meshopt_Meshlet& meshlet = scratch.meshlets[ m ];
+        const u32* meshlet_vertices = scratch.meshlet_vertices.data + meshlet.vertex_offset;
+        const u8* meshlet_triangles = scratch.meshlet_triangles.data + meshlet.triangle_offset;
+
+        ClusterLodCluster& cluster = lod.clusters.push_use();
+        cluster.index_offset = lod.indices.size;
+        cluster.index_count = meshlet.triangle_count * 3;
+        cluster.vertex_count = meshlet.vertex_count;
+        cluster.level = level;
+        cluster.error = error;
+        cluster.parent_bounds = { 0.f, 0.f, 0.f, 0.f };
+        cluster.parent_error = FLT_MAX;
+        cluster.group_index = u32_max;
+
+        if ( group_bounds ) {
+            cluster.bounds = *group_bounds;
+        } else {
+            const meshopt_Bounds bounds = meshopt_computeMeshletBounds( meshlet_vertices, meshlet_triangles, meshlet.triangle_count, positions, vertex_count, position_stride );
+            cluster.bounds = { bounds.center[ 0 ], bounds.center[ 1 ], bounds.center[ 2 ], bounds.radius };
+        }
+
+        for ( u32 i = 0; i < cluster.index_count; ++i ) {
+            const u32 vertex_index = meshlet_vertices[ meshlet_triangles[ i ] ];
+            lod.indices.push( vertex_remap ? vertex_remap[ vertex_index ] : vertex_index );
+        }
+    }
+}
+
+// Greedily grow groups from pending clusters, adding each time the neighbour sharing more positions.
+static u32 group_pending_clusters( ClusterLod& lod, ClusterLodScratch& scratch ) {
+    const u32 pending_count = scratch.pending.size;
+    const u32 position_count = scratch.position_cluster_offsets.size - 1;
+
+    // Build the list of pending clusters using each position.
+    memset( scratch.position_cluster_offsets.data, 0, scratch.position_cluster_offsets.size_in_bytes() );
+    memset( scratch.position_last_cluster.data, 0xff, scratch.position_last_cluster.size_in_bytes() );
+
+    for ( u32 c = 0; c < pending_count; ++c ) {
+        const ClusterLodCluster& cluster = lod.clusters[ scratch.pending[ c ] ];
+        for ( u32 i = 0; i < cluster.index_count; ++i ) {
+            const u32 position = scratch.position_ids[ lod.indices[ cluster.index_offset + i ] ];
+            if ( scratch.position_last_cluster[ position ] != c ) {
+                scratch.position_last_cluster[ position ] = c;
+                ++scratch.position_cluster_offsets[ position + 1 ];
+            }
+        }
+    }
+
+    for ( u32 p = 0; p < position_count; ++p ) {
+        scratch.position_cluster_offsets[ p + 1 ] += scratch.position_cluster_offsets[ p ];
+    }
+    scratch.position_clusters.set_size( scratch.position_cluster_offsets[ position_count ] );
+
+    memset( scratch.position_last_cluster.data, 0xff, scratch.position_last_cluster.size_in_bytes() );
+    for ( u32 c = 0; c < pending_count; ++c ) {
+        const ClusterLodCluster& cluster = lod.clusters[ scratch.pending[ c ] ];
+        for ( u32 i = 0; i < cluster.index_count; ++i ) {
+            const u32 position = scratch.position_ids[ lod.indices[ cluster.index_offset + i ] ];
+            if ( scratch.position_last_cluster[ position ] != c ) {
+                scratch.position_last_cluster[ position ] = c;
+                // Offsets are used as write cursors, restored below.
+                scratch.position_clusters[ scratch.position_cluster_offsets[ position ]++ ] = c;
+            }
+        }
+    }
+
+    for ( u32 p = position_count; p > 0; --p ) {
+        scratch.position_cluster_offsets[ p ] = scratch.position_cluster_offsets[ p - 1 ];
+    }
+    scratch.position_cluster_offsets[ 0 ] = 0;
+
+    scratch.pending_group.set_size( pending_count );
+    scratch.shared_counts.set_size( pending_count );
+    memset( scratch.pending_group.data, 0xff, scratch.pending_group.size_in_bytes() );
+    memset( scratch.shared_counts.data, 0, scratch.shared_counts.size_in_bytes() );
+
+    scratch.group_offsets.clear();
+    scratch.group_clusters.clear();
+
+    u32 group_count = 0;
+    for ( u32 seed = 0; seed < pending_count; ++seed ) {
+        if ( scratch.pending_group[ seed ] != u32_max ) {
+            continue;
+        }
+
+        scratch.group_members.clear();
+        scratch.group_members.push( seed );
+        scratch.pending_group[ seed ] = group_count;
+
+        while ( scratch.group_members.size < k_cluster_group_size ) {
+            scratch.touched.clear();
+
+            for ( u32 m = 0; m < scratch.group_members.size; ++m ) {
+                const ClusterLodCluster& cluster = lod.clusters[ scratch.pending[ scratch.group_members[ m ] ] ];
+                for ( u32 i = 0; i < cluster.index_count; ++i ) {
+                    const u32 position = scratch.position_ids[ lod.indices[ cluster.index_offset + i ] ];
+                    for ( u32 n = scratch.position_cluster_offsets[ position ]; n < scratch.position_cluster_offsets[ position + 1 ]; ++n ) {
+                        const u32 neighbour = scratch.position_clusters[ n ];
+                        if ( scratch.pending_group[ neighbour ] != u32_max ) {
+                            continue;
+                        }
+
+                        if ( scratch.shared_counts[ neighbour ]++ == 0 ) {
+                            scratch.touched.push( neighbour );
+                        }
+                    }
+                }
+            }
+
+            u32 best_neighbour = u32_max;
+            u32 best_count = 0;
+            for ( u32 t = 0; t < scratch.touched.size; ++t ) {
+                const u32 neighbour = scratch.touched[ t ];
+                if ( scratch.shared_counts[ neighbour ] > best_count ) {
+                    best_count = scratch.shared_counts[ neighbour ];
+                    best_neighbour = neighbour;
+                }
+                scratch.shared_counts[ neighbour ] = 0;
+            }
+
+            if ( best_neighbour == u32_max ) {
+                break;
+            }
+
+            scratch.group_members.push( best_neighbour );
+            scratch.pending_group[ best_neighbour ] = group_count;
+        }
+
+        scratch.group_offsets.push( scratch.group_clusters.size );
+        for ( u32 m = 0; m < scratch.group_members.size; ++m ) {
+            scratch.group_clusters.push( scratch.pending[ scratch.group_members[ m ] ] );
+        }
+
+        ++group_count;
+    }
+
+    scratch.group_offsets.push( scratch.group_clusters.size );
+
+    return group_count;
+}
+
+// Simplify the group in its own vertex space, keeping positions shared with other groups or with roots locked.
+// Returns the simplified index count, indices are written in scratch.simplified_indices.
+static u32 simplify_group( ClusterLod& lod, ClusterLodScratch& scratch, const u32* group_clusters, u32 group_cluster_count,
+                           const f32* positions, u32 position_stride, f32 error_scale, f32& out_error ) {
+    scratch.local_to_global.clear();
+    scratch.local_positions.clear();
+    scratch.local_indices.clear();
+
+    for ( u32 m = 0; m < group_cluster_count; ++m ) {
+        const ClusterLodCluster& cluster = lod.clusters[ group_clusters[ m ] ];
+        for ( u32 i = 0; i < cluster.index_count; ++i ) {
+            const u32 global_index = lod.indices[ cluster.index_offset + i ];
+            u32& local_index = scratch.global_to_local[ global_index ];
+            if ( local_index == u32_max ) {
+                local_index = scratch.local_to_global.size;
+                scratch.local_to_global.push( global_index );
+
+                const f32* position = ( const f32* )( ( const u8* )positions + global_index * position_stride );
+                scratch.local_positions.push( position[ 0 ] );
+                scratch.local_positions.push( position[ 1 ] );
+                scratch.local_positions.push( position[ 2 ] );
+            }
+            scratch.local_indices.push( local_index );
+        }
+    }
+
+    const u32 local_vertex_count = scratch.local_to_global.size;
+
+    // meshopt_simplify cannot move a vertex whose position is shared by more than two vertices:
+    // append two unreferenced copies of each locked position.
+    u32 extra_vertex_count = 0;
+    for ( u32 v = 0; v < local_vertex_count; ++v ) {
+        const u32 position = scratch.position_ids[ scratch.local_to_global[ v ] ];
+        if ( scratch.position_group[ position ] == k_position_shared || scratch.position_frozen[ position ] ) {
+            for ( u32 copy = 0; copy < 2; ++copy ) {
+                scratch.local_positions.push( scratch.local_positions[ v * 3 + 0 ] );
+                scratch.local_positions.push( scratch.local_positions[ v * 3 + 1 ] );
+                scratch.local_positions.push( scratch.local_positions[ v * 3 + 2 ] );
+            }
+            extra_vertex_count += 2;
+        }
+    }
+
+    const u32 index_count = scratch.local_indices.size;
+    scratch.simplified_indices.set_size( index_count );
+
+    f32 simplify_error = 0.f;
+    const u32 target_index_count = ( index_count / 2 ) / 3 * 3;
+    const u32 simplified_count = ( u32 )meshopt_simplify( scratch.simplified_indices.data, scratch.local_indices.data, index_count, scratch.local_positions.data,
+                                                          local_vertex_count + extra_vertex_count, sizeof( f32 ) * 3, target_index_count, 1.0f, &simplify_error );
+
+    for ( u32 v = 0; v < local_vertex_count; ++v ) {
+        scratch.global_to_local[ scratch.local_to_global[ v ] ] = u32_max;
+    }
+
+    out_error = simplify_error * error_scale;
+    return simplified_count;
+}
+
+// ClusterLod /////////////////////////////////////////////////////////////
+void ClusterLod::init( Allocator* allocator_, u32 index_count ) {
+    allocator = allocator_;
+
+    const u32 max_meshlets = ( u32 )meshopt_buildMeshletsBound( index_count, k_cluster_max_vertices, k_cluster_max_triangles );
+    // Each level has about half the triangles of the previous one.
+    clusters.init( allocator, max_meshlets * 2 );
+    groups.init( allocator, max_meshlets / k_cluster_group_size + 1 );
+    group_children.init( allocator, max_meshlets * 2 );
+    indices.init( allocator, index_count * 2 );
+}
+
+void ClusterLod::shutdown() {
+    clusters.shutdown();
+    groups.shutdown();
+    group_children.shutdown();
+    indices.shutdown();
+}
+
+void ClusterLod::build( const f32* positions, u32 vertex_count, u32 position_stride, const u32* source_indices, u32 source_index_count ) {
+    ZoneScoped;
+
+    clusters.clear();
+    groups.clear();
+    group_children.clear();
+    indices.clear();
+    level_count = 0;
+    root_count = 0;
+
+    ClusterLodScratch scratch;
+    scratch.init( allocator, vertex_count, source_index_count );
+
+    meshopt_Stream position_stream = { positions, sizeof( f32 ) * 3, position_stride };
+    const u32 position_count = ( u32 )meshopt_generateVertexRemapMulti( scratch.position_ids.data, source_indices, source_index_count, vertex_count, &position_stream, 1 );
+    scratch.position_cluster_offsets.set_size( position_count + 1 );
+
+    // Simplification errors are relative to the mesh extents.
+    const f32 error_scale = meshopt_simplifyScale( positions, vertex_count, position_stride );
+
+    append_clusters( *this, scratch, positions, vertex_count, position_stride, source_indices, source_index_count, nullptr, 0, nullptr, 0.f );
+    for ( u32 c = 0; c < clusters.size; ++c ) {
+        scratch.pending.push( c );
+    }
+
+    u32 level = 0;
+    while ( scratch.pending.size > 1 && level + 1 < k_cluster_lod_max_levels ) {
+        const u32 group_count = group_pending_clusters( *this, scratch );
+
+        // Positions used by more than one group are the group borders.
+        for ( u32 c = 0; c < scratch.pending.size; ++c ) {
+            const ClusterLodCluster& cluster = clusters[ scratch.pending[ c ] ];
+            const u32 group = scratch.pending_group[ c ];
+            for ( u32 i = 0; i < cluster.index_count; ++i ) {
+                u32& position_group = scratch.position_group[ scratch.position_ids[ indices[ cluster.index_offset + i ] ] ];
+                position_group = ( position_group == u32_max || position_group == group ) ? group : k_position_shared;
+            }
+        }
+
+        scratch.next_pending.clear();
+
+        for ( u32 g = 0; g < group_count; ++g ) {
+            const u32* group_clusters = scratch.group_clusters.data + scratch.group_offsets[ g ];
+            const u32 group_cluster_count = scratch.group_offsets[ g + 1 ] - scratch.group_offsets[ g ];
+
+            u32 group_index_count = 0;
+            f32 children_error = 0.f;
+            for ( u32 m = 0; m < group_cluster_count; ++m ) {
+                group_index_count += clusters[ group_clusters[ m ] ].index_count;
+                children_error = raptor::max( children_error, clusters[ group_clusters[ m ] ].error );
+            }
+
+            f32 simplify_error = 0.f;
+            const u32 simplified_count = simplify_group( *this, scratch, group_clusters, group_cluster_count, positions, position_stride, error_scale, simplify_error );
+
+            if ( simplified_count == 0 || simplified_count > group_index_count * k_cluster_min_reduction ) {
+                // Stuck: clusters stay roots, and their positions must not move in the following levels.
+                for ( u32 m = 0; m < group_cluster_count; ++m ) {
+                    const ClusterLodCluster& cluster = clusters[ group_clusters[ m ] ];
+                    for ( u32 i = 0; i < cluster.index_count; ++i ) {
+                        scratch.position_frozen[ scratch.position_ids[ indices[ cluster.index_offset + i ] ] ] = 1;
+                    }
+                }
+                continue;
+            }
+
+            ClusterLodGroup group;
+            group.level = level;
+            group.child_offset = group_children.size;
+            group.child_count = group_cluster_count;
+            group.bounds = merge_bounds( *this, group_clusters, group_cluster_count );
+            group.error = children_error + simplify_error;
+
+            const u32 group_index = groups.size;
+            for ( u32 m = 0; m < group_cluster_count; ++m ) {
+                ClusterLodCluster& cluster = clusters[ group_clusters[ m ] ];
+                cluster.parent_bounds = group.bounds;
+                cluster.parent_error = group.error;
+                cluster.group_index = group_index;
+
+                group_children.push( group_clusters[ m ] );
+            }
+
+            group.cluster_offset = clusters.size;
+            append_clusters( *this, scratch, scratch.local_positions.data, scratch.local_to_global.size, sizeof( f32 ) * 3, scratch.simplified_indices.data, simplified_count,
+                             scratch.local_to_global.data, level + 1, &group.bounds, group.error );
+            group.cluster_count = clusters.size - group.cluster_offset;
+
+            for ( u32 c = group.cluster_offset; c < clusters.size; ++c ) {
+                scratch.next_pending.push( c );
+            }
+
+            groups.push( group );
+        }
+
+        // Reset group borders of this level.
+        for ( u32 c = 0; c < scratch.pending.size; ++c ) {
+            const ClusterLodCluster& cluster = clusters[ scratch.pending[ c ] ];
+            for ( u32 i = 0; i < cluster.index_count; ++i ) {
+                scratch.position_group[ scratch.position_ids[ indices[ cluster.index_offset + i ] ] ] = u32_max;
+            }
+        }
+
+        if ( scratch.next_pending.size == 0 ) {
+            break;
+        }
+
+        ++level;
+
+        Array<u32> swap = scratch.pending;
+        scratch.pending = scratch.next_pending;
+        scratch.next_pending = swap;
+    }
+
+    level_count = level + 1;
+
+    for ( u32 c = 0; c < clusters.size; ++c ) {
+        root_count += clusters[ c ].group_index == u32_max ? 1 : 0;
+    }
+
+    scratch.shutdown();
+}
+
+u32 ClusterLod::select_cut( const vec3s& camera_position, f32 error_to_pixels, f32 pixel_error_threshold, Array<u32>& out_clusters ) const {
+    u32 triangle_count = 0;
+
+    // Group bounds and errors are monotonic along the DAG, so each cluster can be tested on its own.
+    for ( u32 c = 0; c < clusters.size; ++c ) {
+        const ClusterLodCluster& cluster = clusters[ c ];
+
+        const bool error_acceptable = cluster.level == 0 || cluster_lod_projected_error( cluster.bounds, cluster.error, camera_position, error_to_pixels ) <= pixel_error_threshold;
+        const bool parent_error_acceptable = cluster.group_index != u32_max && cluster_lod_projected_error( cluster.parent_bounds, cluster.parent_error, camera_position, error_to_pixels ) <= pixel_error_threshold;
+
+        if ( error_acceptable && !parent_error_acceptable ) {
+            out_clusters.push( c );
+            triangle_count += cluster.index_count / 3;
+        }
+    }
+
+    return triangle_count;
+}
+
+f32 cluster_lod_projected_error( const vec4s& bounds, f32 error, const vec3s& camera_position, f32 error_to_pixels ) {
+    const f32 distance = glms_vec3_distance( vec3s{ bounds.x, bounds.y, bounds.z }, camera_position ) - bounds.w;
+
+    return error * error_to_pixels / raptor::max( distance, FLT_EPSILON );
+}
+
+} // namespace raptor
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "foundation/array.hpp"
+
+#include "external/cglm/types-struct.h"
+
+namespace raptor {
+
+static const u32        k_cluster_lod_max_levels    = 16;
+
+//
+// Meshlet sized triangle list, either from the source mesh or from the simplification of a group.
+struct ClusterLodCluster {
+
+    u32                 index_offset;       // Into ClusterLod::indices, triangles with source vertex indices.
+    u32                 index_count;
+    u32                 vertex_count;
+    u32                 level;
+
+    // Bounds and error of the group this cluster was generated from, shared by all its siblings.
+    // Source clusters use their own bounds and zero error.
+    vec4s               bounds;
+    f32                 error;
+
+    // Bounds and error of the group this cluster was simplified into.
+    vec4s               parent_bounds;
+    f32                 parent_error;
+
+    u32                 group_index;        // u32_max when the cluster is a root.
+}; // struct ClusterLodCluster
+
+//
+// Adjacent clusters simplified together with locked borders, then split again into clusters.
+struct ClusterLodGroup {
+
+    u32                 level;
+    u32                 child_offset;       // Into ClusterLod::group_children.
+    u32                 child_count;
+    u32                 cluster_offset;     // Generated clusters are contiguous.
+    u32                 cluster_count;
+
+    vec4s               bounds;             // Encloses the bounds of all children.
+    f32                 error;              // Object space, never smaller than the error of any children.
+}; // struct ClusterLodGroup
+
+//
+// Cluster hierarchy: a DAG where each group of clusters generates the clusters of the next level.
+// Any cut through it where clusters have an acceptable error and their parents do not is watertight.
+struct ClusterLod {
+
+    void                init( Allocator* allocator, u32 index_count );
+    void                shutdown();
+
+    // Builds the hierarchy of a triangle list. Positions are 3 floats every position_stride bytes.
+    void                build( const f32* positions, u32 vertex_count, u32 position_stride, const u32* source_indices, u32 source_index_count );
+
+    // Reference cut selection, camera position in object space. Returns the selected triangle count.
+    // error_to_pixels converts an error at distance 1 to pixels, for a perspective camera projection_11 * resolution_y * 0.5.
+    u32                 select_cut( const vec3s& camera_position, f32 error_to_pixels, f32 pixel_error_threshold, Array<u32>& out_clusters ) const;
+
+    Array<ClusterLodCluster> clusters;
+    Array<ClusterLodGroup> groups;
+    Array<u32>          group_children;
+    Array<u32>          indices;
+
+    Allocator*          allocator           = nullptr;
+    u32                 level_count         = 0;
+    u32                 root_count          = 0;
+
+}; // struct ClusterLod
+
+// Error in pixels seen from the closest point of the bounding sphere.
+f32                     cluster_lod_projected_error( const vec4s& bounds, f32 error, const vec3s& camera_position, f32 error_to_pixels );
+
+} // namespace raptor
@@ -21,6 +21,7 @@ void CommandBuffer::reset() {
     current_framebuffer = nullptr;
     current_pipeline = nullptr;
     current_command = 0;
+    pipeline_statistics_query_active = false;
 
     vkResetDescriptorPool( gpu_device->vulkan_device, vk_descriptor_pool, 0 );
 
@@ -41,6 +42,7 @@ static const u32 k_descriptor_sets_pool_size = 4096;
 void CommandBuffer::init( GpuDevice* gpu ) {
 
     gpu_device = gpu;
+    queue_type = QueueType::Graphics;
 
     // Create Descriptor Pools
     static const u32 k_global_pool_elements = 128;
@@ -109,6 +111,28 @@ void CommandBuffer::begin_secondary( RenderPass* current_render_pass_, Framebuff
         inheritance.renderPass = current_render_pass_->vk_render_pass;
         inheritance.subpass = 0;
         inheritance.framebuffer = current_framebuffer_->vk_framebuffer;
+        // The primary command buffers count the pipeline statistics for the whole frame.
+        inheritance.pipelineStatistics = k_pipeline_statistics_flags;
+
+        // With dynamic rendering the attachment formats replace the render pass.
+        VkFormat color_formats[ k_max_image_outputs ];
+        VkCommandBufferInheritanceRenderingInfoKHR rendering_inheritance{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR };
+
+        if ( gpu_device->dynamic_rendering_extension_present ) {
+            for ( u32 a = 0; a < current_framebuffer_->num_color_attachments; ++a ) {
+                color_formats[ a ] = gpu_device->access_texture( current_framebuffer_->color_attachments[ a ] )->vk_format;
+            }
+
+            rendering_inheritance.viewMask = current_render_pass_->multiview_mask;
+            rendering_inheritance.colorAttachmentCount = current_framebuffer_->num_color_attachments;
+            rendering_inheritance.pColorAttachmentFormats = color_formats;
+            if ( current_framebuffer_->depth_stencil_attachment.index != k_invalid_index ) {
+                rendering_inheritance.depthAttachmentFormat = gpu_device->access_texture( current_framebuffer_->depth_stencil_attachment )->vk_format;
+            }
+            rendering_inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+            inheritance.pNext = &rendering_inheritance;
+        }
 
         VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
@@ -119,6 +143,7 @@ void CommandBuffer::begin_secondary( RenderPass* current_render_pass_, Framebuff
         is_recording = true;
 
         current_render_pass = current_render_pass_;
+        current_framebuffer = current_framebuffer_;
     }
 }
 
@@ -131,6 +156,10 @@ void CommandBuffer::end() {
     }
 }
 
+void CommandBuffer::execute_commands( CommandBuffer* secondary_command_buffer ) {
+    vkCmdExecuteCommands( vk_command_buffer, 1, &secondary_command_buffer->vk_command_buffer );
+}
+
 void CommandBuffer::end_current_render_pass() {
     if ( is_recording && current_render_pass != nullptr ) {
         if ( gpu_device->dynamic_rendering_extension_present ) {
@@ -606,74 +635,209 @@ void CommandBuffer::issue_buffer_barrier( BufferHandle buffer_handle, ResourceSt
 
 void CommandBuffer::issue_texture_barrier( TextureHandle texture_handle, ResourceState new_state, u32 mip_level, u32 mip_count ) {
     Texture* texture = gpu_device->access_texture( texture_handle );
-    util_add_image_barrier( gpu_device, vk_command_buffer, texture, new_state, mip_level, mip_count, TextureFormat::has_depth( texture->vk_format ) );
-}
-//
-//void CommandBuffer::barrier( const ExecutionBarrier& barrier ) {
-//
-//    if ( current_render_pass ) {
-//        vkCmdEndRenderPass( vk_command_buffer );
-//
-//        current_render_pass = nullptr;
-//        current_framebuffer = nullptr;
-//    }
-//
-//    if ( gpu_device->synchronization2_extension_present ) {
-//
-//        VkImageMemoryBarrier2KHR image_barriers[ 8 ];
-//
-//        for ( u32 i = 0; i < barrier.num_image_barriers; ++i ) {
-//            const ImageBarrier& source_barrier = barrier.image_barriers[ i ];
-//            Texture* texture = gpu_device->access_texture( source_barrier.texture );
-//
-//            VkImageMemoryBarrier2KHR& barrier = image_barriers[ i ];
-//            barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR };
-//            barrier.srcAccessMask = util_to_vk_access_flags2( texture->state );
-//            barrier.srcStageMask = util_determine_pipeline_stage_flags2( barrier.srcAccessMask, QueueType::Graphics );
-//            barrier.dstAccessMask = util_to_vk_access_flags2( source_barrier.destination_state );
-//            barrier.dstStageMask = util_determine_pipeline_stage_flags2( barrier.dstAccessMask, QueueType::Graphics );
-//            barrier.oldLayout = util_to_vk_image_layout2( texture->state );
-//            barrier.newLayout = util_to_vk_image_layout2( source_barrier.destination_state );
-//            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-//            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-//            barrier.image = texture->vk_image;
-//            barrier.subresourceRange.aspectMask = TextureFormat::has_depth_or_stencil( texture->vk_format ) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
-//            barrier.subresourceRange.baseArrayLayer = source_barrier.array_base_layer;
-//            barrier.subresourceRange.layerCount = source_barrier.array_layer_count;
-//            barrier.subresourceRange.baseMipLevel = source_barrier.mip_base_level;
-//            barrier.subresourceRange.levelCount = source_barrier.mip_level_count;
-//        }
-//
-//        VkBufferMemoryBarrier2KHR buffer_barriers[ 8 ];
-//
-//        for ( u32 i = 0; i < barrier.num_buffer_barriers; ++i ) {
-//            const BufferBarrier& source_barrier = barrier.buffer_barriers[ i ];
-//            Buffer* buffer = gpu_device->access_buffer( source_barrier.buffer );
-//
-//            VkBufferMemoryBarrier2KHR& barrier = buffer_barriers[ i ];
-//            barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR };
-//            barrier.srcAccessMask = util_to_vk_access_flags2( source_barrier.source_state );
-//            barrier.srcStageMask = util_determine_pipeline_stage_flags2( barrier.srcAccessMask, QueueType::Graphics );
-//            barrier.dstAccessMask = util_to_vk_access_flags2( source_barrier.destination_state );
-//            barrier.dstStageMask = util_determine_pipeline_stage_flags2( barrier.dstAccessMask, QueueType::Graphics );
-//            barrier.buffer = buffer->vk_buffer;
-//            barrier.offset = source_barrier.offset;
-//            barrier.size = source_barrier.offset > 0 ? source_barrier.offset : buffer->size;
-//        }
-//
-//        VkDependencyInfoKHR dependency_info{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
-//        dependency_info.imageMemoryBarrierCount = barrier.num_image_barriers;
-//        dependency_info.pImageMemoryBarriers = image_barriers;
-//        dependency_info.pBufferMemoryBarriers = buffer_barriers;
-//        dependency_info.bufferMemoryBarrierCount = barrier.num_buffer_barriers;
-//
-//        gpu_device->vkCmdPipelineBarrier2KHR( vk_command_buffer, &dependency_info );
-//    }
-//    else {
-//        // TODO: implement
-//        RASSERT( false );
-//    }
-//}
+    util_add_image_barrier( gpu_device, vk_command_buffer, texture, new_state, mip_level, mip_count, TextureFormat::has_depth( texture->vk_format ), queue_type );
+}
+
+static u32 queue_family_from_type( GpuDevice* gpu, QueueType::Enum queue_type ) {
+    switch ( queue_type ) {
+        case QueueType::Compute: return gpu->vulkan_compute_queue_family;
+        case QueueType::CopyTransfer: return gpu->vulkan_transfer_queue_family;
+        default: return gpu->vulkan_main_queue_family;
+    }
+}
+
+void CommandBuffer::transfer_texture_ownership( TextureHandle texture_handle, QueueType::Enum source_queue_type, QueueType::Enum destination_queue_type ) {
+    Texture* texture = gpu_device->access_texture( texture_handle );
+
+    // Stages of the other queue are ignored, the ones of this queue are valid for both operations.
+    util_add_image_barrier_ext( gpu_device, vk_command_buffer, texture, texture->state, 0, texture->mip_level_count, 0, texture->array_layer_count,
+                                TextureFormat::has_depth( texture->vk_format ), queue_family_from_type( gpu_device, source_queue_type ),
+                                queue_family_from_type( gpu_device, destination_queue_type ), queue_type, queue_type );
+}
+
+void CommandBuffer::transfer_buffer_ownership( BufferHandle buffer_handle, ResourceState state, QueueType::Enum source_queue_type, QueueType::Enum destination_queue_type ) {
+    Buffer* buffer = gpu_device->access_buffer( buffer_handle );
+
+    util_add_buffer_barrier_ext( gpu_device, vk_command_buffer, buffer->vk_buffer, state, state, buffer->size, queue_family_from_type( gpu_device, source_queue_type ),
+                                 queue_family_from_type( gpu_device, destination_queue_type ), queue_type, queue_type );
+}
+
+// Dependency of the barriers with synchronization 2, from the states tracked in the textures. Textures keep their state.
+static void fill_dependency_info2( GpuDevice* gpu_device, QueueType::Enum queue_type, const ExecutionBarrier& barrier, VkImageMemoryBarrier2KHR* image_barriers,
+                                   VkBufferMemoryBarrier2KHR* buffer_barriers, VkDependencyInfoKHR& dependency_info ) {
+
+    for ( u32 i = 0; i < barrier.num_image_barriers; ++i ) {
+        const ImageBarrier& source_barrier = barrier.image_barriers[ i ];
+        Texture* texture = gpu_device->access_texture( source_barrier.texture );
+
+        const ResourceState source_state = source_barrier.discard ? RESOURCE_STATE_UNDEFINED : texture->state;
+
+        VkImageMemoryBarrier2KHR& image_barrier = image_barriers[ i ];
+        image_barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR };
+        image_barrier.srcAccessMask = util_to_vk_access_flags2( source_state );
+        // Memory shared with other resources: wait for all their work before taking it over.
+        image_barrier.srcStageMask = source_barrier.discard ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR : util_determine_pipeline_stage_flags2( image_barrier.srcAccessMask, queue_type );
+        image_barrier.dstAccessMask = util_to_vk_access_flags2( source_barrier.destination_state );
+        image_barrier.dstStageMask = util_determine_pipeline_stage_flags2( image_barrier.dstAccessMask, queue_type );
+        image_barrier.oldLayout = util_to_vk_image_layout2( source_state );
+        image_barrier.newLayout = util_to_vk_image_layout2( source_barrier.destination_state );
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = texture->vk_image;
+        image_barrier.subresourceRange.aspectMask = TextureFormat::has_depth( texture->vk_format ) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        image_barrier.subresourceRange.baseArrayLayer = source_barrier.array_base_layer;
+        image_barrier.subresourceRange.layerCount = source_barrier.array_layer_count;
+        image_barrier.subresourceRange.baseMipLevel = source_barrier.mip_base_level;
+        image_barrier.subresourceRange.levelCount = source_barrier.mip_level_count;
+    }
+
+    for ( u32 i = 0; i < barrier.num_buffer_barriers; ++i ) {
+        const BufferBarrier& source_barrier = barrier.buffer_barriers[ i ];
+        Buffer* buffer = gpu_device->access_buffer( source_barrier.buffer );
+
+        VkBufferMemoryBarrier2KHR& buffer_barrier = buffer_barriers[ i ];
+        buffer_barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR };
+        buffer_barrier.srcAccessMask = util_to_vk_access_flags2( source_barrier.source_state );
+        buffer_barrier.srcStageMask = util_determine_pipeline_stage_flags2( buffer_barrier.srcAccessMask, queue_type );
+        buffer_barrier.dstAccessMask = util_to_vk_access_flags2( source_barrier.destination_state );
+        buffer_barrier.dstStageMask = util_determine_pipeline_stage_flags2( buffer_barrier.dstAccessMask, queue_type );
+        buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.buffer = buffer->vk_buffer;
+        buffer_barrier.offset = source_barrier.offset;
+        buffer_barrier.size = source_barrier.size > 0 ? source_barrier.size : VK_WHOLE_SIZE;
+    }
+
+    dependency_info = { VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependency_info.imageMemoryBarrierCount = barrier.num_image_barriers;
+    dependency_info.pImageMemoryBarriers = image_barriers;
+    dependency_info.pBufferMemoryBarriers = buffer_barriers;
+    dependency_info.bufferMemoryBarrierCount = barrier.num_buffer_barriers;
+}
+
+static void update_texture_states( GpuDevice* gpu_device, const ExecutionBarrier& barrier ) {
+    for ( u32 i = 0; i < barrier.num_image_barriers; ++i ) {
+        Texture* texture = gpu_device->access_texture( barrier.image_barriers[ i ].texture );
+        texture->state = barrier.image_barriers[ i ].destination_state;
+    }
+}
+
+void CommandBuffer::barrier( const ExecutionBarrier& barrier ) {
+
+    if ( barrier.num_image_barriers == 0 && barrier.num_buffer_barriers == 0 ) {
+        return;
+    }
+
+    // Barriers are not allowed inside a render pass.
+    end_current_render_pass();
+
+    if ( gpu_device->synchronization2_extension_present ) {
+
+        VkImageMemoryBarrier2KHR image_barriers[ ExecutionBarrier::k_max_barriers ];
+        VkBufferMemoryBarrier2KHR buffer_barriers[ ExecutionBarrier::k_max_barriers ];
+        VkDependencyInfoKHR dependency_info;
+        fill_dependency_info2( gpu_device, queue_type, barrier, image_barriers, buffer_barriers, dependency_info );
+
+        gpu_device->vkCmdPipelineBarrier2KHR( vk_command_buffer, &dependency_info );
+
+        update_texture_states( gpu_device, barrier );
+    }
+    else {
+        // Without synchronization 2 the stages of all barriers are merged in a single call.
+        VkPipelineStageFlags source_stage_mask = 0;
+        VkPipelineStageFlags destination_stage_mask = 0;
+
+        VkImageMemoryBarrier image_barriers[ ExecutionBarrier::k_max_barriers ];
+
+        for ( u32 i = 0; i < barrier.num_image_barriers; ++i ) {
+            const ImageBarrier& source_barrier = barrier.image_barriers[ i ];
+            Texture* texture = gpu_device->access_texture( source_barrier.texture );
+
+            const ResourceState source_state = source_barrier.discard ? RESOURCE_STATE_UNDEFINED : texture->state;
+
+            VkImageMemoryBarrier& image_barrier = image_barriers[ i ];
+            image_barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            image_barrier.srcAccessMask = util_to_vk_access_flags( source_state );
+            image_barrier.dstAccessMask = util_to_vk_access_flags( source_barrier.destination_state );
+            image_barrier.oldLayout = util_to_vk_image_layout( source_state );
+            image_barrier.newLayout = util_to_vk_image_layout( source_barrier.destination_state );
+            image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.image = texture->vk_image;
+            image_barrier.subresourceRange.aspectMask = TextureFormat::has_depth( texture->vk_format ) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            image_barrier.subresourceRange.baseArrayLayer = source_barrier.array_base_layer;
+            image_barrier.subresourceRange.layerCount = source_barrier.array_layer_count;
+            image_barrier.subresourceRange.baseMipLevel = source_barrier.mip_base_level;
+            image_barrier.subresourceRange.levelCount = source_barrier.mip_level_count;
+
+            source_stage_mask |= source_barrier.discard ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : util_determine_pipeline_stage_flags( image_barrier.srcAccessMask, queue_type );
+            destination_stage_mask |= util_determine_pipeline_stage_flags( image_barrier.dstAccessMask, queue_type );
+
+            texture->state = source_barrier.destination_state;
+        }
+
+        VkBufferMemoryBarrier buffer_barriers[ ExecutionBarrier::k_max_barriers ];
+
+        for ( u32 i = 0; i < barrier.num_buffer_barriers; ++i ) {
+            const BufferBarrier& source_barrier = barrier.buffer_barriers[ i ];
+            Buffer* buffer = gpu_device->access_buffer( source_barrier.buffer );
+
+            VkBufferMemoryBarrier& buffer_barrier = buffer_barriers[ i ];
+            buffer_barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+            buffer_barrier.srcAccessMask = util_to_vk_access_flags( source_barrier.source_state );
+            buffer_barrier.dstAccessMask = util_to_vk_access_flags( source_barrier.destination_state );
+            buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.buffer = buffer->vk_buffer;
+            buffer_barrier.offset = source_barrier.offset;
+            buffer_barrier.size = source_barrier.size > 0 ? source_barrier.size : VK_WHOLE_SIZE;
+
+            source_stage_mask |= util_determine_pipeline_stage_flags( buffer_barrier.srcAccessMask, queue_type );
+            destination_stage_mask |= util_determine_pipeline_stage_flags( buffer_barrier.dstAccessMask, queue_type );
+        }
+
+        vkCmdPipelineBarrier( vk_command_buffer, source_stage_mask, destination_stage_mask, 0,
+                              0, nullptr, barrier.num_buffer_barriers, buffer_barriers, barrier.num_image_barriers, image_barriers );
+    }
+}
+
+void CommandBuffer::set_event( VkEvent event, const ExecutionBarrier& barrier ) {
+    RASSERT( gpu_device->synchronization2_extension_present );
+
+    end_current_render_pass();
+
+    VkImageMemoryBarrier2KHR image_barriers[ ExecutionBarrier::k_max_barriers ];
+    VkBufferMemoryBarrier2KHR buffer_barriers[ ExecutionBarrier::k_max_barriers ];
+    VkDependencyInfoKHR dependency_info;
+    fill_dependency_info2( gpu_device, queue_type, barrier, image_barriers, buffer_barriers, dependency_info );
+
+    gpu_device->vkCmdSetEvent2KHR( vk_command_buffer, event, &dependency_info );
+}
+
+void CommandBuffer::wait_event( VkEvent event, const ExecutionBarrier& barrier ) {
+    RASSERT( gpu_device->synchronization2_extension_present );
+
+    end_current_render_pass();
+
+    VkImageMemoryBarrier2KHR image_barriers[ ExecutionBarrier::k_max_barriers ];
+    VkBufferMemoryBarrier2KHR buffer_barriers[ ExecutionBarrier::k_max_barriers ];
+    VkDependencyInfoKHR dependency_info;
+    fill_dependency_info2( gpu_device, queue_type, barrier, image_barriers, buffer_barriers, dependency_info );
+
+    gpu_device->vkCmdWaitEvents2KHR( vk_command_buffer, 1, &event, &dependency_info );
+
+    update_texture_states( gpu_device, barrier );
+
+    // Reset once the wait is done, so that the event can be set again.
+    VkPipelineStageFlags2KHR wait_stages = 0;
+    for ( u32 i = 0; i < barrier.num_image_barriers; ++i ) {
+        wait_stages |= image_barriers[ i ].dstStageMask;
+    }
+    for ( u32 i = 0; i < barrier.num_buffer_barriers; ++i ) {
+        wait_stages |= buffer_barriers[ i ].dstStageMask;
+    }
+    gpu_device->vkCmdResetEvent2KHR( vk_command_buffer, event, wait_stages != 0 ? wait_stages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR );
+}
 
 void CommandBuffer::clear_color_image( TextureHandle texture, VkClearColorValue clear_color ) {
     Texture* vk_texture = gpu_device->access_texture( texture );
@@ -687,7 +851,7 @@ void CommandBuffer::clear_color_image( TextureHandle texture, VkClearColorValue
 
     ResourceState old_state = vk_texture->state;
 
-    util_add_image_barrier( gpu_device, vk_command_buffer, vk_texture, ResourceState::RESOURCE_STATE_COPY_DEST, 0, VK_REMAINING_MIP_LEVELS, false );
+    util_add_image_barrier( gpu_device, vk_command_buffer, vk_texture, ResourceState::RESOURCE_STATE_COPY_DEST, 0, VK_REMAINING_MIP_LEVELS, false, queue_type );
 
     vkCmdClearColorImage( vk_command_buffer, vk_texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color, 1, &range );
 }
@@ -727,13 +891,21 @@ u32 CommandBuffer::get_subgroup_sized( u32 group ) {
 }
 
 void CommandBuffer::upload_texture_data( TextureHandle texture_handle, void* texture_data, BufferHandle staging_buffer_handle, sizet staging_buffer_offset ) {
+    Texture* texture = gpu_device->access_texture( texture_handle );
+
+    upload_texture_data( texture_handle, texture_data, staging_buffer_handle, staging_buffer_offset, 0, texture->height );
+}
+
+void CommandBuffer::upload_texture_data( TextureHandle texture_handle, void* texture_data, BufferHandle staging_buffer_handle, sizet staging_buffer_offset, u32 first_row, u32 row_count ) {
 
     Texture* texture = gpu_device->access_texture( texture_handle );
     Buffer* staging_buffer = gpu_device->access_buffer( staging_buffer_handle );
-    u32 image_size = texture->width * texture->height * 4;
+    const u32 row_size = texture->width * 4;
 
-    // Copy buffer_data to staging buffer
-    memcpy( staging_buffer->mapped_data + staging_buffer_offset, texture_data, static_cast< size_t >( image_size ) );
+    // Copy buffer_data to staging buffer, unless it was decoded there.
+    if ( texture_data ) {
+        memcpy( staging_buffer->mapped_data + staging_buffer_offset, ( u8* )texture_data + ( sizet )first_row * row_size, static_cast< size_t >( row_count ) * row_size );
+    }
 
     VkBufferImageCopy region = {};
     region.bufferOffset = staging_buffer_offset;
@@ -745,18 +917,58 @@ void CommandBuffer::upload_texture_data( TextureHandle texture_handle, void* tex
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
 
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { texture->width, texture->height, texture->depth };
+    region.imageOffset = { 0, ( i32 )first_row, 0 };
+    region.imageExtent = { texture->width, row_count, texture->depth };
 
     // Pre copy memory barrier to perform layout transition
-    util_add_image_barrier( gpu_device, vk_command_buffer, texture, RESOURCE_STATE_COPY_DEST, 0, 1, false );
+    if ( first_row == 0 ) {
+        util_add_image_barrier( gpu_device, vk_command_buffer, texture, RESOURCE_STATE_COPY_DEST, 0, 1, false );
+    }
     // Copy from the staging buffer to the image
     vkCmdCopyBufferToImage( vk_command_buffer, staging_buffer->vk_buffer, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
 
     // Post copy memory barrier
-    util_add_image_barrier_ext( gpu_device,vk_command_buffer, texture, RESOURCE_STATE_COPY_SOURCE,
-                                0, 1, 0, 1, false, gpu_device->vulkan_transfer_queue_family, gpu_device->vulkan_main_queue_family,
-                                QueueType::CopyTransfer, QueueType::Graphics );
+    if ( first_row + row_count == texture->height ) {
+        util_add_image_barrier_ext( gpu_device,vk_command_buffer, texture, RESOURCE_STATE_COPY_SOURCE,
+                                    0, 1, 0, 1, false, gpu_device->vulkan_transfer_queue_family, gpu_device->vulkan_main_queue_family,
+                                    QueueType::CopyTransfer, QueueType::Graphics );
+    }
+}
+
+void CommandBuffer::upload_texture_mips( TextureHandle texture_handle, BufferHandle staging_buffer_handle, const sizet* staging_buffer_offsets, u32 first_mip, u32 mip_count ) {
+
+    Texture* texture = gpu_device->access_texture( texture_handle );
+    Buffer* staging_buffer = gpu_device->access_buffer( staging_buffer_handle );
+
+    RASSERT( mip_count <= 16 );
+    VkBufferImageCopy regions[ 16 ]{ };
+
+    for ( u32 m = 0; m < mip_count; ++m ) {
+        const u32 mip = first_mip + m;
+        const u32 mip_width = raptor::max( texture->width >> mip, 1 );
+        const u32 mip_height = raptor::max( texture->height >> mip, 1 );
+
+        VkBufferImageCopy& region = regions[ m ];
+        region.bufferOffset = staging_buffer_offsets[ m ];
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { mip_width, mip_height, 1 };
+    }
+
+    // The previous content of the mips is discarded.
+    util_add_image_barrier( gpu_device, vk_command_buffer, texture->vk_image, RESOURCE_STATE_UNDEFINED, RESOURCE_STATE_COPY_DEST, first_mip, mip_count, false );
+
+    vkCmdCopyBufferToImage( vk_command_buffer, staging_buffer->vk_buffer, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mip_count, regions );
+
+    // Released one mip at a time, the graphics queue acquires them the same way whatever the uploads that staged them.
+    for ( u32 mip = first_mip; mip < first_mip + mip_count; ++mip ) {
+        util_add_image_barrier_ext( gpu_device, vk_command_buffer, texture->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_SHADER_RESOURCE,
+                                    mip, 1, 0, 1, false, gpu_device->vulkan_transfer_queue_family, gpu_device->vulkan_main_queue_family,
+                                    QueueType::CopyTransfer, QueueType::Graphics );
+    }
 }
 
 void CommandBuffer::copy_texture( TextureHandle src_, TextureHandle dst_, ResourceState dst_state ) {
@@ -784,24 +996,24 @@ void CommandBuffer::copy_texture( TextureHandle src_, TextureHandle dst_, Resour
     region.extent = { src->width, src->height, src->depth };
 
     // Copy from the staging buffer to the image
-    util_add_image_barrier( gpu_device, vk_command_buffer, src, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, src, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth, queue_type );
     // TODO(marco): maybe we need a state per mip?
     ResourceState old_state = dst->state;
-    util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_DEST, 0, 1, dst_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_DEST, 0, 1, dst_is_depth, queue_type );
 
     vkCmdCopyImage( vk_command_buffer, src->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
 
     // Prepare first mip to create lower mipmaps
     if ( dst->mip_level_count > 1 ) {
         RASSERT( !dst_is_depth );
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_SOURCE, 0, 1, dst_is_depth );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_SOURCE, 0, 1, dst_is_depth, queue_type );
     }
 
     i32 w = dst->width;
     i32 h = dst->height;
 
     for ( int mip_index = 1; mip_index < dst->mip_level_count; ++mip_index ) {
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, old_state, RESOURCE_STATE_COPY_DEST, mip_index, 1, dst_is_depth );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, old_state, RESOURCE_STATE_COPY_DEST, mip_index, 1, dst_is_depth, queue_type );
 
         VkImageBlit blit_region{ };
         blit_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -826,11 +1038,11 @@ void CommandBuffer::copy_texture( TextureHandle src_, TextureHandle dst_, Resour
         vkCmdBlitImage( vk_command_buffer, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region, VK_FILTER_LINEAR );
 
         // Prepare current mip for next level
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_COPY_SOURCE, mip_index, 1, dst_is_depth );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_COPY_SOURCE, mip_index, 1, dst_is_depth, queue_type );
     }
 
     // Transition
-    util_add_image_barrier( gpu_device, vk_command_buffer, dst, dst_state, 0, dst->mip_level_count, dst_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, dst, dst_state, 0, dst->mip_level_count, dst_is_depth, queue_type );
 }
 
 void CommandBuffer::copy_texture( TextureHandle src_, TextureSubResource src_sub, TextureHandle dst_, TextureSubResource dst_sub, ResourceState dst_state ) {
@@ -855,23 +1067,23 @@ void CommandBuffer::copy_texture( TextureHandle src_, TextureSubResource src_sub
     region.extent = { src->width, src->height, src->depth };
 
     // Copy from the staging buffer to the image
-    util_add_image_barrier( gpu_device, vk_command_buffer, src, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, src, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth, queue_type );
     // TODO(marco): maybe we need a state per mip?
     ResourceState old_state = dst->state;
-    util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_DEST, 0, 1, dst_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_DEST, 0, 1, dst_is_depth, queue_type );
 
     vkCmdCopyImage( vk_command_buffer, src->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
 
     // Prepare first mip to create lower mipmaps
     if ( dst->mip_level_count > 1 ) {
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst, RESOURCE_STATE_COPY_SOURCE, 0, 1, src_is_depth, queue_type );
     }
 
     i32 w = dst->width;
     i32 h = dst->height;
 
     for ( int mip_index = 1; mip_index < dst->mip_level_count; ++mip_index ) {
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, old_state, RESOURCE_STATE_COPY_DEST, mip_index, 1, dst_is_depth );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, old_state, RESOURCE_STATE_COPY_DEST, mip_index, 1, dst_is_depth, queue_type );
 
         VkImageBlit blit_region{ };
         blit_region.srcSubresource.aspectMask = src_is_depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
@@ -896,11 +1108,11 @@ void CommandBuffer::copy_texture( TextureHandle src_, TextureSubResource src_sub
         vkCmdBlitImage( vk_command_buffer, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit_region, VK_FILTER_LINEAR );
 
         // Prepare current mip for next level
-        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_COPY_SOURCE, mip_index, 1, false );
+        util_add_image_barrier( gpu_device, vk_command_buffer, dst->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_COPY_SOURCE, mip_index, 1, false, queue_type );
     }
 
     // Transition
-    util_add_image_barrier( gpu_device, vk_command_buffer, dst, dst_state, 0, dst->mip_level_count, dst_is_depth );
+    util_add_image_barrier( gpu_device, vk_command_buffer, dst, dst_state, 0, dst->mip_level_count, dst_is_depth, queue_type );
 }
 
 void CommandBuffer::copy_buffer( BufferHandle src, sizet src_offset, BufferHandle dst, sizet dst_offset, sizet size ) {
@@ -916,24 +1128,31 @@ void CommandBuffer::copy_buffer( BufferHandle src, sizet src_offset, BufferHandl
 }
 
 void CommandBuffer::upload_buffer_data( BufferHandle buffer_handle, void* buffer_data, BufferHandle staging_buffer_handle, sizet staging_buffer_offset ) {
+    Buffer* buffer = gpu_device->access_buffer( buffer_handle );
+
+    upload_buffer_data( buffer_handle, buffer_data, staging_buffer_handle, staging_buffer_offset, 0, buffer->size );
+}
+
+void CommandBuffer::upload_buffer_data( BufferHandle buffer_handle, void* buffer_data, BufferHandle staging_buffer_handle, sizet staging_buffer_offset, u32 offset, u32 size ) {
 
     Buffer* buffer = gpu_device->access_buffer( buffer_handle );
     Buffer* staging_buffer = gpu_device->access_buffer( staging_buffer_handle );
-    u32 copy_size = buffer->size;
 
     // Copy buffer_data to staging buffer
-    memcpy( staging_buffer->mapped_data + staging_buffer_offset, buffer_data, static_cast< size_t >( copy_size ) );
+    memcpy( staging_buffer->mapped_data + staging_buffer_offset, ( u8* )buffer_data + offset, static_cast< size_t >( size ) );
 
     VkBufferCopy region{};
     region.srcOffset = staging_buffer_offset;
-    region.dstOffset = 0;
-    region.size = copy_size;
+    region.dstOffset = offset;
+    region.size = size;
 
     vkCmdCopyBuffer( vk_command_buffer, staging_buffer->vk_buffer, buffer->vk_buffer, 1, &region );
 
-    util_add_buffer_barrier_ext( gpu_device, vk_command_buffer, buffer->vk_buffer, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_UNDEFINED,
-                                 copy_size, gpu_device->vulkan_transfer_queue_family, gpu_device->vulkan_main_queue_family,
-                                 QueueType::CopyTransfer, QueueType::Graphics );
+    if ( offset + size == buffer->size ) {
+        util_add_buffer_barrier_ext( gpu_device, vk_command_buffer, buffer->vk_buffer, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_UNDEFINED,
+                                     buffer->size, gpu_device->vulkan_transfer_queue_family, gpu_device->vulkan_main_queue_family,
+                                     QueueType::CopyTransfer, QueueType::Graphics );
+    }
 }
 
 void CommandBuffer::upload_buffer_data( BufferHandle src_, BufferHandle dst_ ) {
@@ -963,10 +1182,12 @@ void CommandBufferManager::init( GpuDevice* gpu_, u32 num_threads ) {
     // Init per thread-frame used buffers
     used_buffers.init( gpu->allocator, total_pools, total_pools );
     used_secondary_command_buffers.init( gpu->allocator, total_pools, total_pools );
+    used_compute_command_buffers.init( gpu->allocator, total_pools, total_pools );
 
     for ( u32 i = 0; i < total_pools; i++ ) {
         used_buffers[ i ] = 0;
         used_secondary_command_buffers[ i ] = 0;
+        used_compute_command_buffers[ i ] = 0;
     }
 
     // Create command buffers: pools * buffers per pool
@@ -1021,6 +1242,30 @@ void CommandBufferManager::init( GpuDevice* gpu_, u32 num_threads ) {
         }
     }
 
+    // Without a compute queue there are no compute pools.
+    const u32 total_compute_buffers = total_pools * num_compute_command_buffers_per_thread;
+    compute_command_buffers.init( gpu->allocator, total_compute_buffers );
+
+    for ( u32 pool_index = 0; pool_index < total_pools && gpu->thread_frame_pools[ pool_index ].vulkan_compute_command_pool != nullptr; ++pool_index ) {
+        VkCommandBufferAllocateInfo cmd = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr };
+
+        cmd.commandPool = gpu->thread_frame_pools[ pool_index ].vulkan_compute_command_pool;
+        cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmd.commandBufferCount = 1;
+
+        for ( u32 ccb_index = 0; ccb_index < num_compute_command_buffers_per_thread; ++ccb_index ) {
+            CommandBuffer cb{ };
+            vkAllocateCommandBuffers( gpu->vulkan_device, &cmd, &cb.vk_command_buffer );
+
+            cb.handle = handle++;
+            cb.thread_frame_pool = &gpu->thread_frame_pools[ pool_index ];
+            cb.init( gpu );
+            cb.queue_type = QueueType::Compute;
+
+            compute_command_buffers.push( cb );
+        }
+    }
+
     //rprint( "Done\n" );
 }
 
@@ -1034,10 +1279,16 @@ void CommandBufferManager::shutdown() {
         secondary_command_buffers[ i ].shutdown();
     }
 
+    for ( u32 i = 0; i < compute_command_buffers.size; ++i ) {
+        compute_command_buffers[ i ].shutdown();
+    }
+
     command_buffers.shutdown();
     secondary_command_buffers.shutdown();
+    compute_command_buffers.shutdown();
     used_buffers.shutdown();
     used_secondary_command_buffers.shutdown();
+    used_compute_command_buffers.shutdown();
 }
 
 void CommandBufferManager::reset_pools( u32 frame_index ) {
@@ -1046,12 +1297,17 @@ void CommandBufferManager::reset_pools( u32 frame_index ) {
         const u32 pool_index = pool_from_indices( frame_index, i );
         vkResetCommandPool( gpu->vulkan_device, gpu->thread_frame_pools[ pool_index ].vulkan_command_pool, 0 );
 
+        if ( gpu->thread_frame_pools[ pool_index ].vulkan_compute_command_pool != nullptr ) {
+            vkResetCommandPool( gpu->vulkan_device, gpu->thread_frame_pools[ pool_index ].vulkan_compute_command_pool, 0 );
+        }
+
         used_buffers[ pool_index ] = 0;
         used_secondary_command_buffers[ pool_index ] = 0;
+        used_compute_command_buffers[ pool_index ] = 0;
     }
 }
 
-CommandBuffer* CommandBufferManager::get_command_buffer( u32 frame, u32 thread_index, bool begin ) {
+CommandBuffer* CommandBufferManager::get_command_buffer( u32 frame, u32 thread_index, bool begin, bool reset_queries ) {
     const u32 pool_index = pool_from_indices( frame, thread_index );
     u32 current_used_buffer = used_buffers[ pool_index ];
     // TODO: how to handle fire-and-forget command buffers ?
@@ -1064,7 +1320,9 @@ CommandBuffer* CommandBufferManager::get_command_buffer( u32 frame, u32 thread_i
     if ( begin ) {
         cb->reset();
         cb->begin();
+    }
 
+    if ( begin && reset_queries ) {
         // Timestamp queries
         GpuThreadFramePools* thread_pools = cb->thread_frame_pool;
         thread_pools->time_queries->reset();
@@ -1074,18 +1332,36 @@ CommandBuffer* CommandBufferManager::get_command_buffer( u32 frame, u32 thread_i
         vkCmdResetQueryPool( cb->vk_command_buffer, thread_pools->vulkan_pipeline_stats_query_pool, 0, GpuPipelineStatistics::Count );
 
         vkCmdBeginQuery( cb->vk_command_buffer, thread_pools->vulkan_pipeline_stats_query_pool, 0, 0 );
+        cb->pipeline_statistics_query_active = true;
     }
     return cb;
 }
 
+CommandBuffer* CommandBufferManager::get_compute_command_buffer( u32 frame, u32 thread_index ) {
+    const u32 pool_index = pool_from_indices( frame, thread_index );
+    u32 current_used_buffer = used_compute_command_buffers[ pool_index ];
+    used_compute_command_buffers[ pool_index ] = current_used_buffer + 1;
+
+    RASSERT( current_used_buffer < num_compute_command_buffers_per_thread );
+
+    CommandBuffer* cb = &compute_command_buffers[ ( pool_index * num_compute_command_buffers_per_thread ) + current_used_buffer ];
+    cb->reset();
+    cb->begin();
+
+    return cb;
+}
+
 CommandBuffer* CommandBufferManager::get_secondary_command_buffer( u32 frame, u32 thread_index ) {
     const u32 pool_index = pool_from_indices( frame, thread_index );
     u32 current_used_buffer = used_secondary_command_buffers[ pool_index ];
+    if ( current_used_buffer >= k_secondary_command_buffers_count ) {
+        return nullptr;
+    }
     used_secondary_command_buffers[ pool_index ] = current_used_buffer + 1;
 
-    RASSERT( current_used_buffer < k_secondary_command_buffers_count );
-
     CommandBuffer* cb = &secondary_command_buffers[ ( pool_index * k_secondary_command_buffers_count ) + current_used_buffer ];
+    cb->reset();
+
     return cb;
 }
 
@@ -20,10 +20,13 @@ struct CommandBuffer {
     DescriptorSetHandle             create_descriptor_set( const DescriptorSetCreation& creation );
 
     void                            begin();
+    // Begins recording the content of a render pass, executed with execute_commands in the pass bound with use_secondary.
     void                            begin_secondary( RenderPass* current_render_pass, Framebuffer* current_framebuffer );
     void                            end();
     void                            end_current_render_pass();
 
+    void                            execute_commands( CommandBuffer* secondary_command_buffer );
+
     void                            bind_pass( RenderPassHandle handle, FramebufferHandle framebuffer, bool use_secondary );
     void                            bind_pipeline( PipelineHandle handle );
     void                            bind_vertex_buffer( BufferHandle handle, u32 binding, u32 offset );
@@ -60,8 +63,17 @@ struct CommandBuffer {
     void                            issue_buffer_barrier( BufferHandle buffer, ResourceState old_state, ResourceState new_state, QueueType::Enum source_queue_type, QueueType::Enum destination_queue_type );
     void                            issue_texture_barrier( TextureHandle texture, ResourceState new_state, u32 mip_level, u32 mip_count );
 
-    // TODO: add batched barriers
-    //void                            barrier( const ExecutionBarrier& barrier );
+    // Issues all the barriers with a single call. Image source states are the ones tracked in the textures.
+    void                            barrier( const ExecutionBarrier& barrier );
+    // Split barrier, synchronization 2 only. Both halves take the same barriers, the wait transitions the textures
+    // and resets the event. The textures have to keep their state in between.
+    void                            set_event( VkEvent event, const ExecutionBarrier& barrier );
+    void                            wait_event( VkEvent event, const ExecutionBarrier& barrier );
+
+    // Queue family ownership transfer that keeps the state: the same call records the release on the source
+    // queue command buffer and the acquire on the destination one.
+    void                            transfer_texture_ownership( TextureHandle texture, QueueType::Enum source_queue_type, QueueType::Enum destination_queue_type );
+    void                            transfer_buffer_ownership( BufferHandle buffer, ResourceState state, QueueType::Enum source_queue_type, QueueType::Enum destination_queue_type );
 
     void                            clear_color_image( TextureHandle texture, VkClearColorValue clear_color );
     void                            fill_buffer( BufferHandle buffer, u32 offset, u32 size, u32 data );
@@ -72,13 +84,22 @@ struct CommandBuffer {
     u32                             get_subgroup_sized( u32 group );
 
     // Non-drawing methods
+    // A null texture_data means the data is already at staging_buffer_offset.
     void                            upload_texture_data( TextureHandle texture, void* texture_data, BufferHandle staging_buffer, sizet staging_buffer_offset );
+    // Chunked upload of rows [first_row, first_row + row_count) of mip 0, texture_data points to the whole image.
+    // The first chunk transitions the texture, the last one releases it to the graphics queue.
+    void                            upload_texture_data( TextureHandle texture, void* texture_data, BufferHandle staging_buffer, sizet staging_buffer_offset, u32 first_row, u32 row_count );
+    // Upload of mip_count mips from first_mip, each one at its offset in the staging buffer. The mips are released
+    // to the graphics queue in shader resource state, the others are left untouched.
+    void                            upload_texture_mips( TextureHandle texture, BufferHandle staging_buffer, const sizet* staging_buffer_offsets, u32 first_mip, u32 mip_count );
     void                            copy_texture( TextureHandle src, TextureHandle dst, ResourceState dst_state );
     void                            copy_texture( TextureHandle src, TextureSubResource src_sub, TextureHandle dst, TextureSubResource dst_sub, ResourceState dst_state );
 
     void                            copy_buffer( BufferHandle src, sizet src_offset, BufferHandle dst, sizet dst_offset, sizet size );
 
     void                            upload_buffer_data( BufferHandle buffer, void* buffer_data, BufferHandle staging_buffer, sizet staging_buffer_offset );
+    // Chunked upload of size bytes at offset, buffer_data points to the whole buffer. The last chunk releases it to the graphics queue.
+    void                            upload_buffer_data( BufferHandle buffer, void* buffer_data, BufferHandle staging_buffer, sizet staging_buffer_offset, u32 offset, u32 size );
     void                            upload_buffer_data( BufferHandle src, BufferHandle dst );
 
     void                            reset();
@@ -99,7 +120,9 @@ struct CommandBuffer {
     Framebuffer*                    current_framebuffer;
     Pipeline*                       current_pipeline;
     VkClearValue                    clear_values[ k_max_image_outputs + 1 ];    // Clear value for each attachment with depth/stencil at the end.
+    QueueType::Enum                 queue_type;                                 // Of the queue it is submitted to, it determines the barrier stages.
     bool                            is_recording;
+    bool                            pipeline_statistics_query_active;           // Begun when the command buffer was taken, present ends it.
 
     u32                             handle;
 
@@ -116,20 +139,25 @@ struct CommandBufferManager {
 
     void                    reset_pools( u32 frame_index );
 
-    CommandBuffer*          get_command_buffer( u32 frame, u32 thread_index, bool begin );
+    CommandBuffer*          get_command_buffer( u32 frame, u32 thread_index, bool begin, bool reset_queries );
+    // Returns nullptr when all the secondary command buffers of the thread are used.
     CommandBuffer*          get_secondary_command_buffer( u32 frame, u32 thread_index );
+    CommandBuffer*          get_compute_command_buffer( u32 frame, u32 thread_index );
 
     u16                     pool_from_index( u32 index ) { return (u16)index / num_pools_per_frame; }
     u32                     pool_from_indices( u32 frame_index, u32 thread_index );
 
     Array<CommandBuffer>    command_buffers;
     Array<CommandBuffer>    secondary_command_buffers;
+    Array<CommandBuffer>    compute_command_buffers;    // Allocated from the compute queue family pools.
     Array<u8>               used_buffers;       // Track how many buffers were used per thread per frame.
     Array<u8>               used_secondary_command_buffers;
+    Array<u8>               used_compute_command_buffers;
 
     GpuDevice*              gpu                     = nullptr;
     u32                     num_pools_per_frame     = 0;
-    u32                     num_command_buffers_per_thread = 3;
+    u32                     num_command_buffers_per_thread = 8;      // The frame graph splits the frame when it uses async compute.
+    u32                     num_compute_command_buffers_per_thread = 4;
 
 }; // struct CommandBufferManager
 
@@ -2,9 +2,12 @@
 
 #include "foundation/file.hpp"
 #include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
 #include "foundation/string.hpp"
+#include "foundation/time.hpp"
 
 #include "graphics/command_buffer.hpp"
+#include "graphics/frame_graph_plan.hpp"
 #include "graphics/gpu_device.hpp"
 #include "graphics/gpu_resources.hpp"
 #include "graphics/render_scene.hpp"
@@ -69,6 +72,21 @@ void FrameGraph::init( FrameGraphBuilder* builder_ ) {
 
     nodes.init( allocator, FrameGraphBuilder::k_max_nodes_count );
     all_nodes.init( allocator, FrameGraphBuilder::k_max_nodes_count );
+    final_outputs.init( allocator, 4 );
+    external_reads.init( allocator, 8 );
+    compiled_graphs.init( allocator, k_max_compiled_graphs );
+
+    // Device only events, the command buffers of the graph set, wait for and reset them.
+    GpuDevice* gpu = builder->device;
+    for ( u32 e = 0; e < k_max_split_events * k_max_frames; ++e ) {
+        vk_split_events[ e ] = VK_NULL_HANDLE;
+
+        if ( gpu->synchronization2_extension_present ) {
+            VkEventCreateInfo event_info{ VK_STRUCTURE_TYPE_EVENT_CREATE_INFO };
+            event_info.flags = VK_EVENT_CREATE_DEVICE_ONLY_BIT_KHR;
+            vkCreateEvent( gpu->vulkan_device, &event_info, gpu->vulkan_allocation_callbacks, &vk_split_events[ e ] );
+        }
+    }
 }
 
 void FrameGraph::shutdown() {
@@ -77,13 +95,26 @@ void FrameGraph::shutdown() {
         FrameGraphNode* node = builder->access_node( handle );
 
         builder->device->destroy_render_pass( node->render_pass );
-        builder->device->destroy_framebuffer( node->framebuffer );
 
         node->inputs.shutdown();
         node->outputs.shutdown();
-        node->edges.shutdown();
     }
 
+    // Framebuffers are owned by the compiled graphs
+    for ( u32 i = 0; i < compiled_graphs.size; ++i ) {
+        compiled_graphs[ i ].shutdown( builder->device );
+    }
+
+    compiled_graphs.shutdown();
+
+    for ( u32 e = 0; e < k_max_split_events * k_max_frames; ++e ) {
+        if ( vk_split_events[ e ] != VK_NULL_HANDLE ) {
+            vkDestroyEvent( builder->device->vulkan_device, vk_split_events[ e ], builder->device->vulkan_allocation_callbacks );
+        }
+    }
+
+    external_reads.shutdown();
+    final_outputs.shutdown();
     all_nodes.shutdown();
     nodes.shutdown();
 
@@ -110,6 +141,14 @@ void FrameGraph::parse( cstring file_path, StackAllocator* temp_allocator ) {
     std::string name_value = graph_data.value( "name", "" );
     name = string_buffer.append_use_f( "%s", name_value.c_str() );
 
+    json graph_outputs = graph_data[ "outputs" ];
+    if ( graph_outputs.is_array() ) {
+        for ( sizet i = 0; i < graph_outputs.size(); ++i ) {
+            std::string output_name = graph_outputs[ i ];
+            final_outputs.push( string_buffer.append_use_f( "%s", output_name.c_str() ) );
+        }
+    }
+
     json passes = graph_data[ "passes" ];
     for ( sizet i = 0; i < passes.size(); ++i ) {
         json pass = passes[ i ];
@@ -124,6 +163,7 @@ void FrameGraph::parse( cstring file_path, StackAllocator* temp_allocator ) {
         std::string node_type = pass.value( "type", "" );
         node_creation.compute = node_type.compare( "compute" ) == 0;
         node_creation.ray_tracing = node_type.compare( "ray_tracing" ) == 0;
+        node_creation.async_compute = pass.value( "async_compute", false );
 
         for ( sizet ii = 0; ii < pass_inputs.size(); ++ii ) {
             json pass_input = pass_inputs[ ii ];
@@ -257,48 +297,78 @@ void FrameGraph::parse( cstring file_path, StackAllocator* temp_allocator ) {
     temp_allocator->free_marker( current_allocator_marker );
 }
 
-static void compute_edges( FrameGraph* frame_graph, FrameGraphNode* node, u32 node_index ) {
-
-    FrameGraphNodeHandle node_handle = frame_graph->all_nodes[ node_index ];
-
+// Inputs share the description of the output they read.
+static void resolve_node_inputs( FrameGraph* frame_graph, FrameGraphNode* node ) {
     for ( u32 r = 0; r < node->inputs.size; ++r ) {
         FrameGraphResource* resource = frame_graph->access_resource( node->inputs[ r ] );
 
-        {
-            FrameGraphResource* output_resource = frame_graph->get_resource( resource->name );
-            if ( output_resource == nullptr && !resource->resource_info.external ) {
+        FrameGraphResource* output_resource = frame_graph->get_resource( resource->name );
+        if ( output_resource == nullptr ) {
+            if ( !resource->resource_info.external ) {
                 // TODO(marco): external resources
-                rprint( "Requested resource %s is not produced by any node and is not external.", resource->name );
-                continue;
+                rprint( "Frame graph %s: input %s of node %s is not produced by any enabled node and is not external\n", frame_graph->name, resource->name, node->name );
             }
-
-            resource->producer = output_resource->producer;
-            resource->resource_info = output_resource->resource_info;
-            resource->output_handle = output_resource->output_handle;
+            continue;
         }
 
-        for ( u32 n = 0; n < frame_graph->all_nodes.size; ++n ) {
-            if ( n == node_index ) {
-                continue;
-            }
+        resource->producer = output_resource->producer;
+        resource->resource_info = output_resource->resource_info;
+        resource->output_handle = output_resource->output_handle;
+    }
+}
 
-            FrameGraphNodeHandle parent_handle = frame_graph->all_nodes[ n ];
-            FrameGraphNode* parent_node = frame_graph->access_node( parent_handle );
+// Uses of the resources of a node, on the output that holds each one: outputs with the same name are the same resource.
+static void add_node_uses( FrameGraph* frame_graph, FrameGraphPlan& plan, FrameGraphNode* node ) {
+    bool exports = false;
+    for ( u32 o = 0; o < node->outputs.size; ++o ) {
+        FrameGraphResource* resource = frame_graph->access_resource( node->outputs[ o ] );
+        exports = exports || ( resource->type != FrameGraphResourceType_Reference && resource->resource_info.external );
+    }
 
-            for ( u32 o = 0; o < parent_node->outputs.size; ++o ) {
-                FrameGraphResource* output_resource = frame_graph->access_resource( parent_node->outputs[ o ] );
+    plan.add_node( node->enabled, exports );
 
-                if ( strcmp( resource->name, output_resource->name ) != 0 ) {
-                    continue;
-                }
+    for ( u32 i = 0; i < node->inputs.size; ++i ) {
+        FrameGraphResource* input_resource = frame_graph->access_resource( node->inputs[ i ] );
+        plan.add_use( input_resource->output_handle.index, input_resource->type == FrameGraphResourceType_Attachment ? FrameGraphUseType::Load : FrameGraphUseType::Read );
+    }
 
-#if FRAME_GRAPH_DEBUG
-                rprint( "Adding edge for resource %s from %s [%d] to %s [%d]\n", output_resource->name, parent_node->name, n, node->name, node_index )
-#endif
+    for ( u32 o = 0; o < node->outputs.size; ++o ) {
+        FrameGraphResource* resource = frame_graph->access_resource( node->outputs[ o ] );
+        FrameGraphResource* output_resource = frame_graph->get_resource( resource->name );
+
+        if ( resource->type == FrameGraphResourceType_Reference ) {
+            plan.add_use( output_resource != nullptr ? output_resource->output_handle.index : k_invalid_index, FrameGraphUseType::Reference );
+        } else {
+            plan.add_use( output_resource != nullptr ? output_resource->output_handle.index : node->outputs[ o ].index, FrameGraphUseType::Write );
+        }
+    }
+}
 
-                parent_node->edges.push( node_handle );
+// Outputs that hold the resources a node reads or writes, including the ones it references.
+static void get_node_resources( FrameGraph* frame_graph, FrameGraphNode* node, u32 resource_count, Array<u32>& node_resources ) {
+    node_resources.clear();
+
+    for ( u32 i = 0; i < node->inputs.size; ++i ) {
+        FrameGraphResource* input_resource = frame_graph->access_resource( node->inputs[ i ] );
+
+        if ( input_resource->output_handle.index < resource_count ) {
+            node_resources.push( input_resource->output_handle.index );
+        }
+    }
+
+    for ( u32 o = 0; o < node->outputs.size; ++o ) {
+        FrameGraphResource* resource = frame_graph->access_resource( node->outputs[ o ] );
+
+        if ( resource->type == FrameGraphResourceType_Reference ) {
+            resource = frame_graph->get_resource( resource->name );
+            if ( resource == nullptr ) {
+                continue;
             }
         }
+
+        if ( resource->output_handle.index < resource_count ) {
+            node_resources.push( resource->output_handle.index );
+        }
     }
 }
 
@@ -457,255 +527,792 @@ void FrameGraph::disable_render_pass( cstring render_pass_name ) {
     node->enabled = false;
 }
 
-namespace FrameGraphNodeVisitStatus {
-    enum Enum {
-        New = 0, Visited, Added, Count
-    }; // enum Enum
-}; // namespace FrameGraphNodeVisitStatus
+void FrameGraph::add_external_read( cstring resource_name ) {
+    external_reads.push( resource_name );
+}
+
+u64 FrameGraph::compute_compile_key() {
+    u64 key = hash_calculate( builder->device->swapchain_width );
+    key = hash_calculate( builder->device->swapchain_height, key );
+    key = hash_calculate( async_compute && builder->device->async_compute_supported(), key );
+    key = hash_calculate( split_barriers && builder->device->synchronization2_extension_present, key );
+    key = hash_calculate( external_reads.size, key );
+
+    for ( u32 n = 0; n < all_nodes.size; ++n ) {
+        FrameGraphNode* node = builder->access_node( all_nodes[ n ] );
+
+        key = hash_calculate( node->enabled, key );
+        if ( !node->enabled ) {
+            continue;
+        }
+
+        for ( u32 o = 0; o < node->outputs.size; ++o ) {
+            FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
+
+            key = hash_calculate( resource->type, key );
+            if ( resource->type != FrameGraphResourceType_Attachment ) {
+                continue;
+            }
+
+            const FrameGraphResourceInfo& info = resource->resource_info;
+            key = hash_calculate( info.external, key );
+            key = hash_calculate( info.texture.format, key );
+            key = hash_calculate( info.texture.load_op, key );
+            key = hash_calculate( info.texture.compute, key );
+            key = hash_calculate( info.texture.depth, key );
+            key = hash_calculate( info.texture.scale_width, key );
+            key = hash_calculate( info.texture.scale_height, key );
+
+            // Sizes relative to the swapchain are resolved by the compile
+            if ( info.texture.scale_width == 0.f ) {
+                key = hash_calculate( info.texture.width, key );
+                key = hash_calculate( info.texture.height, key );
+            }
+        }
+    }
+
+    return key;
+}
+
+bool FrameGraph::compile() {
+    ZoneScoped;
+
+    const i64 start_time = time_now();
+
+    const u64 key = compute_compile_key();
+    if ( current_compiled_graph != k_invalid_index && compiled_graphs[ current_compiled_graph ].key == key ) {
+        return false;
+    }
+
+    ++compile_count;
+
+    for ( u32 i = 0; i < compiled_graphs.size; ++i ) {
+        if ( compiled_graphs[ i ].key == key ) {
+            ++compile_cache_hits;
+
+            use_compiled_graph( i );
+
+            last_compile_ms = time_delta_milliseconds( start_time, time_now() );
+            return true;
+        }
+    }
+
+    ++compile_cache_misses;
+
+    // When the cache is full replace the least recently used graph
+    u32 index = compiled_graphs.size;
+    if ( compiled_graphs.size < k_max_compiled_graphs ) {
+        compiled_graphs.push_use();
+    } else {
+        index = 0;
+        for ( u32 i = 1; i < compiled_graphs.size; ++i ) {
+            if ( compiled_graphs[ i ].last_used < compiled_graphs[ index ].last_used ) {
+                index = i;
+            }
+        }
+
+        compiled_graphs[ index ].shutdown( builder->device );
+    }
+
+    FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ index ];
+    compiled_graph.init( allocator, all_nodes.size, builder->resource_cache.resources.used_indices );
+    compiled_graph.key = key;
+
+    compile_graph( compiled_graph );
+    use_compiled_graph( index );
+
+    last_compile_ms = time_delta_milliseconds( start_time, time_now() );
+
+#if FRAME_GRAPH_DEBUG
+    rprint( "Frame graph compiled in %f ms, %u nodes\n", last_compile_ms, nodes.size );
+    dump_schedule();
+#endif
+
+    return true;
+}
+
+static TextureCreation get_texture_creation( FrameGraphResource* resource, u32 width, u32 height ) {
+    const FrameGraphResourceInfo& info = resource->resource_info;
+    TextureFlags::Mask texture_creation_flags = info.texture.compute ? ( TextureFlags::Mask )(TextureFlags::RenderTarget_mask | TextureFlags::Compute_mask) : TextureFlags::RenderTarget_mask;
 
-void FrameGraph::compile() {
+    TextureCreation texture_creation{ };
+    texture_creation.set_data( nullptr ).set_name( resource->name ).set_format_type( info.texture.format, TextureType::Enum::Texture2D ).set_size( width, height, info.texture.depth ).set_flags( texture_creation_flags );
+    return texture_creation;
+}
+
+void FrameGraph::compile_graph( FrameGraphCompiledGraph& compiled_graph ) {
     // TODO(marco)
     // - check that input has been produced by a different node
-    // - cull inactive nodes
 
+    // Inputs read the outputs of the enabled nodes, that can change between compiles.
     for ( u32 i = 0; i < all_nodes.size; ++i ) {
         FrameGraphNode* node = builder->access_node( all_nodes[ i ] );
+        if ( !node->enabled ) {
+            continue;
+        }
 
-        // NOTE(marco): we want to clear all edges first, then populate them. If we clear them inside the loop
-        // below we risk clearing the list after it has already been used by one of the child nodes
-        node->edges.clear();
+        for ( u32 o = 0; o < node->outputs.size; ++o ) {
+            FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
+            if ( resource->type != FrameGraphResourceType_Reference ) {
+                builder->resource_cache.resource_map.insert( hash_calculate( resource->name ), node->outputs[ o ].index );
+            }
+        }
     }
 
     for ( u32 i = 0; i < all_nodes.size; ++i ) {
         FrameGraphNode* node = builder->access_node( all_nodes[ i ] );
-        if ( !node->enabled ) {
+        if ( node->enabled ) {
+            resolve_node_inputs( this, node );
+        }
+    }
+
+    // The graph can be compiled many times, temporary arrays do not use the linear allocator
+    const u32 resource_count = builder->resource_cache.resources.used_indices;
+
+    FrameGraphPlan plan;
+    plan.init( allocator, all_nodes.size, resource_count );
+    for ( u32 i = 0; i < all_nodes.size; ++i ) {
+        add_node_uses( this, plan, builder->access_node( all_nodes[ i ] ) );
+    }
+
+    Array<u32> final_resources;
+    final_resources.init( allocator, final_outputs.size );
+
+    for ( u32 i = 0; i < final_outputs.size; ++i ) {
+        FrameGraphResource* resource = builder->get_resource( final_outputs[ i ] );
+        if ( resource == nullptr || resource->output_handle.index >= resource_count ) {
+            rprint( "Frame graph %s: final output %s is not produced by any enabled node\n", name, final_outputs[ i ] );
             continue;
         }
 
-        compute_edges( this, node, i );
+        final_resources.push( resource->output_handle.index );
     }
 
-    Array<FrameGraphNodeHandle> sorted_nodes;
-    sorted_nodes.init( &local_allocator, all_nodes.size );
+    // Positions in all_nodes
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, all_nodes.size );
+
+    frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
 
-    Array<u8> node_status;
-    node_status.init( &local_allocator, all_nodes.size, all_nodes.size );
-    memset( node_status.data, 0, sizeof( bool ) * all_nodes.size );
+    Array<u8> sorted;
+    sorted.init( allocator, all_nodes.size, all_nodes.size );
+    memset( sorted.data, 0, sizeof( u8 ) * all_nodes.size );
 
-    Array<FrameGraphNodeHandle> stack;
-    stack.init( &local_allocator, nodes.size );
+    Array<FrameGraphNodeHandle>& nodes = compiled_graph.nodes;
+
+    for ( u32 i = 0; i < sorted_nodes.size; ++i ) {
+#if FRAME_GRAPH_DEBUG
+        FrameGraphNode* node = builder->access_node( all_nodes[ sorted_nodes[ i ] ] );
+        rprint( "Node %s is at position %d\n", node->name, nodes.size );
+#endif
+
+        nodes.push( all_nodes[ sorted_nodes[ i ] ] );
+        sorted[ sorted_nodes[ i ] ] = 1;
+    }
 
-    // Topological sorting
     for ( u32 n = 0; n < all_nodes.size; ++n ) {
         FrameGraphNode* node = builder->access_node( all_nodes[ n ] );
-        if ( !node->enabled ) {
-            continue;
+        if ( node->enabled && !sorted[ n ] ) {
+            rprint( "Frame graph %s: culled node %s, no final output depends on it\n", name, node->name );
         }
+    }
 
-        stack.push( all_nodes[ n ] );
+    sorted.shutdown();
 
-        while ( stack.size > 0 ) {
-            FrameGraphNodeHandle node_handle = stack.back();
+    compute_schedule( compiled_graph, plan, sorted_nodes, async_compute && builder->device->async_compute_supported() );
 
-            if (node_status[ node_handle.index ] == FrameGraphNodeVisitStatus::Added) {
-                stack.pop();
+    // Final outputs and resources read outside the graph are used after it, other textures cannot use their memory.
+    Array<u32> kept_resources;
+    kept_resources.init( allocator, final_resources.size + external_reads.size );
+    for ( u32 i = 0; i < final_resources.size; ++i ) {
+        kept_resources.push( final_resources[ i ] );
+    }
 
-                continue;
-            }
+    for ( u32 i = 0; i < external_reads.size; ++i ) {
+        FrameGraphResource* resource = builder->get_resource( external_reads[ i ] );
+        if ( resource != nullptr && resource->output_handle.index < resource_count ) {
+            kept_resources.push( resource->output_handle.index );
+        }
+    }
+
+    Array<FrameGraphLifetime> lifetimes;
+    lifetimes.init( allocator, resource_count );
+    frame_graph_compute_lifetimes( plan, sorted_nodes, kept_resources, lifetimes, allocator );
 
-            if ( node_status[ node_handle.index ]  == FrameGraphNodeVisitStatus::Visited) {
-                node_status[ node_handle.index ] = FrameGraphNodeVisitStatus::Added;
+    kept_resources.shutdown();
+    sorted_nodes.shutdown();
+    final_resources.shutdown();
+    plan.shutdown();
+
+    // Textures created by the graph, alive from their first to their last use in the sorted nodes.
+    Array<u32> compiled_resource_indices;
+    compiled_resource_indices.init( allocator, resource_count, resource_count );
+    for ( u32 i = 0; i < resource_count; ++i ) {
+        compiled_resource_indices[ i ] = k_invalid_index;
+    }
 
-                sorted_nodes.push( node_handle );
+    for ( u32 i = 0; i < nodes.size; ++i ) {
+        FrameGraphNode* node = builder->access_node( nodes[ i ] );
 
-                stack.pop();
+        for ( u32 j = 0; j < node->outputs.size; ++j ) {
+            const u32 resource_index = node->outputs[ j ].index;
+            FrameGraphResource* resource = builder->access_resource( node->outputs[ j ] );
 
+            if ( resource->resource_info.external || resource->type != FrameGraphResourceType_Attachment || compiled_resource_indices[ resource_index ] != k_invalid_index ) {
                 continue;
             }
 
-            node_status[ node_handle.index ] = FrameGraphNodeVisitStatus::Visited;
+            FrameGraphResourceInfo& info = resource->resource_info;
 
-            FrameGraphNode* node = builder->access_node( node_handle );
+            // Resolve texture size if needed, the swapchain could have been resized since the last compile
+            if ( info.texture.scale_width > 0.f || info.texture.width == 0 || info.texture.height == 0 ) {
+                info.texture.width = builder->device->swapchain_width * info.texture.scale_width;
+                info.texture.height = builder->device->swapchain_height * info.texture.scale_height;
+            }
 
-            // Leaf node
-            if ( node->edges.size == 0 ) {
-                continue;
+            compiled_resource_indices[ resource_index ] = compiled_graph.resources.size;
+
+            FrameGraphCompiledResource compiled_resource{ };
+            compiled_resource.handle = node->outputs[ j ];
+            compiled_resource.texture = k_invalid_texture;
+            compiled_resource.width = info.texture.width;
+            compiled_resource.height = info.texture.height;
+            compiled_resource.first_node = i;
+            compiled_resource.last_node = nodes.size;
+            // Not in the plan when an output of another enabled node has the same name.
+            if ( lifetimes[ resource_index ].first_node != u32_max ) {
+                compiled_resource.first_node = lifetimes[ resource_index ].first_node;
+                compiled_resource.last_node = lifetimes[ resource_index ].last_node;
             }
+            compiled_graph.resources.push( compiled_resource );
+        }
+    }
 
-            for ( u32 r = 0; r < node->edges.size; ++r ) {
-                FrameGraphNodeHandle child_handle = node->edges[ r ];
+    // Nodes on the compute queue run alongside graphics nodes of any position:
+    // the textures they use are alive for the whole frame and do not share memory.
+    Array<u32> node_resources;
+    node_resources.init( allocator, 16 );
 
-                if ( node_status[ child_handle.index ] == FrameGraphNodeVisitStatus::New ) {
-                    stack.push( child_handle );
-                }
+    for ( u32 i = 0; i < nodes.size; ++i ) {
+        if ( compiled_graph.submissions[ compiled_graph.node_submissions[ i ] ].queue != QueueType::Compute ) {
+            continue;
+        }
+
+        get_node_resources( this, builder->access_node( nodes[ i ] ), resource_count, node_resources );
+        for ( u32 r = 0; r < node_resources.size; ++r ) {
+            const u32 compiled_index = compiled_resource_indices[ node_resources[ r ] ];
+            if ( compiled_index != k_invalid_index ) {
+                compiled_graph.resources[ compiled_index ].first_node = 0;
+                compiled_graph.resources[ compiled_index ].last_node = nodes.size;
             }
         }
     }
 
-    nodes.clear();
+    node_resources.shutdown();
+    compiled_resource_indices.shutdown();
+    lifetimes.shutdown();
+
+    place_textures( compiled_graph );
+
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+        FrameGraphResource* resource = builder->access_resource( compiled_resource.handle );
+
+        TextureCreation texture_creation = get_texture_creation( resource, compiled_resource.width, compiled_resource.height );
+        if ( compiled_graph.memory_heap.index != k_invalid_index ) {
+            texture_creation.set_memory( compiled_graph.memory_heap, compiled_resource.offset );
+        }
+
+        compiled_resource.texture = builder->device->create_texture( texture_creation );
+        resource->resource_info.texture.handle = compiled_resource.texture;
 
-    for ( i32 i = sorted_nodes.size - 1; i >= 0; --i ) {
-        FrameGraphNode* node = builder->access_node( sorted_nodes[ i ] );
 #if FRAME_GRAPH_DEBUG
-        rprint( "Node %s is at position %d\n", node->name, nodes.size );
+        rprint( "Output %s alive from node %u to %u, offset %llu size %llu\n", resource->name, compiled_resource.first_node, compiled_resource.last_node,
+                ( u64 )compiled_resource.offset, ( u64 )compiled_resource.size );
+#endif
+    }
+
+    for ( u32 i = 0; i < nodes.size; ++i ) {
+        FrameGraphNode* node = builder->access_node( nodes[ i ] );
+        RASSERT( node->enabled );
+
+        if ( node->render_pass.index == k_invalid_index ) {
+            create_render_pass( this, node );
+        }
+
+        // The framebuffers of other compiled graphs reference other textures
+        create_framebuffer( this, node );
+        compiled_graph.framebuffers.push( node->framebuffer );
+    }
+
+    compute_barriers( compiled_graph );
+
+#if FRAME_GRAPH_DEBUG
+    dump_barriers();
 #endif
+}
 
-        nodes.push( sorted_nodes[ i ] );
+void FrameGraph::place_textures( FrameGraphCompiledGraph& compiled_graph ) {
+    GpuDevice* device = builder->device;
+
+    // Textures still in the old heap are destroyed with the same delay.
+    if ( compiled_graph.memory_heap.index != k_invalid_index ) {
+        device->destroy_memory_heap( compiled_graph.memory_heap );
+        compiled_graph.memory_heap = k_invalid_memory_heap;
     }
 
-    node_status.shutdown();
-    stack.shutdown();
-    sorted_nodes.shutdown();
+    u32 memory_type_bits = u32_max;
+    sizet heap_alignment = 1;
+    compiled_graph.unaliased_size = 0;
+
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+        FrameGraphResource* resource = builder->access_resource( compiled_resource.handle );
 
-    // NOTE(marco): allocations and deallocations are used for verification purposes only
-    u32 resource_count = builder->resource_cache.resources.used_indices;
-    Array<FrameGraphNodeHandle> allocations;
-    allocations.init( &local_allocator, resource_count, resource_count );
-    for ( u32 i = 0; i < resource_count; ++i) {
-        allocations[ i ].index = k_invalid_index;
+        const VkMemoryRequirements requirements = device->get_texture_memory_requirements( get_texture_creation( resource, compiled_resource.width, compiled_resource.height ) );
+        compiled_resource.size = requirements.size;
+        compiled_resource.alignment = requirements.alignment;
+        compiled_resource.offset = 0;
+        compiled_resource.aliased = false;
+
+        memory_type_bits &= requirements.memoryTypeBits;
+        heap_alignment = raptor::max( heap_alignment, ( sizet )requirements.alignment );
+        compiled_graph.unaliased_size += requirements.size;
     }
 
-    Array<FrameGraphNodeHandle> deallocations;
-    deallocations.init( &local_allocator, resource_count, resource_count );
-    for ( u32 i = 0; i < resource_count; ++i) {
-        deallocations[ i ].index = k_invalid_index;
+    compiled_graph.peak_alive_size = 0;
+    for ( u32 n = 0; n < compiled_graph.nodes.size; ++n ) {
+        sizet alive_size = 0;
+        for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+            const FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+            if ( compiled_resource.first_node <= n && n <= compiled_resource.last_node ) {
+                alive_size += compiled_resource.size;
+            }
+        }
+        compiled_graph.peak_alive_size = raptor::max( compiled_graph.peak_alive_size, alive_size );
     }
 
-    Array<TextureHandle> free_list;
-    free_list.init( &local_allocator, resource_count );
+    Array<FrameGraphPlacement> placements;
+    placements.init( allocator, compiled_graph.resources.size );
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        const FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+        placements.push( { compiled_resource.first_node, compiled_resource.last_node, compiled_resource.size, compiled_resource.alignment, 0, false } );
+    }
 
-    size_t peak_memory = 0;
-    size_t instant_memory = 0;
+    compiled_graph.heap_size = frame_graph_place_textures( placements, allocator );
 
-    for ( u32 i = 0; i < nodes.size; ++i ) {
-        FrameGraphNode* node = builder->access_node( nodes[ i ] );
-        if ( !node->enabled ) {
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        compiled_graph.resources[ r ].offset = placements[ r ].offset;
+        compiled_graph.resources[ r ].aliased = placements[ r ].aliased;
+    }
+    placements.shutdown();
+
+    if ( compiled_graph.resources.size > 0 && memory_type_bits != 0 ) {
+        VkMemoryRequirements heap_requirements{ };
+        heap_requirements.size = compiled_graph.heap_size;
+        heap_requirements.alignment = heap_alignment;
+        heap_requirements.memoryTypeBits = memory_type_bits;
+
+        compiled_graph.memory_heap = device->create_memory_heap( heap_requirements, name );
+    }
+
+    // Without a memory type for all the textures each one has its own allocation.
+    if ( compiled_graph.memory_heap.index == k_invalid_index ) {
+        for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+            compiled_graph.resources[ r ].offset = 0;
+            compiled_graph.resources[ r ].aliased = false;
+        }
+        compiled_graph.heap_size = compiled_graph.unaliased_size;
+    }
+
+    const f64 megabyte = 1024.0 * 1024.0;
+    rprint( "Frame graph %s: %u textures, %.2f MB without aliasing, %.2f MB placed, %.2f MB peak alive\n", name, compiled_graph.resources.size,
+            compiled_graph.unaliased_size / megabyte, compiled_graph.heap_size / megabyte, compiled_graph.peak_alive_size / megabyte );
+}
+
+void FrameGraph::compute_barriers( FrameGraphCompiledGraph& compiled_graph ) {
+    const u32 resource_count = builder->resource_cache.resources.used_indices;
+
+    // States each node needs its resources in, the same the nodes used to transition to when rendering.
+    Array<FrameGraphStateRequest> requests;
+    requests.init( allocator, compiled_graph.nodes.size * 4 );
+
+    Array<u32> node_requests;
+    node_requests.init( allocator, compiled_graph.nodes.size + 1 );
+
+    for ( u32 n = 0; n < compiled_graph.nodes.size; ++n ) {
+        FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ n ] );
+
+        node_requests.push( requests.size );
+
+        // Ray tracing passes transition their own resources.
+        if ( node->ray_tracing ) {
             continue;
         }
 
-        for ( u32 j = 0; j < node->inputs.size; ++j ) {
-            FrameGraphResource* input_resource = builder->access_resource( node->inputs[ j ] );
+        for ( u32 i = 0; i < node->inputs.size; ++i ) {
+            FrameGraphResource* input_resource = builder->access_resource( node->inputs[ i ] );
             FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
 
-            if ( resource == nullptr ) {
+            if ( resource == nullptr || resource->resource_info.external ) {
                 continue;
             }
 
-            resource->ref_count++;
+            if ( input_resource->type == FrameGraphResourceType_Texture ) {
+                requests.push( { input_resource->output_handle.index, node->compute ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_PIXEL_SHADER_RESOURCE, false } );
+            } else if ( input_resource->type == FrameGraphResourceType_Attachment && !node->compute ) {
+                // For textures that are read-write check if a transition is needed.
+                const bool depth = TextureFormat::has_depth_or_stencil( resource->resource_info.texture.format );
+                requests.push( { input_resource->output_handle.index, depth ? RESOURCE_STATE_DEPTH_WRITE : RESOURCE_STATE_RENDER_TARGET, false } );
+            } else if ( input_resource->type == FrameGraphResourceType_Buffer ) {
+                requests.push( { input_resource->output_handle.index, RESOURCE_STATE_SHADER_RESOURCE, true } );
+            }
+        }
+
+        for ( u32 o = 0; o < node->outputs.size; ++o ) {
+            FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
+
+            if ( resource->type == FrameGraphResourceType_Attachment ) {
+                const bool depth = TextureFormat::has_depth( resource->resource_info.texture.format );
+
+                if ( node->compute ) {
+                    // Is this supported even ?
+                    RASSERT( !depth );
+                    requests.push( { node->outputs[ o ].index, RESOURCE_STATE_UNORDERED_ACCESS, false } );
+                } else {
+                    requests.push( { node->outputs[ o ].index, depth ? RESOURCE_STATE_DEPTH_WRITE : RESOURCE_STATE_RENDER_TARGET, false } );
+                }
+            } else if ( resource->type == FrameGraphResourceType_Buffer && !resource->resource_info.external ) {
+                requests.push( { node->outputs[ o ].index, RESOURCE_STATE_UNORDERED_ACCESS, true } );
+            }
         }
     }
 
-    for ( u32 i = 0; i < nodes.size; ++i ) {
-        FrameGraphNode* node = builder->access_node( nodes[ i ] );
-        if ( !node->enabled ) {
+    node_requests.push( requests.size );
+
+    frame_graph_plan_barriers( requests, node_requests, resource_count, compiled_graph.barriers, compiled_graph.node_barriers, allocator );
+
+    // Other textures used the memory of an aliased texture since its last frame, its producer does not keep the contents.
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        const FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+        if ( !compiled_resource.aliased ) {
             continue;
         }
 
-        for ( u32 j = 0; j < node->outputs.size; ++j ) {
-            u32 resource_index = node->outputs[ j ].index;
-            FrameGraphResource* resource = builder->access_resource( node->outputs[ j ] );
-
-            if ( !resource->resource_info.external && allocations[ resource_index ].index == k_invalid_index ) {
-                RASSERT( deallocations[ resource_index ].index == k_invalid_index )
-                allocations[ resource_index ] = nodes[ i ];
+        const u32 node_index = compiled_resource.first_node;
+        for ( u32 b = compiled_graph.node_barriers[ node_index ]; b < compiled_graph.node_barriers[ node_index + 1 ]; ++b ) {
+            FrameGraphBarrier& barrier = compiled_graph.barriers[ b ];
+            if ( !barrier.buffer && barrier.resource == compiled_resource.handle.index ) {
+                barrier.discard = true;
+            }
+        }
+    }
 
-                if ( resource->type == FrameGraphResourceType_Attachment ) {
-                    FrameGraphResourceInfo& info = resource->resource_info;
+    compiled_graph.split_events.clear();
+    if ( split_barriers && builder->device->synchronization2_extension_present ) {
+        // Ray tracing passes transition their resources themselves, the textures could change state before the wait.
+        Array<u8> split_nodes;
+        split_nodes.init( allocator, compiled_graph.nodes.size, compiled_graph.nodes.size );
+        for ( u32 n = 0; n < compiled_graph.nodes.size; ++n ) {
+            split_nodes[ n ] = builder->access_node( compiled_graph.nodes[ n ] )->ray_tracing ? 0 : 1;
+        }
 
-                    // Resolve texture size if needed
-                    if ( info.texture.width == 0 || info.texture.height == 0 ) {
-                        info.texture.width = builder->device->swapchain_width * info.texture.scale_width;
-                        info.texture.height = builder->device->swapchain_height * info.texture.scale_height;
-                    }
+        frame_graph_split_barriers( compiled_graph.barriers, compiled_graph.node_barriers, compiled_graph.node_submissions, split_nodes, k_split_min_distance,
+                                    ExecutionBarrier::k_max_barriers, compiled_graph.split_events, allocator );
 
-                    TextureFlags::Mask texture_creation_flags = info.texture.compute ? ( TextureFlags::Mask )(TextureFlags::RenderTarget_mask | TextureFlags::Compute_mask) : TextureFlags::RenderTarget_mask;
+        // Barriers of the events past the ones created are issued before their node.
+        if ( compiled_graph.split_events.size > k_max_split_events ) {
+            for ( u32 b = 0; b < compiled_graph.barriers.size; ++b ) {
+                FrameGraphBarrier& barrier = compiled_graph.barriers[ b ];
+                if ( barrier.event != u32_max && barrier.event >= k_max_split_events ) {
+                    barrier.event = u32_max;
+                }
+            }
+            compiled_graph.split_events.set_size( k_max_split_events );
+        }
 
-                    bool found_suitable_free_resource = false;
-                    if ( free_list.size > 0 ) {
-                        for ( u32 r = 0; r < free_list.size; ++r ) {
-                            TextureHandle alias_texture_handle = free_list[ r ];
-                            Texture* alias_texture = builder->device->access_texture( alias_texture_handle );
+        split_nodes.shutdown();
+    }
 
-                            if ( alias_texture->width != info.texture.width ||
-                                 alias_texture->height != info.texture.height ||
-                                 alias_texture->vk_format != info.texture.format ) {
-                                continue;
-                            }
+    node_requests.shutdown();
+    requests.shutdown();
+}
 
-                            // NOTE(marco): this texture has already been aliased, get original image
-                            if ( alias_texture->alias_texture.index != k_invalid_index ) {
-                                alias_texture_handle = alias_texture->alias_texture;
-                                alias_texture = builder->device->access_texture( alias_texture_handle );
-                            }
+void FrameGraph::dump_barriers() {
+    if ( current_compiled_graph == k_invalid_index ) {
+        return;
+    }
 
-                            TextureCreation texture_creation{ };
-                            texture_creation.set_data( nullptr ).set_alias( alias_texture_handle ).set_name( resource->name ).set_format_type( info.texture.format, TextureType::Enum::Texture2D ).set_size( info.texture.width, info.texture.height, info.texture.depth ).set_flags( texture_creation_flags );
-                            TextureHandle handle = builder->device->create_texture( texture_creation );
+    const FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ current_compiled_graph ];
 
-                            info.texture.handle = handle;
+    rprint( "Frame graph %s barriers:\n", name );
+    for ( u32 n = 0; n < compiled_graph.nodes.size; ++n ) {
+        FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ n ] );
+        rprint( "%u %s\n", n, node->name );
 
-                            free_list.delete_swap( r );
-                            found_suitable_free_resource = true;
-                            break;
-                        }
-                    }
+        for ( u32 b = compiled_graph.node_barriers[ n ]; b < compiled_graph.node_barriers[ n + 1 ]; ++b ) {
+            const FrameGraphBarrier& barrier = compiled_graph.barriers[ b ];
+            FrameGraphResource* resource = builder->access_resource( { barrier.resource } );
 
-                    if ( !found_suitable_free_resource ) {
-                        TextureCreation texture_creation{ };
-                        texture_creation.set_data( nullptr ).set_name( resource->name ).set_format_type( info.texture.format, TextureType::Enum::Texture2D ).set_size( info.texture.width, info.texture.height, info.texture.depth ).set_flags( texture_creation_flags );
-                        TextureHandle handle = builder->device->create_texture( texture_creation );
+            rprint( "\t%s %s 0x%x -> 0x%x%s", barrier.buffer ? "buffer" : "texture", resource->name, barrier.source_state, barrier.destination_state, barrier.discard ? " discard" : "" );
+            if ( barrier.event != u32_max ) {
+                rprint( ", split after %u", barrier.release_node );
+            }
+            rprint( "\n" );
+        }
+    }
+}
 
-                        info.texture.handle = handle;
-                    }
-                }
+// Async compute nodes stay on the graphics queue when they write a resource used after the graph.
+static bool writes_final_output( FrameGraph* frame_graph, FrameGraphNode* node ) {
+    for ( u32 f = 0; f < frame_graph->final_outputs.size; ++f ) {
+        for ( u32 o = 0; o < node->outputs.size; ++o ) {
+            FrameGraphResource* resource = frame_graph->access_resource( node->outputs[ o ] );
+            if ( strcmp( resource->name, frame_graph->final_outputs[ f ] ) == 0 ) {
+                return true;
+            }
+        }
 
-#if FRAME_GRAPH_DEBUG
-                rprint( "Output %s allocated on node %d\n", resource->name, nodes[ i ].index );
-#endif
+        for ( u32 i = 0; i < node->inputs.size; ++i ) {
+            FrameGraphResource* resource = frame_graph->access_resource( node->inputs[ i ] );
+            if ( resource->type == FrameGraphResourceType_Attachment && strcmp( resource->name, frame_graph->final_outputs[ f ] ) == 0 ) {
+                return true;
             }
         }
+    }
 
-        for ( u32 j = 0; j < node->inputs.size; ++j ) {
-            FrameGraphResource* input_resource = builder->access_resource( node->inputs[ j ] );
+    return false;
+}
 
-            u32 resource_index = input_resource->output_handle.index;
-            FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
+void FrameGraph::compute_schedule( FrameGraphCompiledGraph& compiled_graph, const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, bool async ) {
+    const u32 node_count = compiled_graph.nodes.size;
 
-            if ( resource == nullptr ) {
+    Array<u8> node_queues;
+    node_queues.init( allocator, node_count, node_count );
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ n ] );
+        const bool compute_queue = async && node->async_compute && ( node->compute || node->ray_tracing ) && !writes_final_output( this, node );
+
+        node_queues[ n ] = compute_queue ? QueueType::Compute : QueueType::Graphics;
+    }
+
+    frame_graph_schedule_queues( plan, sorted_nodes, node_queues, compiled_graph.submissions, compiled_graph.submission_nodes, compiled_graph.node_submissions,
+                                 compiled_graph.queue_transfers, allocator );
+
+    node_queues.shutdown();
+
+    u32 submission_counts[ 2 ] = { 0, 0 };
+    for ( u32 s = 0; s < compiled_graph.submissions.size; ++s ) {
+        ++submission_counts[ compiled_graph.submissions[ s ].queue ];
+    }
+
+    if ( submission_counts[ QueueType::Graphics ] > k_max_graphics_submissions || submission_counts[ QueueType::Compute ] > k_max_compute_submissions ) {
+        rprint( "Frame graph %s: %u graphics and %u compute submissions are too many, async compute disabled\n", name,
+                submission_counts[ QueueType::Graphics ], submission_counts[ QueueType::Compute ] );
+
+        compute_schedule( compiled_graph, plan, sorted_nodes, false );
+    }
+}
+
+void FrameGraph::dump_schedule() {
+    if ( current_compiled_graph == k_invalid_index ) {
+        return;
+    }
+
+    const FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ current_compiled_graph ];
+    static cstring queue_names[] = { "graphics", "compute" };
+
+    rprint( "Frame graph %s schedule:\n", name );
+    for ( u32 s = 0; s < compiled_graph.submissions.size; ++s ) {
+        const FrameGraphSubmission& submission = compiled_graph.submissions[ s ];
+
+        rprint( "%u %s", s, queue_names[ submission.queue ] );
+        if ( submission.wait_submission != k_invalid_index ) {
+            rprint( ", waits for %u", submission.wait_submission );
+        }
+        rprint( submission.signal ? ", signals\n" : "\n" );
+
+        for ( u32 n = submission.first_node; n < submission.first_node + submission.node_count; ++n ) {
+            FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ compiled_graph.submission_nodes[ n ] ] );
+            rprint( "\t%s\n", node->name );
+        }
+
+        if ( submission.queue != QueueType::Compute ) {
+            continue;
+        }
+
+        // Graphics submissions after the one waited for, until one waits for this or a later compute submission.
+        for ( u32 g = submission.wait_submission + 1; g < compiled_graph.submissions.size; ++g ) {
+            const FrameGraphSubmission& graphics_submission = compiled_graph.submissions[ g ];
+            if ( graphics_submission.queue != QueueType::Graphics ) {
                 continue;
             }
 
-            resource->ref_count--;
+            if ( graphics_submission.wait_submission != k_invalid_index && graphics_submission.wait_submission >= s ) {
+                break;
+            }
 
-            if ( !resource->resource_info.external && resource->ref_count == 0 ) {
-                RASSERT( deallocations[ resource_index ].index == k_invalid_index );
-                deallocations[ resource_index ] = nodes[ i ];
+            for ( u32 n = graphics_submission.first_node; n < graphics_submission.first_node + graphics_submission.node_count; ++n ) {
+                FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ compiled_graph.submission_nodes[ n ] ] );
+                rprint( "\t\toverlaps %s\n", node->name );
+            }
+        }
+    }
 
-                if ( resource->type == FrameGraphResourceType_Attachment || resource->type == FrameGraphResourceType_Texture ) {
-                    free_list.push( resource->resource_info.texture.handle );
-                }
+    const bool same_family = builder->device->vulkan_compute_queue_family == builder->device->vulkan_main_queue_family;
+    rprint( "Queue ownership transfers%s:\n", same_family ? ", not needed with the same queue family" : "" );
+    for ( u32 t = 0; t < compiled_graph.queue_transfers.size; ++t ) {
+        const FrameGraphQueueTransfer& transfer = compiled_graph.queue_transfers[ t ];
+        FrameGraphResource* resource = builder->access_resource( { transfer.resource } );
+        FrameGraphNode* release_node = builder->access_node( compiled_graph.nodes[ transfer.release_node ] );
+        FrameGraphNode* acquire_node = builder->access_node( compiled_graph.nodes[ transfer.acquire_node ] );
 
-#if FRAME_GRAPH_DEBUG
-                rprint( "Output %s deallocated on node %d\n", resource->name, nodes[ i ].index );
-#endif
-            }
+        rprint( "\t%s %s, released by %s %s%s, acquired by %s %s\n", resource->type == FrameGraphResourceType_Buffer ? "buffer" : "texture", resource->name, queue_names[ transfer.source_queue ],
+                release_node->name, transfer.release_node > transfer.acquire_node ? " in the previous frame" : "", queue_names[ transfer.destination_queue ], acquire_node->name );
+    }
+}
+
+// Returns false when the barrier is not needed.
+static bool add_graph_barrier( FrameGraph* frame_graph, GpuDevice* gpu, const FrameGraphBarrier& barrier, ExecutionBarrier& execution_barrier ) {
+    FrameGraphResource* resource = frame_graph->access_resource( { barrier.resource } );
+
+    if ( barrier.buffer ) {
+        // Buffers outputs are created by the render passes, if at all.
+        if ( resource->resource_info.buffer.handle.index == k_invalid_index ) {
+            return false;
         }
+
+        BufferBarrier buffer_barrier{ };
+        buffer_barrier.buffer = resource->resource_info.buffer.handle;
+        buffer_barrier.source_state = barrier.source_state;
+        buffer_barrier.destination_state = barrier.destination_state;
+        execution_barrier.add_buffer_barrier( buffer_barrier );
+        return true;
     }
 
-    allocations.shutdown();
-    deallocations.shutdown();
-    free_list.shutdown();
+    Texture* texture = gpu->access_texture( resource->resource_info.texture.handle );
+    if ( texture == nullptr ) {
+        return false;
+    }
 
-    for ( u32 i = 0; i < nodes.size; ++i ) {
-        FrameGraphNode* node = builder->access_node( nodes[ i ] );
-        RASSERT( node->enabled );
+    if ( texture->state == barrier.destination_state && frame_graph_is_read_only_state( barrier.destination_state ) && !barrier.discard ) {
+        return false;
+    }
 
-        if ( node->render_pass.index == k_invalid_index ) {
-            create_render_pass( this, node );
+    ImageBarrier image_barrier{ };
+    image_barrier.texture = resource->resource_info.texture.handle;
+    image_barrier.destination_state = barrier.destination_state;
+    image_barrier.discard = barrier.discard;
+    execution_barrier.add_image_barrier( image_barrier );
+    return true;
+}
+
+// Barriers of a split event. The set and the wait build them from the same texture states, so they match.
+static void get_split_event_barrier( FrameGraph* frame_graph, GpuDevice* gpu, const FrameGraphCompiledGraph& compiled_graph, u32 event_index, ExecutionBarrier& execution_barrier ) {
+    const u32 node_index = compiled_graph.split_events[ event_index ].acquire_node;
+
+    execution_barrier.reset();
+    for ( u32 b = compiled_graph.node_barriers[ node_index ]; b < compiled_graph.node_barriers[ node_index + 1 ]; ++b ) {
+        const FrameGraphBarrier& barrier = compiled_graph.barriers[ b ];
+        if ( barrier.event == event_index ) {
+            add_graph_barrier( frame_graph, gpu, barrier, execution_barrier );
         }
+    }
+}
+
+// Sets the split events released by a node, once all its work is recorded.
+static void set_node_events( FrameGraph* frame_graph, CommandBuffer* gpu_commands, const FrameGraphCompiledGraph& compiled_graph, u32 node_index, u32 current_frame_index ) {
+    GpuDevice* gpu = gpu_commands->gpu_device;
+
+    for ( u32 e = 0; e < compiled_graph.split_events.size; ++e ) {
+        if ( compiled_graph.split_events[ e ].release_node != node_index ) {
+            continue;
+        }
+
+        ExecutionBarrier execution_barrier;
+        get_split_event_barrier( frame_graph, gpu, compiled_graph, e, execution_barrier );
 
-        if ( node->framebuffer.index == k_invalid_index ) {
-            create_framebuffer( this, node );
+        if ( execution_barrier.num_image_barriers > 0 || execution_barrier.num_buffer_barriers > 0 ) {
+            gpu_commands->set_event( frame_graph->vk_split_events[ current_frame_index * FrameGraph::k_max_split_events + e ], execution_barrier );
+        }
+    }
+}
+
+// Issues the barriers of a node with a single call, or more if they do not fit in an ExecutionBarrier, then
+// waits for the split events of the node.
+static void issue_node_barriers( FrameGraph* frame_graph, CommandBuffer* gpu_commands, const FrameGraphCompiledGraph& compiled_graph, u32 node_index, u32 current_frame_index ) {
+    GpuDevice* gpu = gpu_commands->gpu_device;
+
+    ExecutionBarrier execution_barrier;
+
+    for ( u32 b = compiled_graph.node_barriers[ node_index ]; b < compiled_graph.node_barriers[ node_index + 1 ]; ++b ) {
+        const FrameGraphBarrier& barrier = compiled_graph.barriers[ b ];
+        if ( barrier.event != u32_max || !add_graph_barrier( frame_graph, gpu, barrier, execution_barrier ) ) {
+            continue;
+        }
+
+        if ( execution_barrier.num_image_barriers == ExecutionBarrier::k_max_barriers || execution_barrier.num_buffer_barriers == ExecutionBarrier::k_max_barriers ) {
+            gpu_commands->barrier( execution_barrier );
+            execution_barrier.reset();
+        }
+    }
+
+    gpu_commands->barrier( execution_barrier );
+
+    for ( u32 e = 0; e < compiled_graph.split_events.size; ++e ) {
+        if ( compiled_graph.split_events[ e ].acquire_node != node_index ) {
+            continue;
+        }
+
+        get_split_event_barrier( frame_graph, gpu, compiled_graph, e, execution_barrier );
+
+        // Empty for the set too, the event was not set.
+        if ( execution_barrier.num_image_barriers > 0 || execution_barrier.num_buffer_barriers > 0 ) {
+            gpu_commands->wait_event( frame_graph->vk_split_events[ current_frame_index * FrameGraph::k_max_split_events + e ], execution_barrier );
+        }
+    }
+}
+
+void FrameGraph::use_compiled_graph( u32 index ) {
+    FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ index ];
+    compiled_graph.last_used = compile_count;
+    current_compiled_graph = index;
+
+    for ( u32 r = 0; r < compiled_graph.resources.size; ++r ) {
+        const FrameGraphCompiledResource& compiled_resource = compiled_graph.resources[ r ];
+        FrameGraphResourceInfo& info = builder->access_resource( compiled_resource.handle )->resource_info;
+
+        info.texture.handle = compiled_resource.texture;
+        info.texture.width = compiled_resource.width;
+        info.texture.height = compiled_resource.height;
+    }
+
+    nodes.clear();
+
+    // Enabled nodes missing from the compiled graph have been culled
+    for ( u32 n = 0; n < all_nodes.size; ++n ) {
+        FrameGraphNode* node = builder->access_node( all_nodes[ n ] );
+        node->culled = node->enabled;
+    }
+
+    for ( u32 n = 0; n < compiled_graph.nodes.size; ++n ) {
+        nodes.push( compiled_graph.nodes[ n ] );
+
+        FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ n ] );
+        node->framebuffer = compiled_graph.framebuffers[ n ];
+        node->culled = false;
+
+        // Inputs share the description of the output they read, as in resolve_node_inputs
+        for ( u32 i = 0; i < node->inputs.size; ++i ) {
+            FrameGraphResource* input_resource = builder->access_resource( node->inputs[ i ] );
+            FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
+
+            if ( resource == nullptr ) {
+                continue;
+            }
+
+            input_resource->resource_info = resource->resource_info;
         }
     }
 }
@@ -719,155 +1326,191 @@ void FrameGraph::add_ui() {
     }
 }
 
-void FrameGraph::render( u32 current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene )
-{
-    for ( u32 n = 0; n < nodes.size; ++n ) {
-        ZoneScopedN("RenderPass");
+// Ownership transfers of the resources a node acquires before it runs, or releases after.
+static void issue_queue_transfers( FrameGraph* frame_graph, CommandBuffer* gpu_commands, const FrameGraphCompiledGraph& compiled_graph, u32 node_index, bool acquire ) {
+    for ( u32 t = 0; t < compiled_graph.queue_transfers.size; ++t ) {
+        const FrameGraphQueueTransfer& transfer = compiled_graph.queue_transfers[ t ];
+        if ( ( acquire ? transfer.acquire_node : transfer.release_node ) != node_index ) {
+            continue;
+        }
 
-        FrameGraphNode* node = builder->access_node( nodes[ n ] );
-        RASSERT( node->enabled );
+        // Resources created by the render passes are known to the graph only when they register them.
+        FrameGraphResource* resource = frame_graph->access_resource( { transfer.resource } );
+        if ( resource->type == FrameGraphResourceType_Buffer ) {
+            if ( resource->resource_info.buffer.handle.index != k_invalid_index ) {
+                gpu_commands->transfer_buffer_ownership( resource->resource_info.buffer.handle, RESOURCE_STATE_UNORDERED_ACCESS, transfer.source_queue, transfer.destination_queue );
+            }
+        } else if ( resource->resource_info.texture.handle.index != k_invalid_index ) {
+            gpu_commands->transfer_texture_ownership( resource->resource_info.texture.handle, transfer.source_queue, transfer.destination_queue );
+        }
+    }
+}
 
-        if ( node->compute ) {
-            gpu_commands->push_marker( node->name );
+CommandBuffer* FrameGraph::render( u32 current_frame_index, u32 thread_index, CommandBuffer* gpu_commands, RenderScene* render_scene )
+{
+    const FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ current_compiled_graph ];
+    GpuDevice* gpu = builder->device;
+
+    // Queues of the same family share the resources.
+    const bool transfer_ownership = gpu->vulkan_compute_queue_family != gpu->vulkan_main_queue_family;
+
+    // Main queue batch or compute submission of the device, for the submissions waited for.
+    u32 queued_submissions[ k_max_graphics_submissions + k_max_compute_submissions ];
+    bool new_graphics_commands = false;
+
+    for ( u32 s = 0; s < compiled_graph.submissions.size; ++s ) {
+        const FrameGraphSubmission& submission = compiled_graph.submissions[ s ];
+        CommandBuffer* commands = gpu_commands;
+
+        if ( submission.queue == QueueType::Compute ) {
+            commands = gpu->get_compute_command_buffer( thread_index, current_frame_index );
+        } else if ( submission.wait_submission != k_invalid_index ) {
+            // Only the command buffers queued from now on wait.
+            if ( !new_graphics_commands ) {
+                gpu->queue_command_buffer( gpu_commands );
+                gpu_commands = gpu->get_command_buffer( thread_index, current_frame_index, true, false );
+                commands = gpu_commands;
+            }
 
-            for ( u32 i = 0; i < node->inputs.size; ++i ) {
-                FrameGraphResource* input_resource = builder->access_resource( node->inputs[ i ] );
-                FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
+            gpu->queue_graphics_wait( queued_submissions[ submission.wait_submission ] );
+        }
 
-                if ( resource == nullptr || resource->resource_info.external ) {
-                    continue;
-                }
+        for ( u32 sn = submission.first_node; sn < submission.first_node + submission.node_count; ++sn ) {
+            ZoneScopedN("RenderPass");
 
-                if ( input_resource->type == FrameGraphResourceType_Texture ) {
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
+            const u32 n = compiled_graph.submission_nodes[ sn ];
 
-                    util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_SHADER_RESOURCE, 0, 1, TextureFormat::has_depth(texture->vk_format) );
-                } else if ( input_resource->type == FrameGraphResourceType_Attachment ) {
-                    // TODO: what to do with attachments ?
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
-                    texture = texture;
-                }
+            if ( transfer_ownership ) {
+                issue_queue_transfers( this, commands, compiled_graph, n, true );
             }
 
-            for ( u32 o = 0; o < node->outputs.size; ++o ) {
-                FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
+            FrameGraphNode* node = builder->access_node( compiled_graph.nodes[ n ] );
+            RASSERT( node->enabled );
 
-                if ( resource->type == FrameGraphResourceType_Attachment ) {
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
+            if ( node->compute ) {
+                commands->push_marker( node->name );
 
-                    if ( TextureFormat::has_depth( texture->vk_format ) ) {
-                        // Is this supported even ?
-                        RASSERT( false );
-                    } else {
-                        util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_UNORDERED_ACCESS, 0, 1, false );
-                    }
-                }
-            }
+                issue_node_barriers( this, commands, compiled_graph, n, current_frame_index );
 
-            node->graph_render_pass->pre_render( current_frame_index, gpu_commands, this, render_scene );
-            node->graph_render_pass->render( current_frame_index, gpu_commands, render_scene );
-            node->graph_render_pass->post_render( current_frame_index, gpu_commands, this, render_scene );
+                node->graph_render_pass->pre_render( current_frame_index, commands, this, render_scene );
+                node->graph_render_pass->render( current_frame_index, commands, render_scene );
+                node->graph_render_pass->post_render( current_frame_index, commands, this, render_scene );
 
-            gpu_commands->pop_marker();
-        } else if ( node->ray_tracing ) {
-            gpu_commands->push_marker( node->name );
+                commands->pop_marker();
+            } else if ( node->ray_tracing ) {
+                commands->push_marker( node->name );
 
-            node->graph_render_pass->pre_render( current_frame_index, gpu_commands, this, render_scene );
-            node->graph_render_pass->render( current_frame_index, gpu_commands, render_scene );
-            node->graph_render_pass->post_render( current_frame_index, gpu_commands, this, render_scene );
+                node->graph_render_pass->pre_render( current_frame_index, commands, this, render_scene );
+                node->graph_render_pass->render( current_frame_index, commands, render_scene );
+                node->graph_render_pass->post_render( current_frame_index, commands, this, render_scene );
 
-            gpu_commands->pop_marker();
-        }
-        else {
-            gpu_commands->push_marker( node->name );
+                commands->pop_marker();
+            }
+            else {
+                commands->push_marker( node->name );
 
-            u32 width = 0;
-            u32 height = 0;
+                issue_node_barriers( this, commands, compiled_graph, n, current_frame_index );
 
-            for ( u32 i = 0; i < node->inputs.size; ++i ) {
-                FrameGraphResource* input_resource = builder->access_resource( node->inputs[ i ] );
-                FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
+                u32 width = 0;
+                u32 height = 0;
+
+                for ( u32 i = 0; i < node->inputs.size; ++i ) {
+                    FrameGraphResource* input_resource = builder->access_resource( node->inputs[ i ] );
+                    FrameGraphResource* resource = builder->access_resource( input_resource->output_handle );
+
+                    if ( resource == nullptr || resource->resource_info.external ) {
+                        continue;
+                    }
+
+                    if ( input_resource->type == FrameGraphResourceType_Attachment ) {
+                        Texture* texture = commands->gpu_device->access_texture( resource->resource_info.texture.handle );
 
-                if ( resource == nullptr || resource->resource_info.external ) {
-                    continue;
+                        width = texture->width;
+                        height = texture->height;
+                    }
                 }
 
-                if ( input_resource->type == FrameGraphResourceType_Texture ) {
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
+                for ( u32 o = 0; o < node->outputs.size; ++o ) {
+                    FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
 
-                    util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_PIXEL_SHADER_RESOURCE, 0, 1, TextureFormat::has_depth( texture->vk_format ) );
-                } else if ( input_resource->type == FrameGraphResourceType_Attachment ) {
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
+                    if ( resource->type == FrameGraphResourceType_Attachment ) {
+                        Texture* texture = commands->gpu_device->access_texture( resource->resource_info.texture.handle );
 
-                    width = texture->width;
-                    height = texture->height;
+                        width = texture->width;
+                        height = texture->height;
 
-                    // For textures that are read-write check if a transition is needed.
-                    if ( !TextureFormat::has_depth_or_stencil( texture->vk_format ) ) {
-                        util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_RENDER_TARGET, 0, 1, false );
-                    }
-                    else {
-                        util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_DEPTH_WRITE, 0, 1, true );
+                        f32* clear_color = resource->resource_info.texture.clear_values;
+                        if ( TextureFormat::has_depth( texture->vk_format ) ) {
+                            commands->clear_depth_stencil( clear_color[ 0 ], ( u8 )clear_color[ 1 ] );
+                        } else {
+                            commands->clear( clear_color[ 0 ], clear_color[ 1 ], clear_color[ 2 ], clear_color[ 3 ], o );
+                        }
                     }
                 }
-            }
 
-            for ( u32 o = 0; o < node->outputs.size; ++o ) {
-                FrameGraphResource* resource = builder->access_resource( node->outputs[ o ] );
+                Rect2DInt scissor{ 0, 0,( u16 )width, ( u16 )height };
+                commands->set_scissor( &scissor );
 
-                if ( resource->type == FrameGraphResourceType_Attachment ) {
-                    Texture* texture = gpu_commands->gpu_device->access_texture( resource->resource_info.texture.handle );
+                Viewport viewport{ };
+                viewport.rect = { 0, 0, ( u16 )width, ( u16 )height };
+                viewport.min_depth = 0.0f;
+                viewport.max_depth = 1.0f;
 
-                    width = texture->width;
-                    height = texture->height;
+                commands->set_viewport( &viewport );
 
-                    if ( TextureFormat::has_depth( texture->vk_format ) ) {
-                        util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_DEPTH_WRITE, 0, 1, true );
+                node->graph_render_pass->pre_render( current_frame_index, commands, this, render_scene );
 
-                        f32* clear_color = resource->resource_info.texture.clear_values;
-                        gpu_commands->clear_depth_stencil( clear_color[ 0 ], ( u8 )clear_color[ 1 ] );
+                commands->bind_pass( node->render_pass, node->framebuffer, false );
 
-                    } else {
-                        util_add_image_barrier( gpu_commands->gpu_device, gpu_commands->vk_command_buffer, texture, RESOURCE_STATE_RENDER_TARGET, 0, 1, false );
+                node->graph_render_pass->render( current_frame_index, commands, render_scene );
 
-                        f32* clear_color = resource->resource_info.texture.clear_values;
-                        gpu_commands->clear( clear_color[ 0 ], clear_color[ 1 ], clear_color[ 2 ], clear_color[ 3 ], o );
-                    }
-                }
-            }
+                commands->end_current_render_pass();
 
-            Rect2DInt scissor{ 0, 0,( u16 )width, ( u16 )height };
-            gpu_commands->set_scissor( &scissor );
+                node->graph_render_pass->post_render( current_frame_index, commands, this, render_scene );
 
-            Viewport viewport{ };
-            viewport.rect = { 0, 0, ( u16 )width, ( u16 )height };
-            viewport.min_depth = 0.0f;
-            viewport.max_depth = 1.0f;
-
-            gpu_commands->set_viewport( &viewport );
+                commands->pop_marker();
+            }
 
-            node->graph_render_pass->pre_render( current_frame_index, gpu_commands, this, render_scene );
+            set_node_events( this, commands, compiled_graph, n, current_frame_index );
 
-            gpu_commands->bind_pass( node->render_pass, node->framebuffer, false );
+            if ( transfer_ownership ) {
+                issue_queue_transfers( this, commands, compiled_graph, n, false );
+            }
+        }
 
-            node->graph_render_pass->render( current_frame_index, gpu_commands, render_scene );
+        if ( submission.queue == QueueType::Compute ) {
+            queued_submissions[ s ] = gpu->queue_compute_command_buffer( commands, queued_submissions[ submission.wait_submission ] );
+            continue;
+        }
 
-            gpu_commands->end_current_render_pass();
+        new_graphics_commands = false;
 
-            node->graph_render_pass->post_render( current_frame_index, gpu_commands, this, render_scene );
+        if ( submission.signal ) {
+            gpu->queue_command_buffer( gpu_commands );
+            queued_submissions[ s ] = gpu->queue_graphics_signal();
 
-            gpu_commands->pop_marker();
+            gpu_commands = gpu->get_command_buffer( thread_index, current_frame_index, true, false );
+            new_graphics_commands = true;
         }
     }
+
+    return gpu_commands;
 }
 
 void FrameGraph::on_resize( GpuDevice& gpu, u32 new_width, u32 new_height ) {
+    // The compiled graphs are for the old size: the compile creates the textures and the framebuffers again.
+    for ( u32 i = 0; i < compiled_graphs.size; ++i ) {
+        compiled_graphs[ i ].shutdown( builder->device );
+    }
+    compiled_graphs.set_size( 0 );
+    current_compiled_graph = k_invalid_index;
+
+    compile();
+
     for ( u32 n = 0; n < nodes.size; ++n ) {
         FrameGraphNode* node = builder->access_node( nodes[ n ] );
         RASSERT( node->enabled );
 
-        gpu.resize_output_textures( node->framebuffer, new_width, new_height );
-
         node->graph_render_pass->on_resize( gpu, this, new_width, new_height );
     }
 }
@@ -884,6 +1527,44 @@ void FrameGraph::reload_shaders( RenderScene& scene, Allocator* resident_allocat
 
 void FrameGraph::debug_ui() {
 
+    if ( ImGui::CollapsingHeader( "Compile" ) ) {
+        ImGui::Text( "Compiled graphs %u / %u", compiled_graphs.size, k_max_compiled_graphs );
+        ImGui::Text( "Cache hits %u, misses %u", compile_cache_hits, compile_cache_misses );
+        ImGui::Text( "Last compile %.3f ms", last_compile_ms );
+
+        for ( u32 n = 0; n < all_nodes.size; ++n ) {
+            FrameGraphNode* node = builder->access_node( all_nodes[ n ] );
+            if ( node->culled ) {
+                ImGui::Text( "Culled %s", node->name );
+            }
+        }
+
+        if ( current_compiled_graph != k_invalid_index ) {
+            const FrameGraphCompiledGraph& compiled_graph = compiled_graphs[ current_compiled_graph ];
+            const f64 megabyte = 1024.0 * 1024.0;
+
+            ImGui::Text( "Textures %u, %.2f MB without aliasing", compiled_graph.resources.size, compiled_graph.unaliased_size / megabyte );
+            ImGui::Text( "Placed %.2f MB, peak alive %.2f MB", compiled_graph.heap_size / megabyte, compiled_graph.peak_alive_size / megabyte );
+            ImGui::Text( "Barriers %u, split events %u", compiled_graph.barriers.size, compiled_graph.split_events.size );
+            if ( ImGui::Button( "Dump barriers" ) ) {
+                dump_barriers();
+            }
+
+            ImGui::Text( "Submissions %u, queue transfers %u", compiled_graph.submissions.size, compiled_graph.queue_transfers.size );
+            if ( ImGui::Button( "Dump schedule" ) ) {
+                dump_schedule();
+            }
+        }
+    }
+
+    if ( ImGui::CollapsingHeader( "Passes" ) ) {
+        // The next compile applies the change.
+        for ( u32 n = 0; n < all_nodes.size; ++n ) {
+            FrameGraphNode* node = builder->access_node( all_nodes[ n ] );
+            ImGui::Checkbox( node->name, &node->enabled );
+        }
+    }
+
     if ( ImGui::CollapsingHeader( "Nodes" ) ) {
         for ( u32 n = 0; n < nodes.size; ++n ) {
             FrameGraphNode* node = builder->access_node( nodes[ n ] );
@@ -932,6 +1613,52 @@ FrameGraphResource* FrameGraph::access_resource( FrameGraphResourceHandle handle
     return builder->access_resource( handle );
 }
 
+// FrameGraphCompiledGraph /////////////////////////////////////////////////////////////
+
+void FrameGraphCompiledGraph::init( Allocator* allocator, u32 node_count, u32 resource_count ) {
+    nodes.init( allocator, node_count );
+    framebuffers.init( allocator, node_count );
+    resources.init( allocator, resource_count );
+    barriers.init( allocator, node_count * 2 );
+    node_barriers.init( allocator, node_count + 1 );
+    split_events.init( allocator, FrameGraph::k_max_split_events );
+    submissions.init( allocator, 8 );
+    submission_nodes.init( allocator, node_count );
+    node_submissions.init( allocator, node_count );
+    queue_transfers.init( allocator, 8 );
+
+    memory_heap = k_invalid_memory_heap;
+    heap_size = 0;
+    unaliased_size = 0;
+    peak_alive_size = 0;
+
+    key = 0;
+    last_used = 0;
+}
+
+void FrameGraphCompiledGraph::shutdown( GpuDevice* device ) {
+    // Destroying a framebuffer also destroys its attachments, that are
+    // all the textures created by the compile
+    for ( u32 i = 0; i < framebuffers.size; ++i ) {
+        device->destroy_framebuffer( framebuffers[ i ] );
+    }
+
+    if ( memory_heap.index != k_invalid_index ) {
+        device->destroy_memory_heap( memory_heap );
+    }
+
+    nodes.shutdown();
+    framebuffers.shutdown();
+    resources.shutdown();
+    barriers.shutdown();
+    node_barriers.shutdown();
+    split_events.shutdown();
+    submissions.shutdown();
+    submission_nodes.shutdown();
+    node_submissions.shutdown();
+    queue_transfers.shutdown();
+}
+
 // FrameGraphRenderPassCache /////////////////////////////////////////////////////////////
 
 void FrameGraphRenderPassCache::init( Allocator* allocator )
@@ -1043,9 +1770,8 @@ FrameGraphResourceHandle FrameGraphBuilder::create_node_output( const FrameGraph
         FrameGraphNode* producer_node = access_node( producer );
         RASSERT( producer_node != nullptr );
 
+        // The compile maps the outputs of the nodes enabled later.
         if ( producer_node->enabled ) {
-            // TODO(marco): eventually we want to allow enabling/disabling a node at runtime.
-            // We will need to patch the producer when the graph changes
             resource_cache.resource_map.insert( hash_bytes( ( void* )resource->name, strlen( creation.name ) ), resource_handle.index );
         }
     }
@@ -1089,9 +1815,9 @@ FrameGraphNodeHandle FrameGraphBuilder::create_node( const FrameGraphNodeCreatio
     node->enabled = creation.enabled;
     node->compute = creation.compute;
     node->ray_tracing = creation.ray_tracing;
+    node->async_compute = creation.async_compute;
     node->inputs.init( allocator, creation.inputs.size );
     node->outputs.init( allocator, creation.outputs.size );
-    node->edges.init( allocator, creation.outputs.size );
 
     node->framebuffer = k_invalid_framebuffer;
     node->render_pass = { k_invalid_index };
@@ -1152,6 +1878,8 @@ void FrameGraphBuilder::add_resource( cstring name, FrameGraphResourceType type,
     resource->type = type;
 
     resource->resource_info = resource_info;
+    resource->producer.index = k_invalid_index;
+    resource->output_handle = resource_handle;
     resource->ref_count = 0;
 
     resource_cache.resource_map.insert( hash_bytes( ( void* )name, strlen( name ) ), resource_handle.index );
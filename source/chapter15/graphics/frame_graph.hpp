@@ -5,6 +5,7 @@
 #include "foundation/hash_map.hpp"
 #include "foundation/service.hpp"
 
+#include "graphics/frame_graph_plan.hpp"
 #include "graphics/gpu_resources.hpp"
 
 namespace raptor {
@@ -114,12 +115,14 @@ struct FrameGraphNodeCreation {
     const char*                             name;
     bool                                    compute;
     bool                                    ray_tracing;
+    bool                                    async_compute;
 };
 
 struct FrameGraphRenderPass
 {
     virtual void                            add_ui() { }
     virtual void                            pre_render( u32 current_frame_index, CommandBuffer* gpu_commands, FrameGraph* frame_graph, RenderScene* render_scene ) { }
+    // For graphics nodes it can run on a task thread, after pre_render: it should only record the draws of the render pass.
     virtual void                            render( u32 current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene ) { }
     virtual void                            post_render( u32 current_frame_index, CommandBuffer* gpu_commands, FrameGraph* frame_graph, RenderScene* render_scene ) { }
 
@@ -146,13 +149,13 @@ struct FrameGraphNode {
     Array<FrameGraphResourceHandle>         inputs;
     Array<FrameGraphResourceHandle>         outputs;
 
-    Array<FrameGraphNodeHandle>             edges;
-
     f32                                     resolution_scale_width = 0.f;
     f32                                     resolution_scale_height = 0.f;
     bool                                    compute = false;
     bool                                    ray_tracing = false;
+    bool                                    async_compute = false;  // Compute or ray tracing node that can run on the compute queue.
     bool                                    enabled = true;
+    bool                                    culled = false;     // Enabled, but no final output depends on it.
 
     const char*                             name    = nullptr;
 };
@@ -184,6 +187,55 @@ struct FrameGraphNodeCache {
     ResourcePool                            nodes;
 };
 
+// Texture allocated by a compile for an output of the graph
+struct FrameGraphCompiledResource {
+    FrameGraphResourceHandle                handle;
+    TextureHandle                           texture;
+
+    u32                                     width;
+    u32                                     height;
+
+    // Lifetime, from the producer to the last consumer in the sorted nodes.
+    u32                                     first_node;
+    u32                                     last_node;
+
+    // Placement in the memory heap of the compiled graph.
+    sizet                                   size;
+    sizet                                   alignment;
+    sizet                                   offset;
+    bool                                    aliased;            // Shares memory with another resource.
+};
+
+// Result of a compile, reused as long as the enabled nodes, the description
+// of their outputs and the swapchain size are the same.
+struct FrameGraphCompiledGraph {
+    void                                    init( Allocator* allocator, u32 node_count, u32 resource_count );
+    void                                    shutdown( GpuDevice* device );
+
+    Array<FrameGraphNodeHandle>             nodes;          // Sorted in topological order.
+    Array<FramebufferHandle>                framebuffers;   // One for each node.
+    Array<FrameGraphCompiledResource>       resources;
+
+    Array<FrameGraphBarrier>                barriers;
+    Array<u32>                              node_barriers;  // First barrier of each node, plus the barrier count.
+    Array<FrameGraphSplitEvent>             split_events;   // Barriers with an event are set after their release node instead.
+
+    // Async compute nodes overlap the graphics nodes recorded between the submissions they wait for.
+    Array<FrameGraphSubmission>             submissions;        // In recording order, the first and the last ones are graphics.
+    Array<u32>                              submission_nodes;   // Sorted node indices, in recording order.
+    Array<u32>                              node_submissions;   // Submission of each sorted node.
+    Array<FrameGraphQueueTransfer>          queue_transfers;
+
+    // Textures with disjoint lifetimes share the memory of the heap.
+    MemoryHeapHandle                        memory_heap;
+    sizet                                   heap_size           = 0;
+    sizet                                   unaliased_size      = 0;    // Sum of the texture sizes.
+    sizet                                   peak_alive_size     = 0;    // Largest sum of the textures alive at the same node, the lower bound of the heap size.
+
+    u64                                     key         = 0;
+    u64                                     last_used   = 0;
+};
+
 //
 //
 struct FrameGraphBuilder : public Service {
@@ -231,9 +283,19 @@ struct FrameGraph {
     void                            reset();
     void                            enable_render_pass( cstring render_pass_name );
     void                            disable_render_pass( cstring render_pass_name );
-    void                            compile();
+    // The resource is read after the graph runs, like the final outputs: its texture does not share memory.
+    // Resources read by passes that do not list them as inputs, e.g. through bindless indices, need it too.
+    void                            add_external_read( cstring resource_name );
+    // Compiling again with the same enabled nodes, outputs and swapchain size reuses
+    // the cached result. Switching to another result changes the textures of the graph, passes
+    // that reference them have to update their dependent resources: returns true when it did.
+    // Cheap when nothing changed, it can run every frame to apply enabled and disabled passes.
+    bool                            compile();
     void                            add_ui();
-    void                            render( u32 current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene );
+    // Async compute nodes are recorded in command buffers for the compute queue, splitting the graphics work in
+    // more command buffers. Returns the one the frame continues with, it waits for all the compute work.
+    CommandBuffer*                  render( u32 current_frame_index, u32 thread_index, CommandBuffer* gpu_commands, RenderScene* render_scene );
+    // Compiles again for the new swapchain size, the textures of the graph change.
     void                            on_resize( GpuDevice& gpu, u32 new_width, u32 new_height );
     void                            reload_shaders( RenderScene& scene, Allocator* resident_allocator, StackAllocator* scratch_allocator );
 
@@ -247,15 +309,58 @@ struct FrameGraph {
     FrameGraphResource*             get_resource( cstring name );
     FrameGraphResource*             access_resource( FrameGraphResourceHandle handle );
 
+    u64                             compute_compile_key();
+    void                            compile_graph( FrameGraphCompiledGraph& compiled_graph );
+    // Places the textures of the compiled graph in a new memory heap, at their current sizes.
+    void                            place_textures( FrameGraphCompiledGraph& compiled_graph );
+    // Does not record or create anything on the device, it reads the nodes, the resource descriptions and the schedule.
+    void                            compute_barriers( FrameGraphCompiledGraph& compiled_graph );
+    void                            dump_barriers();
+    // Assigns the nodes to the queues and finds the waits and the ownership transfers between them.
+    // Does not access the device.
+    void                            compute_schedule( FrameGraphCompiledGraph& compiled_graph, const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, bool async );
+    void                            dump_schedule();
+    void                            use_compiled_graph( u32 index );
+
     // NOTE(marco): nodes sorted in topological order
     Array<FrameGraphNodeHandle>     nodes;
     Array<FrameGraphNodeHandle>     all_nodes;
 
+    // Resources used after the graph runs, such as the presented texture. When there are none
+    // every enabled node runs, otherwise only the nodes they or the exported resources depend on.
+    Array<cstring>                  final_outputs;
+    Array<cstring>                  external_reads;
+
+    Array<FrameGraphCompiledGraph>  compiled_graphs;
+    u32                             current_compiled_graph  = k_invalid_index;
+    u64                             compile_count           = 0;
+
+    u32                             compile_cache_hits      = 0;
+    u32                             compile_cache_misses    = 0;
+    f64                             last_compile_ms         = 0.0;
+
+    // Off by default: nodes flagged async_compute run on the compute queue only when it is enabled and the device
+    // supports it. Read by compile, changing it compiles the graph again.
+    bool                            async_compute           = false;
+    // Off by default: barriers of resources last used two or more nodes before are split with events, set after the
+    // last node that used the resource. Needs synchronization 2, changing it compiles the graph again.
+    bool                            split_barriers          = false;
+
+    static constexpr u32            k_max_compiled_graphs   = 8;
+    // Command buffers of a frame for each queue, within the ones of the command buffer manager.
+    static constexpr u32            k_max_graphics_submissions  = 6;
+    static constexpr u32            k_max_compute_submissions   = 4;
+    // Split events of a compiled graph, each frame in flight has its own events.
+    static constexpr u32            k_max_split_events      = 16;
+    static constexpr u32            k_split_min_distance    = 2;
+
     FrameGraphBuilder*              builder;
     Allocator*                      allocator;
 
     LinearAllocator                 local_allocator;
 
+    VkEvent                         vk_split_events[ k_max_split_events * k_max_frames ];   // Created with synchronization 2 only.
+
     const char*                     name = nullptr;
 };
 
@@ -0,0 +1,692 @@
+#include "graphics/frame_graph_plan.hpp"
+
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include <string.h>
+
+namespace raptor {
+
+namespace FrameGraphNodeVisitStatus {
+    enum Enum {
+        New = 0, Visited, Added, Count
+    }; // enum Enum
+}; // namespace FrameGraphNodeVisitStatus
+
+// FrameGraphPlan /////////////////////////////////////////////////////////
+
+void FrameGraphPlan::init( Allocator* allocator, u32 node_count, u32 resource_count_ ) {
+    nodes.init( allocator, node_count );
+    uses.init( allocator, node_count * 4 );
+    resource_count = resource_count_;
+}
+
+void FrameGraphPlan::shutdown() {
+    nodes.shutdown();
+    uses.shutdown();
+}
+
+void FrameGraphPlan::add_node( bool enabled, bool exports ) {
+    nodes.push( { uses.size, 0, enabled, exports } );
+}
+
+void FrameGraphPlan::add_use( u32 resource, FrameGraphUseType::Enum type ) {
+    uses.push( { resource, type } );
+    ++nodes.back().use_count;
+}
+
+// Sort ///////////////////////////////////////////////////////////////////
+
+static bool is_node_needed( const FrameGraphPlan& plan, const FrameGraphPlanNode& node, const Array<u8>& needed_resources ) {
+    if ( node.exports ) {
+        return true;
+    }
+
+    for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+        const FrameGraphPlanUse& use = plan.uses[ u ];
+        if ( use.type != FrameGraphUseType::Read && use.resource < plan.resource_count && needed_resources[ use.resource ] ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool is_input( FrameGraphUseType::Enum type ) {
+    return type == FrameGraphUseType::Read || type == FrameGraphUseType::Load;
+}
+
+void frame_graph_sort_nodes( const FrameGraphPlan& plan, const Array<u32>& final_resources, Array<u32>& sorted_nodes, Allocator* allocator ) {
+    const u32 node_count = plan.nodes.size;
+    const u32 resource_count = plan.resource_count;
+
+    sorted_nodes.clear();
+
+    // Walk back from the final resources: the resources read by a needed node are needed too.
+    Array<u8> needed_resources;
+    needed_resources.init( allocator, resource_count, resource_count );
+    memset( needed_resources.data, 0, sizeof( u8 ) * resource_count );
+
+    Array<u8> needed_nodes;
+    needed_nodes.init( allocator, node_count, node_count );
+    memset( needed_nodes.data, final_resources.size == 0 ? 1 : 0, sizeof( u8 ) * node_count );
+
+    for ( u32 f = 0; f < final_resources.size; ++f ) {
+        if ( final_resources[ f ] < resource_count ) {
+            needed_resources[ final_resources[ f ] ] = 1;
+        }
+    }
+
+    bool needed_nodes_changed = final_resources.size > 0;
+    while ( needed_nodes_changed ) {
+        needed_nodes_changed = false;
+
+        for ( u32 n = 0; n < node_count; ++n ) {
+            const FrameGraphPlanNode& node = plan.nodes[ n ];
+            if ( !node.enabled || needed_nodes[ n ] || !is_node_needed( plan, node, needed_resources ) ) {
+                continue;
+            }
+
+            needed_nodes[ n ] = 1;
+            needed_nodes_changed = true;
+
+            for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+                const FrameGraphPlanUse& use = plan.uses[ u ];
+                if ( is_input( use.type ) && use.resource < resource_count ) {
+                    needed_resources[ use.resource ] = 1;
+                }
+            }
+        }
+    }
+
+    // Nodes writing each resource, in the order they were added.
+    Array<u32> writer_offsets;
+    writer_offsets.init( allocator, resource_count + 1, resource_count + 1 );
+    memset( writer_offsets.data, 0, sizeof( u32 ) * ( resource_count + 1 ) );
+
+    for ( u32 u = 0; u < plan.uses.size; ++u ) {
+        const FrameGraphPlanUse& use = plan.uses[ u ];
+        if ( !is_input( use.type ) && use.resource < resource_count ) {
+            ++writer_offsets[ use.resource + 1 ];
+        }
+    }
+    for ( u32 r = 0; r < resource_count; ++r ) {
+        writer_offsets[ r + 1 ] += writer_offsets[ r ];
+    }
+
+    Array<u32> writers;
+    writers.init( allocator, writer_offsets[ resource_count ], writer_offsets[ resource_count ] );
+    for ( u32 n = 0; n < node_count; ++n ) {
+        const FrameGraphPlanNode& node = plan.nodes[ n ];
+        for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+            const FrameGraphPlanUse& use = plan.uses[ u ];
+            if ( !is_input( use.type ) && use.resource < resource_count ) {
+                writers[ writer_offsets[ use.resource ]++ ] = n;
+            }
+        }
+    }
+    // Offsets moved to the end of each range while filling.
+    for ( u32 r = resource_count; r > 0; --r ) {
+        writer_offsets[ r ] = writer_offsets[ r - 1 ];
+    }
+    writer_offsets[ 0 ] = 0;
+
+    // Edges from the writers of a resource to the enabled nodes that read it, counted first.
+    Array<u32> edge_offsets;
+    edge_offsets.init( allocator, node_count + 1, node_count + 1 );
+    memset( edge_offsets.data, 0, sizeof( u32 ) * ( node_count + 1 ) );
+
+    Array<u32> edges;
+    edges.init( allocator, 16 );
+
+    for ( u32 pass = 0; pass < 2; ++pass ) {
+        for ( u32 n = 0; n < node_count; ++n ) {
+            const FrameGraphPlanNode& node = plan.nodes[ n ];
+            if ( !node.enabled ) {
+                continue;
+            }
+
+            for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+                const FrameGraphPlanUse& use = plan.uses[ u ];
+                if ( !is_input( use.type ) || use.resource >= resource_count ) {
+                    continue;
+                }
+
+                for ( u32 w = writer_offsets[ use.resource ]; w < writer_offsets[ use.resource + 1 ]; ++w ) {
+                    const u32 parent = writers[ w ];
+                    if ( parent == n ) {
+                        continue;
+                    }
+
+                    if ( pass == 0 ) {
+                        ++edge_offsets[ parent + 1 ];
+                    } else {
+                        edges[ edge_offsets[ parent ]++ ] = n;
+                    }
+                }
+            }
+        }
+
+        if ( pass == 0 ) {
+            for ( u32 n = 0; n < node_count; ++n ) {
+                edge_offsets[ n + 1 ] += edge_offsets[ n ];
+            }
+            edges.set_size( edge_offsets[ node_count ] );
+        }
+    }
+    for ( u32 n = node_count; n > 0; --n ) {
+        edge_offsets[ n ] = edge_offsets[ n - 1 ];
+    }
+    edge_offsets[ 0 ] = 0;
+
+    // Topological sorting, depth first: nodes are added after all the nodes that depend on them.
+    Array<u8> node_status;
+    node_status.init( allocator, node_count, node_count );
+    memset( node_status.data, 0, sizeof( u8 ) * node_count );
+
+    Array<u32> stack;
+    stack.init( allocator, node_count );
+
+    Array<u32> reverse_sorted_nodes;
+    reverse_sorted_nodes.init( allocator, node_count );
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        if ( !plan.nodes[ n ].enabled || !needed_nodes[ n ] ) {
+            continue;
+        }
+
+        stack.push( n );
+
+        while ( stack.size > 0 ) {
+            const u32 node_index = stack.back();
+
+            if ( node_status[ node_index ] == FrameGraphNodeVisitStatus::Added ) {
+                stack.pop();
+                continue;
+            }
+
+            if ( node_status[ node_index ] == FrameGraphNodeVisitStatus::Visited ) {
+                node_status[ node_index ] = FrameGraphNodeVisitStatus::Added;
+                reverse_sorted_nodes.push( node_index );
+                stack.pop();
+                continue;
+            }
+
+            node_status[ node_index ] = FrameGraphNodeVisitStatus::Visited;
+
+            for ( u32 e = edge_offsets[ node_index ]; e < edge_offsets[ node_index + 1 ]; ++e ) {
+                const u32 child = edges[ e ];
+                if ( node_status[ child ] == FrameGraphNodeVisitStatus::New && needed_nodes[ child ] ) {
+                    stack.push( child );
+                }
+            }
+        }
+    }
+
+    for ( u32 i = reverse_sorted_nodes.size; i > 0; --i ) {
+        sorted_nodes.push( reverse_sorted_nodes[ i - 1 ] );
+    }
+
+    reverse_sorted_nodes.shutdown();
+    stack.shutdown();
+    node_status.shutdown();
+    edges.shutdown();
+    edge_offsets.shutdown();
+    writers.shutdown();
+    writer_offsets.shutdown();
+    needed_nodes.shutdown();
+    needed_resources.shutdown();
+}
+
+// Barriers ///////////////////////////////////////////////////////////////
+
+bool frame_graph_is_read_only_state( ResourceState state ) {
+    const u32 read_states = RESOURCE_STATE_GENERIC_READ | RESOURCE_STATE_DEPTH_READ | RESOURCE_STATE_SHADING_RATE_SOURCE;
+    return state != RESOURCE_STATE_UNDEFINED && ( state & ~read_states ) == 0;
+}
+
+static void add_node_transition( Array<FrameGraphBarrier>& node_transitions, const FrameGraphStateRequest& request ) {
+    for ( u32 t = 0; t < node_transitions.size; ++t ) {
+        FrameGraphBarrier& transition = node_transitions[ t ];
+        if ( transition.resource != request.resource ) {
+            continue;
+        }
+
+        if ( frame_graph_is_read_only_state( transition.destination_state ) ) {
+            transition.destination_state = request.state;
+        }
+        return;
+    }
+
+    node_transitions.push( { request.resource, RESOURCE_STATE_UNDEFINED, request.state, u32_max, u32_max, request.buffer, false } );
+}
+
+void frame_graph_plan_barriers( const Array<FrameGraphStateRequest>& requests, const Array<u32>& node_requests, u32 resource_count,
+                                Array<FrameGraphBarrier>& barriers, Array<u32>& node_barriers, Allocator* allocator ) {
+    const u32 node_count = node_requests.size > 0 ? node_requests.size - 1 : 0;
+
+    barriers.clear();
+    node_barriers.clear();
+
+    // The first pass only computes the states the frame ends with.
+    Array<ResourceState> states;
+    states.init( allocator, resource_count, resource_count );
+    for ( u32 i = 0; i < resource_count; ++i ) {
+        states[ i ] = RESOURCE_STATE_UNDEFINED;
+    }
+
+    Array<u32> last_nodes;
+    last_nodes.init( allocator, resource_count, resource_count );
+
+    Array<FrameGraphBarrier> node_transitions;
+    node_transitions.init( allocator, 16 );
+
+    for ( u32 pass = 0; pass < 2; ++pass ) {
+        // Release nodes are the ones of this frame.
+        for ( u32 i = 0; i < resource_count; ++i ) {
+            last_nodes[ i ] = u32_max;
+        }
+
+        for ( u32 n = 0; n < node_count; ++n ) {
+            if ( pass == 1 ) {
+                node_barriers.push( barriers.size );
+            }
+
+            node_transitions.clear();
+            for ( u32 r = node_requests[ n ]; r < node_requests[ n + 1 ]; ++r ) {
+                if ( requests[ r ].resource < resource_count ) {
+                    add_node_transition( node_transitions, requests[ r ] );
+                }
+            }
+
+            for ( u32 t = 0; t < node_transitions.size; ++t ) {
+                FrameGraphBarrier& transition = node_transitions[ t ];
+                ResourceState& state = states[ transition.resource ];
+
+                transition.source_state = state;
+                state = transition.destination_state;
+
+                transition.release_node = last_nodes[ transition.resource ];
+                last_nodes[ transition.resource ] = n;
+
+                if ( pass == 1 && !( transition.buffer && transition.source_state == transition.destination_state &&
+                                     frame_graph_is_read_only_state( transition.source_state ) ) ) {
+                    barriers.push( transition );
+                }
+            }
+        }
+    }
+
+    node_barriers.push( barriers.size );
+
+    node_transitions.shutdown();
+    last_nodes.shutdown();
+    states.shutdown();
+}
+
+void frame_graph_split_barriers( Array<FrameGraphBarrier>& barriers, const Array<u32>& node_barriers, const Array<u32>& node_submissions,
+                                 const Array<u8>& split_nodes, u32 min_distance, u32 max_event_barriers, Array<FrameGraphSplitEvent>& events,
+                                 Allocator* allocator ) {
+    const u32 node_count = node_barriers.size > 0 ? node_barriers.size - 1 : 0;
+
+    events.clear();
+
+    // Barriers of the events of the current node.
+    Array<u32> event_barrier_counts;
+    event_barrier_counts.init( allocator, 8 );
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        const u32 first_event = events.size;
+        event_barrier_counts.clear();
+
+        for ( u32 b = node_barriers[ n ]; b < node_barriers[ n + 1 ]; ++b ) {
+            FrameGraphBarrier& barrier = barriers[ b ];
+            barrier.event = u32_max;
+
+            const u32 release_node = barrier.release_node;
+            if ( barrier.discard || release_node == u32_max || n - release_node < min_distance || node_submissions[ release_node ] != node_submissions[ n ] ) {
+                continue;
+            }
+
+            bool split = true;
+            for ( u32 m = release_node; m <= n && split; ++m ) {
+                split = split_nodes[ m ] != 0;
+            }
+
+            if ( !split ) {
+                continue;
+            }
+
+            u32 e = first_event;
+            while ( e < events.size && events[ e ].release_node != release_node ) {
+                ++e;
+            }
+
+            if ( e == events.size ) {
+                events.push( { release_node, n } );
+                event_barrier_counts.push( 0 );
+            }
+
+            // A full event leaves the barrier to the ones issued before the node.
+            u32& event_barrier_count = event_barrier_counts[ e - first_event ];
+            if ( event_barrier_count < max_event_barriers ) {
+                ++event_barrier_count;
+                barrier.event = e;
+            }
+        }
+    }
+
+    event_barrier_counts.shutdown();
+}
+
+// Lifetimes //////////////////////////////////////////////////////////////
+
+void frame_graph_compute_lifetimes( const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, const Array<u32>& kept_resources,
+                                    Array<FrameGraphLifetime>& lifetimes, Allocator* allocator ) {
+    const u32 resource_count = plan.resource_count;
+    const u32 node_count = sorted_nodes.size;
+
+    lifetimes.set_size( resource_count );
+
+    // Last node that writes each resource.
+    Array<u32> last_writes;
+    last_writes.init( allocator, resource_count, resource_count );
+
+    for ( u32 r = 0; r < resource_count; ++r ) {
+        lifetimes[ r ] = { u32_max, 0 };
+        last_writes[ r ] = u32_max;
+    }
+
+    for ( u32 i = 0; i < node_count; ++i ) {
+        const FrameGraphPlanNode& node = plan.nodes[ sorted_nodes[ i ] ];
+
+        for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+            const FrameGraphPlanUse& use = plan.uses[ u ];
+            if ( use.resource >= resource_count ) {
+                continue;
+            }
+
+            FrameGraphLifetime& lifetime = lifetimes[ use.resource ];
+            if ( lifetime.first_node == u32_max ) {
+                lifetime.first_node = i;
+            }
+            lifetime.last_node = i;
+
+            if ( !is_input( use.type ) || use.type == FrameGraphUseType::Load ) {
+                last_writes[ use.resource ] = i;
+            }
+        }
+    }
+
+    for ( u32 r = 0; r < resource_count; ++r ) {
+        FrameGraphLifetime& lifetime = lifetimes[ r ];
+
+        // Written and not read after, by a node that loads it or by a later one.
+        if ( lifetime.first_node != u32_max && last_writes[ r ] == lifetime.last_node ) {
+            bool read_after_write = false;
+            const FrameGraphPlanNode& node = plan.nodes[ sorted_nodes[ lifetime.last_node ] ];
+            for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+                read_after_write |= plan.uses[ u ].resource == r && plan.uses[ u ].type == FrameGraphUseType::Read;
+            }
+
+            if ( !read_after_write ) {
+                lifetime.last_node = node_count;
+            }
+        }
+    }
+
+    for ( u32 k = 0; k < kept_resources.size; ++k ) {
+        if ( kept_resources[ k ] < resource_count ) {
+            lifetimes[ kept_resources[ k ] ] = { 0, node_count };
+        }
+    }
+
+    last_writes.shutdown();
+}
+
+// Queues /////////////////////////////////////////////////////////////////
+
+static void get_node_resources( const FrameGraphPlan& plan, u32 node_index, Array<u32>& node_resources ) {
+    node_resources.clear();
+
+    const FrameGraphPlanNode& node = plan.nodes[ node_index ];
+    for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+        const u32 resource = plan.uses[ u ].resource;
+        if ( resource < plan.resource_count ) {
+            node_resources.push( resource );
+        }
+    }
+}
+
+void frame_graph_schedule_queues( const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, const Array<u8>& node_queues,
+                                  Array<FrameGraphSubmission>& submissions, Array<u32>& submission_nodes, Array<u32>& node_submissions,
+                                  Array<FrameGraphQueueTransfer>& queue_transfers, Allocator* allocator ) {
+    submissions.clear();
+    submission_nodes.clear();
+    node_submissions.clear();
+    queue_transfers.clear();
+
+    const u32 node_count = sorted_nodes.size;
+    const u32 resource_count = plan.resource_count;
+
+    bool has_compute_nodes = false;
+    for ( u32 n = 0; n < node_count; ++n ) {
+        has_compute_nodes = has_compute_nodes || node_queues[ n ] == QueueType::Compute;
+    }
+
+    // Last node of each queue that used each resource, at resource * 2 + queue: in the whole frame, and so far.
+    Array<u32> frame_accesses;
+    frame_accesses.init( allocator, resource_count * 2, resource_count * 2 );
+
+    Array<u32> accesses;
+    accesses.init( allocator, resource_count * 2, resource_count * 2 );
+
+    for ( u32 i = 0; i < resource_count * 2; ++i ) {
+        frame_accesses[ i ] = u32_max;
+        accesses[ i ] = u32_max;
+    }
+
+    Array<u32> node_resources;
+    node_resources.init( allocator, 16 );
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        get_node_resources( plan, sorted_nodes[ n ], node_resources );
+
+        for ( u32 r = 0; r < node_resources.size; ++r ) {
+            frame_accesses[ node_resources[ r ] * 2 + node_queues[ n ] ] = n;
+        }
+    }
+
+    // The graph runs every frame: resources start it owned by the queue that used them last.
+    Array<u8> owners;
+    owners.init( allocator, resource_count, resource_count );
+
+    for ( u32 r = 0; r < resource_count; ++r ) {
+        const u32 graphics_access = frame_accesses[ r * 2 + QueueType::Graphics ];
+        const u32 compute_access = frame_accesses[ r * 2 + QueueType::Compute ];
+
+        if ( compute_access != u32_max && ( graphics_access == u32_max || compute_access > graphics_access ) ) {
+            owners[ r ] = QueueType::Compute;
+        } else {
+            owners[ r ] = graphics_access != u32_max ? QueueType::Graphics : QueueType::Count;
+        }
+    }
+
+    u32 open_submissions[ 2 ] = { u32_max, u32_max };
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        const u32 queue = node_queues[ n ];
+        const u32 other_queue = queue == QueueType::Graphics ? QueueType::Compute : QueueType::Graphics;
+
+        get_node_resources( plan, sorted_nodes[ n ], node_resources );
+
+        // Wait for the last node of the other queue that used any of the resources.
+        u32 wait_node = u32_max;
+        for ( u32 r = 0; r < node_resources.size; ++r ) {
+            const u32 resource_index = node_resources[ r ];
+            const u32 other_access = accesses[ resource_index * 2 + other_queue ];
+
+            if ( other_access != u32_max && ( wait_node == u32_max || other_access > wait_node ) ) {
+                wait_node = other_access;
+            }
+
+            if ( owners[ resource_index ] == other_queue ) {
+                FrameGraphQueueTransfer transfer{ };
+                transfer.resource = resource_index;
+                // By the last node of the other queue that used it, in the previous frame when none did yet.
+                transfer.release_node = other_access != u32_max ? other_access : frame_accesses[ resource_index * 2 + other_queue ];
+                transfer.acquire_node = n;
+                transfer.source_queue = ( QueueType::Enum )other_queue;
+                transfer.destination_queue = ( QueueType::Enum )queue;
+                queue_transfers.push( transfer );
+            }
+
+            owners[ resource_index ] = ( u8 )queue;
+        }
+
+        // The first graphics submission resets the queries and follows the previous frame on the main queue,
+        // compute submissions that do not depend on graphics nodes wait for it.
+        u32 wait_submission = wait_node != u32_max ? node_submissions[ wait_node ] : u32_max;
+        if ( wait_submission == u32_max && queue == QueueType::Compute ) {
+            if ( submissions.size == 0 ) {
+                submissions.push( { QueueType::Graphics, 0, 0, u32_max, false } );
+            }
+
+            wait_submission = 0;
+        }
+
+        if ( wait_submission != u32_max ) {
+            submissions[ wait_submission ].signal = true;
+
+            // Nodes added after the signal would not be waited for.
+            if ( open_submissions[ other_queue ] == wait_submission ) {
+                open_submissions[ other_queue ] = u32_max;
+            }
+
+            const u32 open_submission = open_submissions[ queue ];
+            if ( open_submission != u32_max ) {
+                const u32 open_wait = submissions[ open_submission ].wait_submission;
+                if ( open_wait == u32_max || open_wait < wait_submission ) {
+                    open_submissions[ queue ] = u32_max;
+                }
+            }
+        }
+
+        if ( open_submissions[ queue ] == u32_max ) {
+            open_submissions[ queue ] = submissions.size;
+            submissions.push( { ( QueueType::Enum )queue, 0, 0, wait_submission, false } );
+        }
+
+        node_submissions.push( open_submissions[ queue ] );
+
+        for ( u32 r = 0; r < node_resources.size; ++r ) {
+            accesses[ node_resources[ r ] * 2 + queue ] = n;
+        }
+    }
+
+    // The frame continues on the graphics queue after all the compute work, that
+    // has to be done before the next frames reuse its command buffers.
+    if ( has_compute_nodes ) {
+        u32 last_compute_submission = submissions.size - 1;
+        while ( submissions[ last_compute_submission ].queue != QueueType::Compute ) {
+            --last_compute_submission;
+        }
+
+        const FrameGraphSubmission& last_submission = submissions.back();
+        if ( last_submission.queue != QueueType::Graphics || last_submission.wait_submission != last_compute_submission ) {
+            submissions[ last_compute_submission ].signal = true;
+            submissions.push( { QueueType::Graphics, 0, 0, last_compute_submission, false } );
+        }
+    }
+
+    for ( u32 s = 0; s < submissions.size; ++s ) {
+        FrameGraphSubmission& submission = submissions[ s ];
+        submission.first_node = submission_nodes.size;
+
+        for ( u32 n = 0; n < node_count; ++n ) {
+            if ( node_submissions[ n ] == s ) {
+                submission_nodes.push( n );
+            }
+        }
+
+        submission.node_count = submission_nodes.size - submission.first_node;
+    }
+
+    owners.shutdown();
+    node_resources.shutdown();
+    accesses.shutdown();
+    frame_accesses.shutdown();
+}
+
+// Placement //////////////////////////////////////////////////////////////
+
+sizet frame_graph_place_textures( Array<FrameGraphPlacement>& placements, Allocator* allocator ) {
+    const u32 placement_count = placements.size;
+
+    Array<u32> order;
+    order.init( allocator, placement_count, placement_count );
+    for ( u32 r = 0; r < placement_count; ++r ) {
+        u32 o = r;
+        for ( ; o > 0 && placements[ order[ o - 1 ] ].size < placements[ r ].size; --o ) {
+            order[ o ] = order[ o - 1 ];
+        }
+        order[ o ] = r;
+    }
+
+    // Placed textures alive at the same time as the one being placed, sorted by offset
+    Array<u32> overlapping;
+    overlapping.init( allocator, placement_count );
+
+    sizet heap_size = 0;
+
+    for ( u32 p = 0; p < placement_count; ++p ) {
+        FrameGraphPlacement& placement = placements[ order[ p ] ];
+
+        overlapping.clear();
+        for ( u32 q = 0; q < p; ++q ) {
+            const FrameGraphPlacement& placed = placements[ order[ q ] ];
+            if ( placed.last_node < placement.first_node || placement.last_node < placed.first_node ) {
+                continue;
+            }
+
+            overlapping.push( order[ q ] );
+            for ( u32 o = overlapping.size - 1; o > 0 && placements[ overlapping[ o - 1 ] ].offset > placed.offset; --o ) {
+                overlapping[ o ] = overlapping[ o - 1 ];
+                overlapping[ o - 1 ] = order[ q ];
+            }
+        }
+
+        sizet offset = 0;
+        for ( u32 o = 0; o < overlapping.size; ++o ) {
+            const FrameGraphPlacement& placed = placements[ overlapping[ o ] ];
+            if ( offset + placement.size <= placed.offset ) {
+                break;
+            }
+
+            offset = raptor::max( offset, memory_align( placed.offset + placed.size, placement.alignment ) );
+        }
+
+        placement.offset = offset;
+        placement.aliased = false;
+        heap_size = raptor::max( heap_size, offset + placement.size );
+    }
+
+    for ( u32 a = 0; a < placement_count; ++a ) {
+        for ( u32 b = a + 1; b < placement_count; ++b ) {
+            FrameGraphPlacement& placement_a = placements[ a ];
+            FrameGraphPlacement& placement_b = placements[ b ];
+
+            if ( placement_a.offset < placement_b.offset + placement_b.size && placement_b.offset < placement_a.offset + placement_a.size ) {
+                placement_a.aliased = true;
+                placement_b.aliased = true;
+            }
+        }
+    }
+
+    overlapping.shutdown();
+    order.shutdown();
+
+    return heap_size;
+}
+
+} // namespace raptor
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "foundation/array.hpp"
+
+#include "graphics/gpu_enum.hpp"
+
+namespace raptor {
+
+struct Allocator;
+
+//
+//
+struct FrameGraphUseType {
+    enum Enum {
+        Read, Load, Write, Reference, Count
+    };
+}; // struct FrameGraphUseType
+
+//
+// Resource used by a node. Read and Load are inputs, a loaded attachment is also written. Write and Reference are
+// outputs, a referenced resource is written by a node that does not create it.
+struct FrameGraphPlanUse {
+
+    u32                 resource;           // Index of the output that holds the resource, the same for all its users.
+    FrameGraphUseType::Enum type;
+}; // struct FrameGraphPlanUse
+
+//
+//
+struct FrameGraphPlanNode {
+
+    u32                 first_use;
+    u32                 use_count;
+    bool                enabled;
+    bool                exports;            // Writes an external resource, it runs as long as it is enabled.
+}; // struct FrameGraphPlanNode
+
+//
+// What a compile needs to know of the nodes, independent of the gpu: the frame graph describes its nodes with it,
+// tests and benchmarks with made up graphs.
+struct FrameGraphPlan {
+
+    void                init( Allocator* allocator, u32 node_count, u32 resource_count );
+    void                shutdown();
+
+    // Uses are added to the last node added.
+    void                add_node( bool enabled, bool exports );
+    void                add_use( u32 resource, FrameGraphUseType::Enum type );
+
+    Array<FrameGraphPlanNode> nodes;
+    Array<FrameGraphPlanUse> uses;
+
+    u32                 resource_count      = 0;
+
+}; // struct FrameGraphPlan
+
+//
+// State a node needs a resource in. A node requests the states of its resources in the order it declares them, inputs first.
+struct FrameGraphStateRequest {
+
+    u32                 resource;           // Index of the output that holds the texture or the buffer.
+    ResourceState       state;
+    bool                buffer;
+}; // struct FrameGraphStateRequest
+
+//
+// Transition of a resource needed before a node runs.
+struct FrameGraphBarrier {
+
+    u32                 resource;           // Index of the output that holds the texture or the buffer.
+    ResourceState       source_state;       // Predicted by the compile, textures are transitioned from the state they track.
+    ResourceState       destination_state;
+    u32                 release_node;       // Last sorted node that used the resource before in the frame, or u32_max.
+    u32                 event;              // Split barrier set after the release node, or u32_max.
+    bool                buffer;
+    bool                discard;            // First use of an aliased texture in the frame.
+}; // struct FrameGraphBarrier
+
+//
+// Event that splits the barriers of a node: set after the release node, waited for before the acquire one.
+struct FrameGraphSplitEvent {
+
+    u32                 release_node;
+    u32                 acquire_node;
+}; // struct FrameGraphSplitEvent
+
+//
+// Sorted nodes a resource is alive from and to.
+struct FrameGraphLifetime {
+
+    u32                 first_node;         // u32_max when no sorted node uses the resource.
+    u32                 last_node;
+}; // struct FrameGraphLifetime
+
+//
+// Memory of a texture in the heap of a compiled graph.
+struct FrameGraphPlacement {
+
+    u32                 first_node;
+    u32                 last_node;
+    sizet               size;
+    sizet               alignment;
+    sizet               offset;
+    bool                aliased;            // Shares memory with another texture.
+}; // struct FrameGraphPlacement
+
+//
+// Consecutive sorted nodes recorded in one command buffer of a queue.
+struct FrameGraphSubmission {
+
+    QueueType::Enum     queue;
+    u32                 first_node;         // In the submission nodes.
+    u32                 node_count;
+    u32                 wait_submission;    // Submission of the other queue that has to finish first, or u32_max.
+    bool                signal;             // A submission of the other queue waits for it.
+}; // struct FrameGraphSubmission
+
+//
+// Queue family ownership transfer of a resource used by both queues.
+struct FrameGraphQueueTransfer {
+
+    u32                 resource;           // Index of the output that holds the texture or the buffer.
+    u32                 release_node;       // After a later node than the acquire one, it is released for the next frame.
+    u32                 acquire_node;
+    QueueType::Enum     source_queue;
+    QueueType::Enum     destination_queue;
+}; // struct FrameGraphQueueTransfer
+
+// Enabled nodes that a final resource depends on, producers before consumers. A node is needed when it exports, or
+// when it writes or loads a needed resource; the resources it reads are then needed too. Without final resources every
+// enabled node is needed. The order of nodes without dependencies between them follows the order they were added in.
+void                    frame_graph_sort_nodes( const FrameGraphPlan& plan, const Array<u32>& final_resources, Array<u32>& sorted_nodes,
+                                                Allocator* allocator );
+
+// Reads do not need a barrier when the resource is already in the same state.
+bool                    frame_graph_is_read_only_state( ResourceState state );
+
+// Barriers of the sorted nodes, the ones of node n from node_barriers[ n ] to node_barriers[ n + 1 ]. The requests of
+// node n go from node_requests[ n ] to node_requests[ n + 1 ]. A resource requested twice by a node keeps the state
+// that allows writes. The graph runs every frame, so sources are predicted from the states the previous frame ends
+// with. Buffers do not track their state: a buffer already in the read state it is requested in gets no barrier.
+void                    frame_graph_plan_barriers( const Array<FrameGraphStateRequest>& requests, const Array<u32>& node_requests, u32 resource_count,
+                                                   Array<FrameGraphBarrier>& barriers, Array<u32>& node_barriers, Allocator* allocator );
+
+// Splits the barriers of resources last used at least min_distance sorted nodes before, so that the nodes in between do
+// not wait for the release node. Both nodes have to be in the same submission and all the nodes from the release one to
+// the acquire one have to be in split_nodes, the ones whose resources are only transitioned by the barriers. Discards
+// wait for all the work before them and are not split. Barriers with the same release and acquire nodes share an event
+// of at most max_event_barriers barriers, events are sorted by acquire node.
+void                    frame_graph_split_barriers( Array<FrameGraphBarrier>& barriers, const Array<u32>& node_barriers, const Array<u32>& node_submissions,
+                                                    const Array<u8>& split_nodes, u32 min_distance, u32 max_event_barriers, Array<FrameGraphSplitEvent>& events,
+                                                    Allocator* allocator );
+
+// Lifetime of each resource, from the first sorted node that uses it to the last one. A resource written after the last
+// node that reads it is alive until the end of the frame, sorted_nodes.size. Kept resources, like the final outputs and
+// the ones read outside the graph, are alive for the whole frame so that no other resource shares their memory.
+void                    frame_graph_compute_lifetimes( const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, const Array<u32>& kept_resources,
+                                                       Array<FrameGraphLifetime>& lifetimes, Allocator* allocator );
+
+// Submissions of the sorted nodes, in recording order, with node_queues holding the queue of each sorted node. A node
+// waits for the submission of the other queue that ran the last node using any of its resources, a compute submission
+// that depends on no graphics node waits for the first graphics submission. Waited for submissions signal, and nodes
+// added after the wait go in a new submission. The frame ends with a graphics submission that waits for all compute
+// work. A resource used by a node of the other queue than the last one is transferred: the graph runs every frame, so
+// the first use of the frame acquires it from the queue that used it last in the previous frame.
+// submission_nodes lists the sorted nodes of each submission, node_submissions the submission of each sorted node.
+void                    frame_graph_schedule_queues( const FrameGraphPlan& plan, const Array<u32>& sorted_nodes, const Array<u8>& node_queues,
+                                                     Array<FrameGraphSubmission>& submissions, Array<u32>& submission_nodes, Array<u32>& node_submissions,
+                                                     Array<FrameGraphQueueTransfer>& queue_transfers, Allocator* allocator );
+
+// Textures with overlapping lifetimes cannot share memory. Each texture, largest first, goes at the lowest offset that
+// does not overlap the memory of the textures already placed that are alive at the same time. Returns the size of the heap.
+sizet                   frame_graph_place_textures( Array<FrameGraphPlacement>& placements, Allocator* allocator );
+
+} // namespace raptor
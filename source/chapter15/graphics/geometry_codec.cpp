@@ -0,0 +1,343 @@
+#include "graphics/geometry_codec.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/file.hpp"
+#include "foundation/gltf.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include "external/tracy/tracy/Tracy.hpp"
+#include "external/meshoptimizer/meshoptimizer.h"
+
+#include <string.h>
+
+namespace raptor {
+
+// Big views are split so that a single stream does not serialize the decoding. Multiple of 3 to keep triangles whole.
+static const u32        k_geometry_codec_region_elements = 3 * 16384;
+// meshopt_encodeVertexBuffer limits.
+static const u32        k_geometry_codec_max_vertex_size = 256;
+
+//
+//
+struct IndexAccessorUsage {
+    enum Enum {
+        None = 0, Triangles, Other
+    };
+}; // struct IndexAccessorUsage
+
+static u32 get_buffer_view_offset( const glTF::BufferView& buffer_view ) {
+    return buffer_view.byte_offset == glTF::INVALID_INT_VALUE ? 0 : buffer_view.byte_offset;
+}
+
+// Chooses how a buffer view is encoded, looking at all the accessors reading it.
+static GeometryCodecMode::Enum get_buffer_view_mode( glTF::glTF& gltf, u32 buffer_view_index, const u8* index_accessors, u32& out_element_size ) {
+    const glTF::BufferView& buffer_view = gltf.buffer_views[ buffer_view_index ];
+    const bool has_stride = buffer_view.byte_stride != glTF::INVALID_INT_VALUE && buffer_view.byte_stride != 0;
+
+    u32 accessor_count = 0;
+    u32 stride = 0;
+    bool consistent_stride = true;
+    u8 index_usage = IndexAccessorUsage::None;
+    i32 index_accessor = -1;
+
+    for ( u32 a = 0; a < gltf.accessors_count; ++a ) {
+        const glTF::Accessor& accessor = gltf.accessors[ a ];
+        if ( accessor.buffer_view != ( i32 )buffer_view_index ) {
+            continue;
+        }
+
+        ++accessor_count;
+
+        const u32 element_size = glTF::get_component_size( accessor.component_type ) * glTF::get_component_count( accessor.type );
+        const u32 accessor_stride = has_stride ? buffer_view.byte_stride : element_size;
+        if ( stride == 0 ) {
+            stride = accessor_stride;
+        } else if ( stride != accessor_stride ) {
+            consistent_stride = false;
+        }
+
+        if ( index_accessors[ a ] != IndexAccessorUsage::None ) {
+            index_usage = raptor::max( index_usage, index_accessors[ a ] );
+            index_accessor = a;
+        }
+    }
+
+    // Triangle list indices covering the whole view.
+    if ( index_usage != IndexAccessorUsage::None ) {
+        if ( index_usage != IndexAccessorUsage::Triangles || accessor_count != 1 ) {
+            return GeometryCodecMode::Raw;
+        }
+
+        const glTF::Accessor& accessor = gltf.accessors[ index_accessor ];
+        const u32 index_size = glTF::get_component_size( accessor.component_type );
+        const bool offset_zero = accessor.byte_offset == glTF::INVALID_INT_VALUE || accessor.byte_offset == 0;
+        if ( offset_zero && ( index_size == 2 || index_size == 4 ) && accessor.sparse == nullptr &&
+             ( accessor.count % 3 ) == 0 && accessor.count * index_size == ( u32 )buffer_view.byte_length ) {
+            out_element_size = index_size;
+            return GeometryCodecMode::Index;
+        }
+
+        return GeometryCodecMode::Raw;
+    }
+
+    // Images and sparse data are not referenced as accessor views and stay raw.
+    if ( accessor_count > 0 && consistent_stride && ( stride % 4 ) == 0 && stride <= k_geometry_codec_max_vertex_size && ( buffer_view.byte_length % stride ) == 0 ) {
+        out_element_size = stride;
+        return GeometryCodecMode::Vertex;
+    }
+
+    return GeometryCodecMode::Raw;
+}
+
+static bool encode_region( const u8* buffer_data, GeometryCodecRegion& region, Array<u8>& encoded_data ) {
+    const u8* source = buffer_data + region.byte_offset;
+
+    sizet bound = region.byte_length;
+    u32 vertex_count = 0;
+    if ( region.mode == GeometryCodecMode::Vertex ) {
+        bound = meshopt_encodeVertexBufferBound( region.element_count, region.element_size );
+    } else if ( region.mode == GeometryCodecMode::Index ) {
+        for ( u32 i = 0; i < region.element_count; ++i ) {
+            const u32 index = region.element_size == 2 ? ( ( const u16* )source )[ i ] : ( ( const u32* )source )[ i ];
+            vertex_count = raptor::max( vertex_count, index + 1 );
+        }
+        bound = meshopt_encodeIndexBufferBound( region.element_count, vertex_count );
+    }
+
+    // Keep encoded regions 4 bytes aligned.
+    region.data_offset = ( u32 )memory_align( encoded_data.size, 4 );
+    encoded_data.set_size( region.data_offset + ( u32 )bound );
+    u8* destination = encoded_data.data + region.data_offset;
+
+    sizet encoded_size = 0;
+    switch ( region.mode ) {
+        case GeometryCodecMode::Vertex:
+        {
+            encoded_size = meshopt_encodeVertexBuffer( destination, bound, source, region.element_count, region.element_size );
+            break;
+        }
+
+        case GeometryCodecMode::Index:
+        {
+            if ( region.element_size == 2 ) {
+                encoded_size = meshopt_encodeIndexBuffer( destination, bound, ( const u16* )source, region.element_count );
+            } else {
+                encoded_size = meshopt_encodeIndexBuffer( destination, bound, ( const u32* )source, region.element_count );
+            }
+            break;
+        }
+
+        default:
+        {
+            memcpy( destination, source, region.byte_length );
+            encoded_size = region.byte_length;
+            break;
+        }
+    }
+
+    region.data_size = ( u32 )encoded_size;
+    encoded_data.set_size( region.data_offset + region.data_size );
+
+    return encoded_size > 0 || region.byte_length == 0;
+}
+
+sizet geometry_codec_write_sidecar( glTF::glTF& gltf, u32 buffer_index, const u8* buffer_data, u64 source_write_time, cstring path, Allocator* allocator ) {
+    ZoneScoped;
+
+    const glTF::Buffer& buffer = gltf.buffers[ buffer_index ];
+
+    u8* index_accessors = ( u8* )ralloca( raptor::max( gltf.accessors_count, 1u ), allocator );
+    memset( index_accessors, 0, gltf.accessors_count );
+
+    for ( u32 m = 0; m < gltf.meshes_count; ++m ) {
+        const glTF::Mesh& mesh = gltf.meshes[ m ];
+        for ( u32 p = 0; p < mesh.primitives_count; ++p ) {
+            const glTF::MeshPrimitive& primitive = mesh.primitives[ p ];
+            if ( primitive.indices == glTF::INVALID_INT_VALUE ) {
+                continue;
+            }
+
+            // Only triangle lists can use the index codec.
+            const bool triangles = primitive.mode == glTF::INVALID_INT_VALUE || primitive.mode == 4;
+            u8& usage = index_accessors[ primitive.indices ];
+            usage = raptor::max( usage, ( u8 )( triangles ? IndexAccessorUsage::Triangles : IndexAccessorUsage::Other ) );
+        }
+    }
+
+    Array<GeometryCodecRegion> regions;
+    regions.init( allocator, 16 );
+
+    Array<u8> encoded_data;
+    encoded_data.init( allocator, buffer.byte_length / 2 );
+
+    bool valid = true;
+    for ( u32 v = 0; v < gltf.buffer_views_count && valid; ++v ) {
+        const glTF::BufferView& buffer_view = gltf.buffer_views[ v ];
+        if ( buffer_view.buffer != ( i32 )buffer_index ) {
+            continue;
+        }
+
+        const u32 view_offset = get_buffer_view_offset( buffer_view );
+        const u32 view_length = buffer_view.byte_length;
+
+        // Overlapping views would make concurrent decoding write the same bytes, keep these buffers raw.
+        for ( u32 r = 0; r < regions.size; ++r ) {
+            const GeometryCodecRegion& other = regions[ r ];
+            if ( view_offset < other.byte_offset + other.byte_length && other.byte_offset < view_offset + view_length ) {
+                valid = false;
+            }
+        }
+
+        if ( !valid || view_offset + view_length > ( u32 )buffer.byte_length ) {
+            valid = false;
+            break;
+        }
+
+        u32 element_size = 1;
+        const GeometryCodecMode::Enum mode = get_buffer_view_mode( gltf, v, index_accessors, element_size );
+
+        const u32 element_count = view_length / element_size;
+        const u32 elements_per_region = mode == GeometryCodecMode::Raw ? element_count : k_geometry_codec_region_elements;
+
+        u32 first_element = 0;
+        do {
+            GeometryCodecRegion region{ };
+            region.mode = mode;
+            region.element_size = element_size;
+            region.element_count = raptor::min( elements_per_region, element_count - first_element );
+            region.byte_offset = view_offset + first_element * element_size;
+            region.byte_length = region.element_count * element_size;
+
+            valid = valid && encode_region( buffer_data, region, encoded_data );
+            regions.push( region );
+
+            first_element += elements_per_region;
+        } while ( first_element < element_count );
+    }
+
+    // Sorted regions let the loader find the gaps between them in a single pass.
+    for ( u32 r = 1; r < regions.size; ++r ) {
+        const GeometryCodecRegion region = regions[ r ];
+        u32 s = r;
+        for ( ; s > 0 && regions[ s - 1 ].byte_offset > region.byte_offset; --s ) {
+            regions[ s ] = regions[ s - 1 ];
+        }
+        regions[ s ] = region;
+    }
+
+    sizet sidecar_size = 0;
+    if ( valid ) {
+        GeometryCodecHeader header{ k_geometry_codec_magic, k_geometry_codec_version, ( u32 )buffer.byte_length, regions.size, source_write_time };
+
+        // Encoded data offsets are relative to the start of the data section.
+        const u32 data_start = ( u32 )( sizeof( GeometryCodecHeader ) + regions.size_in_bytes() );
+        for ( u32 r = 0; r < regions.size; ++r ) {
+            regions[ r ].data_offset += data_start;
+        }
+
+        FileHandle file;
+        file_open( path, "wb", &file );
+        if ( file ) {
+            file_write( ( u8* )&header, sizeof( GeometryCodecHeader ), 1, file );
+            file_write( ( u8* )regions.data, sizeof( GeometryCodecRegion ), regions.size, file );
+            file_write( encoded_data.data, 1, encoded_data.size, file );
+            file_close( file );
+
+            sidecar_size = data_start + encoded_data.size;
+        }
+    }
+
+    encoded_data.shutdown();
+    regions.shutdown();
+    rfree( index_accessors, allocator );
+
+    return sidecar_size;
+}
+
+const GeometryCodecRegion* geometry_codec_get_regions( const u8* sidecar_data, sizet sidecar_size, u32 byte_length, u64 source_write_time, u32& out_region_count ) {
+    out_region_count = 0;
+
+    if ( sidecar_data == nullptr || sidecar_size < sizeof( GeometryCodecHeader ) ) {
+        return nullptr;
+    }
+
+    const GeometryCodecHeader* header = ( const GeometryCodecHeader* )sidecar_data;
+    if ( header->magic != k_geometry_codec_magic || header->version != k_geometry_codec_version || header->byte_length != byte_length ||
+         header->source_write_time != source_write_time ) {
+        return nullptr;
+    }
+
+    if ( sizeof( GeometryCodecHeader ) + ( sizet )header->region_count * sizeof( GeometryCodecRegion ) > sidecar_size ) {
+        return nullptr;
+    }
+
+    const GeometryCodecRegion* regions = ( const GeometryCodecRegion* )( sidecar_data + sizeof( GeometryCodecHeader ) );
+    sizet previous_end = 0;
+    for ( u32 r = 0; r < header->region_count; ++r ) {
+        const GeometryCodecRegion& region = regions[ r ];
+        if ( ( sizet )region.data_offset + region.data_size > sidecar_size || ( sizet )region.byte_offset + region.byte_length > byte_length ||
+             region.byte_offset < previous_end ) {
+            return nullptr;
+        }
+        previous_end = ( sizet )region.byte_offset + region.byte_length;
+    }
+
+    out_region_count = header->region_count;
+    return regions;
+}
+
+void geometry_codec_clear_gaps( const GeometryCodecRegion* regions, u32 region_count, u32 byte_length, u8* buffer_data ) {
+    u32 gap_start = 0;
+    for ( u32 r = 0; r < region_count; ++r ) {
+        if ( regions[ r ].byte_offset > gap_start ) {
+            memset( buffer_data + gap_start, 0, regions[ r ].byte_offset - gap_start );
+        }
+        gap_start = regions[ r ].byte_offset + regions[ r ].byte_length;
+    }
+
+    if ( byte_length > gap_start ) {
+        memset( buffer_data + gap_start, 0, byte_length - gap_start );
+    }
+}
+
+bool geometry_codec_decode_region( const u8* sidecar_data, const GeometryCodecRegion& region, u8* buffer_data ) {
+    ZoneScoped;
+
+    const u8* source = sidecar_data + region.data_offset;
+    u8* destination = buffer_data + region.byte_offset;
+
+    switch ( region.mode ) {
+        case GeometryCodecMode::Vertex:
+            return meshopt_decodeVertexBuffer( destination, region.element_count, region.element_size, source, region.data_size ) == 0;
+
+        case GeometryCodecMode::Index:
+            return meshopt_decodeIndexBuffer( destination, region.element_count, region.element_size, source, region.data_size ) == 0;
+
+        case GeometryCodecMode::Raw:
+            if ( region.data_size != region.byte_length ) {
+                return false;
+            }
+            memcpy( destination, source, region.byte_length );
+            return true;
+    }
+
+    return false;
+}
+
+bool geometry_codec_read_source( cstring path, u32 byte_length, u8* buffer_data, Allocator* allocator ) {
+    FileSpan source = file_map( path, allocator );
+
+    const bool valid = source.data != nullptr && source.size >= byte_length;
+    if ( valid ) {
+        memory_copy( buffer_data, source.data, byte_length );
+    } else {
+        // Zeroes instead of memory past the source file.
+        memset( buffer_data, 0, byte_length );
+    }
+
+    file_unmap( source );
+    return valid;
+}
+
+} // namespace raptor
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "foundation/platform.hpp"
+
+namespace raptor {
+
+struct Allocator;
+
+namespace glTF {
+    struct glTF;
+} // namespace glTF
+
+// Sidecar file next to a glTF buffer, with its buffer views compressed by the meshoptimizer codecs.
+// Layout: GeometryCodecHeader, GeometryCodecRegion array sorted by byte_offset, encoded data.
+static const char* const k_geometry_codec_extension = ".meshopt";
+static const u32        k_geometry_codec_magic      = 0x43474d52;   // RMGC
+static const u32        k_geometry_codec_version    = 2;
+
+//
+//
+struct GeometryCodecMode {
+    enum Enum {
+        Raw, Vertex, Index
+    };
+}; // struct GeometryCodecMode
+
+//
+//
+struct GeometryCodecHeader {
+
+    u32                 magic;
+    u32                 version;
+    u32                 byte_length;        // Of the decoded glTF buffer.
+    u32                 region_count;
+    u64                 source_write_time;  // file_modification_time of the glTF buffer, used to detect stale sidecars.
+}; // struct GeometryCodecHeader
+
+//
+// Part of a buffer view, decoded independently from the others so regions can be decoded in parallel.
+struct GeometryCodecRegion {
+
+    u32                 byte_offset;        // In the decoded glTF buffer.
+    u32                 byte_length;
+    u32                 mode;               // GeometryCodecMode
+    u32                 element_size;       // Vertex stride or index size.
+    u32                 element_count;
+    u32                 data_offset;        // In the sidecar file.
+    u32                 data_size;
+    u32                 padding;
+}; // struct GeometryCodecRegion
+
+// Encodes the buffer views of buffer_index and writes them to path. Returns the sidecar size, 0 on failure.
+sizet                   geometry_codec_write_sidecar( glTF::glTF& gltf, u32 buffer_index, const u8* buffer_data, u64 source_write_time, cstring path, Allocator* allocator );
+
+// Regions of a sidecar loaded in memory, nullptr if it is not a valid sidecar for the buffer of byte_length bytes
+// last written at source_write_time.
+const GeometryCodecRegion* geometry_codec_get_regions( const u8* sidecar_data, sizet sidecar_size, u32 byte_length, u64 source_write_time, u32& out_region_count );
+
+// Zeroes the bytes no region covers, the padding between buffer views.
+void                    geometry_codec_clear_gaps( const GeometryCodecRegion* regions, u32 region_count, u32 byte_length, u8* buffer_data );
+
+// Writes the region at its offset in buffer_data. Regions of a buffer never overlap, so they can be decoded concurrently.
+bool                    geometry_codec_decode_region( const u8* sidecar_data, const GeometryCodecRegion& region, u8* buffer_data );
+
+// Fallback when a sidecar region fails to decode: copies the whole glTF buffer from its source file. Returns false
+// and zeroes buffer_data when the file cannot be read or is shorter than byte_length.
+bool                    geometry_codec_read_source( cstring path, u32 byte_length, u8* buffer_data, Allocator* allocator );
+
+} // namespace raptor
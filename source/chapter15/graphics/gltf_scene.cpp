@@ -3,6 +3,9 @@
 #include "graphics/raptor_imgui.hpp"
 #include "graphics/asynchronous_loader.hpp"
 #include "graphics/scene_graph.hpp"
+#include "graphics/cluster_lod.hpp"
+#include "graphics/geometry_codec.hpp"
+#include "graphics/texture_streamer.hpp"
 
 #include "foundation/file.hpp"
 #include "foundation/time.hpp"
@@ -21,17 +24,784 @@
 
 namespace raptor {
 
+// Textures ///////////////////////////////////////////////////////////////
+
+// Images with the same file content, within a scene or across scenes, share a single texture and bindless slot.
+static bool         deduplicate_textures        = true;
+
+// Geometry sidecars //////////////////////////////////////////////////////
+
+// glTF buffers are read from their meshoptimizer encoded sidecar when one exists, see geometry_codec.hpp.
+static bool         use_compressed_geometry     = true;
+// Write a sidecar next to each glTF buffer loaded without one, so the following loads use it.
+// Off by default: loading should not write next to the assets, the Chapter15GeometrySidecars tool generates them.
+static bool         write_compressed_geometry   = false;
+
+// Buffer views only read on the cpu are not uploaded, the other views of their buffer are packed at this alignment.
+static const u32    k_buffer_view_alignment     = 16;
+static const u32    k_buffer_view_not_uploaded  = u32_max;
+
+// Meshlet building ///////////////////////////////////////////////////////
+
+static const u32    k_meshlet_max_vertices      = 64;
+static const u32    k_meshlet_max_triangles     = 124;
+static const f32    k_meshlet_cone_weight       = 0.0f;
+
+// When false meshlets are built on the calling thread, used to measure the parallel speedup.
+static bool         build_meshlets_in_parallel  = true;
+// Optional import stage: reorder indices for vertex cache and overdraw, then vertices for fetch locality.
+// Optimized primitives cannot use the source glTF buffers anymore, so their decoded streams are uploaded.
+static bool         optimize_meshes_on_import   = false;
+static const f32    k_overdraw_threshold        = 1.05f;
+static const u32    k_vertex_cache_size         = 16;
+
+// Exact vertex deduplication across all attribute streams, run before any other import stage.
+// Deduplicated primitives draw from their decoded streams, and the glTF buffer views they no longer
+// read are not uploaded. Skinned primitives are skipped, as their joints and weights are still read
+// from the glTF buffers.
+static bool         deduplicate_vertices_on_import = true;
+// Optionally also weld vertices with matching attributes and positions closer than the tolerance.
+static bool         weld_vertices_on_import     = false;
+static const f32    k_vertex_weld_tolerance     = 1e-5f;   // Relative to the mesh extents.
+
+// Automatic instancing: primitives with identical decoded geometry and material share the same Mesh.
+static bool         instance_identical_primitives = true;
+
+// Level of detail chain: each lod is simplified from the previous one, halving its triangles.
+// A lod is kept only if it removes enough triangles, otherwise the chain stops there.
+static bool         generate_mesh_lods          = true;
+static const f32    k_lod_target_ratio          = 0.5f;
+static const f32    k_lod_min_reduction         = 0.8f;
+static const f32    k_lod_target_error          = 0.05f;   // Relative to the mesh extents.
+
+// Cluster hierarchy, built on the calling thread as its arrays grow. Only statistics are used for now.
+static bool         build_cluster_lods_on_import = false;
+
+// Upper bound of the meshlets data of a single meshlet: vertex indices, triangle indices packed
+// by four and up to 2 additional index groups of padding.
+static const u32    k_meshlet_max_data_size     = k_meshlet_max_vertices + ( k_meshlet_max_triangles * 3 + 3 ) / 4 + 2;
+
+// Upper bound of the index count of the lod following one with previous_index_count indices.
+static u32 get_next_lod_max_index_count( u32 previous_index_count ) {
+    return ( u32 )( previous_index_count * k_lod_min_reduction ) / 3 * 3;
+}
+
+// Welding scratch: vertices are swept along x, only the ones within the tolerance on x are compared.
+struct WeldVertex {
+    f32                     x;
+    u32                     index;
+}; // struct WeldVertex
+
+//
+// Decoded streams of a single glTF primitive and its meshlets, built independently from other primitives.
+struct PrimitiveMeshletData {
+
+    void                    shutdown( Allocator* allocator );
+
+    // Decoded vertex streams.
+    f32*                    positions       = nullptr;
+    f32*                    normals         = nullptr;
+    f32*                    tangents        = nullptr;
+    f32*                    tex_coords      = nullptr;
+    u32*                    indices         = nullptr;
+
+    u32                     vertex_count    = 0;
+    u32                     index_count     = 0;
+    u32                     mesh_index      = 0;
+    i32                     material_index  = glTF::INVALID_INT_VALUE;
+
+    // Other glTF primitives drawn as instances of this one.
+    u32                     duplicate_count = 0;
+
+    // Upload decoded streams instead of referencing the glTF buffers.
+    cstring                 decoded_buffer_name = nullptr;
+    bool                    upload_decoded_streams = false;
+    bool                    deduplicate     = false;
+    bool                    optimize        = false;
+
+    // Vertex count of the glTF primitive and after deduplication.
+    u32                     source_vertex_count = 0;
+    u32                     unique_vertex_count = 0;
+
+    // Simplified indices of lods 1 and above, packed one after the other.
+    Array<u32>              lod_indices;
+
+    // Import optimization statistics.
+    meshopt_VertexCacheStatistics   vertex_cache_before{ };
+    meshopt_VertexCacheStatistics   vertex_cache_after{ };
+    meshopt_OverdrawStatistics      overdraw_before{ };
+    meshopt_OverdrawStatistics      overdraw_after{ };
+    meshopt_VertexFetchStatistics   vertex_fetch_before{ };
+    meshopt_VertexFetchStatistics   vertex_fetch_after{ };
+
+    // meshoptimizer scratch memory.
+    Array<u32>              vertex_remap;
+    Array<WeldVertex>       weld_vertices;
+    Array<meshopt_Meshlet>  local_meshlets;
+    Array<u32>              local_vertex_indices;
+    Array<u8>               local_triangles;
+
+    // Output. Data offsets and vertex indices are relative to this primitive.
+    Array<GpuMeshlet>       meshlets;
+    Array<u32>              meshlets_data;
+    Array<GpuMeshletVertexPosition> vertex_positions;
+    Array<GpuMeshletVertexData> vertex_data;
+
+    u32                     index_group_count   = 0;
+
+    // Meshlet ranges of each lod, relative to the meshlets above. Lod 0 is the source mesh.
+    MeshLod                 lods[ k_max_mesh_lods ];
+    u32                     lod_index_counts[ k_max_mesh_lods ];
+    u32                     lod_count           = 0;
+    u32                     max_lod_count       = 1;
+
+    vec3s                   aabb_min;
+    vec3s                   aabb_max;
+
+}; // struct PrimitiveMeshletData
+
+void PrimitiveMeshletData::shutdown( Allocator* allocator ) {
+    rfree( positions, allocator );
+    if ( normals ) {
+        rfree( normals, allocator );
+    }
+    if ( tangents ) {
+        rfree( tangents, allocator );
+    }
+    if ( tex_coords ) {
+        rfree( tex_coords, allocator );
+    }
+    rfree( indices, allocator );
+
+    vertex_remap.shutdown();
+    weld_vertices.shutdown();
+    lod_indices.shutdown();
+    local_meshlets.shutdown();
+    local_vertex_indices.shutdown();
+    local_triangles.shutdown();
+
+    meshlets.shutdown();
+    meshlets_data.shutdown();
+    vertex_positions.shutdown();
+    vertex_data.shutdown();
+}
+
+static void remap_vertex_stream( f32* stream, u32 component_count, u32 vertex_count, const u32* remap ) {
+    if ( stream ) {
+        meshopt_remapVertexBuffer( stream, stream, vertex_count, sizeof( f32 ) * component_count, remap );
+    }
+}
+
+// Frees the decoded streams of a primitive that is not built, its arrays were never initialized.
+static void free_primitive_streams( PrimitiveMeshletData& primitive, Allocator* allocator ) {
+    rfree( primitive.positions, allocator );
+    if ( primitive.normals ) {
+        rfree( primitive.normals, allocator );
+    }
+    if ( primitive.tangents ) {
+        rfree( primitive.tangents, allocator );
+    }
+    if ( primitive.tex_coords ) {
+        rfree( primitive.tex_coords, allocator );
+    }
+    rfree( primitive.indices, allocator );
+}
+
+static u64 hash_primitive_geometry( const PrimitiveMeshletData& primitive ) {
+    u64 hash = hash_calculate( primitive.material_index );
+    hash = hash_bytes( primitive.positions, sizeof( f32 ) * 3 * primitive.vertex_count, hash );
+    if ( primitive.normals ) {
+        hash = hash_bytes( primitive.normals, sizeof( f32 ) * 3 * primitive.vertex_count, hash );
+    }
+    if ( primitive.tangents ) {
+        hash = hash_bytes( primitive.tangents, sizeof( f32 ) * 4 * primitive.vertex_count, hash );
+    }
+    if ( primitive.tex_coords ) {
+        hash = hash_bytes( primitive.tex_coords, sizeof( f32 ) * 2 * primitive.vertex_count, hash );
+    }
+    return hash_bytes( primitive.indices, sizeof( u32 ) * primitive.index_count, hash );
+}
+
+static bool compare_vertex_stream( const f32* a, const f32* b, u32 component_count, u32 vertex_count ) {
+    if ( a == nullptr || b == nullptr ) {
+        return a == b;
+    }
+    return memcmp( a, b, sizeof( f32 ) * component_count * vertex_count ) == 0;
+}
+
+// Byte exact comparison, hash collisions must not merge different primitives.
+static bool compare_primitive_geometry( const PrimitiveMeshletData& a, const PrimitiveMeshletData& b ) {
+    return a.material_index == b.material_index && a.vertex_count == b.vertex_count && a.index_count == b.index_count &&
+           compare_vertex_stream( a.positions, b.positions, 3, a.vertex_count ) &&
+           compare_vertex_stream( a.normals, b.normals, 3, a.vertex_count ) &&
+           compare_vertex_stream( a.tangents, b.tangents, 4, a.vertex_count ) &&
+           compare_vertex_stream( a.tex_coords, b.tex_coords, 2, a.vertex_count ) &&
+           memcmp( a.indices, b.indices, sizeof( u32 ) * a.index_count ) == 0;
+}
+
+// Vertex cache, overdraw and vertex fetch optimization, done in place on the decoded streams.
+static void optimize_primitive( PrimitiveMeshletData& primitive ) {
+    ZoneScoped;
+
+    const sizet position_stride = sizeof( f32 ) * 3;
+
+    primitive.vertex_cache_before = meshopt_analyzeVertexCache( primitive.indices, primitive.index_count, primitive.vertex_count, k_vertex_cache_size, 0, 0 );
+    primitive.overdraw_before = meshopt_analyzeOverdraw( primitive.indices, primitive.index_count, primitive.positions, primitive.vertex_count, position_stride );
+    primitive.vertex_fetch_before = meshopt_analyzeVertexFetch( primitive.indices, primitive.index_count, primitive.vertex_count, sizeof( GpuMeshletVertexPosition ) );
+
+    meshopt_optimizeVertexCache( primitive.indices, primitive.indices, primitive.index_count, primitive.vertex_count );
+    meshopt_optimizeOverdraw( primitive.indices, primitive.indices, primitive.index_count, primitive.positions, primitive.vertex_count, position_stride, k_overdraw_threshold );
+
+    // Reorder all vertex streams in the order they are first referenced. Unreferenced vertices are dropped.
+    const u32 unique_vertex_count = ( u32 )meshopt_optimizeVertexFetchRemap( primitive.vertex_remap.data, primitive.indices, primitive.index_count, primitive.vertex_count );
+    meshopt_remapIndexBuffer( primitive.indices, primitive.indices, primitive.index_count, primitive.vertex_remap.data );
+
+    remap_vertex_stream( primitive.positions, 3, primitive.vertex_count, primitive.vertex_remap.data );
+    remap_vertex_stream( primitive.normals, 3, primitive.vertex_count, primitive.vertex_remap.data );
+    remap_vertex_stream( primitive.tangents, 4, primitive.vertex_count, primitive.vertex_remap.data );
+    remap_vertex_stream( primitive.tex_coords, 2, primitive.vertex_count, primitive.vertex_remap.data );
+
+    primitive.vertex_count = unique_vertex_count;
+
+    primitive.vertex_cache_after = meshopt_analyzeVertexCache( primitive.indices, primitive.index_count, primitive.vertex_count, k_vertex_cache_size, 0, 0 );
+    primitive.overdraw_after = meshopt_analyzeOverdraw( primitive.indices, primitive.index_count, primitive.positions, primitive.vertex_count, position_stride );
+    primitive.vertex_fetch_after = meshopt_analyzeVertexFetch( primitive.indices, primitive.index_count, primitive.vertex_count, sizeof( GpuMeshletVertexPosition ) );
+}
+
+static int compare_weld_vertices( const void* a, const void* b ) {
+    const f32 x_a = ( ( const WeldVertex* )a )->x;
+    const f32 x_b = ( ( const WeldVertex* )b )->x;
+    return x_a < x_b ? -1 : ( x_a > x_b ? 1 : 0 );
+}
+
+static bool compare_vertex_attribute( const f32* stream, u32 component_count, u32 a, u32 b ) {
+    return stream == nullptr || memcmp( stream + a * component_count, stream + b * component_count, sizeof( f32 ) * component_count ) == 0;
+}
+
+// Moves every vertex closer than the tolerance to an earlier one in x order, and with the same other attributes,
+// onto its position. Vertices are moved only onto vertices that were not moved themselves, so welding is not chained.
+static void weld_primitive_vertices( PrimitiveMeshletData& primitive ) {
+    ZoneScoped;
+
+    const f32 tolerance = k_vertex_weld_tolerance * meshopt_simplifyScale( primitive.positions, primitive.vertex_count, sizeof( f32 ) * 3 );
+    const f32 tolerance_squared = tolerance * tolerance;
+
+    primitive.weld_vertices.set_size( primitive.vertex_count );
+    for ( u32 i = 0; i < primitive.vertex_count; ++i ) {
+        primitive.weld_vertices[ i ] = { primitive.positions[ i * 3 ], i };
+    }
+    qsort( primitive.weld_vertices.data, primitive.vertex_count, sizeof( WeldVertex ), compare_weld_vertices );
+
+    // The remap is overwritten by deduplication afterwards, use it to flag welded vertices.
+    u32* welded = primitive.vertex_remap.data;
+    memset( welded, 0, sizeof( u32 ) * primitive.vertex_count );
+
+    for ( u32 i = 0; i < primitive.vertex_count; ++i ) {
+        const WeldVertex& target = primitive.weld_vertices[ i ];
+        if ( welded[ target.index ] ) {
+            continue;
+        }
+        const f32* target_position = primitive.positions + target.index * 3;
+
+        for ( u32 j = i + 1; j < primitive.vertex_count && primitive.weld_vertices[ j ].x - target.x <= tolerance; ++j ) {
+            const u32 vertex = primitive.weld_vertices[ j ].index;
+            if ( welded[ vertex ] ) {
+                continue;
+            }
+
+            f32* position = primitive.positions + vertex * 3;
+            const f32 dx = position[ 0 ] - target_position[ 0 ];
+            const f32 dy = position[ 1 ] - target_position[ 1 ];
+            const f32 dz = position[ 2 ] - target_position[ 2 ];
+            if ( dx * dx + dy * dy + dz * dz > tolerance_squared ) {
+                continue;
+            }
+
+            if ( compare_vertex_attribute( primitive.normals, 3, vertex, target.index ) &&
+                 compare_vertex_attribute( primitive.tangents, 4, vertex, target.index ) &&
+                 compare_vertex_attribute( primitive.tex_coords, 2, vertex, target.index ) ) {
+                memcpy( position, target_position, sizeof( f32 ) * 3 );
+                welded[ vertex ] = 1;
+            }
+        }
+    }
+}
+
+// Removes duplicated vertices, comparing all attribute streams. Welding runs first, so that welded vertices
+// become exact duplicates.
+static void deduplicate_primitive_vertices( PrimitiveMeshletData& primitive ) {
+    ZoneScoped;
+
+    const sizet position_stride = sizeof( f32 ) * 3;
+
+    if ( primitive.weld_vertices.capacity > 0 ) {
+        weld_primitive_vertices( primitive );
+    }
+
+    meshopt_Stream streams[ 4 ];
+    u32 stream_count = 0;
+    streams[ stream_count++ ] = { primitive.positions, position_stride, position_stride };
+    if ( primitive.normals ) {
+        streams[ stream_count++ ] = { primitive.normals, sizeof( f32 ) * 3, sizeof( f32 ) * 3 };
+    }
+    if ( primitive.tangents ) {
+        streams[ stream_count++ ] = { primitive.tangents, sizeof( f32 ) * 4, sizeof( f32 ) * 4 };
+    }
+    if ( primitive.tex_coords ) {
+        streams[ stream_count++ ] = { primitive.tex_coords, sizeof( f32 ) * 2, sizeof( f32 ) * 2 };
+    }
+
+    const u32 unique_vertex_count = ( u32 )meshopt_generateVertexRemapMulti( primitive.vertex_remap.data, primitive.indices, primitive.index_count, primitive.vertex_count, streams, stream_count );
+
+    // The remap also orders vertices by first use: leave primitives without duplicates untouched.
+    if ( unique_vertex_count < primitive.vertex_count ) {
+        meshopt_remapIndexBuffer( primitive.indices, primitive.indices, primitive.index_count, primitive.vertex_remap.data );
+
+        remap_vertex_stream( primitive.positions, 3, primitive.vertex_count, primitive.vertex_remap.data );
+        remap_vertex_stream( primitive.normals, 3, primitive.vertex_count, primitive.vertex_remap.data );
+        remap_vertex_stream( primitive.tangents, 4, primitive.vertex_count, primitive.vertex_remap.data );
+        remap_vertex_stream( primitive.tex_coords, 2, primitive.vertex_count, primitive.vertex_remap.data );
+
+        primitive.vertex_count = unique_vertex_count;
+    }
+}
+
+// Simplify each lod from the previous one. Lods share the primitive vertices, only indices change.
+static void generate_primitive_lods( PrimitiveMeshletData& primitive ) {
+    ZoneScoped;
+
+    const sizet position_stride = sizeof( f32 ) * 3;
+    // Simplification errors are relative to the mesh extents, scale them to object space.
+    const f32 error_scale = meshopt_simplifyScale( primitive.positions, primitive.vertex_count, position_stride );
+
+    const u32* source_indices = primitive.indices;
+    u32 source_index_count = primitive.index_count;
+    f32 source_error = 0.0f;
+
+    for ( u32 l = 1; l < primitive.max_lod_count; ++l ) {
+        // Simplification can write up to the source index count, stop the chain if it does not fit.
+        if ( primitive.lod_indices.size + source_index_count > primitive.lod_indices.capacity ) {
+            break;
+        }
+        u32* lod_indices = primitive.lod_indices.data + primitive.lod_indices.size;
+
+        const u32 target_index_count = ( u32 )( source_index_count * k_lod_target_ratio ) / 3 * 3;
+        const u32 max_index_count = get_next_lod_max_index_count( source_index_count );
+
+        f32 lod_error = 0.0f;
+        u32 lod_index_count = ( u32 )meshopt_simplify( lod_indices, source_indices, source_index_count, primitive.positions, primitive.vertex_count, position_stride,
+                                                       target_index_count, k_lod_target_error, &lod_error );
+
+        // Topology preserving simplification can get stuck on borders and seams: fall back to the sloppy one.
+        if ( lod_index_count > max_index_count ) {
+            lod_index_count = ( u32 )meshopt_simplifySloppy( lod_indices, source_indices, source_index_count, primitive.positions, primitive.vertex_count, position_stride,
+                                                             target_index_count, k_lod_target_error, &lod_error );
+        }
+
+        if ( lod_index_count == 0 || lod_index_count > max_index_count ) {
+            break;
+        }
+
+        // Errors are measured against the previous lod, accumulate them to have a monotonic bound.
+        source_error += lod_error * error_scale;
+        primitive.lods[ l ].error = source_error;
+        primitive.lod_index_counts[ l ] = lod_index_count;
+
+        primitive.lod_indices.set_size( primitive.lod_indices.size + lod_index_count );
+        ++primitive.lod_count;
+
+        source_indices = lod_indices;
+        source_index_count = lod_index_count;
+    }
+}
+
+// Build meshlets of a single lod and append them to the primitive output.
+// Returns false, leaving the output untouched, when they do not fit in the preallocated arrays.
+static bool build_lod_meshlets( PrimitiveMeshletData& primitive, const u32* indices, u32 index_count, MeshLod& lod ) {
+    const f32* vertices = primitive.positions;
+
+    if ( meshopt_buildMeshletsBound( index_count, k_meshlet_max_vertices, k_meshlet_max_triangles ) > primitive.local_meshlets.size ) {
+        return false;
+    }
+
+    sizet meshlet_count = meshopt_buildMeshlets( primitive.local_meshlets.data, primitive.local_vertex_indices.data, primitive.local_triangles.data, indices,
+                                                 index_count, vertices, primitive.vertex_count, sizeof( vec3s ),
+                                                 k_meshlet_max_vertices, k_meshlet_max_triangles, k_meshlet_cone_weight );
+    if ( primitive.meshlets.size + meshlet_count > primitive.meshlets.capacity ||
+         primitive.meshlets_data.size + meshlet_count * k_meshlet_max_data_size > primitive.meshlets_data.capacity ) {
+        return false;
+    }
+
+    lod.meshlet_offset = primitive.meshlets.size;
+    lod.meshlet_count = ( u32 )meshlet_count;
+    lod.meshlet_index_count = 0;
+
+    // Append meshlet data
+    for ( u32 m = 0; m < meshlet_count; ++m ) {
+        meshopt_Meshlet& local_meshlet = primitive.local_meshlets[ m ];
+
+        meshopt_Bounds meshlet_bounds = meshopt_computeMeshletBounds( primitive.local_vertex_indices.data + local_meshlet.vertex_offset,
+                                                                      primitive.local_triangles.data + local_meshlet.triangle_offset, local_meshlet.triangle_count,
+                                                                      vertices, primitive.vertex_count, sizeof( vec3s ) );
+
+        GpuMeshlet meshlet{};
+        meshlet.data_offset = primitive.meshlets_data.size;
+        meshlet.vertex_count = local_meshlet.vertex_count;
+        meshlet.triangle_count = local_meshlet.triangle_count;
+
+        meshlet.center = vec3s{ meshlet_bounds.center[ 0 ], meshlet_bounds.center[ 1 ], meshlet_bounds.center[ 2 ] };
+        meshlet.radius = meshlet_bounds.radius;
+
+        meshlet.cone_axis[ 0 ] = meshlet_bounds.cone_axis_s8[ 0 ];
+        meshlet.cone_axis[ 1 ] = meshlet_bounds.cone_axis_s8[ 1 ];
+        meshlet.cone_axis[ 2 ] = meshlet_bounds.cone_axis_s8[ 2 ];
+
+        meshlet.cone_cutoff = meshlet_bounds.cone_cutoff_s8;
+        meshlet.mesh_index = primitive.mesh_index;
+
+        const u32 index_group_count = ( local_meshlet.triangle_count * 3 + 3 ) / 4;
+
+        for ( u32 i = 0; i < meshlet.vertex_count; ++i ) {
+            const u32 vertex_index = primitive.local_vertex_indices[ local_meshlet.vertex_offset + i ];
+            primitive.meshlets_data.push( vertex_index );
+        }
+
+        // Store indices as uint32
+        // NOTE(marco): we write 4 indices at at time, it will come in handy in the mesh shader
+        const u32* index_groups = reinterpret_cast< const u32* >( primitive.local_triangles.data + local_meshlet.triangle_offset );
+        for ( u32 i = 0; i < index_group_count; ++i ) {
+            const u32 index_group = index_groups[ i ];
+            primitive.meshlets_data.push( index_group );
+        }
+
+        // Writing in group of fours can be problematic, if there are non multiple of 3
+        // indices a triangle can be shared between meshlets.
+        // We need to add some padding for that.
+        // This is visible only when emulating meshlets, so probably there are controls
+        // at driver level that avoid this problems when using mesh shaders.
+        // Check for the last 3 indices: if last one are two are zero, then add one or two
+        // groups of empty triangles.
+        u32 last_index_group = index_groups[ index_group_count - 1 ];
+        u32 last_index = ( last_index_group >> 8 ) & 0xff;
+        u32 second_last_index = ( last_index_group >> 16 ) & 0xff;
+        u32 third_last_index = ( last_index_group >> 24 ) & 0xff;
+        if ( last_index != 0 && third_last_index == 0 ) {
+
+            if ( second_last_index != 0 ) {
+                // Add a single index group of zeroes
+                primitive.meshlets_data.push( 0 );
+                meshlet.triangle_count++;
+            }
+
+            meshlet.triangle_count++;
+            // Add another index group of zeroes
+            primitive.meshlets_data.push( 0 );
+        }
+
+        lod.meshlet_index_count += meshlet.triangle_count * 3;
+
+        primitive.meshlets.push( meshlet );
+
+        primitive.index_group_count += index_group_count;
+    }
+
+    return true;
+}
+
+// Output arrays are preallocated with their upper bound, so no allocation happens here.
+static void build_primitive_meshlets( PrimitiveMeshletData& primitive ) {
+    ZoneScoped;
+
+    if ( primitive.deduplicate ) {
+        deduplicate_primitive_vertices( primitive );
+    }
+    primitive.unique_vertex_count = primitive.vertex_count;
+
+    if ( primitive.optimize ) {
+        optimize_primitive( primitive );
+    }
+
+    primitive.lods[ 0 ] = { };
+    primitive.lod_index_counts[ 0 ] = primitive.index_count;
+    primitive.lod_count = 1;
+    generate_primitive_lods( primitive );
+
+    const f32* vertices = primitive.positions;
+    const f32* normals = primitive.normals;
+    const f32* tangents = primitive.tangents;
+    const f32* tex_coords = primitive.tex_coords;
+
+    primitive.aabb_min = vec3s{ FLT_MAX, FLT_MAX, FLT_MAX };
+    primitive.aabb_max = vec3s{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for ( u32 v = 0; v < primitive.vertex_count; ++v ) {
+        const vec3s position{ vertices[ v * 3 + 0 ], vertices[ v * 3 + 1 ], vertices[ v * 3 + 2 ] };
+
+        primitive.aabb_min = glms_vec3_minv( primitive.aabb_min, position );
+        primitive.aabb_max = glms_vec3_maxv( primitive.aabb_max, position );
+    }
+
+    // Positions are stored as unorm16 inside the primitive bounding box. Meshlets share vertices,
+    // across lods too, so the box of the whole primitive is used instead of the one of each meshlet.
+    const vec3s extent = glms_vec3_sub( primitive.aabb_max, primitive.aabb_min );
+    const vec3s inverse_extent{ extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f };
+
+    for ( u32 v = 0; v < primitive.vertex_count; ++v ) {
+        GpuMeshletVertexPosition meshlet_vertex_pos{ };
+
+        meshlet_vertex_pos.position[ 0 ] = quantize_unorm16( ( vertices[ v * 3 + 0 ] - primitive.aabb_min.x ) * inverse_extent.x );
+        meshlet_vertex_pos.position[ 1 ] = quantize_unorm16( ( vertices[ v * 3 + 1 ] - primitive.aabb_min.y ) * inverse_extent.y );
+        meshlet_vertex_pos.position[ 2 ] = quantize_unorm16( ( vertices[ v * 3 + 2 ] - primitive.aabb_min.z ) * inverse_extent.z );
+
+        primitive.vertex_positions.push( meshlet_vertex_pos );
+
+        GpuMeshletVertexData meshlet_vertex_data{ };
+
+        if ( normals != nullptr ) {
+            meshlet_vertex_data.normal = octahedral_encode_snorm16( normals[ v * 3 + 0 ], normals[ v * 3 + 1 ], normals[ v * 3 + 2 ] );
+        }
+
+        if ( tangents != nullptr ) {
+            meshlet_vertex_data.tangent = octahedral_encode_tangent( tangents[ v * 4 + 0 ], tangents[ v * 4 + 1 ], tangents[ v * 4 + 2 ], tangents[ v * 4 + 3 ] );
+        }
+
+        if ( tex_coords != nullptr ) {
+            meshlet_vertex_data.uv_coords[ 0 ] = meshopt_quantizeHalf( tex_coords[ v * 2 + 0 ] );
+            meshlet_vertex_data.uv_coords[ 1 ] = meshopt_quantizeHalf( tex_coords[ v * 2 + 1 ] );
+        }
+
+        primitive.vertex_data.push( meshlet_vertex_data );
+    }
+
+    // Output arrays are never grown from the tasks: lods that do not fit are dropped.
+    if ( !build_lod_meshlets( primitive, primitive.indices, primitive.index_count, primitive.lods[ 0 ] ) ) {
+        rprint( "Meshlets of mesh %u do not fit in their output, the mesh is not drawn with meshlets\n", primitive.mesh_index );
+        primitive.lod_count = 1;
+        return;
+    }
+
+    const u32* lod_indices = primitive.lod_indices.data;
+    for ( u32 l = 1; l < primitive.lod_count; ++l ) {
+        if ( !build_lod_meshlets( primitive, lod_indices, primitive.lod_index_counts[ l ], primitive.lods[ l ] ) ) {
+            primitive.lod_count = l;
+            break;
+        }
+        lod_indices += primitive.lod_index_counts[ l ];
+    }
+}
+
+//
+//
+struct MeshletBuildTask : public enki::ITaskSet {
+
+    PrimitiveMeshletData*   primitives  = nullptr;
+
+    void ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) override {
+        for ( u32 i = range_.start; i < range_.end; ++i ) {
+            build_primitive_meshlets( primitives[ i ] );
+        }
+    }
+
+}; // struct MeshletBuildTask
+
+//
+// Where the cpu reads the data of a glTF buffer from while loading.
+enum BufferDataSource : u8 {
+    BufferDataSource_File = 0,      // Mapped source file.
+    BufferDataSource_Gpu,           // Mapped gpu buffer, the whole buffer is uploaded and decoded from its sidecar.
+    BufferDataSource_Decoded        // Decoded from its sidecar in cpu memory, only some views are uploaded.
+}; // enum BufferDataSource
+
+//
+// Region of a geometry sidecar decoded straight into the buffer data.
+struct GeometryDecodeJob {
+
+    const u8*               sidecar_data;
+    const GeometryCodecRegion* region;
+    u8*                     buffer_data;
+    u32                     buffer_index;
+    bool                    decoded;
+}; // struct GeometryDecodeJob
+
+//
+//
+struct GeometryDecodeTask : public enki::ITaskSet {
+
+    GeometryDecodeJob*      jobs        = nullptr;
+
+    void ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) override {
+        for ( u32 i = range_.start; i < range_.end; ++i ) {
+            GeometryDecodeJob& job = jobs[ i ];
+            job.decoded = geometry_codec_decode_region( job.sidecar_data, *job.region, job.buffer_data );
+        }
+    }
+
+}; // struct GeometryDecodeTask
+
+// Image files are read on the task workers, the resident allocator is not thread safe.
+static MallocAllocator      image_file_allocator;
+
+//
+// Size and content hash of a glTF image, read on the task workers.
+struct ImageInfoJob {
+
+    cstring                 uri;
+    u64                     content_hash;
+    sizet                   content_size;
+    i32                     width;
+    i32                     height;
+    i32                     comp;
+}; // struct ImageInfoJob
+
+//
+//
+struct ImageInfoTask : public enki::ITaskSet {
+
+    ImageInfoJob*           jobs        = nullptr;
+
+    void ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) override {
+        for ( u32 i = range_.start; i < range_.end; ++i ) {
+            ImageInfoJob& job = jobs[ i ];
+
+            // Images can be stored in a pack, read them through the vfs.
+            FileSpan image_file = file_map( job.uri, &image_file_allocator );
+            if ( image_file.data == nullptr ) {
+                continue;
+            }
+
+            if ( deduplicate_textures ) {
+                job.content_hash = hash_bytes( ( void* )image_file.data, image_file.size );
+                job.content_size = image_file.size;
+            }
+
+            stbi_info_from_memory( image_file.data, ( int )image_file.size, &job.width, &job.height, &job.comp );
+
+            file_unmap( image_file );
+        }
+    }
+
+}; // struct ImageInfoTask
+
+// Content hashes can collide: images share a texture only when their files have the same bytes.
+static bool compare_image_files( cstring path_a, cstring path_b, sizet size ) {
+    FileSpan file_a = file_map( path_a, &image_file_allocator );
+    FileSpan file_b = file_map( path_b, &image_file_allocator );
+
+    const bool equal = file_a.data != nullptr && file_b.data != nullptr && file_a.size == size && file_b.size == size &&
+                       memcmp( file_a.data, file_b.data, size ) == 0;
+
+    file_unmap( file_a );
+    file_unmap( file_b );
+
+    return equal;
+}
+
+// Skinned primitives keep reading their joints and weights from the glTF buffers, so their vertices cannot move.
+static bool primitive_deduplicates_vertices( glTF::MeshPrimitive& mesh_primitive ) {
+    const i32 joints_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "JOINTS_0" );
+    const i32 weights_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "WEIGHTS_0" );
+
+    return deduplicate_vertices_on_import && joints_accessor_index == -1 && weights_accessor_index == -1;
+}
+
+// Raster and ray tracing paths read vertices straight from the glTF buffers: that works only for tightly packed floats
+// and 16/32 bit indices, of primitives neither deduplicated nor optimized. Otherwise the decoded streams are uploaded.
+static bool primitive_uploads_decoded_streams( glTF::glTF& gltf_scene, glTF::MeshPrimitive& mesh_primitive ) {
+    const i32 position_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION" );
+    const i32 normal_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "NORMAL" );
+    const i32 tex_coord_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0" );
+    const i32 tangent_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT" );
+
+    const bool use_source_buffers = gltf_accessor_is_packed_float( gltf_scene, position_accessor_index ) &&
+                                    ( normal_accessor_index == -1 || gltf_accessor_is_packed_float( gltf_scene, normal_accessor_index ) ) &&
+                                    ( tex_coord_accessor_index == -1 || gltf_accessor_is_packed_float( gltf_scene, tex_coord_accessor_index ) ) &&
+                                    ( tangent_accessor_index == -1 || gltf_accessor_is_packed_float( gltf_scene, tangent_accessor_index ) ) &&
+                                    gltf_accessor_is_packed_index( gltf_scene, mesh_primitive.indices );
+
+    return !use_source_buffers || optimize_meshes_on_import || primitive_deduplicates_vertices( mesh_primitive );
+}
+
+static void mark_accessor_buffer_view( glTF::glTF& gltf_scene, i32 accessor_index, Array<u8>& buffer_views_used ) {
+    if ( accessor_index == -1 ) {
+        return;
+    }
+
+    const i32 buffer_view_index = gltf_scene.accessors[ accessor_index ].buffer_view;
+    if ( buffer_view_index != glTF::INVALID_INT_VALUE ) {
+        buffer_views_used[ buffer_view_index ] = 1;
+    }
+}
+
 //
 // glTFScene //////////////////////////////////////////////////////////////
 
-void glTFScene::get_mesh_vertex_buffer( glTF::glTF& gltf_scene, u32 buffers_offset, i32 accessor_index, u32 flag, BufferHandle& out_buffer_handle, u32& out_buffer_offset, u32& out_flags ) {
+void glTFScene::create_decoded_vertex_buffer( PrimitiveMeshletData& primitive_data, cstring name, Mesh& mesh ) {
+    const u32 vertex_count = primitive_data.vertex_count;
+
+    // Layout: positions, tangents, normals, texcoords, u32 indices.
+    const u32 positions_size = sizeof( f32 ) * 3 * vertex_count;
+    const u32 tangents_size = primitive_data.tangents ? sizeof( f32 ) * 4 * vertex_count : 0;
+    const u32 normals_size = primitive_data.normals ? sizeof( f32 ) * 3 * vertex_count : 0;
+    const u32 tex_coords_size = primitive_data.tex_coords ? sizeof( f32 ) * 2 * vertex_count : 0;
+    const u32 indices_size = sizeof( u32 ) * primitive_data.index_count;
+
+    const u32 tangents_offset = positions_size;
+    const u32 normals_offset = tangents_offset + tangents_size;
+    const u32 tex_coords_offset = normals_offset + normals_size;
+    const u32 indices_offset = tex_coords_offset + tex_coords_size;
+    const u32 decoded_buffer_size = indices_offset + indices_size;
+
+    u8* decoded_data = rallocam( decoded_buffer_size, resident_allocator );
+    memory_copy( decoded_data, primitive_data.positions, positions_size );
+    if ( primitive_data.tangents ) {
+        memory_copy( decoded_data + tangents_offset, primitive_data.tangents, tangents_size );
+    }
+    if ( primitive_data.normals ) {
+        memory_copy( decoded_data + normals_offset, primitive_data.normals, normals_size );
+    }
+    if ( primitive_data.tex_coords ) {
+        memory_copy( decoded_data + tex_coords_offset, primitive_data.tex_coords, tex_coords_size );
+    }
+    memory_copy( decoded_data + indices_offset, primitive_data.indices, indices_size );
+
+    VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+    BufferResource* br = renderer->create_buffer( flags, ResourceUsageType::Immutable, decoded_buffer_size, decoded_data, name );
+    buffers.push( *br );
+
+    rfree( decoded_data, resident_allocator );
+
+    mesh.position_buffer = br->handle;
+    mesh.position_offset = 0;
+    if ( primitive_data.tangents ) {
+        mesh.tangent_buffer = br->handle;
+        mesh.tangent_offset = tangents_offset;
+        mesh.pbr_material.flags |= DrawFlags_HasTangents;
+    }
+    if ( primitive_data.normals ) {
+        mesh.normal_buffer = br->handle;
+        mesh.normal_offset = normals_offset;
+        mesh.pbr_material.flags |= DrawFlags_HasNormals;
+    }
+    if ( primitive_data.tex_coords ) {
+        mesh.texcoord_buffer = br->handle;
+        mesh.texcoord_offset = tex_coords_offset;
+        mesh.pbr_material.flags |= DrawFlags_HasTexCoords;
+    }
+
+    mesh.index_buffer = br->handle;
+    mesh.index_offset = indices_offset;
+    mesh.index_type = VK_INDEX_TYPE_UINT32;
+}
+
+void glTFScene::get_mesh_vertex_buffer( glTF::glTF& gltf_scene, u32 buffers_offset, const Array<u32>& buffer_view_offsets, i32 accessor_index, u32 flag, BufferHandle& out_buffer_handle, u32& out_buffer_offset, u32& out_flags ) {
     if ( accessor_index != -1 ) {
         glTF::Accessor& buffer_accessor = gltf_scene.accessors[ accessor_index ];
         glTF::BufferView& buffer_view = gltf_scene.buffer_views[ buffer_accessor.buffer_view ];
         BufferResource& buffer_gpu = buffers[ buffer_view.buffer + buffers_offset ];
+        RASSERT( buffer_view_offsets[ buffer_accessor.buffer_view ] != k_buffer_view_not_uploaded );
 
         out_buffer_handle = buffer_gpu.handle;
-        out_buffer_offset = glTF::get_data_offset( buffer_accessor.byte_offset, buffer_view.byte_offset );
+        out_buffer_offset = glTF::get_data_offset( buffer_accessor.byte_offset, ( i32 )buffer_view_offsets[ buffer_accessor.buffer_view ] );
 
         out_flags |= flag;
     }
@@ -142,7 +912,8 @@ void glTFScene::init( SceneGraph* scene_graph_, Allocator* resident_allocator_,
     meshlets_data.init( resident_allocator, 16 );
     meshlets_vertex_positions.init( resident_allocator, 16 );
     meshlets_vertex_data.init( resident_allocator, 16 );
-    gltf_mesh_to_mesh_offset.init( resident_allocator, 16 );
+    gltf_mesh_to_primitive_offset.init( resident_allocator, 16 );
+    gltf_primitive_to_mesh.init( resident_allocator, 16 );
 
     meshlets_index_count = 0;
 
@@ -179,14 +950,42 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
     StringBuffer temp_name_buffer;
     temp_name_buffer.init( 4096, temp_allocator );
 
+    u32 duplicate_images_count = 0;
+    sizet duplicate_images_memory = 0;
+
+    // Reading and hashing every image file is the slow part, do it on all workers.
+    Array<ImageInfoJob> image_info_jobs;
+    image_info_jobs.init( temp_allocator, gltf_scene.images_count, gltf_scene.images_count );
+    for ( u32 image_index = 0; image_index < gltf_scene.images_count; ++image_index ) {
+        image_info_jobs[ image_index ] = { gltf_scene.images[ image_index ].uri.data, 0, 0, 0, 0, 0 };
+    }
+
+    ImageInfoTask image_info_task;
+    image_info_task.jobs = image_info_jobs.data;
+    image_info_task.m_SetSize = image_info_jobs.size;
+
+    if ( image_info_jobs.size > 0 ) {
+        task_scheduler->AddTaskSetToPipe( &image_info_task );
+        task_scheduler->WaitforTask( &image_info_task );
+    }
+
+    // Image uris are relative to the scene, the current directory while loading it.
+    Directory scene_directory{ };
+    directory_current( &scene_directory );
+
     for ( u32 image_index = 0; image_index < gltf_scene.images_count; ++image_index ) {
         glTF::Image& image = gltf_scene.images[ image_index ];
 
-        int comp, width, height;
+        const ImageInfoJob& image_info = image_info_jobs[ image_index ];
+        const int width = image_info.width;
+        const int height = image_info.height;
+        const u64 content_hash = image_info.content_hash;
 
-        stbi_info( image.uri.data, &width, &height, &comp );
+        // Shared textures outlive the scene that created them, paths are absolute to compare across scenes.
+        char* content_path = temp_name_buffer.append_use_f( "%s/%s", scene_directory.path, image.uri.data );
 
         u32 mip_levels = 1;
+        sizet texture_memory = ( sizet )width * height * 4;
         if ( true ) {
             u32 w = width;
             u32 h = height;
@@ -195,24 +994,55 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
                 w /= 2;
                 h /= 2;
 
+                texture_memory += w * h * 4;
                 ++mip_levels;
             }
         }
 
+        TextureResource* shared_texture = content_hash != 0 ? renderer->find_texture_by_content( content_hash ) : nullptr;
+        if ( shared_texture != nullptr && shared_texture->content_size == image_info.content_size &&
+             compare_image_files( shared_texture->content_path, content_path, image_info.content_size ) ) {
+            shared_texture->add_reference();
+            images.push( *shared_texture );
+
+            ++duplicate_images_count;
+            duplicate_images_memory += texture_memory;
+
+            temp_name_buffer.clear();
+            continue;
+        }
+
+        // Reconstruct file path
+        char* full_filename = temp_name_buffer.append_use_f( "%s%s", path, image.uri.data );
+
         TextureCreation tc;
         tc.set_data( nullptr ).set_format_type( VK_FORMAT_R8G8B8A8_UNORM, TextureType::Texture2D ).set_flags( 0 ).set_size( ( u16 )width, ( u16 )height, 1 ).set_name( image.uri.data ).set_mips( mip_levels );
-        TextureResource* tr = renderer->create_texture( tc );
+
+        // Streamed textures load their mips when seen, the others all at once.
+        TextureResource* tr = nullptr;
+        if ( texture_streamer ) {
+            tr = texture_streamer->create_texture( tc, full_filename );
+        } else {
+            tr = renderer->create_texture( tc );
+            async_loader->request_texture_data( full_filename, tr->handle );
+        }
         RASSERT( tr != nullptr );
 
+        if ( content_hash != 0 && shared_texture == nullptr ) {
+            renderer->register_texture_content( tr, content_hash, image_info.content_size, content_path );
+        }
+
         images.push( *tr );
 
-        // Reconstruct file path
-        char* full_filename = temp_name_buffer.append_use_f( "%s%s", path, image.uri.data );
-        async_loader->request_texture_data( full_filename, tr->handle );
         // Reset name buffer
         temp_name_buffer.clear();
     }
 
+    if ( duplicate_images_count > 0 ) {
+        rprint( "Texture deduplication: %u of %u images are duplicates, saved %f MB of VRAM\n", duplicate_images_count, gltf_scene.images_count,
+                duplicate_images_memory / ( 1024.0 * 1024.0 ) );
+    }
+
     i64 end_loading_textures_files = time_now();
 
     i64 end_creating_textures = time_now();
@@ -289,13 +1119,93 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
     Array<void*> buffers_data;
     buffers_data.init( resident_allocator, gltf_scene.buffers_count );
 
+    // See BufferDataSource, one per glTF buffer.
+    Array<u8> buffers_data_source;
+    buffers_data_source.init( resident_allocator, gltf_scene.buffers_count, gltf_scene.buffers_count );
+
+    // Source buffers stay mapped when they are stored uncompressed in a pack.
+    Array<FileSpan> buffers_files;
+    buffers_files.init( resident_allocator, gltf_scene.buffers_count, gltf_scene.buffers_count );
+
+    Array<FileSpan> sidecars_data;
+    sidecars_data.init( resident_allocator, gltf_scene.buffers_count );
+
+    Array<GeometryDecodeJob> geometry_decode_jobs;
+    geometry_decode_jobs.init( resident_allocator, 16 );
+
+    sizet geometry_bytes_read = 0;
+    sizet geometry_bytes_decoded = 0;
+    u32 sidecars_written = 0;
+
+    // The gpu reads only joints, weights and the streams of primitives drawn straight from the glTF buffers.
+    // Primitives uploading their decoded streams read the other views on the cpu, while loading.
+    Array<u8> buffer_views_used;
+    buffer_views_used.init( resident_allocator, gltf_scene.buffer_views_count, gltf_scene.buffer_views_count );
+    memset( buffer_views_used.data, 0, buffer_views_used.size_in_bytes() );
+
+    for ( u32 mi = 0; mi < gltf_scene.meshes_count; ++mi ) {
+        glTF::Mesh& gltf_mesh = gltf_scene.meshes[ mi ];
+
+        for ( u32 p = 0; p < gltf_mesh.primitives_count; ++p ) {
+            glTF::MeshPrimitive& mesh_primitive = gltf_mesh.primitives[ p ];
+
+            if ( !primitive_uploads_decoded_streams( gltf_scene, mesh_primitive ) ) {
+                mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION" ), buffer_views_used );
+                mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "NORMAL" ), buffer_views_used );
+                mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0" ), buffer_views_used );
+                mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT" ), buffer_views_used );
+                mark_accessor_buffer_view( gltf_scene, mesh_primitive.indices, buffer_views_used );
+            }
+
+            mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "JOINTS_0" ), buffer_views_used );
+            mark_accessor_buffer_view( gltf_scene, gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "WEIGHTS_0" ), buffer_views_used );
+        }
+    }
+
+    // Buffers with all their views used are uploaded whole, straight from the file or the decoded sidecar.
+    // The others upload only their used views, packed one after the other: gpu offsets are per buffer view.
+    Array<u32> buffers_views_count;
+    buffers_views_count.init( resident_allocator, gltf_scene.buffers_count, gltf_scene.buffers_count );
+    memset( buffers_views_count.data, 0, buffers_views_count.size_in_bytes() );
+
+    Array<u32> buffers_used_views_count;
+    buffers_used_views_count.init( resident_allocator, gltf_scene.buffers_count, gltf_scene.buffers_count );
+    memset( buffers_used_views_count.data, 0, buffers_used_views_count.size_in_bytes() );
+
+    for ( u32 v = 0; v < gltf_scene.buffer_views_count; ++v ) {
+        const glTF::BufferView& buffer_view = gltf_scene.buffer_views[ v ];
+        ++buffers_views_count[ buffer_view.buffer ];
+        buffers_used_views_count[ buffer_view.buffer ] += buffer_views_used[ v ];
+    }
+
+    Array<u32> buffers_gpu_size;
+    buffers_gpu_size.init( resident_allocator, gltf_scene.buffers_count, gltf_scene.buffers_count );
     for ( u32 buffer_index = 0; buffer_index < gltf_scene.buffers_count; ++buffer_index ) {
-        glTF::Buffer& buffer = gltf_scene.buffers[ buffer_index ];
+        const bool upload_whole_buffer = buffers_used_views_count[ buffer_index ] > 0 && buffers_used_views_count[ buffer_index ] == buffers_views_count[ buffer_index ];
+        buffers_gpu_size[ buffer_index ] = upload_whole_buffer ? gltf_scene.buffers[ buffer_index ].byte_length : 0;
+    }
+
+    Array<u32> buffer_view_offsets;
+    buffer_view_offsets.init( resident_allocator, gltf_scene.buffer_views_count, gltf_scene.buffer_views_count );
+    for ( u32 v = 0; v < gltf_scene.buffer_views_count; ++v ) {
+        const glTF::BufferView& buffer_view = gltf_scene.buffer_views[ v ];
 
-        FileReadResult buffer_data = file_read_binary( buffer.uri.data, resident_allocator );
-        buffers_data.push( buffer_data.data );
+        if ( !buffer_views_used[ v ] ) {
+            buffer_view_offsets[ v ] = k_buffer_view_not_uploaded;
+        } else if ( buffers_used_views_count[ buffer_view.buffer ] == buffers_views_count[ buffer_view.buffer ] ) {
+            buffer_view_offsets[ v ] = glTF::get_data_offset( 0, buffer_view.byte_offset );
+        } else {
+            u32& buffer_gpu_size = buffers_gpu_size[ buffer_view.buffer ];
+            buffer_view_offsets[ v ] = ( buffer_gpu_size + k_buffer_view_alignment - 1 ) & ~( k_buffer_view_alignment - 1 );
+            buffer_gpu_size = buffer_view_offsets[ v ] + buffer_view.byte_length;
+        }
     }
 
+    const VkBufferUsageFlags buffer_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
+    // Buffers uploading only some views are created once their data is decoded, until then their slot is empty.
+    BufferResource empty_buffer{ };
+    empty_buffer.handle = k_invalid_buffer;
 
     // Load all buffers and initialize them with buffer data
     u32 buffers_offset = buffers.size;
@@ -303,23 +1213,159 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
 
         glTF::Buffer& buffer = gltf_scene.buffers[ buffer_index ];
 
-        VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+        const bool upload_whole_buffer = buffers_used_views_count[ buffer_index ] > 0 && buffers_used_views_count[ buffer_index ] == buffers_views_count[ buffer_index ];
+
+        char sidecar_path[ k_max_path ];
+        snprintf( sidecar_path, k_max_path, "%s%s", buffer.uri.data, k_geometry_codec_extension );
+
+        buffers_data_source[ buffer_index ] = BufferDataSource_File;
+        buffers_files[ buffer_index ] = { };
+
+        // Buffers only stored in a pack have no write time, sidecars written for other files do not match them.
+        const u64 buffer_write_time = use_compressed_geometry ? file_modification_time( buffer.uri.data ) : 0;
+
+        if ( use_compressed_geometry && file_exists( sidecar_path ) ) {
+            FileSpan sidecar_data = file_map( sidecar_path, resident_allocator );
+
+            u32 region_count = 0;
+            const GeometryCodecRegion* regions = geometry_codec_get_regions( sidecar_data.data, sidecar_data.size, buffer.byte_length, buffer_write_time, region_count );
+            if ( regions != nullptr ) {
+                u8* decoded_data = nullptr;
+
+                if ( upload_whole_buffer ) {
+                    BufferResource* br = renderer->create_buffer( buffer_flags, ResourceUsageType::Immutable, buffer.byte_length, nullptr, names_buffer.append_use_f( "buffer_%u", buffer_index ) );
+                    buffers.push( *br );
+
+                    MapBufferParameters map_parameters{ br->handle, 0, 0 };
+                    decoded_data = ( u8* )renderer->gpu->map_buffer( map_parameters );
+                    buffers_data_source[ buffer_index ] = BufferDataSource_Gpu;
+                } else {
+                    buffers.push( empty_buffer );
+
+                    decoded_data = rallocam( buffer.byte_length, resident_allocator );
+                    buffers_data_source[ buffer_index ] = BufferDataSource_Decoded;
+                }
+
+                buffers_data.push( decoded_data );
+                sidecars_data.push( sidecar_data );
+
+                geometry_codec_clear_gaps( regions, region_count, buffer.byte_length, decoded_data );
+
+                for ( u32 r = 0; r < region_count; ++r ) {
+                    geometry_decode_jobs.push( { sidecar_data.data, &regions[ r ], decoded_data, buffer_index, false } );
+                }
+
+                geometry_bytes_read += sidecar_data.size;
+                geometry_bytes_decoded += buffer.byte_length;
+                continue;
+            }
+
+            rprint( "Ignoring stale geometry sidecar %s\n", sidecar_path );
+            file_unmap( sidecar_data );
+        }
 
-        char* buffer_name = names_buffer.append_use_f( "buffer_%u", buffer_index );
+        FileSpan& buffer_file = buffers_files[ buffer_index ];
+        buffer_file = file_map( buffer.uri.data, resident_allocator );
+        buffers_data.push( ( void* )buffer_file.data );
 
-        u8* buffer_data = ( u8* )buffers_data[ buffer_index ];
-        BufferResource* br = renderer->create_buffer( flags, ResourceUsageType::Immutable, buffer.byte_length, buffer_data, buffer_name );
-        buffers.push( *br );
+        if ( upload_whole_buffer ) {
+            BufferResource* br = renderer->create_buffer( buffer_flags, ResourceUsageType::Immutable, buffer.byte_length, ( void* )buffer_file.data, names_buffer.append_use_f( "buffer_%u", buffer_index ) );
+            buffers.push( *br );
+        } else {
+            buffers.push( empty_buffer );
+        }
+
+        if ( use_compressed_geometry && write_compressed_geometry ) {
+            sidecars_written += geometry_codec_write_sidecar( gltf_scene, buffer_index, buffer_file.data, buffer_write_time, sidecar_path, resident_allocator ) > 0 ? 1 : 0;
+        }
     }
 
+    i64 end_reading_geometry = time_now();
+
+    // Sidecar regions are independent, decode them on all workers.
+    GeometryDecodeTask geometry_decode_task;
+    geometry_decode_task.jobs = geometry_decode_jobs.data;
+    geometry_decode_task.m_SetSize = geometry_decode_jobs.size;
+    geometry_decode_task.m_MinRange = 4;
+
+    if ( geometry_decode_jobs.size > 0 ) {
+        task_scheduler->AddTaskSetToPipe( &geometry_decode_task );
+        task_scheduler->WaitforTask( &geometry_decode_task );
+    }
+
+    for ( u32 j = 0; j < geometry_decode_jobs.size; ++j ) {
+        const GeometryDecodeJob& job = geometry_decode_jobs[ j ];
+        if ( job.decoded ) {
+            continue;
+        }
+
+        // Corrupted sidecar: fill the whole buffer from the source file.
+        glTF::Buffer& buffer = gltf_scene.buffers[ job.buffer_index ];
+        rprint( "Failed decoding geometry sidecar of %s, reading the source buffer\n", buffer.uri.data );
+
+        if ( !geometry_codec_read_source( buffer.uri.data, buffer.byte_length, job.buffer_data, resident_allocator ) ) {
+            rprint( "Cannot read %d bytes from %s, the geometry of the buffer is lost\n", buffer.byte_length, buffer.uri.data );
+        }
+
+        for ( u32 k = j; k < geometry_decode_jobs.size; ++k ) {
+            if ( geometry_decode_jobs[ k ].buffer_index == job.buffer_index ) {
+                geometry_decode_jobs[ k ].decoded = true;
+            }
+        }
+    }
+
+    for ( u32 i = 0; i < sidecars_data.size; ++i ) {
+        file_unmap( sidecars_data[ i ] );
+    }
+    sidecars_data.shutdown();
+    geometry_decode_jobs.shutdown();
+
+    if ( geometry_bytes_decoded > 0 || sidecars_written > 0 ) {
+        rprint( "Geometry sidecars: read %f MB for %f MB of buffers, decode %f seconds, %u written\n", geometry_bytes_read / ( 1024.0 * 1024.0 ), geometry_bytes_decoded / ( 1024.0 * 1024.0 ),
+                time_delta_seconds( end_reading_geometry, time_now() ), sidecars_written );
+    }
+
+    // Upload the used views of the other buffers, now that all buffer data is on the cpu.
+    sizet source_buffers_size = 0;
+    sizet uploaded_buffers_size = 0;
+    for ( u32 buffer_index = 0; buffer_index < gltf_scene.buffers_count; ++buffer_index ) {
+        source_buffers_size += gltf_scene.buffers[ buffer_index ].byte_length;
+        uploaded_buffers_size += buffers_gpu_size[ buffer_index ];
+
+        if ( buffers[ buffers_offset + buffer_index ].handle.index != k_invalid_buffer.index || buffers_gpu_size[ buffer_index ] == 0 ) {
+            continue;
+        }
+
+        BufferResource* br = renderer->create_buffer( buffer_flags, ResourceUsageType::Immutable, buffers_gpu_size[ buffer_index ], nullptr, names_buffer.append_use_f( "buffer_%u", buffer_index ) );
+        buffers[ buffers_offset + buffer_index ] = *br;
+
+        MapBufferParameters map_parameters{ br->handle, 0, 0 };
+        u8* gpu_data = ( u8* )renderer->gpu->map_buffer( map_parameters );
+
+        for ( u32 v = 0; v < gltf_scene.buffer_views_count; ++v ) {
+            const glTF::BufferView& buffer_view = gltf_scene.buffer_views[ v ];
+            if ( buffer_view.buffer != ( i32 )buffer_index || !buffer_views_used[ v ] ) {
+                continue;
+            }
+
+            memory_copy( gpu_data + buffer_view_offsets[ v ], ( const u8* )buffers_data[ buffer_index ] + glTF::get_data_offset( 0, buffer_view.byte_offset ), buffer_view.byte_length );
+        }
+
+        renderer->gpu->unmap_buffer( map_parameters );
+    }
+
+    if ( uploaded_buffers_size < source_buffers_size ) {
+        rprint( "glTF buffers: uploaded %f MB of %f MB, the other views are read only on the cpu\n", uploaded_buffers_size / ( 1024.0 * 1024.0 ), source_buffers_size / ( 1024.0 * 1024.0 ) );
+    }
+
+    buffer_views_used.shutdown();
+    buffers_views_count.shutdown();
+    buffers_used_views_count.shutdown();
+    buffers_gpu_size.shutdown();
 
     i64 end_reading_buffers_data = time_now();
 
     // Build meshlets
-    const sizet max_vertices = 64;
-    const sizet max_triangles = 124;
-    const f32 cone_weight = 0.0f;
-
     u32 mesh_index = 0;
 
     mesh_aabb[0] = vec3s{ FLT_MAX, FLT_MAX, FLT_MAX };
@@ -327,13 +1373,26 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
 
     sizet temp_marker = temp_allocator->get_marker();
 
-    u32 mesh_offset = meshes.size;
     u32 mesh_instances_offset = mesh_instances.size;
 
+    // Count primitives to allocate per primitive meshlet data
+    u32 total_primitives_count = 0;
+    for ( u32 mi = 0; mi < gltf_scene.meshes_count; ++mi ) {
+        total_primitives_count += gltf_scene.meshes[ mi ].primitives_count;
+    }
+
+    Array<PrimitiveMeshletData> primitives_meshlet_data;
+    primitives_meshlet_data.init( resident_allocator, total_primitives_count, total_primitives_count );
+
+    // Geometry hash to the index of the first primitive with that geometry.
+    FlatHashMap<u64, u32> primitive_geometry_map;
+    primitive_geometry_map.init( temp_allocator, raptor::max( total_primitives_count, 4u ) );
+    u32 duplicate_primitives_count = 0;
+
     for ( u32 mi = 0; mi < gltf_scene.meshes_count; ++mi ) {
         glTF::Mesh& mesh = gltf_scene.meshes[ mi ];
 
-        gltf_mesh_to_mesh_offset.push( meshes.size );
+        gltf_mesh_to_primitive_offset.push( gltf_primitive_to_mesh.size );
 
         for ( u32 p = 0; p < mesh.primitives_count; ++p ) {
             glTF::MeshPrimitive& mesh_primitive = mesh.primitives[ p ];
@@ -355,9 +1414,7 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
             // Vertex positions
             const i32 position_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION" );
             glTF::Accessor& position_buffer_accessor = gltf_scene.accessors[ position_accessor_index ];
-            glTF::BufferView& position_buffer_view = gltf_scene.buffer_views[ position_buffer_accessor.buffer_view ];
-            i32 position_data_offset = glTF::get_data_offset( position_buffer_accessor.byte_offset, position_buffer_view.byte_offset );
-            f32* vertices = ( f32* )((u8*)buffers_data[ position_buffer_view.buffer ] + position_data_offset);
+            const u32 vertex_count = position_buffer_accessor.count;
 
             // Calculate bounding sphere center
             vec3s position_min{ position_buffer_accessor.min[ 0 ], position_buffer_accessor.min[ 1 ], position_buffer_accessor.min[ 2 ] };
@@ -369,55 +1426,93 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
             f32 radius = raptor::max( glms_vec3_distance( position_max, bounding_center ), glms_vec3_distance( position_min, bounding_center ) );
             mesh.bounding_sphere = { bounding_center.x, bounding_center.y, bounding_center.z, radius };
 
-            // Vertex normals
             const i32 normal_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "NORMAL" );
-            f32* normals = nullptr;
+            const i32 tex_coord_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0" );
+            const i32 tangent_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT" );
+
+            // Decode all vertex streams to floats, whatever the source component type, stride or sparse storage is.
+            // Streams are kept until meshlets are built, so they come from the resident allocator.
+            PrimitiveMeshletData& primitive_data = primitives_meshlet_data[ mesh_index ];
+            primitive_data = {};
+            primitive_data.vertex_count = vertex_count;
+            primitive_data.source_vertex_count = vertex_count;
+            primitive_data.mesh_index = meshes.size;
+
+            primitive_data.positions = ( f32* )ralloca( sizeof( f32 ) * 3 * vertex_count, resident_allocator );
+            gltf_decode_accessor_floats( gltf_scene, buffers_data.data, position_accessor_index, primitive_data.positions, 3, sizeof( f32 ) * 3 );
+
             if ( normal_accessor_index != -1 ) {
-                glTF::Accessor& normal_buffer_accessor = gltf_scene.accessors[ normal_accessor_index ];
-                glTF::BufferView& normal_buffer_view = gltf_scene.buffer_views[ normal_buffer_accessor.buffer_view ];
-                i32 normal_data_offset = glTF::get_data_offset( normal_buffer_accessor.byte_offset, normal_buffer_view.byte_offset );
-                normals = ( f32* )((u8*)buffers_data[ normal_buffer_view.buffer ] + normal_data_offset);
+                primitive_data.normals = ( f32* )ralloca( sizeof( f32 ) * 3 * vertex_count, resident_allocator );
+                gltf_decode_accessor_floats( gltf_scene, buffers_data.data, normal_accessor_index, primitive_data.normals, 3, sizeof( f32 ) * 3 );
             }
 
-            // Vertex texture coords
-            const i32 tex_coord_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0" );
-            f32* tex_coords = nullptr;
             if ( tex_coord_accessor_index != -1 ) {
-                glTF::Accessor& tex_coord_buffer_accessor = gltf_scene.accessors[ tex_coord_accessor_index ];
-                glTF::BufferView& tex_coord_buffer_view = gltf_scene.buffer_views[ tex_coord_buffer_accessor.buffer_view ];
-                i32 tex_coord_data_offset = glTF::get_data_offset( tex_coord_buffer_accessor.byte_offset, tex_coord_buffer_view.byte_offset );
-                tex_coords = ( f32* )((u8*)buffers_data[ tex_coord_buffer_view.buffer ] + tex_coord_data_offset);
+                primitive_data.tex_coords = ( f32* )ralloca( sizeof( f32 ) * 2 * vertex_count, resident_allocator );
+                gltf_decode_accessor_floats( gltf_scene, buffers_data.data, tex_coord_accessor_index, primitive_data.tex_coords, 2, sizeof( f32 ) * 2 );
             }
 
-            // Vertex tangents
-            const i32 tangent_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT" );
-            f32* tangents = nullptr;
             if ( tangent_accessor_index != -1 ) {
-                glTF::Accessor& tangent_buffer_accessor = gltf_scene.accessors[ tangent_accessor_index ];
-                glTF::BufferView& tangent_buffer_view = gltf_scene.buffer_views[ tangent_buffer_accessor.buffer_view ];
-                i32 tangent_data_offset = glTF::get_data_offset( tangent_buffer_accessor.byte_offset, tangent_buffer_view.byte_offset );
-                tangents = ( f32* )((u8*)buffers_data[ tangent_buffer_view.buffer ] + tangent_data_offset);
+                primitive_data.tangents = ( f32* )ralloca( sizeof( f32 ) * 4 * vertex_count, resident_allocator );
+                gltf_decode_accessor_floats( gltf_scene, buffers_data.data, tangent_accessor_index, primitive_data.tangents, 4, sizeof( f32 ) * 4 );
             }
 
-            // Cache vertex buffers
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, position_accessor_index, 0, mesh.position_buffer, mesh.position_offset, mesh.pbr_material.flags );
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, tangent_accessor_index, DrawFlags_HasTangents, mesh.tangent_buffer, mesh.tangent_offset, mesh.pbr_material.flags );
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, normal_accessor_index, DrawFlags_HasNormals, mesh.normal_buffer, mesh.normal_offset, mesh.pbr_material.flags );
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, tex_coord_accessor_index, DrawFlags_HasTexCoords, mesh.texcoord_buffer, mesh.texcoord_offset, mesh.pbr_material.flags );
+            // Index buffer
+            glTF::Accessor& indices_accessor = gltf_scene.accessors[ mesh_primitive.indices ];
+            primitive_data.index_count = indices_accessor.count;
+            primitive_data.indices = ( u32* )ralloca( sizeof( u32 ) * indices_accessor.count, resident_allocator );
+            gltf_decode_accessor_indices( gltf_scene, buffers_data.data, mesh_primitive.indices, primitive_data.indices );
+
+            primitive_data.material_index = mesh_primitive.material;
 
             const i32 joints_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "JOINTS_0" );
             const i32 weights_accessor_index = gltf_get_attribute_accessor_index( mesh_primitive.attributes, mesh_primitive.attribute_count, "WEIGHTS_0" );
 
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, joints_accessor_index, DrawFlags_HasJoints, mesh.joints_buffer, mesh.joints_offset, mesh.pbr_material.flags );
-            get_mesh_vertex_buffer( gltf_scene, buffers_offset, weights_accessor_index, DrawFlags_HasWeights, mesh.weights_buffer, mesh.weights_offset, mesh.pbr_material.flags );
+            // Skinned primitives are never shared, as each node can use a different skin.
+            if ( instance_identical_primitives && joints_accessor_index == -1 && weights_accessor_index == -1 ) {
+                const u64 geometry_hash = hash_primitive_geometry( primitive_data );
 
+                FlatHashMapIterator it = primitive_geometry_map.find( geometry_hash );
+                if ( it.is_invalid() ) {
+                    primitive_geometry_map.insert( geometry_hash, mesh_index );
+                } else {
+                    PrimitiveMeshletData& original_data = primitives_meshlet_data[ primitive_geometry_map.get( it ) ];
+                    if ( compare_primitive_geometry( original_data, primitive_data ) ) {
+                        ++original_data.duplicate_count;
+                        ++duplicate_primitives_count;
 
-            // Index buffer
-            glTF::Accessor& indices_accessor = gltf_scene.accessors[ mesh_primitive.indices ];
-            glTF::BufferView& indices_buffer_view = gltf_scene.buffer_views[ indices_accessor.buffer_view ];
-            u8* buffer_data = ( u8* )buffers_data[ indices_buffer_view.buffer ];
-            i32 index_data_offset = glTF::get_data_offset( indices_accessor.byte_offset, indices_buffer_view.byte_offset );
-            u16* indices = ( u16* )(buffer_data + index_data_offset);
+                        gltf_primitive_to_mesh.push( original_data.mesh_index );
+
+                        free_primitive_streams( primitive_data, resident_allocator );
+                        primitive_data = {};
+                        continue;
+                    }
+                }
+            }
+
+            gltf_primitive_to_mesh.push( meshes.size );
+
+            // Buffer views read by the gpu were chosen the same way before uploading the glTF buffers.
+            primitive_data.deduplicate = primitive_deduplicates_vertices( mesh_primitive );
+            primitive_data.optimize = optimize_meshes_on_import;
+            primitive_data.upload_decoded_streams = primitive_uploads_decoded_streams( gltf_scene, mesh_primitive );
+
+            if ( primitive_data.upload_decoded_streams ) {
+                primitive_data.decoded_buffer_name = names_buffer.append_use_f( "decoded_buffer_%u_%u", mi, p );
+            } else {
+                // Cache vertex buffers
+                get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, position_accessor_index, 0, mesh.position_buffer, mesh.position_offset, mesh.pbr_material.flags );
+                get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, tangent_accessor_index, DrawFlags_HasTangents, mesh.tangent_buffer, mesh.tangent_offset, mesh.pbr_material.flags );
+                get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, normal_accessor_index, DrawFlags_HasNormals, mesh.normal_buffer, mesh.normal_offset, mesh.pbr_material.flags );
+                get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, tex_coord_accessor_index, DrawFlags_HasTexCoords, mesh.texcoord_buffer, mesh.texcoord_offset, mesh.pbr_material.flags );
+
+                u32 index_flags = 0;
+                get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, mesh_primitive.indices, 0, mesh.index_buffer, mesh.index_offset, index_flags );
+                mesh.index_type = indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+            }
+            // Otherwise decoded streams are final only after deduplication and optimization, they are uploaded when merging.
+
+            get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, joints_accessor_index, DrawFlags_HasJoints, mesh.joints_buffer, mesh.joints_offset, mesh.pbr_material.flags );
+            get_mesh_vertex_buffer( gltf_scene, buffers_offset, buffer_view_offsets, weights_accessor_index, DrawFlags_HasWeights, mesh.weights_buffer, mesh.weights_offset, mesh.pbr_material.flags );
 
             // Read pbr material data if present
             if ( mesh_primitive.material != glTF::INVALID_INT_VALUE ) {
@@ -425,177 +1520,243 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
                 fill_pbr_material( gltf_scene, *renderer, material, mesh.pbr_material );
             }
 
-            BufferResource& indices_buffer_gpu = buffers[ indices_buffer_view.buffer + buffers_offset ];
-            mesh.index_buffer = indices_buffer_gpu.handle;
-            mesh.index_offset = glTF::get_data_offset( indices_accessor.byte_offset, indices_buffer_view.byte_offset );
             mesh.primitive_count = indices_accessor.count;
 
             mesh.gpu_mesh_index = meshes.size;
 
-            const sizet max_meshlets = meshopt_buildMeshletsBound( indices_accessor.count, max_vertices, max_triangles );
+            // Allocate meshlet output here, as the resident allocator is not thread safe.
+            const sizet max_meshlets = meshopt_buildMeshletsBound( indices_accessor.count, k_meshlet_max_vertices, k_meshlet_max_triangles );
+
+            // Optional scratch arrays are still initialized empty: assigning {} leaves arrays uninitialized.
+            const u32 remap_count = ( primitive_data.optimize || primitive_data.deduplicate ) ? vertex_count : 0;
+            primitive_data.vertex_remap.init( resident_allocator, remap_count, remap_count );
+            primitive_data.weld_vertices.init( resident_allocator, ( primitive_data.deduplicate && weld_vertices_on_import ) ? vertex_count : 0 );
+
+            // Lods output is bounded by the minimum reduction each lod must reach to be kept.
+            primitive_data.max_lod_count = generate_mesh_lods ? k_max_mesh_lods : 1;
+            sizet max_lods_meshlets = max_meshlets;
+            u32 max_lod_index_count = indices_accessor.count;
+            for ( u32 l = 1; l < primitive_data.max_lod_count; ++l ) {
+                max_lod_index_count = get_next_lod_max_index_count( max_lod_index_count );
+                max_lods_meshlets += meshopt_buildMeshletsBound( max_lod_index_count, k_meshlet_max_vertices, k_meshlet_max_triangles );
+            }
 
-            Array<meshopt_Meshlet> local_meshlets;
-            local_meshlets.init( temp_allocator, max_meshlets, max_meshlets );
+            // Simplification writes up to the source index count before the result is accepted.
+            primitive_data.lod_indices.init( resident_allocator, indices_accessor.count * ( primitive_data.max_lod_count - 1 ) );
 
-            Array<u32> meshlet_vertex_indices;
-            meshlet_vertex_indices.init( temp_allocator, max_meshlets * max_vertices, max_meshlets* max_vertices );
+            primitive_data.local_meshlets.init( resident_allocator, max_meshlets, max_meshlets );
+            primitive_data.local_vertex_indices.init( resident_allocator, max_meshlets * k_meshlet_max_vertices, max_meshlets * k_meshlet_max_vertices );
+            primitive_data.local_triangles.init( resident_allocator, max_meshlets * k_meshlet_max_triangles * 3, max_meshlets * k_meshlet_max_triangles * 3 );
 
-            Array<u8> meshlet_triangles;
-            meshlet_triangles.init( temp_allocator, max_meshlets * max_triangles * 3, max_meshlets * max_triangles * 3 );
+            primitive_data.meshlets.init( resident_allocator, max_lods_meshlets );
+            primitive_data.meshlets_data.init( resident_allocator, max_lods_meshlets * k_meshlet_max_data_size );
+            primitive_data.vertex_positions.init( resident_allocator, vertex_count );
+            primitive_data.vertex_data.init( resident_allocator, vertex_count );
 
-            sizet meshlet_count = meshopt_buildMeshlets( local_meshlets.data, meshlet_vertex_indices.data, meshlet_triangles.data, indices,
-                                                         indices_accessor.count, vertices, position_buffer_accessor.count, sizeof( vec3s ),
-                                                         max_vertices, max_triangles, cone_weight );
+            // Add mesh with all data. Meshlet offsets are filled when merging.
+            meshes.push( mesh );
 
-            u32 meshlet_vertex_offset = meshlets_vertex_positions.size;
-            for ( u32 v = 0; v < position_buffer_accessor.count; ++v ) {
-                GpuMeshletVertexPosition meshlet_vertex_pos{ };
+            mesh_index++;
+        }
+    }
 
-                f32 x = vertices[ v * 3 + 0 ];
-                f32 y = vertices[ v * 3 + 1 ];
-                f32 z = vertices[ v * 3 + 2 ];
+    // Duplicated primitives are not built.
+    primitives_meshlet_data.set_size( mesh_index );
+    const u32 built_primitives_count = primitives_meshlet_data.size;
 
-                if ( x < mesh_aabb[ 0 ].x )
-                {
-                    mesh_aabb[ 0 ].x = x;
-                }
-                if ( y < mesh_aabb[ 0 ].y )
-                {
-                    mesh_aabb[ 0 ].y = y;
-                }
-                if ( z < mesh_aabb[ 0 ].z )
-                {
-                    mesh_aabb[ 0 ].z = z;
-                }
+    // Build meshlets for all primitives in parallel, each primitive writing in its own output.
+    i64 start_building_meshlets = time_now();
 
-                if ( x > mesh_aabb[ 1 ].x )
-                {
-                    mesh_aabb[ 1 ].x = x;
-                }
-                if ( y > mesh_aabb[ 1 ].y )
-                {
-                    mesh_aabb[ 1 ].y = y;
-                }
-                if ( z > mesh_aabb[ 1 ].z )
-                {
-                    mesh_aabb[ 1 ].z = z;
-                }
+    MeshletBuildTask meshlet_build_task;
+    meshlet_build_task.primitives = primitives_meshlet_data.data;
+    meshlet_build_task.m_SetSize = primitives_meshlet_data.size;
 
-                meshlet_vertex_pos.position[ 0 ] = x;
-                meshlet_vertex_pos.position[ 1 ] = y;
-                meshlet_vertex_pos.position[ 2 ] = z;
+    if ( build_meshlets_in_parallel ) {
+        task_scheduler->AddTaskSetToPipe( &meshlet_build_task );
+        task_scheduler->WaitforTask( &meshlet_build_task );
+    } else {
+        meshlet_build_task.ExecuteRange( { 0, primitives_meshlet_data.size }, 0 );
+    }
 
-                meshlets_vertex_positions.push( meshlet_vertex_pos );
+    i64 end_building_primitives_meshlets = time_now();
 
-                GpuMeshletVertexData meshlet_vertex_data{ };
+    // Accumulated import optimization statistics
+    f64 triangles_count = 0, vertices_count = 0;
+    f64 transformed_before = 0, transformed_after = 0;
+    f64 pixels_covered_before = 0, pixels_shaded_before = 0, pixels_covered_after = 0, pixels_shaded_after = 0;
+    f64 bytes_fetched_before = 0, bytes_fetched_after = 0, vertices_count_after = 0;
+    u32 source_vertices_count = 0, unique_vertices_count = 0;
+    u32 instancing_saved_meshlets = 0;
+    sizet instancing_saved_bytes = 0;
 
-                if ( normals != nullptr ) {
-                    meshlet_vertex_data.normal[ 0 ] = ( normals[ v * 3 + 0 ] + 1.0f ) * 127.0f;
-                    meshlet_vertex_data.normal[ 1 ] = ( normals[ v * 3 + 1 ] + 1.0f ) * 127.0f;
-                    meshlet_vertex_data.normal[ 2 ] = ( normals[ v * 3 + 2 ] + 1.0f ) * 127.0f;
-                }
+    u32 lods_count = 0;
+    u32 cluster_lod_clusters = 0, cluster_lod_groups = 0, cluster_lod_roots = 0, cluster_lod_levels = 0;
 
-                if ( tangents != nullptr ) {
-                    meshlet_vertex_data.tangent[ 0 ] = ( tangents[ v * 3 + 0 ] + 1.0f ) * 127.0f;
-                    meshlet_vertex_data.tangent[ 1 ] = ( tangents[ v * 3 + 1 ] + 1.0f ) * 127.0f;
-                    meshlet_vertex_data.tangent[ 2 ] = ( tangents[ v * 3 + 2 ] + 1.0f ) * 127.0f;
-                    meshlet_vertex_data.tangent[ 3 ] = ( tangents[ v * 3 + 3 ] + 1.0f ) * 127.0f;
-                }
+    // Merge in primitive order: output is the same as building serially.
+    for ( u32 pi = 0; pi < primitives_meshlet_data.size; ++pi ) {
+        PrimitiveMeshletData& primitive_data = primitives_meshlet_data[ pi ];
+        Mesh& mesh = meshes[ primitive_data.mesh_index ];
 
-                meshlet_vertex_data.uv_coords[ 0 ] = meshopt_quantizeHalf( tex_coords[ v * 2 + 0 ] );
-                meshlet_vertex_data.uv_coords[ 1 ] = meshopt_quantizeHalf( tex_coords[ v * 2 + 1 ] );
+        // Deduplicated and optimized primitives do not match the glTF buffers anymore.
+        if ( primitive_data.upload_decoded_streams ) {
+            create_decoded_vertex_buffer( primitive_data, primitive_data.decoded_buffer_name, mesh );
+        }
 
-                meshlets_vertex_data.push( meshlet_vertex_data );
+        source_vertices_count += primitive_data.source_vertex_count;
+        unique_vertices_count += primitive_data.unique_vertex_count;
+
+        if ( primitive_data.duplicate_count > 0 ) {
+            // Each duplicate would have had its own meshlets, meshlet vertices, draw data and bounds.
+            sizet primitive_gpu_size = primitive_data.meshlets.size_in_bytes() + primitive_data.meshlets_data.size_in_bytes() +
+                                       primitive_data.vertex_positions.size_in_bytes() + primitive_data.vertex_data.size_in_bytes() +
+                                       sizeof( GpuMaterialData ) + sizeof( vec4s );
+            if ( primitive_data.upload_decoded_streams ) {
+                const u32 vertex_components = 3 + ( primitive_data.normals ? 3 : 0 ) + ( primitive_data.tangents ? 4 : 0 ) + ( primitive_data.tex_coords ? 2 : 0 );
+                primitive_gpu_size += sizeof( f32 ) * vertex_components * primitive_data.vertex_count + sizeof( u32 ) * primitive_data.index_count;
             }
 
-            // Cache meshlet offset
-            mesh.meshlet_offset = meshlets.size;
-            mesh.meshlet_count = meshlet_count;
-            mesh.meshlet_index_count = 0;
+            instancing_saved_meshlets += primitive_data.duplicate_count * primitive_data.meshlets.size;
+            instancing_saved_bytes += primitive_data.duplicate_count * primitive_gpu_size;
+        }
 
-            // Append meshlet data
-            for ( u32 m = 0; m < meshlet_count; ++m ) {
-                meshopt_Meshlet& local_meshlet = local_meshlets[ m ];
+        if ( primitive_data.optimize ) {
+            triangles_count += primitive_data.index_count / 3;
+            vertices_count += primitive_data.unique_vertex_count;
+            vertices_count_after += primitive_data.vertex_count;
+
+            transformed_before += primitive_data.vertex_cache_before.vertices_transformed;
+            transformed_after += primitive_data.vertex_cache_after.vertices_transformed;
+            pixels_covered_before += primitive_data.overdraw_before.pixels_covered;
+            pixels_shaded_before += primitive_data.overdraw_before.pixels_shaded;
+            pixels_covered_after += primitive_data.overdraw_after.pixels_covered;
+            pixels_shaded_after += primitive_data.overdraw_after.pixels_shaded;
+            bytes_fetched_before += primitive_data.vertex_fetch_before.bytes_fetched;
+            bytes_fetched_after += primitive_data.vertex_fetch_after.bytes_fetched;
+        }
 
-                meshopt_Bounds meshlet_bounds = meshopt_computeMeshletBounds(meshlet_vertex_indices.data + local_meshlet.vertex_offset,
-                                                                             meshlet_triangles.data + local_meshlet.triangle_offset, local_meshlet.triangle_count,
-                                                                             vertices, position_buffer_accessor.count, sizeof( vec3s ));
+        const u32 meshlet_vertex_offset = meshlets_vertex_positions.size;
+        meshlets_vertex_positions.set_size( meshlet_vertex_offset + primitive_data.vertex_positions.size );
+        memory_copy( meshlets_vertex_positions.data + meshlet_vertex_offset, primitive_data.vertex_positions.data, primitive_data.vertex_positions.size_in_bytes() );
 
-                GpuMeshlet meshlet{};
-                meshlet.data_offset = meshlets_data.size;
-                meshlet.vertex_count = local_meshlet.vertex_count;
-                meshlet.triangle_count = local_meshlet.triangle_count;
+        meshlets_vertex_data.set_size( meshlet_vertex_offset + primitive_data.vertex_data.size );
+        memory_copy( meshlets_vertex_data.data + meshlet_vertex_offset, primitive_data.vertex_data.data, primitive_data.vertex_data.size_in_bytes() );
 
-                meshlet.center = vec3s{ meshlet_bounds.center[ 0 ], meshlet_bounds.center[ 1 ], meshlet_bounds.center[ 2 ] };
-                meshlet.radius = meshlet_bounds.radius;
+        const u32 meshlet_data_offset = meshlets_data.size;
+        meshlets_data.set_size( meshlet_data_offset + primitive_data.meshlets_data.size );
+        memory_copy( meshlets_data.data + meshlet_data_offset, primitive_data.meshlets_data.data, primitive_data.meshlets_data.size_in_bytes() );
 
-                meshlet.cone_axis[ 0 ] = meshlet_bounds.cone_axis_s8[ 0 ];
-                meshlet.cone_axis[ 1 ] = meshlet_bounds.cone_axis_s8[ 1 ];
-                meshlet.cone_axis[ 2 ] = meshlet_bounds.cone_axis_s8[ 2 ];
+        // Each lod starts at a multiple of 32 meshlets, as task shaders process meshlets in groups of 32.
+        meshlets.set_capacity( meshlets.size + primitive_data.meshlets.size + 32 * primitive_data.lod_count );
+        for ( u32 l = 0; l < primitive_data.lod_count; ++l ) {
+            const MeshLod& primitive_lod = primitive_data.lods[ l ];
 
-                meshlet.cone_cutoff = meshlet_bounds.cone_cutoff_s8;
-                meshlet.mesh_index = meshes.size;
+            MeshLod& lod = mesh.lods[ l ];
+            lod = primitive_lod;
+            lod.meshlet_offset = meshlets.size;
 
-                // Resize data array
-                const u32 index_group_count = ( local_meshlet.triangle_count * 3 + 3 ) / 4;
-                meshlets_data.set_capacity( meshlets_data.size + local_meshlet.vertex_count + index_group_count );
+            for ( u32 m = 0; m < primitive_lod.meshlet_count; ++m ) {
+                GpuMeshlet meshlet = primitive_data.meshlets[ primitive_lod.meshlet_offset + m ];
+                meshlet.data_offset += meshlet_data_offset;
 
+                // Rebase vertex indices, stored before the triangle indices.
                 for ( u32 i = 0; i < meshlet.vertex_count; ++i ) {
-                    const u32 vertex_index = meshlet_vertex_offset + meshlet_vertex_indices[ local_meshlet.vertex_offset + i ];
-                    meshlets_data.push( vertex_index );
+                    meshlets_data[ meshlet.data_offset + i ] += meshlet_vertex_offset;
                 }
 
-                // Store indices as uint32
-                // NOTE(marco): we write 4 indices at at time, it will come in handy in the mesh shader
-                const u32* index_groups = reinterpret_cast< const u32* >( meshlet_triangles.data + local_meshlet.triangle_offset );
-                for ( u32 i = 0; i < index_group_count; ++i ) {
-                    const u32 index_group = index_groups[ i ];
-                    meshlets_data.push( index_group );
-                }
+                meshlets.push( meshlet );
+            }
 
-                // Writing in group of fours can be problematic, if there are non multiple of 3
-                // indices a triangle can be shared between meshlets.
-                // We need to add some padding for that.
-                // This is visible only when emulating meshlets, so probably there are controls
-                // at driver level that avoid this problems when using mesh shaders.
-                // Check for the last 3 indices: if last one are two are zero, then add one or two
-                // groups of empty triangles.
-                u32 last_index_group = index_groups[ index_group_count - 1 ];
-                u32 last_index = ( last_index_group >> 8 ) & 0xff;
-                u32 second_last_index = ( last_index_group >> 16 ) & 0xff;
-                u32 third_last_index = ( last_index_group >> 24 ) & 0xff;
-                if ( last_index != 0 && third_last_index == 0 ) {
-
-                    if ( second_last_index != 0 ) {
-                        // Add a single index group of zeroes
-                        meshlets_data.push( 0 );
-                        meshlet.triangle_count++;
-                    }
+            while ( meshlets.size % 32 )
+                meshlets.push( GpuMeshlet() );
+        }
 
-                    meshlet.triangle_count++;
-                    // Add another index group of zeroes
-                    meshlets_data.push( 0 );
-                }
+        mesh.lod_count = primitive_data.lod_count;
+        lods_count += primitive_data.lod_count;
 
-                mesh.meshlet_index_count += meshlet.triangle_count * 3;
+        // Lods index the same vertices of lod 0, drawn with their own index buffer without meshlets.
+        u32 lod_indices_count = 0;
+        for ( u32 l = 1; l < primitive_data.lod_count; ++l ) {
+            mesh.lod_first_indices[ l ] = lod_indices_count;
+            mesh.lod_index_counts[ l ] = primitive_data.lod_index_counts[ l ];
+            lod_indices_count += primitive_data.lod_index_counts[ l ];
+        }
 
-                meshlets.push( meshlet );
+        if ( lod_indices_count > 0 ) {
+            BufferResource* br = renderer->create_buffer( VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceUsageType::Immutable, sizeof( u32 ) * lod_indices_count,
+                                                          primitive_data.lod_indices.data, "lod_indices" );
+            buffers.push( *br );
+            mesh.lod_index_buffer = br->handle;
+        }
 
-                meshlets_index_count += index_group_count;
-            }
+        mesh.meshlet_position_offset = primitive_data.aabb_min;
+        mesh.meshlet_position_scale = glms_vec3_sub( primitive_data.aabb_max, primitive_data.aabb_min );
 
-            // Add mesh with all data
-            meshes.push( mesh );
+        // Cache meshlet offset
+        mesh.meshlet_offset = mesh.lods[ 0 ].meshlet_offset;
+        mesh.meshlet_count = mesh.lods[ 0 ].meshlet_count;
+        mesh.meshlet_index_count = mesh.lods[ 0 ].meshlet_index_count;
 
-            while ( meshlets.size % 32 )
-                meshlets.push( GpuMeshlet() );
+        meshlets_index_count += primitive_data.index_group_count;
 
-            temp_allocator->free_marker( temp_marker );
+        if ( build_cluster_lods_on_import ) {
+            ClusterLod cluster_lod;
+            cluster_lod.init( resident_allocator, primitive_data.index_count );
+            cluster_lod.build( primitive_data.positions, primitive_data.vertex_count, sizeof( f32 ) * 3, primitive_data.indices, primitive_data.index_count );
 
-            mesh_index++;
+            cluster_lod_clusters += cluster_lod.clusters.size;
+            cluster_lod_groups += cluster_lod.groups.size;
+            cluster_lod_roots += cluster_lod.root_count;
+            cluster_lod_levels = raptor::max( cluster_lod_levels, cluster_lod.level_count );
+
+            cluster_lod.shutdown();
         }
+
+        mesh_aabb[ 0 ] = glms_vec3_minv( mesh_aabb[ 0 ], primitive_data.aabb_min );
+        mesh_aabb[ 1 ] = glms_vec3_maxv( mesh_aabb[ 1 ], primitive_data.aabb_max );
+
+        primitive_data.shutdown( resident_allocator );
+    }
+
+    primitives_meshlet_data.shutdown();
+
+    i64 end_merging_meshlets = time_now();
+
+    if ( instance_identical_primitives ) {
+        rprint( "Automatic instancing: %u of %u primitives are duplicates, saved %u meshlets and %f MB\n", duplicate_primitives_count, total_primitives_count,
+                instancing_saved_meshlets, instancing_saved_bytes / ( 1024.0 * 1024.0 ) );
+    }
+
+    if ( deduplicate_vertices_on_import ) {
+        rprint( "Vertex deduplication%s: %u -> %u vertices\n", weld_vertices_on_import ? " and welding" : "", source_vertices_count, unique_vertices_count );
     }
 
+    if ( optimize_meshes_on_import && triangles_count > 0 ) {
+        const f64 vertex_size = sizeof( GpuMeshletVertexPosition );
+        rprint( "Import optimization: ACMR %f -> %f, ATVR %f -> %f, overdraw %f -> %f, overfetch %f -> %f\n",
+                transformed_before / triangles_count, transformed_after / triangles_count,
+                transformed_before / vertices_count, transformed_after / vertices_count_after,
+                pixels_shaded_before / raptor::max( pixels_covered_before, 1.0 ), pixels_shaded_after / raptor::max( pixels_covered_after, 1.0 ),
+                bytes_fetched_before / ( vertices_count * vertex_size ), bytes_fetched_after / ( vertices_count_after * vertex_size ) );
+    }
+
+    if ( build_cluster_lods_on_import ) {
+        rprint( "Cluster lods: %u clusters, %u groups, %u roots, up to %u levels\n", cluster_lod_clusters, cluster_lod_groups, cluster_lod_roots, cluster_lod_levels );
+    }
+
+    // Uncompressed vertices used float positions, 8 bit normals and tangents, each stream padded to 16 bytes.
+    const u32 meshlet_vertex_count = meshlets_vertex_positions.size;
+    const f64 compressed_vertex_size = sizeof( GpuMeshletVertexPosition ) + sizeof( GpuMeshletVertexData );
+    const f64 uncompressed_vertex_size = sizeof( f32 ) * 4 * 2;
+    rprint( "Meshlet vertex memory: %u vertices, %f MB -> %f MB\n", meshlet_vertex_count, meshlet_vertex_count * uncompressed_vertex_size / ( 1024.0 * 1024.0 ),
+            meshlet_vertex_count * compressed_vertex_size / ( 1024.0 * 1024.0 ) );
+
+    rprint( "Built %u meshlets for %u primitives and %u lods: build %f seconds (%s, %u threads), merge %f seconds\n", meshlets.size, built_primitives_count, lods_count,
+            time_delta_seconds( start_building_meshlets, end_building_primitives_meshlets ), build_meshlets_in_parallel ? "parallel" : "serial",
+            build_meshlets_in_parallel ? task_scheduler->GetNumTaskThreads() : 1,
+            time_delta_seconds( end_building_primitives_meshlets, end_merging_meshlets ) );
+
+    temp_allocator->free_marker( temp_marker );
+
     // Create material
     const u64 hashed_name = hash_calculate( "main" );
     GpuTechnique* main_technique = renderer->resource_cache.techniques.get( hashed_name );
@@ -717,7 +1878,7 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
 
         // Start mesh part
         glTF::Mesh& gltf_mesh = gltf_scene.meshes[ node.mesh ];
-        u32 gltf_mesh_offset = gltf_mesh_to_mesh_offset[ node.mesh ];
+        u32 gltf_primitive_offset = gltf_mesh_to_primitive_offset[ node.mesh ];
 
         // Gltf primitives are conceptually submeshes.
         for ( u32 primitive_index = 0; primitive_index < gltf_mesh.primitives_count; ++primitive_index ) {
@@ -728,7 +1889,7 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
             glTF::MeshPrimitive& mesh_primitive = gltf_mesh.primitives[ primitive_index ];
 
             // Cache parent mesh and assign material
-            u32 mesh_primitive_index = gltf_mesh_offset + primitive_index;
+            u32 mesh_primitive_index = gltf_primitive_to_mesh[ gltf_primitive_offset + primitive_index ];
             mesh_instance.mesh = &meshes[ mesh_primitive_index ];
             mesh_instance.mesh->pbr_material.material = pbr_material;
             // Cache gpu mesh instance index, used to retrieve data on gpu.
@@ -750,15 +1911,15 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
 
     rprint( "Total meshlet instances %u\n", total_meshlets );
 
-    sizet mesh_count = meshes.size - mesh_offset;
-    sizet geometry_transform_buffer_size = sizeof( VkTransformMatrixKHR ) * mesh_count;
+    // One transform for each geometry, and geometries are built per mesh instance.
+    sizet transform_count = mesh_instances.size - mesh_instances_offset;
+    sizet geometry_transform_buffer_size = sizeof( VkTransformMatrixKHR ) * transform_count;
     BufferCreation bc{};
     bc.set( VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR, ResourceUsageType::Immutable, geometry_transform_buffer_size ).set_persistent( true ).set_name( "geometry_transform_buffer" );
     BufferHandle geometry_transform_buffer = renderer->gpu->create_buffer( bc );
     geometry_transform_buffers.push( geometry_transform_buffer );
 
     Array<VkTransformMatrixKHR> geometry_transform;
-    sizet transform_count = mesh_instances.size - mesh_instances_offset;
     geometry_transform.init( temp_allocator, transform_count, transform_count );
 
     for ( u32 mesh_index = 0; mesh_index < transform_count; ++mesh_index ) {
@@ -929,10 +2090,23 @@ void glTFScene::add_mesh( cstring filename, cstring path, StackAllocator* temp_a
 
     // Deallocate file-read buffer data
     for ( u32 buffer_index = 0; buffer_index < gltf_scene.buffers_count; ++buffer_index ) {
-        void* buffer = buffers_data[ buffer_index ];
-        resident_allocator->deallocate( buffer );
+        if ( buffers_data_source[ buffer_index ] == BufferDataSource_Gpu ) {
+            MapBufferParameters map_parameters{ buffers[ buffers_offset + buffer_index ].handle, 0, 0 };
+            renderer->gpu->unmap_buffer( map_parameters );
+            continue;
+        }
+
+        if ( buffers_data_source[ buffer_index ] == BufferDataSource_Decoded ) {
+            rfree( buffers_data[ buffer_index ], resident_allocator );
+            continue;
+        }
+
+        file_unmap( buffers_files[ buffer_index ] );
     }
     buffers_data.shutdown();
+    buffers_data_source.shutdown();
+    buffers_files.shutdown();
+    buffer_view_offsets.shutdown();
 
     i64 end_creating_buffers = time_now();
 
@@ -980,7 +2154,8 @@ void glTFScene::shutdown( Renderer* renderer ) {
     meshlets_vertex_data.shutdown();
     meshlets_vertex_positions.shutdown();
     meshlets_data.shutdown();
-    gltf_mesh_to_mesh_offset.shutdown();
+    gltf_mesh_to_primitive_offset.shutdown();
+    gltf_primitive_to_mesh.shutdown();
 
     // Unload meshes
     for ( u32 mesh_index = 0; mesh_index < meshes.size; ++mesh_index ) {
@@ -1033,8 +2208,9 @@ void glTFScene::shutdown( Renderer* renderer ) {
         gpu.destroy_descriptor_set( meshlet_emulation_descriptor_set[ i ] );
     }
 
+    // Images hold copies, release the pooled texture as it can be referenced by several images.
     for ( u32 i = 0; i < images.size; ++i) {
-        renderer->destroy_texture( &images[ i ] );
+        renderer->destroy_texture( renderer->textures.get( images[ i ].pool_index ) );
     }
 
     for ( u32 i = 0; i < samplers.size; ++i ) {
@@ -1042,6 +2218,11 @@ void glTFScene::shutdown( Renderer* renderer ) {
     }
 
     for ( u32 i = 0; i < buffers.size; ++i ) {
+        // glTF buffers read only on the cpu have no gpu buffer.
+        if ( buffers[ i ].handle.index == k_invalid_buffer.index ) {
+            continue;
+        }
+
         renderer->destroy_buffer( &buffers[ i ] );
     }
 
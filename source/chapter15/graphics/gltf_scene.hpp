@@ -6,6 +6,9 @@
 #include "foundation/gltf.hpp"
 
 namespace raptor {
+
+    struct PrimitiveMeshletData;
+
     //
     //
     struct glTFScene : public RenderScene {
@@ -16,10 +19,12 @@ namespace raptor {
 
         void                    prepare_draws( Renderer* renderer, StackAllocator* scratch_allocator, SceneGraph* scene_graph ) override;
 
-        void                    get_mesh_vertex_buffer( glTF::glTF& gltf_scene, u32 buffers_offset, i32 accessor_index, u32 flag, BufferHandle& out_buffer_handle, u32& out_buffer_offset, u32& out_flags );
+        void                    get_mesh_vertex_buffer( glTF::glTF& gltf_scene, u32 buffers_offset, const Array<u32>& buffer_view_offsets, i32 accessor_index, u32 flag, BufferHandle& out_buffer_handle, u32& out_buffer_offset, u32& out_flags );
         u16                     get_material_texture( GpuDevice& gpu, glTF::glTF& gltf_scene, glTF::TextureInfo* texture_info );
         u16                     get_material_texture( GpuDevice& gpu, glTF::glTF& gltf_scene, i32 gltf_texture_index );
 
+        void                    create_decoded_vertex_buffer( PrimitiveMeshletData& primitive_data, cstring name, Mesh& mesh );
+
         void                    fill_pbr_material( glTF::glTF& gltf_scene, Renderer& renderer, glTF::Material& material, PBRMaterial& pbr_material );
 
         // All graphics resources used by the scene
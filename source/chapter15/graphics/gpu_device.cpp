@@ -674,6 +674,9 @@ void GpuDevice::init( const GpuDeviceCreation& creation ) {
     if ( synchronization2_extension_present ) {
         vkQueueSubmit2KHR = ( PFN_vkQueueSubmit2KHR )vkGetDeviceProcAddr( vulkan_device, "vkQueueSubmit2KHR" );
         vkCmdPipelineBarrier2KHR = ( PFN_vkCmdPipelineBarrier2KHR )vkGetDeviceProcAddr( vulkan_device, "vkCmdPipelineBarrier2KHR" );
+        vkCmdSetEvent2KHR = ( PFN_vkCmdSetEvent2KHR )vkGetDeviceProcAddr( vulkan_device, "vkCmdSetEvent2KHR" );
+        vkCmdWaitEvents2KHR = ( PFN_vkCmdWaitEvents2KHR )vkGetDeviceProcAddr( vulkan_device, "vkCmdWaitEvents2KHR" );
+        vkCmdResetEvent2KHR = ( PFN_vkCmdResetEvent2KHR )vkGetDeviceProcAddr( vulkan_device, "vkCmdResetEvent2KHR" );
     }
 
     if ( mesh_shaders_extension_present ) {
@@ -870,19 +873,18 @@ void GpuDevice::init( const GpuDeviceCreation& creation ) {
 
         vkCreateCommandPool( vulkan_device, &cmd_pool_info, vulkan_allocation_callbacks, &pool.vulkan_command_pool );
 
+        if ( vulkan_compute_queue_family != u32_max ) {
+            cmd_pool_info.queueFamilyIndex = vulkan_compute_queue_family;
+            vkCreateCommandPool( vulkan_device, &cmd_pool_info, vulkan_allocation_callbacks, &pool.vulkan_compute_command_pool );
+        }
+
         // Create timestamp query pool used for GPU timings.
         VkQueryPoolCreateInfo timestamp_pool_info{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, nullptr, 0, VK_QUERY_TYPE_TIMESTAMP, creation.gpu_time_queries_per_frame * 2, 0 };
         vkCreateQueryPool( vulkan_device, &timestamp_pool_info, vulkan_allocation_callbacks, &pool.vulkan_timestamp_query_pool );
 
         // Create pipeline statistics query pool
         VkQueryPoolCreateInfo statistics_pool_info{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, nullptr, 0, VK_QUERY_TYPE_PIPELINE_STATISTICS, 7, 0 };
-        statistics_pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+        statistics_pool_info.pipelineStatistics = k_pipeline_statistics_flags;
         vkCreateQueryPool( vulkan_device, &statistics_pool_info, vulkan_allocation_callbacks, &pool.vulkan_pipeline_stats_query_pool);
     }
 
@@ -898,9 +900,12 @@ void GpuDevice::init( const GpuDeviceCreation& creation ) {
     descriptor_sets.init( allocator, resource_pool_creation.descriptor_sets, sizeof( DescriptorSet ) );
     samplers.init( allocator, resource_pool_creation.samplers, sizeof( Sampler ) );
     page_pools.init( allocator, resource_pool_creation.page_pools, sizeof( PagePool ) );
+    memory_heaps.init( allocator, resource_pool_creation.memory_heaps, sizeof( MemoryHeap ) );
 
     pending_sparse_queue_binds.init( allocator, 1024 );
     pending_sparse_memory_info.init( allocator, 1024 );
+    pending_sparse_opaque_binds.init( allocator, 64 );
+    pending_sparse_opaque_info.init( allocator, 64 );
 
     VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
     vkCreateSemaphore( vulkan_device, &semaphore_info, vulkan_allocation_callbacks, &vulkan_image_acquired_semaphore );
@@ -926,6 +931,8 @@ void GpuDevice::init( const GpuDeviceCreation& creation ) {
         vkCreateSemaphore( vulkan_device, &semaphore_info, vulkan_allocation_callbacks, &vulkan_graphics_semaphore );
 
         vkCreateSemaphore( vulkan_device, &semaphore_info, vulkan_allocation_callbacks, &vulkan_compute_semaphore );
+
+        vkCreateSemaphore( vulkan_device, &semaphore_info, vulkan_allocation_callbacks, &vulkan_graphics_queue_semaphore );
     } else {
         vkCreateSemaphore( vulkan_device, &semaphore_info, vulkan_allocation_callbacks, &vulkan_compute_semaphore );
 
@@ -1045,6 +1052,7 @@ void GpuDevice::shutdown() {
 
     if ( timeline_semaphore_extension_present ) {
         vkDestroySemaphore( vulkan_device, vulkan_graphics_semaphore, vulkan_allocation_callbacks );
+        vkDestroySemaphore( vulkan_device, vulkan_graphics_queue_semaphore, vulkan_allocation_callbacks );
     } else {
         vkDestroyFence( vulkan_device, vulkan_compute_fence, vulkan_allocation_callbacks );
     }
@@ -1148,6 +1156,12 @@ void GpuDevice::shutdown() {
                 break;
             }
 
+            case ResourceUpdateType::MemoryHeap:
+            {
+                destroy_memory_heap_instant( resource_deletion.handle );
+                break;
+            }
+
             default:
             {
                 RASSERTM( false, "Cannot process resource type %u\n", resource_deletion.type );
@@ -1188,6 +1202,7 @@ void GpuDevice::shutdown() {
     textures.shutdown();
     samplers.shutdown();
     page_pools.shutdown();
+    memory_heaps.shutdown();
     descriptor_set_layouts.shutdown();
     descriptor_sets.shutdown();
     render_passes.shutdown();
@@ -1195,6 +1210,8 @@ void GpuDevice::shutdown() {
 
     pending_sparse_queue_binds.shutdown();
     pending_sparse_memory_info.shutdown();
+    pending_sparse_opaque_binds.shutdown();
+    pending_sparse_opaque_info.shutdown();
 
 #ifdef VULKAN_DEBUG_REPORT
     // Remove the debug report callback
@@ -1215,6 +1232,10 @@ void GpuDevice::shutdown() {
         vkDestroyQueryPool( vulkan_device, pool.vulkan_timestamp_query_pool, vulkan_allocation_callbacks );
         vkDestroyQueryPool( vulkan_device, pool.vulkan_pipeline_stats_query_pool, vulkan_allocation_callbacks );
         vkDestroyCommandPool( vulkan_device, pool.vulkan_command_pool, vulkan_allocation_callbacks );
+
+        if ( pool.vulkan_compute_command_pool != nullptr ) {
+            vkDestroyCommandPool( vulkan_device, pool.vulkan_compute_command_pool, vulkan_allocation_callbacks );
+        }
     }
 
     // Memory: this contains allocations for gpu timestamp memory, queued command buffers and render frames.
@@ -1287,13 +1308,30 @@ static VkImageUsageFlags vulkan_get_image_usage( const TextureCreation& creation
     return usage;
 }
 
+static void vulkan_fill_image_info( const TextureCreation& creation, VkImageCreateInfo& image_info ) {
+
+    const bool is_cubemap = creation.type == TextureType::TextureCube || creation.type == TextureType::Texture_Cube_Array;
+    const bool is_sparse_texture = ( creation.flags & TextureFlags::Sparse_mask ) == TextureFlags::Sparse_mask;
+
+    image_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    image_info.format = creation.format;
+    image_info.flags = ( is_cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0 ) | ( is_sparse_texture ? ( VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT | VK_IMAGE_CREATE_SPARSE_BINDING_BIT ) : 0 );
+    image_info.imageType = to_vk_image_type( creation.type );
+    image_info.extent.width = creation.width;
+    image_info.extent.height = creation.height;
+    image_info.extent.depth = creation.depth;
+    image_info.mipLevels = creation.mip_level_count;
+    image_info.arrayLayers = creation.array_layer_count;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = vulkan_get_image_usage( creation );
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
 static void vulkan_create_texture( GpuDevice& gpu, const TextureCreation& creation, TextureHandle handle, Texture* texture ) {
 
-    bool is_cubemap = false;
     u32 layer_count = creation.array_layer_count;
-    if ( creation.type == TextureType::TextureCube || creation.type == TextureType::Texture_Cube_Array ) {
-        is_cubemap = true;
-    }
 
     const bool is_sparse_texture = ( creation.flags & TextureFlags::Sparse_mask ) == TextureFlags::Sparse_mask;
 
@@ -1316,29 +1354,28 @@ static void vulkan_create_texture( GpuDevice& gpu, const TextureCreation& creati
     texture->alias_texture = k_invalid_texture;
 
     //// Create the image
-    VkImageCreateInfo image_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
-    image_info.format = texture->vk_format;
-    image_info.flags = ( is_cubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0 ) | ( is_sparse_texture ? ( VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT | VK_IMAGE_CREATE_SPARSE_BINDING_BIT ) : 0 );
-    image_info.imageType = to_vk_image_type( texture->type );
-    image_info.extent.width = creation.width;
-    image_info.extent.height = creation.height;
-    image_info.extent.depth = creation.depth;
-    image_info.mipLevels = creation.mip_level_count;
-    image_info.arrayLayers = layer_count;
-    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
-    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    image_info.usage = texture->vk_usage;
-    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkImageCreateInfo image_info;
+    vulkan_fill_image_info( creation, image_info );
 
     VmaAllocationCreateInfo memory_info{};
     memory_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
     rprint( "creating tex %s\n", creation.name );
 
-    if ( creation.alias.index == k_invalid_texture.index ) {
+    if ( creation.memory_heap.index != k_invalid_memory_heap.index ) {
+        MemoryHeap* memory_heap = gpu.access_memory_heap( creation.memory_heap );
+        RASSERT( memory_heap != nullptr );
+        RASSERT( !is_sparse_texture && creation.alias.index == k_invalid_texture.index );
+
+        // The heap owns the memory, the texture only its image.
+        check( vkCreateImage( gpu.vulkan_device, &image_info, gpu.vulkan_allocation_callbacks, &texture->vk_image ) );
+        check( vmaBindImageMemory2( gpu.vma_allocator, memory_heap->vma_allocation, creation.memory_offset, texture->vk_image, nullptr ) );
+        texture->vma_allocation = 0;
+    } else if ( creation.alias.index == k_invalid_texture.index ) {
         if ( is_sparse_texture ) {
             check( vkCreateImage( gpu.vulkan_device, &image_info, gpu.vulkan_allocation_callbacks, &texture->vk_image ) );
+            // Memory is bound page by page.
+            texture->vma_allocation = 0;
         } else {
             check( vmaCreateImage( gpu.vma_allocator, &image_info, &memory_info,
                                 &texture->vk_image, &texture->vma_allocation, nullptr ) );
@@ -3111,13 +3148,16 @@ void GpuDevice::destroy_texture_instant( ResourceHandle texture ) {
         vkDestroyImageView( vulkan_device, v_texture->vk_image_view, vulkan_allocation_callbacks );
         v_texture->vk_image_view = VK_NULL_HANDLE;
 
+        // Texture views do not own the image, even when their parent is sparse or aliased.
+        const bool owns_image = v_texture->parent_texture.index == k_invalid_texture.index;
+
         // Standard texture: vma allocation valid, and is NOT a texture view (parent_texture is invalid)
-        if ( v_texture->vma_allocation != 0 && v_texture->parent_texture.index == k_invalid_texture.index ) {
+        if ( v_texture->vma_allocation != 0 && owns_image ) {
             vmaDestroyImage( vma_allocator, v_texture->vk_image, v_texture->vma_allocation );
-        } else if ( ( v_texture->flags & TextureFlags::Sparse_mask ) == TextureFlags::Sparse_mask ) {
+        } else if ( ( v_texture->flags & TextureFlags::Sparse_mask ) == TextureFlags::Sparse_mask && owns_image ) {
             // Sparse textures
             vkDestroyImage( vulkan_device, v_texture->vk_image, vulkan_allocation_callbacks );
-        } else if ( v_texture->vma_allocation == nullptr ) {
+        } else if ( v_texture->vma_allocation == nullptr && owns_image ) {
             // Aliased textures
             vkDestroyImage( vulkan_device, v_texture->vk_image, vulkan_allocation_callbacks );
         }
@@ -3579,6 +3619,15 @@ void GpuDevice::resize_texture_3d( TextureHandle texture, u32 width, u32 height,
         return;
     }
 
+    TextureCreation tc;
+    tc.set_size( width, height, depth );
+    recreate_texture( texture, tc );
+}
+
+void GpuDevice::recreate_texture( TextureHandle texture, TextureCreation& creation ) {
+
+    Texture* vk_texture = access_texture( texture );
+
     // Queue deletion of texture by creating a temporary one
     TextureHandle texture_to_delete = { textures.obtain_resource() };
     Texture* vk_texture_to_delete = access_texture( texture_to_delete );
@@ -3592,15 +3641,75 @@ void GpuDevice::resize_texture_3d( TextureHandle texture, u32 width, u32 height,
     vk_texture_to_delete->handle = texture_to_delete;
     
     // Re-create image in place.
-    TextureCreation tc;
-    tc.set_flags( vk_texture->flags ).set_format_type( vk_texture->vk_format, vk_texture->type )
-      .set_name( vk_texture->name ).set_size( width, height, depth )
-      .set_mips( vk_texture->mip_level_count );
-    vulkan_create_texture( *this, tc, vk_texture->handle, vk_texture );
+    creation.set_flags( vk_texture->flags ).set_format_type( vk_texture->vk_format, vk_texture->type )
+      .set_name( vk_texture->name ).set_mips( vk_texture->mip_level_count );
+    vulkan_create_texture( *this, creation, vk_texture->handle, vk_texture );
 
     destroy_texture( texture_to_delete );
 }
 
+MemoryHeapHandle GpuDevice::create_memory_heap( const VkMemoryRequirements& requirements, cstring name ) {
+    MemoryHeapHandle heap_handle = { memory_heaps.obtain_resource() };
+    if ( heap_handle.index == k_invalid_index ) {
+        return heap_handle;
+    }
+
+    MemoryHeap* memory_heap = access_memory_heap( heap_handle );
+
+    VmaAllocationCreateInfo allocation_create_info{};
+    allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    if ( vmaAllocateMemory( vma_allocator, &requirements, &allocation_create_info, &memory_heap->vma_allocation, nullptr ) != VK_SUCCESS ) {
+        rprint( "Graphics error: cannot allocate memory heap %s of %llu bytes\n", name ? name : "", ( u64 )requirements.size );
+
+        memory_heaps.release_resource( heap_handle.index );
+        return k_invalid_memory_heap;
+    }
+
+#if defined (_DEBUG)
+    vmaSetAllocationName( vma_allocator, memory_heap->vma_allocation, name );
+#endif // _DEBUG
+
+    memory_heap->size = requirements.size;
+    memory_heap->memory_type_bits = requirements.memoryTypeBits;
+
+    return heap_handle;
+}
+
+void GpuDevice::destroy_memory_heap( MemoryHeapHandle heap_handle ) {
+    if ( heap_handle.index < memory_heaps.pool_size ) {
+        // Resources placed in the heap could still be in use by the frames in flight.
+        resource_deletion_queue.push( { ResourceUpdateType::MemoryHeap, heap_handle.index, current_frame + k_max_frames, 1 } );
+    } else {
+        rprint( "Graphics error: trying to free invalid MemoryHeap %u\n", heap_handle.index );
+    }
+}
+
+void GpuDevice::destroy_memory_heap_instant( ResourceHandle handle ) {
+    MemoryHeap* memory_heap = ( MemoryHeap* )memory_heaps.access_resource( handle );
+    if ( memory_heap ) {
+        vmaFreeMemory( vma_allocator, memory_heap->vma_allocation );
+        memory_heap->vma_allocation = 0;
+    }
+    memory_heaps.release_resource( handle );
+}
+
+VkMemoryRequirements GpuDevice::get_texture_memory_requirements( const TextureCreation& creation ) {
+    VkImageCreateInfo image_info;
+    vulkan_fill_image_info( creation, image_info );
+
+    // Images with the same creation info have the same requirements: query them on a temporary image.
+    VkImage image = VK_NULL_HANDLE;
+    check( vkCreateImage( vulkan_device, &image_info, vulkan_allocation_callbacks, &image ) );
+
+    VkMemoryRequirements memory_requirements{ };
+    vkGetImageMemoryRequirements( vulkan_device, image, &memory_requirements );
+
+    vkDestroyImage( vulkan_device, image, vulkan_allocation_callbacks );
+
+    return memory_requirements;
+}
+
 PagePoolHandle GpuDevice::allocate_texture_pool( TextureHandle texture_handle, u32 pool_size ) {
     PagePoolHandle pool_handle = { k_invalid_index };
 
@@ -3777,6 +3886,149 @@ void GpuDevice::bind_texture_pages( PagePoolHandle pool_handle, TextureHandle te
     pending_sparse_memory_info.push( bind_info );
 }
 
+void GpuDevice::get_sparse_texture_properties( TextureHandle texture_handle, SparseTextureProperties& out_properties ) {
+    Texture* texture = access_texture( texture_handle );
+    RASSERT( texture != nullptr && texture->sparse );
+
+    VkMemoryRequirements memory_requirements{ };
+    vkGetImageMemoryRequirements( vulkan_device, texture->vk_image, &memory_requirements );
+
+    // Color textures have a single aspect, thus a single requirement.
+    u32 requirement_count = 1;
+    VkSparseImageMemoryRequirements sparse_requirements{ };
+    vkGetImageSparseMemoryRequirements( vulkan_device, texture->vk_image, &requirement_count, &sparse_requirements );
+    RASSERT( requirement_count == 1 );
+
+    const u32 page_size = ( u32 )memory_requirements.alignment; // NOTE: alignment corresponds to block size for sparse textures
+
+    out_properties.page_width = sparse_requirements.formatProperties.imageGranularity.width;
+    out_properties.page_height = sparse_requirements.formatProperties.imageGranularity.height;
+    out_properties.page_size = page_size;
+    out_properties.mip_tail_first = sparse_requirements.imageMipTailFirstLod;
+    out_properties.mip_tail_page_count = ( u32 )( ( sparse_requirements.imageMipTailSize + page_size - 1 ) / page_size );
+    out_properties.mip_tail_offset = sparse_requirements.imageMipTailOffset;
+}
+
+void GpuDevice::bind_texture_mip_pages( PagePoolHandle pool_handle, TextureHandle texture_handle, u32 mip, const u32* pages, u32 page_count_x, u32 page_count_y ) {
+    PagePool* page_pool = access_page_pool( pool_handle );
+    Texture* texture = access_texture( texture_handle );
+    if ( page_pool == nullptr || texture == nullptr ) {
+        RASSERT( false );
+        return;
+    }
+
+    RASSERT( texture->sparse );
+
+    const u32 mip_width = raptor_max( ( u32 )texture->width >> mip, 1u );
+    const u32 mip_height = raptor_max( ( u32 )texture->height >> mip, 1u );
+
+    u32 array_offset = pending_sparse_queue_binds.size;
+
+    for ( u32 page_y = 0; page_y < page_count_y; ++page_y ) {
+        for ( u32 page_x = 0; page_x < page_count_x; ++page_x ) {
+            VkSparseImageMemoryBind sparse_bind{ };
+
+            // No memory unbinds the page.
+            const u32 page = pages[ page_y * page_count_x + page_x ];
+            if ( page != k_invalid_index ) {
+                VmaAllocationInfo allocation_info{ };
+                vmaGetAllocationInfo( vma_allocator, page_pool->vma_allocations[ page ], &allocation_info );
+
+                sparse_bind.memory = allocation_info.deviceMemory;
+                sparse_bind.memoryOffset = allocation_info.offset;
+            }
+
+            const u32 x = page_x * page_pool->block_width;
+            const u32 y = page_y * page_pool->block_height;
+
+            // Pages on the edges are clipped to the mip.
+            sparse_bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            sparse_bind.subresource.mipLevel = mip;
+            sparse_bind.subresource.arrayLayer = 0;
+            sparse_bind.offset = { ( i32 )x, ( i32 )y, 0 };
+            sparse_bind.extent = { raptor_min( page_pool->block_width, mip_width - x ), raptor_min( page_pool->block_height, mip_height - y ), 1 };
+
+            pending_sparse_queue_binds.push( sparse_bind );
+        }
+    }
+
+    SparseMemoryBindInfo bind_info{ };
+    bind_info.image = texture->vk_image;
+    bind_info.binding_array_offset = array_offset;
+    bind_info.count = page_count_x * page_count_y;
+
+    pending_sparse_memory_info.push( bind_info );
+}
+
+void GpuDevice::bind_texture_mip_tail( PagePoolHandle pool_handle, TextureHandle texture_handle, const u32* pages, u32 page_count ) {
+    PagePool* page_pool = access_page_pool( pool_handle );
+    Texture* texture = access_texture( texture_handle );
+    if ( page_pool == nullptr || texture == nullptr ) {
+        RASSERT( false );
+        return;
+    }
+
+    SparseTextureProperties properties;
+    get_sparse_texture_properties( texture_handle, properties );
+
+    u32 array_offset = pending_sparse_opaque_binds.size;
+
+    // Single layer textures have a single mip tail, bound as opaque memory.
+    for ( u32 p = 0; p < page_count; ++p ) {
+        VkSparseMemoryBind sparse_bind{ };
+        sparse_bind.resourceOffset = properties.mip_tail_offset + ( VkDeviceSize )p * properties.page_size;
+        sparse_bind.size = properties.page_size;
+
+        if ( pages[ p ] != k_invalid_index ) {
+            VmaAllocationInfo allocation_info{ };
+            vmaGetAllocationInfo( vma_allocator, page_pool->vma_allocations[ pages[ p ] ], &allocation_info );
+
+            sparse_bind.memory = allocation_info.deviceMemory;
+            sparse_bind.memoryOffset = allocation_info.offset;
+        }
+
+        pending_sparse_opaque_binds.push( sparse_bind );
+    }
+
+    SparseMemoryBindInfo bind_info{ };
+    bind_info.image = texture->vk_image;
+    bind_info.binding_array_offset = array_offset;
+    bind_info.count = page_count;
+
+    pending_sparse_opaque_info.push( bind_info );
+}
+
+void GpuDevice::set_texture_base_mip( TextureHandle texture_handle, u32 base_mip ) {
+    Texture* texture = access_texture( texture_handle );
+    if ( texture == nullptr || base_mip >= texture->mip_level_count ) {
+        RASSERT( false );
+        return;
+    }
+
+    TextureViewCreation tvc;
+    tvc.set_parent_texture( texture_handle ).set_mips( base_mip, texture->mip_level_count - base_mip ).set_array( 0, texture->array_layer_count )
+       .set_view_type( to_vk_image_view_type( texture->type ) ).set_name( texture->name );
+    TextureHandle view_handle = create_texture_view( tvc );
+    if ( view_handle.index == k_invalid_index ) {
+        return;
+    }
+
+    // Swap the image views, the old one is destroyed with the temporary view.
+    texture = access_texture( texture_handle );
+    Texture* view = access_texture( view_handle );
+
+    VkImageView previous_image_view = texture->vk_image_view;
+    texture->vk_image_view = view->vk_image_view;
+    view->vk_image_view = previous_image_view;
+
+    destroy_texture( view_handle );
+
+    if ( bindless_supported ) {
+        ResourceUpdate resource_update{ ResourceUpdateType::Texture, texture_handle.index, current_frame, 0 };
+        texture_to_update_bindless.push( resource_update );
+    }
+}
+
 
 //
 //
@@ -3882,8 +4134,8 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
     VkSemaphore* render_complete_semaphore = &vulkan_render_complete_semaphore[ current_frame ];
 
     // Copy all commands
-    VkCommandBuffer enqueued_command_buffers[ 4 ];
-    RASSERT( num_queued_command_buffers < 4 );
+    VkCommandBuffer enqueued_command_buffers[ k_max_queued_command_buffers ];
+    RASSERT( num_queued_command_buffers <= k_max_queued_command_buffers );
     for ( u32 c = 0; c < num_queued_command_buffers; c++ ) {
 
         CommandBuffer* command_buffer = queued_command_buffers[ c ];
@@ -3894,18 +4146,26 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
         command_buffer->end_current_render_pass();
 
         // If marker are present, then queries are as well.
-        if ( command_buffer->thread_frame_pool->time_queries->allocated_time_query ) {
+        if ( command_buffer->pipeline_statistics_query_active && command_buffer->thread_frame_pool->time_queries->allocated_time_query ) {
             vkCmdEndQuery( command_buffer->vk_command_buffer, command_buffer->thread_frame_pool->vulkan_pipeline_stats_query_pool, 0 );
         }
+        command_buffer->pipeline_statistics_query_active = false;
 
         vkEndCommandBuffer( command_buffer->vk_command_buffer );
         command_buffer->is_recording = false;
         command_buffer->current_render_pass = nullptr;
     }
 
+    for ( u32 c = 0; c < num_queued_compute_submissions; ++c ) {
+        CommandBuffer* command_buffer = queued_compute_submissions[ c ].command_buffer;
+
+        vkEndCommandBuffer( command_buffer->vk_command_buffer );
+        command_buffer->is_recording = false;
+    }
+
     // Submit command buffers
 
-    bool has_pending_sparse_bindings = pending_sparse_memory_info.size > 0;
+    bool has_pending_sparse_bindings = pending_sparse_memory_info.size > 0 || pending_sparse_opaque_info.size > 0;
 
     if ( has_pending_sparse_bindings ) {
         // TODO(marco): use fence or semaphores
@@ -3923,64 +4183,140 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
             info.pBinds = pending_sparse_queue_binds.data + internal_info.binding_array_offset;
         }
 
+        Array<VkSparseImageOpaqueMemoryBindInfo> sparse_opaque_binding_infos;
+        sparse_opaque_binding_infos.init( allocator, pending_sparse_opaque_info.size, pending_sparse_opaque_info.size );
+
+        for ( u32 b = 0; b < pending_sparse_opaque_info.size; ++b ) {
+            SparseMemoryBindInfo& internal_info = pending_sparse_opaque_info[ b ];
+
+            VkSparseImageOpaqueMemoryBindInfo& info = sparse_opaque_binding_infos[ b ];
+            info.image = internal_info.image;
+            info.bindCount = internal_info.count;
+            info.pBinds = pending_sparse_opaque_binds.data + internal_info.binding_array_offset;
+        }
+
         VkBindSparseInfo sparse_info{ VK_STRUCTURE_TYPE_BIND_SPARSE_INFO };
         sparse_info.imageBindCount = sparse_binding_infos.size;
         sparse_info.pImageBinds = sparse_binding_infos.data;
+        sparse_info.imageOpaqueBindCount = sparse_opaque_binding_infos.size;
+        sparse_info.pImageOpaqueBinds = sparse_opaque_binding_infos.data;
         sparse_info.signalSemaphoreCount = 1;
         sparse_info.pSignalSemaphores = &vulkan_bind_semaphore;
 
         check( vkQueueBindSparse( vulkan_main_queue, 1, &sparse_info, VK_NULL_HANDLE ) );
 
         sparse_binding_infos.shutdown();
+        sparse_opaque_binding_infos.shutdown();
 
         pending_sparse_memory_info.clear();
         pending_sparse_queue_binds.clear();
+        pending_sparse_opaque_info.clear();
+        pending_sparse_opaque_binds.clear();
     }
 
     if ( timeline_semaphore_extension_present ) {
-        bool wait_for_compute_semaphore = ( last_compute_semaphore_value > 0 ) && has_async_work;
+        bool wait_for_compute_semaphore = ( compute_load_semaphore_value > 0 ) && has_async_work;
 
         bool wait_for_timeline_semaphore = absolute_frame >= k_max_frames;
 
         if ( synchronization2_extension_present ) {
-            VkCommandBufferSubmitInfoKHR command_buffer_info[ 4 ]{ };
+            VkCommandBufferSubmitInfoKHR command_buffer_info[ k_max_queued_command_buffers ]{ };
             for ( u32 c = 0; c < num_queued_command_buffers; c++ ) {
                 command_buffer_info[ c ].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
                 command_buffer_info[ c ].commandBuffer = enqueued_command_buffers[ c ];
             }
 
-            Array<VkSemaphoreSubmitInfoKHR> wait_semaphores;
-            wait_semaphores.init( allocator, 4 );
-            wait_semaphores.push( { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_image_acquired_semaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0 } );
+            // The command buffers queued after the last wait or signal form the last batch.
+            GpuQueueBatch& last_batch = queued_batches[ num_queued_batches ];
+            last_batch.command_buffer_count = num_queued_command_buffers - num_batched_command_buffers;
+            last_batch.compute_wait = queued_compute_wait;
+            const u32 batch_count = num_queued_batches + 1;
+
+            // The first batch waits for the previous frames, the last one for the swapchain image.
+            VkSemaphoreSubmitInfoKHR wait_semaphores[ k_max_queue_batches + 4 ];
+            VkSemaphoreSubmitInfoKHR signal_semaphores[ k_max_queue_batches + 1 ];
+            VkSubmitInfo2KHR submit_infos[ k_max_queue_batches ];
+            u32 wait_count = 0;
+            u32 signal_count = 0;
+            u32 command_buffer_offset = 0;
+
+            for ( u32 b = 0; b < batch_count; ++b ) {
+                const GpuQueueBatch& batch = queued_batches[ b ];
+                const u32 first_wait = wait_count;
+                const u32 first_signal = signal_count;
+
+                if ( b == 0 ) {
+                    if ( wait_for_compute_semaphore ) {
+                        wait_semaphores[ wait_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_compute_semaphore, compute_load_semaphore_value, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, 0 };
+                    }
 
-            if ( wait_for_compute_semaphore ) {
-                wait_semaphores.push( { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_compute_semaphore, last_compute_semaphore_value, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR, 0 } );
-            }
+                    if ( wait_for_timeline_semaphore ) {
+                        wait_semaphores[ wait_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_semaphore, absolute_frame - ( k_max_frames - 1 ), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT_KHR , 0 };
+                    }
 
-            if ( wait_for_timeline_semaphore ) {
-                wait_semaphores.push( { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_semaphore, absolute_frame - ( k_max_frames - 1 ), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT_KHR , 0 } );
-            }
+                    if ( has_pending_sparse_bindings ) {
+                        wait_semaphores[ wait_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_bind_semaphore, 0, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, 0 };
+                    }
+                }
 
-            if ( has_pending_sparse_bindings ) {
-                wait_semaphores.push( { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_bind_semaphore, 0, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, 0 } );
+                if ( batch.compute_wait != u32_max ) {
+                    wait_semaphores[ wait_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_compute_semaphore, last_compute_semaphore_value + batch.compute_wait + 1, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0 };
+                }
+
+                if ( b == batch_count - 1 ) {
+                    wait_semaphores[ wait_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_image_acquired_semaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0 };
+
+                    signal_semaphores[ signal_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, *render_complete_semaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0 };
+                    signal_semaphores[ signal_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_semaphore, absolute_frame + 1, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR , 0 };
+                } else {
+                    signal_semaphores[ signal_count++ ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_queue_semaphore, last_graphics_queue_semaphore_value + b + 1, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0 };
+                }
+
+                VkSubmitInfo2KHR& submit_info = submit_infos[ b ];
+                submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR };
+                submit_info.waitSemaphoreInfoCount = wait_count - first_wait;
+                submit_info.pWaitSemaphoreInfos = wait_semaphores + first_wait;
+                submit_info.commandBufferInfoCount = batch.command_buffer_count;
+                submit_info.pCommandBufferInfos = command_buffer_info + command_buffer_offset;
+                submit_info.signalSemaphoreInfoCount = signal_count - first_signal;
+                submit_info.pSignalSemaphoreInfos = signal_semaphores + first_signal;
+
+                command_buffer_offset += batch.command_buffer_count;
             }
 
-            VkSemaphoreSubmitInfoKHR signal_semaphores[]{
-                { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, *render_complete_semaphore, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0 },
-                { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_semaphore, absolute_frame + 1, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR , 0 }
-            };
+            check( vkQueueSubmit2KHR( vulkan_main_queue, batch_count, submit_infos, VK_NULL_HANDLE ) );
 
-            VkSubmitInfo2KHR submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR };
-            submit_info.waitSemaphoreInfoCount = wait_semaphores.size;
-            submit_info.pWaitSemaphoreInfos = wait_semaphores.data;
-            submit_info.commandBufferInfoCount = num_queued_command_buffers;
-            submit_info.pCommandBufferInfos = command_buffer_info;
-            submit_info.signalSemaphoreInfoCount = 2;
-            submit_info.pSignalSemaphoreInfos = signal_semaphores;
+            // Compute submissions can wait for batches above, and batches above for them: timeline waits can come before their signals.
+            if ( num_queued_compute_submissions > 0 ) {
+                VkCommandBufferSubmitInfoKHR compute_command_buffer_info[ k_max_queue_batches ]{ };
+                VkSemaphoreSubmitInfoKHR compute_wait_semaphores[ k_max_queue_batches ];
+                VkSemaphoreSubmitInfoKHR compute_signal_semaphores[ k_max_queue_batches ];
+                VkSubmitInfo2KHR compute_submit_infos[ k_max_queue_batches ];
 
-            check( vkQueueSubmit2KHR( vulkan_main_queue, 1, &submit_info, VK_NULL_HANDLE ) );
+                for ( u32 c = 0; c < num_queued_compute_submissions; ++c ) {
+                    const GpuComputeSubmission& submission = queued_compute_submissions[ c ];
 
-            wait_semaphores.shutdown();
+                    compute_command_buffer_info[ c ].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+                    compute_command_buffer_info[ c ].commandBuffer = submission.command_buffer->vk_command_buffer;
+
+                    compute_wait_semaphores[ c ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_graphics_queue_semaphore, last_graphics_queue_semaphore_value + submission.graphics_wait + 1, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0 };
+                    compute_signal_semaphores[ c ] = { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_compute_semaphore, last_compute_semaphore_value + c + 1, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, 0 };
+
+                    VkSubmitInfo2KHR& submit_info = compute_submit_infos[ c ];
+                    submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR };
+                    submit_info.waitSemaphoreInfoCount = submission.graphics_wait != u32_max ? 1 : 0;
+                    submit_info.pWaitSemaphoreInfos = &compute_wait_semaphores[ c ];
+                    submit_info.commandBufferInfoCount = 1;
+                    submit_info.pCommandBufferInfos = &compute_command_buffer_info[ c ];
+                    submit_info.signalSemaphoreInfoCount = 1;
+                    submit_info.pSignalSemaphoreInfos = &compute_signal_semaphores[ c ];
+                }
+
+                check( vkQueueSubmit2KHR( vulkan_compute_queue, num_queued_compute_submissions, compute_submit_infos, VK_NULL_HANDLE ) );
+            }
+
+            last_graphics_queue_semaphore_value += num_queued_batches;
+            last_compute_semaphore_value += num_queued_compute_submissions;
         } else {
             Array<VkSemaphore> wait_semaphores;
             wait_semaphores.init( allocator, 4 );
@@ -3995,9 +4331,11 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
             wait_values.push( 0 );
             wait_stages.push( VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT );
 
+            RASSERT( num_queued_batches == 0 && num_queued_compute_submissions == 0 );
+
             if ( wait_for_compute_semaphore ) {
                 wait_semaphores.push( vulkan_compute_semaphore );
-                wait_values.push( last_compute_semaphore_value );
+                wait_values.push( compute_load_semaphore_value );
                 wait_stages.push( VK_PIPELINE_STAGE_VERTEX_INPUT_BIT );
             }
 
@@ -4046,8 +4384,10 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
     } else {
         VkFence render_complete_fence = vulkan_command_buffer_executed_fence[ current_frame ];
 
+        RASSERT( num_queued_batches == 0 && num_queued_compute_submissions == 0 );
+
         if ( synchronization2_extension_present ) {
-            VkCommandBufferSubmitInfoKHR command_buffer_info[ 4 ]{ };
+            VkCommandBufferSubmitInfoKHR command_buffer_info[ k_max_queued_command_buffers ]{ };
             for ( u32 c = 0; c < num_queued_command_buffers; c++ ) {
                 command_buffer_info[ c ].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
                 command_buffer_info[ c ].commandBuffer = enqueued_command_buffers[ c ];
@@ -4130,6 +4470,10 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
     RASSERT( result != VK_ERROR_DEVICE_LOST );
 
     num_queued_command_buffers = 0;
+    num_queued_batches = 0;
+    num_batched_command_buffers = 0;
+    queued_compute_wait = u32_max;
+    num_queued_compute_submissions = 0;
 
     //
     // GPU Timestamp resolve
@@ -4373,6 +4717,12 @@ void GpuDevice::present( CommandBuffer* async_compute_command_buffer ) {
                         destroy_page_pool_instant( resource_deletion.handle );
                         break;
                     }
+
+                    case ResourceUpdateType::MemoryHeap:
+                    {
+                        destroy_memory_heap_instant( resource_deletion.handle );
+                        break;
+                    }
                 }
 
                 // Mark resource as free
@@ -4398,6 +4748,7 @@ void GpuDevice::submit_compute_load( CommandBuffer* command_buffer ) {
             };
 
             last_compute_semaphore_value++;
+            compute_load_semaphore_value = last_compute_semaphore_value;
 
             VkSemaphoreSubmitInfoKHR signal_semaphores[]{
                 { VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR, nullptr, vulkan_compute_semaphore, last_compute_semaphore_value, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, 0 },
@@ -4428,6 +4779,7 @@ void GpuDevice::submit_compute_load( CommandBuffer* command_buffer ) {
             semaphore_info.pWaitSemaphoreValues = wait_values;
 
             last_compute_semaphore_value++;
+            compute_load_semaphore_value = last_compute_semaphore_value;
 
             u64 signal_values[] = { last_compute_semaphore_value };
             semaphore_info.signalSemaphoreValueCount = 1;
@@ -4444,7 +4796,7 @@ void GpuDevice::submit_compute_load( CommandBuffer* command_buffer ) {
 
             submit_info.pNext = &semaphore_info;
 
-            vkQueueSubmit( vulkan_main_queue, 1, &submit_info, VK_NULL_HANDLE );
+            vkQueueSubmit( vulkan_compute_queue, 1, &submit_info, VK_NULL_HANDLE );
         }
     } else {
         if ( vkGetFenceStatus( vulkan_device, vulkan_compute_fence ) != VK_SUCCESS ) {
@@ -4581,10 +4933,50 @@ void GpuDevice::queue_command_buffer( CommandBuffer* command_buffer ) {
     queued_command_buffers[ num_queued_command_buffers++ ] = command_buffer;
 }
 
+bool GpuDevice::async_compute_supported() const {
+    return timeline_semaphore_extension_present && synchronization2_extension_present && vulkan_compute_queue_family != u32_max;
+}
+
+u32 GpuDevice::queue_graphics_signal() {
+    RASSERT( num_queued_batches + 1 < k_max_queue_batches );
+
+    GpuQueueBatch& batch = queued_batches[ num_queued_batches ];
+    batch.command_buffer_count = num_queued_command_buffers - num_batched_command_buffers;
+    batch.compute_wait = queued_compute_wait;
+
+    num_batched_command_buffers = num_queued_command_buffers;
+    return num_queued_batches++;
+}
+
+void GpuDevice::queue_graphics_wait( u32 compute_submission ) {
+    RASSERT( compute_submission < num_queued_compute_submissions );
+
+    // Command buffers queued before do not wait.
+    if ( num_queued_command_buffers > num_batched_command_buffers ) {
+        queue_graphics_signal();
+    }
+
+    // Timeline values only grow: waiting for the last submission waits for the earlier ones too.
+    if ( queued_compute_wait == u32_max || compute_submission > queued_compute_wait ) {
+        queued_compute_wait = compute_submission;
+    }
+}
+
+u32 GpuDevice::queue_compute_command_buffer( CommandBuffer* command_buffer, u32 graphics_batch ) {
+    RASSERT( num_queued_compute_submissions < k_max_queue_batches );
+    RASSERT( graphics_batch == u32_max || graphics_batch < num_queued_batches );
+
+    GpuComputeSubmission& submission = queued_compute_submissions[ num_queued_compute_submissions ];
+    submission.command_buffer = command_buffer;
+    submission.graphics_wait = graphics_batch;
+
+    return num_queued_compute_submissions++;
+}
+
 //
 //
-CommandBuffer* GpuDevice::get_command_buffer( u32 thread_index, u32 frame_index, bool begin ) {
-    CommandBuffer* cb = command_buffer_ring.get_command_buffer( frame_index, thread_index, begin );
+CommandBuffer* GpuDevice::get_command_buffer( u32 thread_index, u32 frame_index, bool begin, bool reset_queries ) {
+    CommandBuffer* cb = command_buffer_ring.get_command_buffer( frame_index, thread_index, begin, reset_queries );
     return cb;
 }
 
@@ -4595,6 +4987,13 @@ CommandBuffer* GpuDevice::get_secondary_command_buffer( u32 thread_index, u32 fr
     return cb;
 }
 
+//
+//
+CommandBuffer* GpuDevice::get_compute_command_buffer( u32 thread_index, u32 frame_index ) {
+    CommandBuffer* cb = command_buffer_ring.get_compute_command_buffer( frame_index, thread_index );
+    return cb;
+}
+
 // Resource Description Query /////////////////////////////////////////////
 
 void GpuDevice::query_buffer( BufferHandle buffer, BufferDescription& out_description ) {
@@ -4685,9 +5084,10 @@ void* GpuDevice::map_buffer( const MapBufferParameters& parameters ) {
 
     if ( buffer->parent_buffer.index == dynamic_buffer.index ) {
 
-        buffer->global_offset = dynamic_allocated_size;
+        u8* mapped_memory = ( u8* )dynamic_allocate( parameters.size == 0 ? buffer->size : parameters.size );
+        buffer->global_offset = ( u32 )( mapped_memory - dynamic_mapped_memory );
 
-        return dynamic_allocate( parameters.size == 0 ? buffer->size : parameters.size );
+        return mapped_memory;
     }
 
     void* data;
@@ -4863,6 +5263,14 @@ const PagePool* GpuDevice::access_page_pool( PagePoolHandle page_pool ) const {
     return (PagePool*)page_pools.access_resource( page_pool.index );
 }
 
+MemoryHeap* GpuDevice::access_memory_heap( MemoryHeapHandle memory_heap ) {
+    return (MemoryHeap*)memory_heaps.access_resource( memory_heap.index );
+}
+
+const MemoryHeap* GpuDevice::access_memory_heap( MemoryHeapHandle memory_heap ) const {
+    return (MemoryHeap*)memory_heaps.access_resource( memory_heap.index );
+}
+
 // GpuDeviceCreation //////////////////////////////////////////////////////
 GpuDeviceCreation& GpuDeviceCreation::set_window( u32 width_, u32 height_, void* handle ) {
     width = ( u16 )width_;
@@ -41,10 +41,17 @@ struct GPUTimeQuery;
 struct GpuTimeQueryTree;
 struct GpuPipelineStatistics;
 
+// Counted by the pipeline statistics queries, secondary command buffers inherit them.
+static const VkQueryPipelineStatisticFlags k_pipeline_statistics_flags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
 //
 struct GpuThreadFramePools {
 
     VkCommandPool                   vulkan_command_pool             = nullptr;
+    VkCommandPool                   vulkan_compute_command_pool     = nullptr;  // For the command buffers submitted to the compute queue.
     VkQueryPool                     vulkan_timestamp_query_pool     = nullptr;
     VkQueryPool                     vulkan_pipeline_stats_query_pool = nullptr;
 
@@ -52,6 +59,24 @@ struct GpuThreadFramePools {
 
 }; // struct GpuThreadFramePools
 
+//
+// Command buffers submitted together to the main queue, between waits on and signals to the compute queue.
+struct GpuQueueBatch {
+
+    u32                             command_buffer_count            = 0;
+    u32                             compute_wait                    = u32_max;  // Index of the compute submission waited for.
+
+}; // struct GpuQueueBatch
+
+//
+//
+struct GpuComputeSubmission {
+
+    CommandBuffer*                  command_buffer                  = nullptr;
+    u32                             graphics_wait                   = u32_max;  // Index of the main queue batch waited for.
+
+}; // struct GpuComputeSubmission
+
 //
 //
 struct GpuDescriptorPoolCreation {
@@ -85,6 +110,7 @@ struct GpuResourcePoolCreation {
     u16                             command_buffers = 256;
     u16                             shaders         = 256;
     u16                             page_pools      = 64;
+    u16                             memory_heaps    = 32;
 };
 
 //
@@ -164,12 +190,25 @@ struct GpuDevice : public Service {
     void                            resize_output_textures( FramebufferHandle render_pass, u32 width, u32 height );
     void                            resize_texture( TextureHandle texture, u32 width, u32 height );
     void                            resize_texture_3d( TextureHandle texture, u32 width, u32 height, u32 depth );
+    // Re-creates the texture with the same handle, with size and memory from creation and everything else from the texture.
+    void                            recreate_texture( TextureHandle texture, TextureCreation& creation );
 
     PagePoolHandle                  allocate_texture_pool( TextureHandle texture_handle, u32 pool_size );
     void                            destroy_page_pool( PagePoolHandle pool_handle );
 
+    // Memory for resources placed at offsets in it, see TextureCreation::set_memory.
+    MemoryHeapHandle                create_memory_heap( const VkMemoryRequirements& requirements, cstring name );
+    void                            destroy_memory_heap( MemoryHeapHandle heap_handle );
+    VkMemoryRequirements            get_texture_memory_requirements( const TextureCreation& creation );
+
     void                            reset_pool( PagePoolHandle pool_handle );
     void                            bind_texture_pages( PagePoolHandle pool_handle, TextureHandle handle, u32 x, u32 y, u32 width, u32 height, u32 layer );
+    void                            get_sparse_texture_properties( TextureHandle handle, SparseTextureProperties& out_properties );
+    // Binds pool pages to the pages of a mip, in rows of page_count_x. Pages equal to k_invalid_index are unbound.
+    void                            bind_texture_mip_pages( PagePoolHandle pool_handle, TextureHandle handle, u32 mip, const u32* pages, u32 page_count_x, u32 page_count_y );
+    void                            bind_texture_mip_tail( PagePoolHandle pool_handle, TextureHandle handle, const u32* pages, u32 page_count );
+    // Replaces the default view with one starting at base_mip. The previous view is destroyed once the frames using it completed.
+    void                            set_texture_base_mip( TextureHandle handle, u32 base_mip );
 
     void                            update_descriptor_set( DescriptorSetHandle set );
 
@@ -197,11 +236,23 @@ struct GpuDevice : public Service {
     void                            set_buffer_global_offset( BufferHandle buffer, u32 offset );
 
     // Command Buffers ///////////////////////////////////////////////////
-    CommandBuffer*                  get_command_buffer( u32 thread_index, u32 frame_index, bool begin );
-    CommandBuffer*                  get_secondary_command_buffer( u32 thread_index, u32 frame_index );
+    // Command buffers other than the first of the frame pass reset_queries false, to keep the queries of the thread.
+    CommandBuffer*                  get_command_buffer( u32 thread_index, u32 frame_index, bool begin, bool reset_queries = true );
+    CommandBuffer*                  get_secondary_command_buffer( u32 thread_index, u32 frame_index );  // Reset, nullptr when the thread has none left.
+    CommandBuffer*                  get_compute_command_buffer( u32 thread_index, u32 frame_index );   // Begun, for the compute queue.
 
     void                            queue_command_buffer( CommandBuffer* command_buffer );          // Queue command buffer that will not be executed until present is called.
 
+    // Async compute /////////////////////////////////////////////////////
+    // Timeline semaphores, synchronization 2 and a compute queue are needed.
+    bool                            async_compute_supported() const;
+    // Closes the batch of the command buffers queued so far, it signals the compute queue when done. Returns the batch index.
+    u32                             queue_graphics_signal();
+    // The command buffers queued from now on wait for the compute submission.
+    void                            queue_graphics_wait( u32 compute_submission );
+    // Submitted to the compute queue at present, after the main queue batch unless it is u32_max. Returns the submission index.
+    u32                             queue_compute_command_buffer( CommandBuffer* command_buffer, u32 graphics_batch );
+
     // Rendering /////////////////////////////////////////////////////////
     void                            new_frame();
     void                            present( CommandBuffer* async_compute_command_buffer );
@@ -247,6 +298,7 @@ struct GpuDevice : public Service {
     void                            destroy_framebuffer_instant( ResourceHandle framebuffer );
     void                            destroy_shader_state_instant( ResourceHandle shader );
     void                            destroy_page_pool_instant( ResourceHandle handle );
+    void                            destroy_memory_heap_instant( ResourceHandle handle );
 
     void                            update_descriptor_set_instant( const DescriptorSetUpdate& update );
 
@@ -264,6 +316,7 @@ struct GpuDevice : public Service {
     ResourcePool                    framebuffers;
     ResourcePool                    shaders;
     ResourcePool                    page_pools;
+    ResourcePool                    memory_heaps;
 
     // Primitive resources
     BufferHandle                    fullscreen_vertex_buffer;
@@ -344,8 +397,19 @@ struct GpuDevice : public Service {
     VkSemaphore                     vulkan_compute_semaphore;
     VkFence                         vulkan_compute_fence;
     u64                             last_compute_semaphore_value = 0;
+    u64                             compute_load_semaphore_value = 0;   // Signaled by the last submit_compute_load.
     bool                            has_async_work = false;
 
+    // Async compute of the queued command buffers
+    VkSemaphore                     vulkan_graphics_queue_semaphore;    // Timeline, signaled by the main queue batches for the compute queue.
+    u64                             last_graphics_queue_semaphore_value = 0;
+    GpuQueueBatch                   queued_batches[ k_max_queue_batches ];
+    u32                             num_queued_batches                  = 0;    // Closed ones, the remaining command buffers form the last batch.
+    u32                             num_batched_command_buffers         = 0;
+    u32                             queued_compute_wait                 = u32_max;
+    GpuComputeSubmission            queued_compute_submissions[ k_max_queue_batches ];
+    u32                             num_queued_compute_submissions      = 0;
+
     VkFence                         vulkan_immediate_fence;
 
     // Windows specific
@@ -367,6 +431,9 @@ struct GpuDevice : public Service {
     PFN_vkCmdEndRenderingKHR        vkCmdEndRenderingKHR;
     PFN_vkQueueSubmit2KHR           vkQueueSubmit2KHR;
     PFN_vkCmdPipelineBarrier2KHR    vkCmdPipelineBarrier2KHR;
+    PFN_vkCmdSetEvent2KHR           vkCmdSetEvent2KHR;
+    PFN_vkCmdWaitEvents2KHR         vkCmdWaitEvents2KHR;
+    PFN_vkCmdResetEvent2KHR         vkCmdResetEvent2KHR;
 
     // Mesh shaders functions
     PFN_vkCmdDrawMeshTasksNV        vkCmdDrawMeshTasksNV;
@@ -407,6 +474,8 @@ struct GpuDevice : public Service {
 
     Array<SparseMemoryBindInfo>     pending_sparse_memory_info;
     Array<VkSparseImageMemoryBind>  pending_sparse_queue_binds;
+    Array<SparseMemoryBindInfo>     pending_sparse_opaque_info;
+    Array<VkSparseMemoryBind>       pending_sparse_opaque_binds;
 
     u32                             num_threads = 1;
     f32                             gpu_timestamp_frequency;
@@ -466,6 +535,9 @@ struct GpuDevice : public Service {
     PagePool*                       access_page_pool( PagePoolHandle page_pool );
     const PagePool*                 access_page_pool( PagePoolHandle page_pool ) const;
 
+    MemoryHeap*                     access_memory_heap( MemoryHeapHandle memory_heap );
+    const MemoryHeap*               access_memory_heap( MemoryHeapHandle memory_heap ) const;
+
 }; // struct GpuDevice
 
 
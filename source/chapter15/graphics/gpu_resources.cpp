@@ -105,6 +105,8 @@ TextureCreation& TextureCreation::reset() {
     array_layer_count = 1;
     initial_data = nullptr;
     alias = k_invalid_texture;
+    memory_heap = k_invalid_memory_heap;
+    memory_offset = 0;
 
     width = height = depth = 1;
     format = VK_FORMAT_UNDEFINED;
@@ -164,6 +166,13 @@ TextureCreation& TextureCreation::set_alias( TextureHandle alias_ ) {
     return *this;
 }
 
+TextureCreation& TextureCreation::set_memory( MemoryHeapHandle heap_, sizet offset_ ) {
+    memory_heap = heap_;
+    memory_offset = offset_;
+
+    return *this;
+}
+
 // TextureViewCreation ////////////////////////////////////////////////////
 TextureViewCreation& TextureViewCreation::reset() {
     parent_texture = k_invalid_texture;
@@ -851,9 +860,13 @@ VkPipelineStageFlags util_determine_pipeline_stage_flags( VkAccessFlags access_f
                  ( access_flags & ( VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT ) ) != 0 )
                 return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
 
-            if ( ( access_flags & ( VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT ) ) != 0 )
+            if ( ( access_flags & ( VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT ) ) != 0 ) {
                 flags |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+                // Ray tracing pipelines can run on compute queues.
+                flags |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+            }
+
             break;
         }
         case QueueType::CopyTransfer: return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
@@ -920,9 +933,13 @@ VkPipelineStageFlags2KHR util_determine_pipeline_stage_flags2( VkAccessFlags2KHR
                  ( access_flags & ( VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT ) ) != 0 )
                 return VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
 
-            if ( ( access_flags & ( VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT ) ) != 0 )
+            if ( ( access_flags & ( VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT ) ) != 0 ) {
                 flags |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
 
+                // Ray tracing pipelines can run on compute queues.
+                flags |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+            }
+
             break;
         }
         case QueueType::CopyTransfer: return VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
@@ -945,13 +962,14 @@ VkPipelineStageFlags2KHR util_determine_pipeline_stage_flags2( VkAccessFlags2KHR
     return flags;
 }
 
-void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, VkImage image, ResourceState old_state, ResourceState new_state, u32 base_mip_level, u32 mip_count, bool is_depth ) {
+void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, VkImage image, ResourceState old_state, ResourceState new_state, u32 base_mip_level, u32 mip_count, bool is_depth,
+                             QueueType::Enum queue_type ) {
     if ( gpu->synchronization2_extension_present ) {
         VkImageMemoryBarrier2KHR barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR };
         barrier.srcAccessMask = util_to_vk_access_flags2( old_state );
-        barrier.srcStageMask = util_determine_pipeline_stage_flags2( barrier.srcAccessMask, QueueType::Graphics );
+        barrier.srcStageMask = util_determine_pipeline_stage_flags2( barrier.srcAccessMask, queue_type );
         barrier.dstAccessMask = util_to_vk_access_flags2( new_state );
-        barrier.dstStageMask = util_determine_pipeline_stage_flags2( barrier.dstAccessMask, QueueType::Graphics );
+        barrier.dstStageMask = util_determine_pipeline_stage_flags2( barrier.dstAccessMask, queue_type );
         barrier.oldLayout = util_to_vk_image_layout2( old_state );
         barrier.newLayout = util_to_vk_image_layout2( new_state );
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -984,21 +1002,22 @@ void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, VkI
         barrier.srcAccessMask = util_to_vk_access_flags( old_state );
         barrier.dstAccessMask = util_to_vk_access_flags( new_state );
 
-        const VkPipelineStageFlags source_stage_mask = util_determine_pipeline_stage_flags( barrier.srcAccessMask, QueueType::Graphics );
-        const VkPipelineStageFlags destination_stage_mask = util_determine_pipeline_stage_flags( barrier.dstAccessMask, QueueType::Graphics );
+        const VkPipelineStageFlags source_stage_mask = util_determine_pipeline_stage_flags( barrier.srcAccessMask, queue_type );
+        const VkPipelineStageFlags destination_stage_mask = util_determine_pipeline_stage_flags( barrier.dstAccessMask, queue_type );
 
         vkCmdPipelineBarrier( command_buffer, source_stage_mask, destination_stage_mask, 0,
                             0, nullptr, 0, nullptr, 1, &barrier );
     }
 }
 
-void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, Texture* texture, ResourceState new_state, u32 base_mip_level, u32 mip_count, bool is_depth ) {
+void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, Texture* texture, ResourceState new_state, u32 base_mip_level, u32 mip_count, bool is_depth,
+                             QueueType::Enum queue_type ) {
 
     //rprint( "Transitioning Texture %s from %s to %s\n", texture->name, ResourceStateName( texture->state ), ResourceStateName( new_state ) );
     if ( strcmp("motion_vectors", texture->name ) == 0 ) {
         //rprint( "Transitioning Texture %s from %s to %s\n", texture->name, ResourceStateName( texture->state ), ResourceStateName( new_state ) );
     }
-    util_add_image_barrier( gpu, command_buffer, texture->vk_image, texture->state, new_state, base_mip_level, mip_count, is_depth );
+    util_add_image_barrier( gpu, command_buffer, texture->vk_image, texture->state, new_state, base_mip_level, mip_count, is_depth, queue_type );
     texture->state = new_state;
 }
 
@@ -1076,6 +1095,8 @@ void util_add_buffer_barrier_ext( GpuDevice* gpu, VkCommandBuffer command_buffer
         barrier.srcStageMask = util_determine_pipeline_stage_flags2( barrier.srcAccessMask, source_queue_type );
         barrier.dstAccessMask = util_to_vk_access_flags2( new_state );
         barrier.dstStageMask = util_determine_pipeline_stage_flags2( barrier.dstAccessMask, destination_queue_type );
+        barrier.srcQueueFamilyIndex = source_family;
+        barrier.dstQueueFamilyIndex = destination_family;
         barrier.buffer = buffer;
         barrier.offset = 0;
         barrier.size = buffer_size;
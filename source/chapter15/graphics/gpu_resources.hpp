@@ -63,6 +63,10 @@ struct PagePoolHandle {
     ResourceHandle                  index;
 }; // struct FramebufferHandle
 
+struct MemoryHeapHandle {
+    ResourceHandle                  index;
+}; // struct MemoryHeapHandle
+
 // Invalid handles
 static BufferHandle                 k_invalid_buffer        { k_invalid_index };
 static TextureHandle                k_invalid_texture       { k_invalid_index };
@@ -74,6 +78,7 @@ static PipelineHandle               k_invalid_pipeline      { k_invalid_index };
 static RenderPassHandle             k_invalid_pass          { k_invalid_index };
 static FramebufferHandle            k_invalid_framebuffer   { k_invalid_index };
 static PagePoolHandle               k_invalid_page_pool     { k_invalid_index };
+static MemoryHeapHandle             k_invalid_memory_heap   { k_invalid_index };
 
 
 // Consts ///////////////////////////////////////////////////////////////////////
@@ -245,6 +250,10 @@ struct TextureCreation {
 
     TextureHandle                   alias           = k_invalid_texture;
 
+    // Places the texture in a heap instead of its own allocation.
+    MemoryHeapHandle                memory_heap     = k_invalid_memory_heap;
+    sizet                           memory_offset   = 0;
+
     cstring                         name            = nullptr;
 
     TextureCreation&                reset();
@@ -256,6 +265,7 @@ struct TextureCreation {
     TextureCreation&                set_name( cstring name );
     TextureCreation&                set_data( void* data );
     TextureCreation&                set_alias( TextureHandle alias );
+    TextureCreation&                set_memory( MemoryHeapHandle heap, sizet offset );
 
 }; // struct TextureCreation
 
@@ -729,6 +739,8 @@ struct ImageBarrier {
     u16                             mip_base_level      = 0;
     u16                             mip_level_count     = 1;
 
+    bool                            discard             = false;    // Transition from undefined: the contents are not kept.
+
 }; // struct ImageBarrier
 
 //
@@ -775,6 +787,8 @@ struct ResourceUpdate {
 
 static const u32                    k_max_swapchain_images = 3;
 static const u32                    k_max_frames           = 2;
+static const u32                    k_max_queued_command_buffers = 16;  // Submitted to the main queue in a frame.
+static const u32                    k_max_queue_batches    = 8;         // Submissions split by waits on or signals to the compute queue.
 
 //
 //
@@ -991,6 +1005,17 @@ struct SparseMemoryBindInfo {
     u32                             binding_array_offset;
 }; // struct SparseMemoryBindInfo
 
+//
+//
+struct SparseTextureProperties {
+    u32                             page_width;     // In texels.
+    u32                             page_height;
+    u32                             page_size;      // In bytes.
+    u32                             mip_tail_first; // Not smaller than the mip count when there is no tail.
+    u32                             mip_tail_page_count;
+    VkDeviceSize                    mip_tail_offset;
+}; // struct SparseTextureProperties
+
 
 //
 //
@@ -1008,6 +1033,15 @@ struct PagePool {
     PagePoolAllocation*             free_list;
 }; // struct PagePool
 
+//
+// Memory shared by resources placed at offsets in it.
+struct MemoryHeap {
+    VmaAllocation                   vma_allocation;
+
+    sizet                           size;
+    u32                             memory_type_bits;
+}; // struct MemoryHeap
+
 
 //
 //
@@ -1043,10 +1077,10 @@ VkPipelineStageFlags        util_determine_pipeline_stage_flags( VkAccessFlags a
 VkPipelineStageFlags2KHR    util_determine_pipeline_stage_flags2( VkAccessFlags2KHR access_flags, QueueType::Enum queue_type );
 
 void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, Texture* texture, ResourceState new_state,
-                             u32 base_mip_level, u32 mip_count, bool is_depth );
+                             u32 base_mip_level, u32 mip_count, bool is_depth, QueueType::Enum queue_type = QueueType::Graphics );
 
 void util_add_image_barrier( GpuDevice* gpu, VkCommandBuffer command_buffer, VkImage image, ResourceState old_state, ResourceState new_state,
-                             u32 base_mip_level, u32 mip_count, bool is_depth );
+                             u32 base_mip_level, u32 mip_count, bool is_depth, QueueType::Enum queue_type = QueueType::Graphics );
 
 void util_add_image_barrier_ext( GpuDevice* gpu, VkCommandBuffer command_buffer, VkImage image, ResourceState old_state, ResourceState new_state,
                                  u32 base_mip_level, u32 mip_count, u32 base_array_layer, u32 array_layer_count, bool is_depth, u32 source_family, u32 destination_family,
@@ -0,0 +1,60 @@
+#include "graphics/image_decode.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace raptor {
+
+// Image decode target ////////////////////////////////////////////////////
+
+//
+//
+struct ImageDecodeTarget {
+
+    u8*                     data        = nullptr;
+    sizet                   image_size  = 0;
+    bool                    armed       = false;
+}; // struct ImageDecodeTarget
+
+static thread_local ImageDecodeTarget decode_target;
+
+void image_decode_set_target( void* target, sizet image_size ) {
+    decode_target.data = ( u8* )target;
+    decode_target.image_size = image_size;
+    decode_target.armed = target != nullptr;
+}
+
+void* image_decode_malloc( sizet size ) {
+    // Decoders allocate their output with up to one byte of padding.
+    if ( decode_target.armed && ( size == decode_target.image_size || size == decode_target.image_size + 1 ) ) {
+        decode_target.armed = false;
+        return decode_target.data;
+    }
+
+    return malloc( size );
+}
+
+void* image_decode_realloc( void* pointer, sizet old_size, sizet new_size ) {
+    // Something else than the image took the target, move it to the heap and give the target back.
+    if ( pointer != nullptr && pointer == decode_target.data ) {
+        void* heap_pointer = malloc( new_size );
+        if ( heap_pointer ) {
+            memcpy( heap_pointer, pointer, old_size < new_size ? old_size : new_size );
+            decode_target.armed = true;
+        }
+        return heap_pointer;
+    }
+
+    return realloc( pointer, new_size );
+}
+
+void image_decode_free( void* pointer ) {
+    if ( pointer != nullptr && pointer == decode_target.data ) {
+        decode_target.armed = true;
+        return;
+    }
+
+    free( pointer );
+}
+
+} // namespace raptor
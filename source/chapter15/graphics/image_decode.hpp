@@ -0,0 +1,14 @@
+#pragma once
+
+#include "foundation/platform.hpp"
+
+namespace raptor {
+
+// stb_image allocation functions, used as STBI_MALLOC, STBI_REALLOC_SIZED and STBI_FREE where stb_image is implemented.
+// The first allocation of the size of a decoded image goes to the target set for the calling thread, if any.
+void                    image_decode_set_target( void* target, sizet image_size );
+void*                   image_decode_malloc( sizet size );
+void*                   image_decode_realloc( void* pointer, sizet old_size, sizet new_size );
+void                    image_decode_free( void* pointer );
+
+} // namespace raptor
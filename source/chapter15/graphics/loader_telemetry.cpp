@@ -0,0 +1,212 @@
+#include "graphics/loader_telemetry.hpp"
+
+#include "foundation/file.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/string.hpp"
+#include "foundation/time.hpp"
+
+#include "external/imgui/imgui.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace raptor {
+
+cstring LoaderLatency::names[ Count ] = { "queue", "decode", "staging", "transfer", "total" };
+cstring LoaderQueueDepth::names[ Count ] = { "file_requests", "reading", "decoding", "uploads", "in_flight" };
+
+static const f64        k_throughput_window_seconds = 1.0;
+
+static f64 to_megabytes( sizet bytes ) {
+    return bytes / ( 1024.0 * 1024.0 );
+}
+
+// LoaderLatencyWindow ////////////////////////////////////////////////////
+
+void LoaderLatencyWindow::add( f32 milliseconds ) {
+    samples[ next ] = milliseconds;
+    next = ( next + 1 ) % k_loader_latency_samples;
+    count = count < k_loader_latency_samples ? count + 1 : count;
+}
+
+static int compare_latencies( const void* a, const void* b ) {
+    const f32 latency_a = *( const f32* )a;
+    const f32 latency_b = *( const f32* )b;
+    return latency_a < latency_b ? -1 : ( latency_a > latency_b ? 1 : 0 );
+}
+
+static f32 get_percentile( const f32* sorted_samples, u32 count, u32 percentile ) {
+    // Nearest rank: the smallest sample with at least percentile% of the samples at or below it.
+    const u32 rank = ( percentile * count + 99 ) / 100;
+    return sorted_samples[ rank > 0 ? rank - 1 : 0 ];
+}
+
+void LoaderLatencyWindow::get_percentiles( f32& p50, f32& p95, f32& p99 ) const {
+    if ( count == 0 ) {
+        p50 = p95 = p99 = 0.f;
+        return;
+    }
+
+    f32 sorted_samples[ k_loader_latency_samples ];
+    memcpy( sorted_samples, samples, sizeof( f32 ) * count );
+    qsort( sorted_samples, count, sizeof( f32 ), compare_latencies );
+
+    p50 = get_percentile( sorted_samples, count, 50 );
+    p95 = get_percentile( sorted_samples, count, 95 );
+    p99 = get_percentile( sorted_samples, count, 99 );
+}
+
+// LoaderTelemetry ////////////////////////////////////////////////////////
+
+void LoaderTelemetry::init() {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    for ( u32 l = 0; l < LoaderLatency::Count; ++l ) {
+        latencies[ l ].count = 0;
+        latencies[ l ].next = 0;
+    }
+
+    for ( u32 q = 0; q < LoaderQueueDepth::Count; ++q ) {
+        queue_depths[ q ] = 0;
+        max_queue_depths[ q ] = 0;
+    }
+
+    first_request_time = 0;
+    window_start_time = 0;
+    window_bytes = 0;
+    window_throughput = 0;
+
+    completed_requests = 0;
+    completed_bytes = 0;
+    last_complete_time = 0;
+}
+
+void LoaderTelemetry::add_request( const LoaderRequestTimes& times, sizet size ) {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    // The decode steps are skipped by buffer uploads, their queue latency goes up to staging.
+    const bool decoded = times.decode_start != 0;
+    const i64 queue_end = decoded ? times.decode_start : times.staged;
+
+    latencies[ LoaderLatency::Queue ].add( ( f32 )time_delta_milliseconds( times.enqueue, queue_end ) );
+    if ( decoded ) {
+        latencies[ LoaderLatency::Decode ].add( ( f32 )time_delta_milliseconds( times.decode_start, times.decode_end ) );
+        latencies[ LoaderLatency::Staging ].add( ( f32 )time_delta_milliseconds( times.decode_end, times.staged ) );
+    }
+    latencies[ LoaderLatency::Transfer ].add( ( f32 )time_delta_milliseconds( times.staged, times.gpu_complete ) );
+    latencies[ LoaderLatency::Total ].add( ( f32 )time_delta_milliseconds( times.enqueue, times.gpu_complete ) );
+
+    if ( first_request_time == 0 || times.enqueue < first_request_time ) {
+        first_request_time = times.enqueue;
+    }
+    if ( window_start_time == 0 ) {
+        window_start_time = times.gpu_complete;
+    }
+
+    ++completed_requests;
+    completed_bytes += size;
+    last_complete_time = times.gpu_complete;
+
+    window_bytes += size;
+    const f64 window_seconds = time_delta_seconds( window_start_time, times.gpu_complete );
+    if ( window_seconds >= k_throughput_window_seconds ) {
+        window_throughput = to_megabytes( window_bytes ) / window_seconds;
+        window_start_time = times.gpu_complete;
+        window_bytes = 0;
+    }
+}
+
+void LoaderTelemetry::set_queue_depths( const u32 depths[ LoaderQueueDepth::Count ] ) {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    for ( u32 q = 0; q < LoaderQueueDepth::Count; ++q ) {
+        queue_depths[ q ] = depths[ q ];
+        max_queue_depths[ q ] = depths[ q ] > max_queue_depths[ q ] ? depths[ q ] : max_queue_depths[ q ];
+    }
+}
+
+f64 LoaderTelemetry::get_average_throughput() const {
+    const f64 total_seconds = completed_requests ? time_delta_seconds( first_request_time, last_complete_time ) : 0.0;
+    return total_seconds > 0.0 ? to_megabytes( completed_bytes ) / total_seconds : 0.0;
+}
+
+void LoaderTelemetry::imgui_draw() {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    const f64 average_throughput = get_average_throughput();
+
+    ImGui::Text( "Completed requests %llu, %.2f MB", ( unsigned long long )completed_requests, to_megabytes( completed_bytes ) );
+    ImGui::Text( "Throughput %.2f MB/s, average %.2f MB/s", window_throughput > 0.0 ? window_throughput : average_throughput, average_throughput );
+
+    ImGui::Separator();
+    for ( u32 q = 0; q < LoaderQueueDepth::Count; ++q ) {
+        ImGui::Text( "%s: %u (max %u)", LoaderQueueDepth::names[ q ], queue_depths[ q ], max_queue_depths[ q ] );
+    }
+
+    ImGui::Separator();
+    if ( ImGui::BeginTable( "loader_latencies", 4 ) ) {
+        ImGui::TableSetupColumn( "Latency ms" );
+        ImGui::TableSetupColumn( "p50" );
+        ImGui::TableSetupColumn( "p95" );
+        ImGui::TableSetupColumn( "p99" );
+        ImGui::TableHeadersRow();
+
+        for ( u32 l = 0; l < LoaderLatency::Count; ++l ) {
+            f32 p50, p95, p99;
+            latencies[ l ].get_percentiles( p50, p95, p99 );
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text( "%s", LoaderLatency::names[ l ] );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", p50 );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", p95 );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", p99 );
+        }
+
+        ImGui::EndTable();
+    }
+}
+
+bool LoaderTelemetry::write_report( cstring path, Allocator* temp_allocator ) {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    StringBuffer report;
+    report.init( rkilo( 4 ), temp_allocator );
+
+    const f64 average_throughput = get_average_throughput();
+
+    report.append_f( "{\n  \"completed_requests\": %llu,\n  \"completed_mb\": %f,\n", ( unsigned long long )completed_requests, to_megabytes( completed_bytes ) );
+    report.append_f( "  \"throughput_mb_s\": %f,\n  \"average_throughput_mb_s\": %f,\n", window_throughput > 0.0 ? window_throughput : average_throughput,
+                     average_throughput );
+
+    report.append( "  \"max_queue_depths\": {" );
+    for ( u32 q = 0; q < LoaderQueueDepth::Count; ++q ) {
+        report.append_f( "%s \"%s\": %u", q ? "," : "", LoaderQueueDepth::names[ q ], max_queue_depths[ q ] );
+    }
+    report.append( " },\n  \"latencies_ms\": {\n" );
+
+    for ( u32 l = 0; l < LoaderLatency::Count; ++l ) {
+        f32 p50, p95, p99;
+        latencies[ l ].get_percentiles( p50, p95, p99 );
+
+        report.append_f( "    \"%s\": { \"samples\": %u, \"p50\": %f, \"p95\": %f, \"p99\": %f }%s\n", LoaderLatency::names[ l ], latencies[ l ].count,
+                         p50, p95, p99, l + 1 < LoaderLatency::Count ? "," : "" );
+    }
+    report.append( "  }\n}\n" );
+
+    FileHandle file;
+    file_open( path, "wb", &file );
+    if ( file != nullptr ) {
+        file_write( ( u8* )report.data, 1, report.current_size, file );
+        file_close( file );
+    }
+
+    report.shutdown();
+
+    return file != nullptr;
+}
+
+} // namespace raptor
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "foundation/platform.hpp"
+
+#include <mutex>
+
+namespace raptor {
+
+struct Allocator;
+
+static const u32        k_loader_latency_samples    = 512;
+
+//
+// Timestamps of a request through the loader, from time_now. Zero when the step does not apply, as decoding for buffers.
+struct LoaderRequestTimes {
+
+    i64                 enqueue         = 0;
+    i64                 decode_start    = 0;
+    i64                 decode_end      = 0;
+    i64                 staged          = 0;    // Recorded in a transfer command buffer.
+    i64                 gpu_complete    = 0;
+}; // struct LoaderRequestTimes
+
+//
+//
+struct LoaderLatency {
+    enum Enum {
+        Queue, Decode, Staging, Transfer, Total, Count
+    };
+
+    static cstring      names[ Count ];
+}; // struct LoaderLatency
+
+//
+// Last k_loader_latency_samples latencies in milliseconds.
+struct LoaderLatencyWindow {
+
+    void                add( f32 milliseconds );
+    // Nearest rank percentiles of the samples in the window, 0 when empty.
+    void                get_percentiles( f32& p50, f32& p95, f32& p99 ) const;
+
+    f32                 samples[ k_loader_latency_samples ];
+    u32                 count           = 0;
+    u32                 next            = 0;
+}; // struct LoaderLatencyWindow
+
+//
+//
+struct LoaderQueueDepth {
+    enum Enum {
+        FileRequests, Reading, Decoding, Uploads, InFlight, Count
+    };
+
+    static cstring      names[ Count ];
+}; // struct LoaderQueueDepth
+
+//
+// Statistics of the asynchronous loader. Written by the loader thread and read by the main thread.
+struct LoaderTelemetry {
+
+    void                init();
+
+    void                add_request( const LoaderRequestTimes& times, sizet size );
+    void                set_queue_depths( const u32 depths[ LoaderQueueDepth::Count ] );
+
+    // MB/s since the first request. Call with mutex locked.
+    f64                 get_average_throughput() const;
+
+    void                imgui_draw();
+    // Writes the statistics as json, returns false if the file cannot be written.
+    bool                write_report( cstring path, Allocator* temp_allocator );
+
+    std::mutex          mutex;
+
+    LoaderLatencyWindow latencies[ LoaderLatency::Count ];
+
+    u32                 queue_depths[ LoaderQueueDepth::Count ];
+    u32                 max_queue_depths[ LoaderQueueDepth::Count ];
+
+    // Throughput over the last completed second, the average is shown until the first one completes.
+    i64                 first_request_time  = 0;
+    i64                 window_start_time   = 0;
+    sizet               window_bytes        = 0;
+    f64                 window_throughput   = 0;    // MB/s.
+
+    u64                 completed_requests  = 0;
+    sizet               completed_bytes     = 0;
+    i64                 last_complete_time  = 0;
+
+}; // struct LoaderTelemetry
+
+} // namespace raptor
@@ -4,8 +4,14 @@
 #include "foundation/file.hpp"
 #include "foundation/time.hpp"
 
+#include "graphics/image_decode.hpp"
+
 #include "external/json.hpp"
 
+// The asynchronous loader decodes images straight into staging memory.
+#define STBI_MALLOC( size )                                 raptor::image_decode_malloc( size )
+#define STBI_REALLOC_SIZED( pointer, old_size, new_size )   raptor::image_decode_realloc( pointer, old_size, new_size )
+#define STBI_FREE( pointer )                                raptor::image_decode_free( pointer )
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb_image.h"
 
@@ -4,6 +4,7 @@
 #include "graphics/asynchronous_loader.hpp"
 #include "graphics/raptor_imgui.hpp"
 #include "graphics/gpu_profiler.hpp"
+#include "graphics/texture_streamer.hpp"
 
 #include "foundation/time.hpp"
 #include "foundation/numerics.hpp"
@@ -71,6 +72,19 @@ static void copy_gpu_material_data( GpuDevice& gpu, GpuMaterialData& gpu_mesh_da
     gpu_mesh_data.meshlet_count = mesh.meshlet_count;
     gpu_mesh_data.meshlet_index_count = mesh.meshlet_index_count;
 
+    // Meshes without generated lods only have the full detail meshlets.
+    gpu_mesh_data.lod_count = raptor::max( mesh.lod_count, 1u );
+    for ( u32 l = 0; l < k_max_mesh_lods; ++l ) {
+        if ( l < mesh.lod_count ) {
+            gpu_mesh_data.lods[ l ] = mesh.lods[ l ];
+        } else {
+            gpu_mesh_data.lods[ l ] = { mesh.meshlet_offset, mesh.meshlet_count, mesh.meshlet_index_count, 0.0f };
+        }
+    }
+
+    gpu_mesh_data.meshlet_position_offset = vec4s{ mesh.meshlet_position_offset.x, mesh.meshlet_position_offset.y, mesh.meshlet_position_offset.z, 0.0f };
+    gpu_mesh_data.meshlet_position_scale = vec4s{ mesh.meshlet_position_scale.x, mesh.meshlet_position_scale.y, mesh.meshlet_position_scale.z, 0.0f };
+
     gpu_mesh_data.position_buffer = gpu.get_buffer_device_address( mesh.position_buffer ) + mesh.position_offset;
     gpu_mesh_data.uv_buffer = gpu.get_buffer_device_address( mesh.texcoord_buffer ) + mesh.texcoord_offset;
     gpu_mesh_data.index_buffer = gpu.get_buffer_device_address( mesh.index_buffer ) + mesh.index_offset;
@@ -167,7 +181,7 @@ void DepthPrePass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, A
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -283,7 +297,7 @@ void DepthPyramidPass::prepare_draws( RenderScene& scene, FrameGraph* frame_grap
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -463,7 +477,7 @@ void GBufferPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, Al
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -583,7 +597,7 @@ void LateGBufferPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -731,7 +745,7 @@ void LightPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, Allo
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -971,7 +985,7 @@ void TransparentPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -1179,7 +1193,7 @@ void DebugPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, Allo
        return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
        return;
 
@@ -1540,7 +1554,7 @@ void DoFPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, Alloca
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -1702,7 +1716,7 @@ void CullingEarlyPass::prepare_draws( RenderScene& scene, FrameGraph* frame_grap
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     renderer = scene.renderer;
     GpuDevice& gpu = *renderer->gpu;
@@ -1795,7 +1809,7 @@ void CullingLatePass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     renderer = scene.renderer;
     GpuDevice& gpu = *renderer->gpu;
@@ -1865,7 +1879,7 @@ void RayTracingTestPass::prepare_draws( RenderScene& scene, FrameGraph* frame_gr
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     renderer = scene.renderer;
 
@@ -2088,7 +2102,7 @@ void ShadowVisibilityPass::prepare_draws( RenderScene& scene, FrameGraph* frame_
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     renderer = scene.renderer;
 
@@ -2728,7 +2742,7 @@ void PointlightShadowPass::prepare_draws( RenderScene& scene, FrameGraph* frame_
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled )
         return;
 
@@ -3120,7 +3134,7 @@ void VolumetricFogPass::prepare_draws( RenderScene& scene, FrameGraph* frame_gra
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     GpuDevice& gpu = *renderer->gpu;
 
@@ -3154,6 +3168,13 @@ void VolumetricFogPass::prepare_draws( RenderScene& scene, FrameGraph* frame_gra
     // Cache texture index
     scene.volumetric_fog_texture_index = integrated_light_scattering_texture.index;
 
+    // The lighting reads it, possibly on another queue.
+    FrameGraphResource* resource = frame_graph->get_resource( "volumetric_fog_texture" );
+    if ( resource != nullptr ) {
+        resource->resource_info.set_external_texture_3d( scene.volumetric_fog_tile_count_x, scene.volumetric_fog_tile_count_y, scene.volumetric_fog_slices,
+                                                         VK_FORMAT_R16G16B16A16_SFLOAT, 0, integrated_light_scattering_texture );
+    }
+
     raptor::BufferCreation buffer_creation;
     buffer_creation.set( VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, ResourceUsageType::Dynamic, sizeof( GpuVolumetricFogConstants ) ).set_name( "volumetric_fog_constants" );
     fog_constants = gpu.create_buffer( buffer_creation );
@@ -3367,7 +3388,7 @@ void TemporalAntiAliasingPass::prepare_draws( RenderScene& scene, FrameGraph* fr
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     GpuDevice& gpu = *renderer->gpu;
 
@@ -3479,7 +3500,7 @@ void MotionVectorPass::prepare_draws( RenderScene& scene, FrameGraph* frame_grap
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
 
     GpuDevice& gpu = *renderer->gpu;
 
@@ -3700,7 +3721,7 @@ void IndirectPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph, A
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled ) {
         return;
     }
@@ -3974,7 +3995,7 @@ void ReflectionsPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled ) {
         return;
     }
@@ -4196,7 +4217,7 @@ void SVGFAccumulationPass::prepare_draws( RenderScene& scene, FrameGraph* frame_
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled ) {
         return;
     }
@@ -4422,7 +4443,7 @@ void SVGFVariancePass::prepare_draws( RenderScene& scene, FrameGraph* frame_grap
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled ) {
         return;
     }
@@ -4668,7 +4689,7 @@ void SVGFWaveletPass::prepare_draws( RenderScene& scene, FrameGraph* frame_graph
         return;
     }
 
-    enabled = node->enabled;
+    enabled = node->enabled && !node->culled;
     if ( !enabled ) {
         return;
     }
@@ -5180,6 +5201,94 @@ void RenderScene::update_joints() {
     }
 }
 
+// Textures of visible meshes load before all the others.
+static const f32 k_visible_texture_priority = 1000.f;
+
+void RenderScene::prioritize_texture_loads( const Camera& camera, AsynchronousLoader* async_loader, StackAllocator* scratch_allocator ) {
+    ZoneScoped;
+
+    const u32 texture_count = renderer->gpu->textures.pool_size;
+    const sizet current_marker = scratch_allocator->get_marker();
+
+    f32* priorities = ( f32* )ralloca( sizeof( f32 ) * texture_count, scratch_allocator );
+    for ( u32 t = 0; t < texture_count; ++t ) {
+        priorities[ t ] = 0.f;
+    }
+
+    const mat4s scale_matrix = glms_scale_make( { global_scale, global_scale, -global_scale } );
+
+    for ( u32 mi = 0; mi < mesh_instances.size; ++mi ) {
+        const MeshInstance& mesh_instance = mesh_instances[ mi ];
+        const Mesh& mesh = *mesh_instance.mesh;
+
+        const mat4s world = glms_mat4_mul( scale_matrix, scene_graph->world_matrices[ mesh_instance.scene_graph_node_index ] );
+        const f32 world_scale = raptor::max( raptor::max( glms_vec3_norm( glms_vec3( world.col[ 0 ] ) ), glms_vec3_norm( glms_vec3( world.col[ 1 ] ) ) ),
+                                             glms_vec3_norm( glms_vec3( world.col[ 2 ] ) ) );
+
+        const vec4s center = glms_mat4_mulv( world, vec4s{ mesh.bounding_sphere.x, mesh.bounding_sphere.y, mesh.bounding_sphere.z, 1.0f } );
+        const f32 radius = mesh.bounding_sphere.w * world_scale;
+
+        // Screen-space size of the bounding sphere, with a conservative frustum test in view space.
+        const vec4s view_center = glms_mat4_mulv( camera.view, center );
+        const f32 distance = raptor::max( glms_vec3_distance( glms_vec3( center ), camera.position ), camera.near_plane );
+        const f32 depth = -view_center.z;
+        const bool visible = depth > -radius && fabsf( view_center.x ) * camera.projection.m00 <= depth + radius * camera.projection.m00 &&
+                             fabsf( view_center.y ) * camera.projection.m11 <= depth + radius * camera.projection.m11;
+
+        const f32 priority = radius / distance + ( visible ? k_visible_texture_priority : 0.f );
+
+        // Texels per pixel if the texture covers the mesh once, each mip halves them.
+        const f32 projected_pixels = raptor::max( radius / distance * camera.projection.m11 * camera.viewport_height, 1.f );
+
+        const PBRMaterial& material = mesh.pbr_material;
+        const u16 texture_indices[] = { material.diffuse_texture_index, material.roughness_texture_index, material.normal_texture_index,
+                                        material.occlusion_texture_index, material.emissive_texture_index };
+        for ( u32 t = 0; t < ArraySize( texture_indices ); ++t ) {
+            const u16 texture_index = texture_indices[ t ];
+            if ( texture_index != k_invalid_scene_texture_index && texture_index < texture_count ) {
+                priorities[ texture_index ] = raptor::max( priorities[ texture_index ], priority );
+
+                if ( visible && texture_streamer != nullptr && texture_streamer->is_streamed( { texture_index } ) ) {
+                    const Texture* texture = renderer->gpu->access_texture( { texture_index } );
+                    const f32 texels_per_pixel = raptor::max( texture->width, texture->height ) / projected_pixels;
+                    texture_streamer->request_mip( { texture_index }, texels_per_pixel > 1.f ? ( u32 )log2f( texels_per_pixel ) : 0 );
+                }
+            }
+        }
+    }
+
+    async_loader->set_texture_priorities( priorities, texture_count );
+
+    scratch_allocator->free_marker( current_marker );
+}
+
+void RenderScene::select_mesh_instance_lods( const Camera& camera ) {
+    ZoneScoped;
+
+    const mat4s scale_matrix = glms_scale_make( { global_scale, global_scale, -global_scale } );
+
+    for ( u32 mi = 0; mi < mesh_instances.size; ++mi ) {
+        MeshInstance& mesh_instance = mesh_instances[ mi ];
+        const Mesh& mesh = *mesh_instance.mesh;
+
+        mesh_instance.lod_index = 0;
+        if ( mesh.lod_count <= 1 || mesh.lod_index_buffer.index == k_invalid_index ) {
+            continue;
+        }
+
+        const mat4s world = glms_mat4_mul( scale_matrix, scene_graph->world_matrices[ mesh_instance.scene_graph_node_index ] );
+        const f32 world_scale = raptor::max( raptor::max( glms_vec3_norm( glms_vec3( world.col[ 0 ] ) ), glms_vec3_norm( glms_vec3( world.col[ 1 ] ) ) ),
+                                             glms_vec3_norm( glms_vec3( world.col[ 2 ] ) ) );
+
+        // Distance to the closest point of the bounding sphere, as in culling.glsl.
+        const vec4s center = glms_mat4_mulv( world, vec4s{ mesh.bounding_sphere.x, mesh.bounding_sphere.y, mesh.bounding_sphere.z, 1.0f } );
+        const f32 distance = glms_vec3_norm( glms_vec3( glms_mat4_mulv( camera.view, center ) ) ) - mesh.bounding_sphere.w * world_scale;
+
+        mesh_instance.lod_index = select_mesh_lod( mesh.lods, mesh.lod_count, distance, world_scale, camera.projection.m11, camera.viewport_height,
+                                                   lod_pixel_error_threshold );
+    }
+}
+
 struct SortedLight {
 
     u32             light_index;
@@ -5700,7 +5809,12 @@ void RenderScene::draw_mesh_instance( CommandBuffer* gpu_commands, MeshInstance&
     u32 offsets[]{ mesh.position_offset, mesh.tangent_offset, mesh.normal_offset, mesh.texcoord_offset, mesh.joints_offset, mesh.weights_offset };
     gpu_commands->bind_vertex_buffers( buffers, 0, mesh.skin_index != i32_max ? 6 : 4, offsets );
 
-    gpu_commands->bind_index_buffer( mesh.index_buffer, mesh.index_offset, mesh.index_type );
+    const u32 lod_index = use_mesh_lods ? mesh_instance.lod_index : 0;
+    if ( lod_index > 0 ) {
+        gpu_commands->bind_index_buffer( mesh.lod_index_buffer, 0, VK_INDEX_TYPE_UINT32 );
+    } else {
+        gpu_commands->bind_index_buffer( mesh.index_buffer, mesh.index_offset, mesh.index_type );
+    }
 
     if ( recreate_per_thread_descriptors ) {
         DescriptorSetCreation ds_creation{};
@@ -5713,7 +5827,11 @@ void RenderScene::draw_mesh_instance( CommandBuffer* gpu_commands, MeshInstance&
     }
 
     // Gpu mesh index used to retrieve mesh data
-    gpu_commands->draw_indexed( TopologyType::Triangle, mesh.primitive_count, 1, 0, 0, mesh_instance.gpu_mesh_instance_index );
+    if ( lod_index > 0 ) {
+        gpu_commands->draw_indexed( TopologyType::Triangle, mesh.lod_index_counts[ lod_index ], 1, mesh.lod_first_indices[ lod_index ], 0, mesh_instance.gpu_mesh_instance_index );
+    } else {
+        gpu_commands->draw_indexed( TopologyType::Triangle, mesh.primitive_count, 1, 0, 0, mesh_instance.gpu_mesh_instance_index );
+    }
 }
 
 void RenderScene::add_scene_descriptors( DescriptorSetCreation& descriptor_set_creation, GpuTechniquePass& pass ) {
@@ -5832,7 +5950,8 @@ void DrawTask::ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_
     CommandBuffer* gpu_commands = gpu->get_command_buffer( threadnum_, current_frame_index, true );
     gpu_commands->push_marker( "Frame" );
 
-    frame_graph->render( current_frame_index, gpu_commands, scene );
+    // Async compute nodes split the frame in more command buffers, the last one waits for them.
+    gpu_commands = frame_graph->render( current_frame_index, threadnum_, gpu_commands, scene );
 
     gpu_commands->push_marker( "Fullscreen" );
     gpu_commands->clear( 0.3f, 0.3f, 0.3f, 1.f, 0 );
@@ -6078,6 +6197,19 @@ vec3s project( const mat4s& P, const vec3s& Q ) {
     return vec3s{ v.x, v.y, v.z };
 }
 
+u32 select_mesh_lod( const MeshLod* lods, u32 lod_count, f32 distance, f32 scale, f32 projection_11, f32 resolution_y, f32 pixel_error_threshold ) {
+    // Lods are sorted by increasing error: world space error to pixels, same as projecting a segment at distance.
+    const f32 error_to_pixels = scale * projection_11 * resolution_y * 0.5f / glm_max( distance, FLT_EPSILON );
+
+    for ( u32 l = lod_count; l > 1; --l ) {
+        if ( lods[ l - 1 ].error * error_to_pixels <= pixel_error_threshold ) {
+            return l - 1;
+        }
+    }
+
+    return 0;
+}
+
 void project_aabb_cubemap_positive_x( const vec3s aabb[ 2 ], f32& s_min, f32& s_max, f32& t_min, f32& t_max ) {
     f32 rd_min = 1.f / glm_max( FLT_EPSILON, aabb[ 0 ].x );
     f32 rd_max = 1.f / glm_max( FLT_EPSILON, aabb[ 1 ].x );
@@ -28,12 +28,15 @@ namespace raptor {
     struct RenderScene;
     struct SceneGraph;
     struct StackAllocator;
+    struct TextureStreamer;
+    struct Camera;
     struct GameCamera;
 
     static const u16    k_invalid_scene_texture_index      = u16_max;
     static const u32    k_material_descriptor_set_index    = 1;
     static const u32    k_max_joint_count                  = 12;
     static const u32    k_max_depth_pyramid_levels         = 16;
+    static const u32    k_max_mesh_lods                    = 4;    // NOTE: must be in sync with MAX_MESH_LODS in mesh.h
 
     static const u32    k_num_lights                       = 256;
     static const u32    k_light_z_bins                     = 16;
@@ -41,7 +44,6 @@ namespace raptor {
     static const u32    k_num_words                        = ( k_num_lights + 31 ) / 32;
 
     static bool         recreate_per_thread_descriptors = false;
-    static bool         use_secondary_command_buffers   = false;
 
     //
     //
@@ -106,6 +108,11 @@ namespace raptor {
 
         vec4s                   frustum_planes[ 6 ];
 
+        f32                     lod_pixel_error_threshold;
+        u32                     pad000_lod;
+        u32                     pad001_lod;
+        u32                     pad002_lod;
+
         // Helpers for bit packing. Would be perfect for code generation
         // NOTE: must be in sync with scene.h!
         bool                    frustum_cull_meshes() const             { return ( culling_options &  1 ) ==  1; }
@@ -117,6 +124,7 @@ namespace raptor {
         bool                    shadow_meshlets_sphere_cull() const       { return ( culling_options & 64 ) == 64; }
         bool                    shadow_meshlets_cubemap_face_cull() const { return ( culling_options & 128 ) == 128; }
         bool                    shadow_mesh_sphere_cull() const         { return ( culling_options & 256 ) == 256; }
+        bool                    mesh_lods() const                       { return ( culling_options & 512 ) == 512; }
 
         void                    set_frustum_cull_meshes(bool value)     { value ? (culling_options |=  1) : (culling_options &= ~( 1)); }
         void                    set_frustum_cull_meshlets(bool value)   { value ? (culling_options |=  2) : (culling_options &= ~( 2)); }
@@ -127,6 +135,7 @@ namespace raptor {
         void                    set_shadow_meshlets_sphere_cull( bool value )    { value ? ( culling_options |= 64 ) : ( culling_options &= ~( 64 ) ); }
         void                    set_shadow_meshlets_cubemap_face_cull( bool value ) { value ? ( culling_options |= 128 ) : ( culling_options &= ~( 128 ) ); }
         void                    set_shadow_mesh_sphere_cull( bool value ) { value ? ( culling_options |= 256 ) : ( culling_options &= ~( 256 ) ); }
+        void                    set_mesh_lods( bool value )             { value ? ( culling_options |= 512 ) : ( culling_options &= ~( 512 ) ); }
 
     }; // struct GpuSceneData
 
@@ -285,6 +294,16 @@ namespace raptor {
         DescriptorSetHandle     debug_mesh_descriptor_set;
     };
 
+    //
+    // Meshlet range of a single level of detail. Error is the object space simplification error.
+    struct MeshLod {
+
+        u32                     meshlet_offset;
+        u32                     meshlet_count;
+        u32                     meshlet_index_count;
+        f32                     error;
+    }; // struct MeshLod
+
     //
     //
     struct Mesh {
@@ -316,10 +335,23 @@ namespace raptor {
 
         u32                     primitive_count;
 
+        // Meshlets of the full detail mesh, same as lods[ 0 ].
         u32                     meshlet_offset;
         u32                     meshlet_count;
         u32                     meshlet_index_count;
 
+        MeshLod                 lods[ k_max_mesh_lods ];
+        u32                     lod_count               = 0;
+
+        // Simplified u32 indices of lods 1 and above, drawn without meshlets. Lod 0 uses index_buffer.
+        BufferHandle            lod_index_buffer        = k_invalid_buffer;
+        u32                     lod_first_indices[ k_max_mesh_lods ];
+        u32                     lod_index_counts[ k_max_mesh_lods ];
+
+        // Meshlet vertex positions are quantized inside the bounding box: offset + unorm * scale.
+        vec3s                   meshlet_position_offset;
+        vec3s                   meshlet_position_scale;
+
         u32                     gpu_mesh_index          = u32_max;
         i32                     skin_index              = i32_max;
 
@@ -340,6 +372,9 @@ namespace raptor {
         u32                     gpu_mesh_instance_index = u32_max;
         u32                     scene_graph_node_index  = u32_max;
 
+        // Lod drawn without meshlets, selected on the cpu each frame.
+        u32                     lod_index               = 0;
+
     }; // struct MeshInstance
 
     //
@@ -376,8 +411,8 @@ namespace raptor {
     //
     struct GpuMeshletVertexPosition {
 
-        float                   position[3];
-        float                   padding;
+        u16                     position[ 3 ];  // unorm16 inside the mesh bounding box, see Mesh::meshlet_position_offset.
+        u16                     padding;
     }; // struct GpuMeshletVertexPosition
 
 
@@ -385,10 +420,9 @@ namespace raptor {
     //
     struct GpuMeshletVertexData {
 
-        u8                      normal[ 4 ];
-        u8                      tangent[ 4 ];
-        u16                     uv_coords[ 2 ];
-        float                   padding;
+        u32                     normal;         // octahedral_encode_snorm16
+        u32                     tangent;        // octahedral_encode_tangent
+        u16                     uv_coords[ 2 ]; // half
     }; // struct GpuMeshletVertexData
 
     //
@@ -409,13 +443,19 @@ namespace raptor {
         u32                     meshlet_offset;
         u32                     meshlet_count;
         u32                     meshlet_index_count;
-        u32                     padding1_;
+        u32                     lod_count;
 
         VkDeviceAddress         position_buffer;
         VkDeviceAddress         uv_buffer;
         VkDeviceAddress         index_buffer;
         VkDeviceAddress         normals_buffer;
 
+        MeshLod                 lods[ k_max_mesh_lods ];
+
+        // Meshlet vertex position dequantization, xyz only.
+        vec4s                   meshlet_position_offset;
+        vec4s                   meshlet_position_scale;
+
     }; // struct GpuMaterialData
 
     //
@@ -1426,6 +1466,10 @@ namespace raptor {
         CommandBuffer*          update_physics( f32 delta_time, f32 air_density, f32 spring_stiffness, f32 spring_damping, vec3s wind_direction, bool reset_simulation );
         void                    update_animations( f32 delta_time );
         void                    update_joints();
+        // Raises the loading priority of the textures of the biggest meshes on screen, and requests the mips streamed textures need.
+        void                    prioritize_texture_loads( const Camera& camera, AsynchronousLoader* async_loader, StackAllocator* scratch_allocator );
+        // Same lod selection of the culling shader, for the mesh instances drawn without meshlets.
+        void                    select_mesh_instance_lods( const Camera& camera );
 
         void                    upload_gpu_data( UploadGpuDataContext& context );
         void                    draw_mesh_instance( CommandBuffer* gpu_commands, MeshInstance& mesh_instance, bool transparent );
@@ -1442,7 +1486,9 @@ namespace raptor {
         // Mesh and MeshInstances
         Array<Mesh>             meshes;
         Array<MeshInstance>     mesh_instances;
-        Array<u32>              gltf_mesh_to_mesh_offset;
+        // Identical glTF primitives share a single Mesh, drawn with multiple MeshInstances.
+        Array<u32>              gltf_mesh_to_primitive_offset;
+        Array<u32>              gltf_primitive_to_mesh;
 
         // Meshlet data
         Array<GpuMeshlet>       meshlets;
@@ -1535,6 +1581,8 @@ namespace raptor {
 
         Allocator*              resident_allocator;
         Renderer*               renderer;
+        // Sparse textures with their mips streamed, set before add_mesh. Textures load whole when null.
+        TextureStreamer*        texture_streamer = nullptr;
 
         u32                     cubemap_shadows_index = 0;
         u32                     lighting_debug_texture_index = 0;
@@ -1628,6 +1676,8 @@ namespace raptor {
 
         bool                    use_meshlets = true;
         bool                    use_meshlets_emulation = false;
+        bool                    use_mesh_lods = true;
+        f32                     lod_pixel_error_threshold = 1.0f;
         bool                    show_debug_gpu_draws = false;
         bool                    pointlight_rendering = true;
         bool                    pointlight_use_meshlets = true;
@@ -1728,6 +1778,11 @@ namespace raptor {
     void                        get_bounds_for_axis( const vec3s& a, const vec3s& C, float r, float nearZ, vec3s& L, vec3s& U );
     vec3s                       project( const mat4s& P, const vec3s& Q );
 
+    // Returns the coarsest lod whose error, projected at distance from the camera, is below the pixel threshold.
+    // NOTE: must be in sync with select_mesh_lod in mesh.h
+    u32                         select_mesh_lod( const MeshLod* lods, u32 lod_count, f32 distance, f32 scale,
+                                                 f32 projection_11, f32 resolution_y, f32 pixel_error_threshold );
+
     void                        project_aabb_cubemap_positive_x( const vec3s aabb[ 2 ], f32& s_min, f32& s_max, f32& t_min, f32& t_max );
     void                        project_aabb_cubemap_negative_x( const vec3s aabb[ 2 ], f32& s_min, f32& s_max, f32& t_min, f32& t_max );
     void                        project_aabb_cubemap_positive_y( const vec3s aabb[ 2 ], f32& s_min, f32& s_max, f32& t_min, f32& t_max );
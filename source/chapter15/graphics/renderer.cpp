@@ -217,6 +217,27 @@ TextureResource* Renderer::create_texture( const TextureCreation& creation ) {
     return nullptr;
 }
 
+TextureResource* Renderer::find_texture_by_content( u64 content_hash ) {
+    FlatHashMapIterator it = resource_cache.texture_contents.find( content_hash );
+    if ( it.is_invalid() ) {
+        return nullptr;
+    }
+
+    return resource_cache.texture_contents.get( it );
+}
+
+void Renderer::register_texture_content( TextureResource* texture, u64 content_hash, sizet content_size, cstring content_path ) {
+    RASSERT( texture->content_hash == 0 );
+
+    const sizet content_path_length = strlen( content_path );
+    texture->content_path = ( char* )ralloca( content_path_length + 1, resident_allocator );
+    memory_copy( texture->content_path, content_path, content_path_length + 1 );
+
+    texture->content_hash = content_hash;
+    texture->content_size = content_size;
+    resource_cache.texture_contents.insert( content_hash, texture );
+}
+
 SamplerResource* Renderer::create_sampler( const SamplerCreation& creation ) {
     SamplerResource* sampler = samplers.obtain();
     if ( sampler ) {
@@ -367,6 +388,14 @@ void Renderer::destroy_texture( TextureResource* texture ) {
         resource_cache.textures.remove( hash_calculate( texture->desc.name ) );
     }
 
+    if ( texture->content_hash != 0 ) {
+        resource_cache.texture_contents.remove( texture->content_hash );
+        rfree( texture->content_path, resident_allocator );
+        texture->content_hash = 0;
+        texture->content_size = 0;
+        texture->content_path = nullptr;
+    }
+
     gpu->destroy_texture( texture->handle );
     textures.release( texture );
 }
@@ -439,10 +468,27 @@ void Renderer::unmap_buffer( BufferResource* buffer ) {
     }
 }
 
-void Renderer::add_texture_to_update( raptor::TextureHandle texture ) {
+bool Renderer::add_texture_to_update( raptor::TextureHandle texture, u32 first_mip, u32 mip_count ) {
     std::lock_guard<std::mutex> guard( texture_update_mutex );
 
-    textures_to_update[ num_textures_to_update++ ] = texture;
+    if ( num_textures_to_update == ArraySize( textures_to_update ) ) {
+        return false;
+    }
+
+    TextureUpdate& texture_update = textures_to_update[ num_textures_to_update++ ];
+    texture_update.texture = texture;
+    texture_update.first_mip = ( u16 )first_mip;
+    texture_update.mip_count = ( u16 )mip_count;
+    return true;
+}
+
+void Renderer::get_streamed_texture_updates( Array<TextureUpdate>& out_updates ) {
+    std::lock_guard<std::mutex> guard( texture_update_mutex );
+
+    for ( u32 i = 0; i < num_streamed_texture_updates; ++i ) {
+        out_updates.push( streamed_texture_updates[ i ] );
+    }
+    num_streamed_texture_updates = 0;
 }
 
 //TODO:
@@ -505,9 +551,27 @@ void Renderer::add_texture_update_commands( u32 thread_id ) {
     CommandBuffer* cb = gpu->get_command_buffer( thread_id, gpu->current_frame, false );
     cb->begin();
 
+    u32 deferred_textures = 0;
     for ( u32 i = 0; i < num_textures_to_update; ++i ) {
+        const TextureUpdate& texture_update = textures_to_update[ i ];
+        Texture* texture = gpu->access_texture( texture_update.texture );
+
+        // Acquire the streamed mips, the transfer queue released them ready to be sampled.
+        if ( texture_update.mip_count > 0 ) {
+            if ( num_streamed_texture_updates == ArraySize( streamed_texture_updates ) ) {
+                textures_to_update[ deferred_textures++ ] = texture_update;
+                continue;
+            }
 
-        Texture* texture = gpu->access_texture( textures_to_update[i] );
+            for ( u32 mip = texture_update.first_mip; mip < ( u32 )texture_update.first_mip + texture_update.mip_count; ++mip ) {
+                util_add_image_barrier_ext( cb->gpu_device, cb->vk_command_buffer, texture->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_SHADER_RESOURCE,
+                                            mip, 1, 0, 1, false, gpu->vulkan_transfer_queue_family, gpu->vulkan_main_queue_family,
+                                            QueueType::CopyTransfer, QueueType::Graphics );
+            }
+
+            streamed_texture_updates[ num_streamed_texture_updates++ ] = texture_update;
+            continue;
+        }
 
         util_add_image_barrier_ext( cb->gpu_device, cb->vk_command_buffer, texture->vk_image, RESOURCE_STATE_COPY_DEST, RESOURCE_STATE_COPY_SOURCE,
                                     0, 1, 0, 1, false, gpu->vulkan_transfer_queue_family, gpu->vulkan_main_queue_family, QueueType::CopyTransfer, QueueType::Graphics );
@@ -519,7 +583,7 @@ void Renderer::add_texture_update_commands( u32 thread_id ) {
     //cb->end();
     gpu->queue_command_buffer( cb );
 
-    num_textures_to_update = 0;
+    num_textures_to_update = deferred_textures;
 }
 
 
@@ -531,6 +595,7 @@ void ResourceCache::init( Allocator* allocator ) {
     samplers.init( allocator, 16 );
     materials.init( allocator, 16 );
     techniques.init( allocator, 16 );
+    texture_contents.init( allocator, 16 );
 }
 
 void ResourceCache::shutdown( Renderer* renderer ) {
@@ -585,6 +650,7 @@ void ResourceCache::shutdown( Renderer* renderer ) {
     samplers.shutdown();
     materials.shutdown();
     techniques.shutdown();
+    texture_contents.shutdown();
 }
 
 // GpuTechnique ///////////////////////////////////////////////////////////
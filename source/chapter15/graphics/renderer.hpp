@@ -30,11 +30,25 @@ struct TextureResource : public raptor::Resource {
     u32                             pool_index;
     TextureDescription              desc;
 
+    u64                             content_hash = 0;   // Of the source file, 0 when not shared by content.
+    sizet                           content_size = 0;
+    char*                           content_path = nullptr; // Absolute path of the source file, hashes are checked against its bytes.
+
     static constexpr cstring        k_type = "raptor_texture_type";
     static u64                      k_type_hash;
 
 }; // struct Texture
 
+//
+//
+struct TextureUpdate {
+
+    TextureHandle                   texture;
+    u16                             first_mip   = 0;
+    u16                             mip_count   = 0;    // 0 when mip 0 was uploaded and the others are generated.
+
+}; // struct TextureUpdate
+
 //
 //
 struct SamplerResource : public raptor::Resource {
@@ -153,6 +167,9 @@ struct ResourceCache {
     FlatHashMap<u64, Material*>        materials;
     FlatHashMap<u64, GpuTechnique*>    techniques;
 
+    // Textures by content hash of their source file, entries do not hold a reference.
+    FlatHashMap<u64, TextureResource*> texture_contents;
+
     char                            binary_data_folder[512];
 
 }; // struct ResourceCache
@@ -204,6 +221,9 @@ struct Renderer : public Service {
     BufferResource*             create_buffer( VkBufferUsageFlags type, ResourceUsageType::Enum usage, u32 size, void* data, cstring name );
 
     TextureResource*            create_texture( const TextureCreation& creation );
+    // Texture created from a file with the same content hash, nullptr if none is alive.
+    TextureResource*            find_texture_by_content( u64 content_hash );
+    void                        register_texture_content( TextureResource* texture, u64 content_hash, sizet content_size, cstring content_path );
 
     SamplerResource*            create_sampler( const SamplerCreation& creation );
 
@@ -229,9 +249,12 @@ struct Renderer : public Service {
     CommandBuffer*              get_command_buffer( u32 thread_index, u32 current_frame_index, bool begin )  { return gpu->get_command_buffer( thread_index, current_frame_index, begin ); }
     void                        queue_command_buffer( raptor::CommandBuffer* commands ) { gpu->queue_command_buffer( commands ); }
 
-    // Multithread friendly update to textures
-    void                        add_texture_to_update( raptor::TextureHandle texture );
+    // Multithread friendly update to textures. Returns false when no more textures can be updated this frame.
+    // Streamed mips are uploaded in shader resource state and only acquired by the graphics queue.
+    bool                        add_texture_to_update( raptor::TextureHandle texture, u32 first_mip = 0, u32 mip_count = 0 );
     void                        add_texture_update_commands( u32 thread_id );
+    // Moves the streamed mips acquired in previous frames to out_updates.
+    void                        get_streamed_texture_updates( Array<TextureUpdate>& out_updates );
 
     ResourcePoolTyped<TextureResource>  textures;
     ResourcePoolTyped<BufferResource>   buffers;
@@ -241,8 +264,10 @@ struct Renderer : public Service {
 
     ResourceCache               resource_cache;
 
-    TextureHandle               textures_to_update[ 128 ];
+    TextureUpdate               textures_to_update[ 128 ];
     u32                         num_textures_to_update = 0;
+    TextureUpdate               streamed_texture_updates[ 128 ];
+    u32                         num_streamed_texture_updates = 0;
 
     raptor::GpuDevice*          gpu;
     Allocator*                  resident_allocator;
@@ -0,0 +1,124 @@
+#include "graphics/staging_ring.hpp"
+
+#include "foundation/assert.hpp"
+#include "foundation/memory.hpp"
+
+#include <string.h>
+
+namespace raptor {
+
+void StagingRing::init( Allocator* allocator, sizet capacity_, sizet alignment_ ) {
+    RASSERT( alignment_ > 0 && ( capacity_ % alignment_ ) == 0 );
+
+    regions.init( allocator, 64 );
+    first_region = 0;
+
+    capacity = capacity_;
+    alignment = alignment_;
+    head = 0;
+    tail = 0;
+    used_size = 0;
+}
+
+void StagingRing::shutdown() {
+    regions.shutdown();
+}
+
+bool StagingRing::allocate( sizet size, u64 completion_value, sizet& out_offset ) {
+    size = memory_align( size, alignment );
+    if ( size == 0 || size > capacity ) {
+        return false;
+    }
+
+    // An empty ring starts over, giving the whole capacity to the next allocations.
+    if ( used_size == 0 ) {
+        head = 0;
+        tail = 0;
+    }
+
+    sizet offset = 0;
+    sizet padding = 0;
+    if ( used_size == 0 || head > tail ) {
+        // Free space is [head, capacity) and [0, tail). Wrapping around wastes the end of the buffer.
+        if ( head + size <= capacity ) {
+            offset = head;
+        } else if ( size <= tail ) {
+            padding = capacity - head;
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if ( head < tail ) {
+        // Free space is [head, tail).
+        if ( head + size > tail ) {
+            return false;
+        }
+        offset = head;
+    } else {
+        // Full.
+        return false;
+    }
+
+    regions.push( { head, offset, padding + size, completion_value } );
+
+    used_size += padding + size;
+    head = offset + size;
+
+    out_offset = offset;
+    return true;
+}
+
+void StagingRing::set_completion_value( sizet offset, u64 completion_value ) {
+    for ( u32 r = first_region; r < regions.size; ++r ) {
+        StagingRingRegion& region = regions[ r ];
+        if ( region.offset == offset ) {
+            RASSERT( region.completion_value == k_staging_ring_pending );
+            region.completion_value = completion_value;
+            return;
+        }
+    }
+
+    // Not an allocated offset.
+    RASSERT( false );
+}
+
+sizet StagingRing::get_max_allocation_size() const {
+    if ( used_size == 0 ) {
+        return capacity;
+    }
+
+    if ( head > tail ) {
+        const sizet end_size = capacity - head;
+        return end_size > tail ? end_size : tail;
+    }
+
+    return head < tail ? tail - head : 0;
+}
+
+void StagingRing::release( u64 completed_value ) {
+    while ( first_region < regions.size && regions[ first_region ].completion_value <= completed_value ) {
+        used_size -= regions[ first_region ].size;
+        ++first_region;
+    }
+
+    if ( first_region == regions.size ) {
+        regions.clear();
+        first_region = 0;
+
+        RASSERT( used_size == 0 );
+        tail = head;
+        return;
+    }
+
+    tail = regions[ first_region ].start;
+
+    // Keep the live regions at the start of the array, so it does not grow with the released ones.
+    if ( first_region >= regions.size / 2 ) {
+        const u32 live_regions = regions.size - first_region;
+        memmove( regions.data, regions.data + first_region, sizeof( StagingRingRegion ) * live_regions );
+        regions.set_size( live_regions );
+        first_region = 0;
+    }
+}
+
+} // namespace raptor
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "foundation/array.hpp"
+
+namespace raptor {
+
+//
+//
+struct StagingRingRegion {
+
+    sizet               start;              // Where its reserved space begins, before padding when it wrapped around.
+    sizet               offset;             // Returned to the caller.
+    sizet               size;               // Including the padding.
+    u64                 completion_value;
+}; // struct StagingRingRegion
+
+// Completion value of space reserved before the transfer reading it is recorded.
+static const u64        k_staging_ring_pending  = u64_max;
+
+//
+// Ring allocator over a staging buffer. Regions are released in allocation order, once the completion value
+// they were allocated with is reached. Completion values come from the caller, a transfer timeline or any
+// fake source, so the ring does not depend on the gpu.
+struct StagingRing {
+
+    void                init( Allocator* allocator, sizet capacity, sizet alignment );
+    void                shutdown();
+
+    // Returns false when size bytes do not fit until older regions are released. A region waiting for a
+    // bigger completion value than the following ones holds them until it is released.
+    bool                allocate( sizet size, u64 completion_value, sizet& out_offset );
+    // Sets the completion value of a region allocated as k_staging_ring_pending.
+    void                set_completion_value( sizet offset, u64 completion_value );
+    // Biggest allocation that would succeed now.
+    sizet               get_max_allocation_size() const;
+
+    // Releases the regions allocated with a completion value up to completed_value.
+    void                release( u64 completed_value );
+
+    Array<StagingRingRegion> regions;       // Live regions from first_region, in allocation order.
+    u32                 first_region        = 0;
+
+    sizet               capacity            = 0;
+    sizet               alignment           = 1;
+    sizet               head                = 0;    // Next allocation offset.
+    sizet               tail                = 0;    // Start of the oldest live region.
+    sizet               used_size           = 0;
+
+}; // struct StagingRing
+
+// Records queued requests in order while the ring has space for them, removing the recorded ones. A request that does
+// not get all its staging memory stays queued, and after it only the requests already holding theirs are recorded:
+// they set the completion value of pending regions the blocked request may be waiting for, so they cannot wait behind it.
+// Recorder provides bool record( Request& ), true once the request is fully recorded, and bool holds_staging( const Request& ).
+template <typename Request, typename Recorder>
+void staging_ring_record_requests( Array<Request>& requests, Recorder& recorder ) {
+    u32 kept_count = 0;
+    bool blocked = false;
+
+    for ( u32 r = 0; r < requests.size; ++r ) {
+        Request& request = requests[ r ];
+        if ( ( !blocked || recorder.holds_staging( request ) ) && recorder.record( request ) ) {
+            continue;
+        }
+
+        blocked = true;
+        requests[ kept_count++ ] = request;
+    }
+
+    requests.set_size( kept_count );
+}
+
+} // namespace raptor
@@ -0,0 +1,397 @@
+#include "graphics/texture_residency.hpp"
+
+#include "foundation/assert.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include <string.h>
+
+namespace raptor {
+
+static u32 get_mip_page_count( u32 size, u32 mip, u32 page_size ) {
+    const u32 mip_size = raptor::max( size >> mip, 1u );
+    return ( mip_size + page_size - 1 ) / page_size;
+}
+
+// Removes the first count elements, keeping the order of the others.
+template <typename T>
+static void remove_front( Array<T>& elements, u32 count ) {
+    memmove( elements.data, elements.data + count, sizeof( T ) * ( elements.size - count ) );
+    elements.set_size( elements.size - count );
+}
+
+// TextureResidency ///////////////////////////////////////////////////////
+
+void TextureResidency::init( Allocator* allocator_, u32 page_count_, u32 page_size_, u32 latency_frames_ ) {
+    allocator = allocator_;
+    page_count = page_count_;
+    page_size = page_size_;
+    budget_pages = page_count_;
+    latency_frames = latency_frames_;
+    used_pages = 0;
+    releasing_pages = 0;
+    current_frame = 0;
+    lru_first = k_invalid_residency_page;
+    lru_last = k_invalid_residency_page;
+
+    textures.init( allocator, 64 );
+    pending_releases.init( allocator, 16 );
+    releasing_page_list.init( allocator, 256 );
+
+    // Lower pages are used first.
+    free_pages.init( allocator, raptor::max( page_count, 1u ) );
+    for ( u32 p = page_count; p > 0; --p ) {
+        free_pages.push( p - 1 );
+    }
+}
+
+void TextureResidency::shutdown() {
+    for ( u32 t = 0; t < textures.size; ++t ) {
+        if ( textures[ t ].active ) {
+            rfree( textures[ t ].page_table, allocator );
+        }
+    }
+
+    textures.shutdown();
+    free_pages.shutdown();
+    pending_releases.shutdown();
+    releasing_page_list.shutdown();
+}
+
+bool TextureResidency::add_texture( u32 texture_index, u32 width, u32 height, u32 mip_count, u32 mip_tail_first, u32 mip_tail_page_count,
+                                    u32 page_width, u32 page_height ) {
+    RASSERT( mip_count > 0 && mip_count <= k_max_resident_texture_mips );
+    RASSERT( mip_tail_first < mip_count );
+
+    if ( mip_tail_page_count > budget_pages ) {
+        return false;
+    }
+
+    while ( texture_index >= textures.size ) {
+        ResidentTexture empty_texture{ };
+        textures.push( empty_texture );
+    }
+
+    ResidentTexture& texture = textures[ texture_index ];
+    RASSERT( !texture.active );
+
+    texture = ResidentTexture{ };
+    texture.width = width;
+    texture.height = height;
+    texture.page_width = page_width;
+    texture.page_height = page_height;
+    texture.mip_count = mip_count;
+    texture.mip_tail_first = mip_tail_first;
+    texture.mip_tail_page_count = mip_tail_page_count;
+
+    // The tail is bound in the next update, nothing can be sampled until it is streamed.
+    texture.bound_mip = mip_count;
+    texture.resident_mip = mip_count;
+    texture.requested_mip = mip_tail_first;
+    texture.last_used_frame = current_frame;
+    texture.active = true;
+
+    texture.mip_page_offsets[ 0 ] = 0;
+    for ( u32 mip = 0; mip < mip_tail_first; ++mip ) {
+        const u32 mip_pages = get_mip_page_count( width, mip, page_width ) * get_mip_page_count( height, mip, page_height );
+        texture.mip_page_offsets[ mip + 1 ] = texture.mip_page_offsets[ mip ] + mip_pages;
+    }
+
+    const u32 table_size = texture.mip_page_offsets[ mip_tail_first ] + mip_tail_page_count;
+    texture.page_table = ( u32* )ralloca( sizeof( u32 ) * raptor::max( table_size, 1u ), allocator );
+    for ( u32 p = 0; p < table_size; ++p ) {
+        texture.page_table[ p ] = k_invalid_residency_page;
+    }
+
+    lru_push_front( texture_index );
+
+    return true;
+}
+
+void TextureResidency::remove_texture( u32 texture_index, u64 frame ) {
+    if ( texture_index >= textures.size || !textures[ texture_index ].active ) {
+        return;
+    }
+
+    ResidentTexture& texture = textures[ texture_index ];
+
+    // The texture is destroyed with its bindings, evictions still pending only release their pages.
+    for ( u32 r = 0; r < pending_releases.size; ++r ) {
+        if ( pending_releases[ r ].texture == texture_index ) {
+            pending_releases[ r ].texture = k_invalid_residency_page;
+        }
+    }
+
+    const u32 table_size = texture.mip_page_offsets[ texture.mip_tail_first ] + texture.mip_tail_page_count;
+    u32 bound_pages = 0;
+    for ( u32 p = 0; p < table_size; ++p ) {
+        if ( texture.page_table[ p ] != k_invalid_residency_page ) {
+            texture.page_table[ bound_pages++ ] = texture.page_table[ p ];
+        }
+    }
+
+    if ( bound_pages > 0 ) {
+        release_pages( k_invalid_residency_page, 0, texture.page_table, bound_pages, frame + latency_frames );
+    }
+
+    lru_remove( texture_index );
+    rfree( texture.page_table, allocator );
+    texture.page_table = nullptr;
+    texture.active = false;
+}
+
+void TextureResidency::request_mip( u32 texture_index, u32 mip, u64 frame ) {
+    if ( texture_index >= textures.size || !textures[ texture_index ].active ) {
+        return;
+    }
+
+    ResidentTexture& texture = textures[ texture_index ];
+
+    // The finest mip requested in a frame wins.
+    mip = raptor::min( mip, texture.mip_count - 1 );
+    texture.requested_mip = texture.last_used_frame == frame ? raptor::min( texture.requested_mip, mip ) : mip;
+    texture.last_used_frame = frame;
+
+    lru_remove( texture_index );
+    lru_push_front( texture_index );
+}
+
+void TextureResidency::on_mips_streamed( u32 texture_index, u32 first_mip ) {
+    if ( texture_index >= textures.size || !textures[ texture_index ].active ) {
+        return;
+    }
+
+    ResidentTexture& texture = textures[ texture_index ];
+    if ( !texture.streaming || first_mip != texture.bound_mip ) {
+        return;
+    }
+
+    texture.resident_mip = first_mip;
+    texture.streaming = false;
+    texture.stream_requested = false;
+    texture.base_mip_changed = true;
+}
+
+void TextureResidency::set_budget( u32 budget_pages_ ) {
+    budget_pages = raptor::min( budget_pages_, page_count );
+}
+
+bool TextureResidency::has_pending_requests() const {
+    for ( u32 t = lru_first; t != k_invalid_residency_page; t = textures[ t ].lru_next ) {
+        const ResidentTexture& texture = textures[ t ];
+        if ( !texture.tail_bound || texture.streaming || texture.requested_mip < texture.bound_mip ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureResidency::update( u64 frame, Array<TextureResidencyUpdate>& updates ) {
+    current_frame = frame;
+
+    // Unbind evicted mips and reuse their pages, nothing samples them anymore.
+    u32 released = 0;
+    u32 released_pages = 0;
+    for ( ; released < pending_releases.size && pending_releases[ released ].release_frame <= frame; ++released ) {
+        const PendingPageRelease& release = pending_releases[ released ];
+        if ( release.texture != k_invalid_residency_page ) {
+            updates.push( { TextureResidencyAction::Unbind, release.texture, release.mip } );
+            --textures[ release.texture ].pending_unbinds;
+        }
+
+        for ( u32 p = 0; p < release.page_count; ++p ) {
+            free_pages.push( releasing_page_list[ released_pages + p ] );
+        }
+        released_pages += release.page_count;
+    }
+    remove_front( pending_releases, released );
+    remove_front( releasing_page_list, released_pages );
+    used_pages -= released_pages;
+    releasing_pages -= released_pages;
+
+    // A lowered budget evicts the least recently used mips.
+    while ( used_pages - releasing_pages > budget_pages && ( evict_mip( k_invalid_residency_page, true ) || evict_mip( k_invalid_residency_page, false ) ) ) {
+    }
+
+    // Bind the mip tails of the new textures, then the mips down to the requested one, most recently used textures first.
+    for ( u32 t = lru_first; t != k_invalid_residency_page; t = textures[ t ].lru_next ) {
+        ResidentTexture& texture = textures[ t ];
+        if ( texture.tail_bound || !reserve_pages( t, texture.mip_tail_page_count ) ) {
+            continue;
+        }
+
+        u32* tail_pages = texture.page_table + texture.mip_page_offsets[ texture.mip_tail_first ];
+        for ( u32 p = 0; p < texture.mip_tail_page_count; ++p ) {
+            tail_pages[ p ] = free_pages.back();
+            free_pages.pop();
+        }
+        used_pages += texture.mip_tail_page_count;
+
+        updates.push( { TextureResidencyAction::Bind, t, texture.mip_tail_first } );
+
+        texture.tail_bound = true;
+        texture.bound_mip = texture.mip_tail_first;
+        texture.streaming = true;
+        texture.stream_requested = false;
+        texture.stream_frame = frame + latency_frames;
+    }
+
+    for ( u32 t = lru_first; t != k_invalid_residency_page; t = textures[ t ].lru_next ) {
+        ResidentTexture& texture = textures[ t ];
+        if ( !texture.tail_bound || texture.streaming || texture.pending_unbinds > 0 || texture.requested_mip >= texture.bound_mip ) {
+            continue;
+        }
+
+        u32 mip = texture.bound_mip;
+        while ( mip > texture.requested_mip ) {
+            const u32 mip_page_offset = texture.mip_page_offsets[ mip - 1 ];
+            const u32 mip_page_count = texture.mip_page_offsets[ mip ] - mip_page_offset;
+            if ( !reserve_pages( t, mip_page_count ) ) {
+                break;
+            }
+
+            for ( u32 p = 0; p < mip_page_count; ++p ) {
+                texture.page_table[ mip_page_offset + p ] = free_pages.back();
+                free_pages.pop();
+            }
+            used_pages += mip_page_count;
+
+            --mip;
+            updates.push( { TextureResidencyAction::Bind, t, mip } );
+        }
+
+        if ( mip < texture.bound_mip ) {
+            texture.bound_mip = mip;
+            texture.streaming = true;
+            texture.stream_requested = false;
+            texture.stream_frame = frame + latency_frames;
+        }
+    }
+
+    for ( u32 t = 0; t < textures.size; ++t ) {
+        ResidentTexture& texture = textures[ t ];
+        if ( !texture.active ) {
+            continue;
+        }
+
+        // Stream the bound mips once their binds completed.
+        if ( texture.streaming && !texture.stream_requested && frame >= texture.stream_frame ) {
+            updates.push( { TextureResidencyAction::Stream, t, texture.bound_mip, texture.resident_mip - texture.bound_mip } );
+            texture.stream_requested = true;
+        }
+
+        if ( texture.base_mip_changed ) {
+            updates.push( { TextureResidencyAction::SetBaseMip, t, texture.resident_mip } );
+            texture.base_mip_changed = false;
+        }
+    }
+}
+
+const u32* TextureResidency::get_mip_pages( u32 texture_index, u32 mip, u32& out_page_count_x, u32& out_page_count_y ) const {
+    const ResidentTexture& texture = textures[ texture_index ];
+    RASSERT( mip < texture.mip_tail_first );
+
+    out_page_count_x = get_mip_page_count( texture.width, mip, texture.page_width );
+    out_page_count_y = get_mip_page_count( texture.height, mip, texture.page_height );
+    return texture.page_table + texture.mip_page_offsets[ mip ];
+}
+
+const u32* TextureResidency::get_mip_tail_pages( u32 texture_index, u32& out_page_count ) const {
+    const ResidentTexture& texture = textures[ texture_index ];
+
+    out_page_count = texture.mip_tail_page_count;
+    return texture.page_table + texture.mip_page_offsets[ texture.mip_tail_first ];
+}
+
+bool TextureResidency::reserve_pages( u32 requester, u32 reserved_pages ) {
+    if ( reserved_pages > budget_pages ) {
+        return false;
+    }
+
+    // Mips not needed anymore go first, then the ones of textures used before the requester.
+    while ( used_pages - releasing_pages + reserved_pages > budget_pages ) {
+        if ( !evict_mip( requester, true ) && !evict_mip( requester, false ) ) {
+            return false;
+        }
+    }
+
+    // Evicted pages are reused once released.
+    return used_pages + reserved_pages <= budget_pages;
+}
+
+bool TextureResidency::evict_mip( u32 requester, bool only_unneeded ) {
+    const u64 requester_frame = requester != k_invalid_residency_page ? textures[ requester ].last_used_frame : u64_max;
+
+    for ( u32 t = lru_last; t != k_invalid_residency_page; t = textures[ t ].lru_previous ) {
+        ResidentTexture& texture = textures[ t ];
+
+        // Mips being streamed and the tail stay.
+        if ( t == requester || texture.streaming || texture.resident_mip >= texture.mip_tail_first ) {
+            continue;
+        }
+
+        const bool evictable = only_unneeded ? texture.resident_mip < texture.requested_mip : texture.last_used_frame < requester_frame;
+        if ( !evictable ) {
+            continue;
+        }
+
+        const u32 mip = texture.resident_mip;
+        const u32 mip_page_offset = texture.mip_page_offsets[ mip ];
+        release_pages( t, mip, texture.page_table + mip_page_offset, texture.mip_page_offsets[ mip + 1 ] - mip_page_offset, current_frame + latency_frames );
+
+        texture.resident_mip = mip + 1;
+        texture.bound_mip = mip + 1;
+        texture.base_mip_changed = true;
+        ++texture.pending_unbinds;
+
+        return true;
+    }
+
+    return false;
+}
+
+void TextureResidency::release_pages( u32 texture_index, u32 mip, u32* pages, u32 release_page_count, u64 release_frame ) {
+    PendingPageRelease release{ texture_index, mip, release_page_count, release_frame };
+    pending_releases.push( release );
+
+    for ( u32 p = 0; p < release_page_count; ++p ) {
+        releasing_page_list.push( pages[ p ] );
+        pages[ p ] = k_invalid_residency_page;
+    }
+    releasing_pages += release_page_count;
+}
+
+void TextureResidency::lru_remove( u32 texture_index ) {
+    ResidentTexture& texture = textures[ texture_index ];
+
+    if ( texture.lru_previous != k_invalid_residency_page ) {
+        textures[ texture.lru_previous ].lru_next = texture.lru_next;
+    } else {
+        lru_first = texture.lru_next;
+    }
+
+    if ( texture.lru_next != k_invalid_residency_page ) {
+        textures[ texture.lru_next ].lru_previous = texture.lru_previous;
+    } else {
+        lru_last = texture.lru_previous;
+    }
+
+    texture.lru_previous = k_invalid_residency_page;
+    texture.lru_next = k_invalid_residency_page;
+}
+
+void TextureResidency::lru_push_front( u32 texture_index ) {
+    ResidentTexture& texture = textures[ texture_index ];
+
+    texture.lru_previous = k_invalid_residency_page;
+    texture.lru_next = lru_first;
+
+    if ( lru_first != k_invalid_residency_page ) {
+        textures[ lru_first ].lru_previous = texture_index;
+    } else {
+        lru_last = texture_index;
+    }
+    lru_first = texture_index;
+}
+
+} // namespace raptor
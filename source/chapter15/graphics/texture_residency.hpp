@@ -0,0 +1,130 @@
+#pragma once
+
+#include "foundation/array.hpp"
+
+namespace raptor {
+
+static const u32        k_invalid_residency_page        = u32_max;
+static const u32        k_max_resident_texture_mips     = 16;
+
+//
+//
+struct TextureResidencyAction {
+    enum Enum {
+        Bind, Unbind, Stream, SetBaseMip, Count
+    };
+}; // struct TextureResidencyAction
+
+//
+// Work for the caller, that owns the gpu resources. Bind and Unbind with mip equal to the mip tail first mip refer to the whole tail.
+struct TextureResidencyUpdate {
+
+    TextureResidencyAction::Enum action;
+    u32                 texture;
+    u32                 mip;                // First mip to stream, or new base mip.
+    u32                 mip_count   = 1;    // Mips to stream.
+}; // struct TextureResidencyUpdate
+
+//
+// Sparse texture whose mips before mip_tail_first are bound page by page, the tail as a whole.
+struct ResidentTexture {
+
+    u32*                page_table          = nullptr;  // Pool page of each page, rows of pages of mip 0 first, then the tail pages.
+    u32                 mip_page_offsets[ k_max_resident_texture_mips + 1 ];
+
+    u32                 width               = 0;
+    u32                 height              = 0;
+    u32                 page_width          = 0;    // In texels.
+    u32                 page_height         = 0;
+    u32                 mip_count           = 0;
+    u32                 mip_tail_first      = 0;
+    u32                 mip_tail_page_count = 0;
+
+    u32                 bound_mip           = 0;    // Finest mip with pages bound.
+    u32                 resident_mip        = 0;    // Finest mip that can be sampled, mip_count until the tail is streamed.
+    u32                 requested_mip       = 0;
+    u64                 stream_frame        = 0;    // Bound mips are streamed from this frame, once the binds completed.
+    u32                 pending_unbinds     = 0;
+    bool                streaming           = false;
+    bool                stream_requested    = false;
+    bool                tail_bound          = false;
+    bool                base_mip_changed    = false;
+
+    u64                 last_used_frame     = 0;
+    u32                 lru_previous        = k_invalid_residency_page;
+    u32                 lru_next            = k_invalid_residency_page;
+    bool                active              = false;
+}; // struct ResidentTexture
+
+//
+// Pages of a mip evicted or of a removed texture, in release order.
+struct PendingPageRelease {
+
+    u32                 texture;            // k_invalid_residency_page when there is nothing to unbind.
+    u32                 mip;
+    u32                 page_count;
+    u64                 release_frame;
+}; // struct PendingPageRelease
+
+//
+// Residency of sparse textures in a pool of pages, independent of the gpu. Textures are identified by an index
+// chosen by the caller, e.g. the texture handle index. Mips are made resident from the tail to the requested mip and
+// evicted from the finest one, least recently used textures first, to stay in the page budget. Binds and unbinds
+// are assumed complete after latency_frames, pages are reused only then.
+struct TextureResidency {
+
+    void                init( Allocator* allocator, u32 page_count, u32 page_size, u32 latency_frames );
+    void                shutdown();
+
+    // Returns false when the mip tail does not fit in the budget.
+    bool                add_texture( u32 texture, u32 width, u32 height, u32 mip_count, u32 mip_tail_first, u32 mip_tail_page_count,
+                                     u32 page_width, u32 page_height );
+    // Pages are released after latency_frames, without unbind.
+    void                remove_texture( u32 texture, u64 frame );
+
+    // LOD feedback, marks the texture as used in frame.
+    void                request_mip( u32 texture, u32 mip, u64 frame );
+    // The mips streamed from first_mip are uploaded and visible to the gpu.
+    void                on_mips_streamed( u32 texture, u32 first_mip );
+
+    // Binding, streaming and eviction work for this frame.
+    void                update( u64 frame, Array<TextureResidencyUpdate>& updates );
+
+    // Lowering the budget evicts pages in the next update.
+    void                set_budget( u32 budget_pages );
+
+    // A texture waits for its tail, for requested mips to be bound or for bound mips to be streamed.
+    bool                has_pending_requests() const;
+
+    // Pool pages of a mip in rows of page_count_x, k_invalid_residency_page when not bound.
+    const u32*          get_mip_pages( u32 texture, u32 mip, u32& out_page_count_x, u32& out_page_count_y ) const;
+    const u32*          get_mip_tail_pages( u32 texture, u32& out_page_count ) const;
+
+    bool                reserve_pages( u32 requester, u32 page_count );
+    bool                evict_mip( u32 requester, bool only_unneeded );
+    void                release_pages( u32 texture, u32 mip, u32* pages, u32 page_count, u64 release_frame );
+
+    void                lru_remove( u32 texture );
+    void                lru_push_front( u32 texture );
+
+    Array<ResidentTexture>  textures;
+    Array<u32>          free_pages;
+    Array<PendingPageRelease> pending_releases;
+    Array<u32>          releasing_page_list;   // Pages of pending_releases, in the same order.
+
+    Allocator*          allocator           = nullptr;
+
+    u32                 lru_first           = k_invalid_residency_page;  // Most recently used.
+    u32                 lru_last            = k_invalid_residency_page;
+
+    u32                 page_count          = 0;
+    u32                 page_size           = 0;    // In bytes.
+    u32                 budget_pages        = 0;
+    u32                 used_pages          = 0;    // Including the pages waiting for their release.
+    u32                 releasing_pages     = 0;
+    u32                 latency_frames      = 0;
+    u64                 current_frame       = 0;
+
+}; // struct TextureResidency
+
+} // namespace raptor
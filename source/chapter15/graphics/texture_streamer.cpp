@@ -0,0 +1,201 @@
+#include "graphics/texture_streamer.hpp"
+
+#include "graphics/asynchronous_loader.hpp"
+#include "graphics/gpu_device.hpp"
+
+#include "foundation/assert.hpp"
+#include "foundation/memory.hpp"
+
+#include "external/imgui/imgui.h"
+
+#include <string.h>
+
+namespace raptor {
+
+// Sparse binds are submitted with the frame and complete with its fence.
+static const u32        k_residency_latency_frames = k_max_frames + 1;
+
+// TextureStreamer ////////////////////////////////////////////////////////
+
+void TextureStreamer::init( Renderer* renderer_, AsynchronousLoader* async_loader_, Allocator* allocator_, u32 budget_pages_ ) {
+    renderer = renderer_;
+    async_loader = async_loader_;
+    allocator = allocator_;
+    budget_pages = budget_pages_;
+    page_pool = k_invalid_page_pool;
+    current_frame = 0;
+
+    bound_mips = 0;
+    unbound_mips = 0;
+    streamed_mips = 0;
+
+    streamed_textures.init( allocator, 64 );
+    residency_updates.init( allocator, 64 );
+    streamed_updates.init( allocator, 16 );
+}
+
+void TextureStreamer::shutdown() {
+    if ( page_pool.index != k_invalid_index ) {
+        residency.shutdown();
+        renderer->gpu->destroy_page_pool( page_pool );
+    }
+
+    streamed_textures.shutdown();
+    residency_updates.shutdown();
+    streamed_updates.shutdown();
+}
+
+TextureResource* TextureStreamer::create_texture( const TextureCreation& creation, cstring path ) {
+    GpuDevice* gpu = renderer->gpu;
+
+    TextureCreation sparse_creation = creation;
+    sparse_creation.set_flags( creation.flags | TextureFlags::Sparse_mask );
+
+    TextureResource* texture = renderer->create_texture( sparse_creation );
+    if ( texture == nullptr ) {
+        return nullptr;
+    }
+
+    SparseTextureProperties properties;
+    gpu->get_sparse_texture_properties( texture->handle, properties );
+
+    if ( page_pool.index == k_invalid_index ) {
+        page_pool = gpu->allocate_texture_pool( texture->handle, budget_pages * properties.page_width * properties.page_height );
+        if ( page_pool.index != k_invalid_index ) {
+            residency.init( allocator, budget_pages, properties.page_size, k_residency_latency_frames );
+        }
+    }
+
+    // The residency streams the mips down from the tail, in pages of the pool.
+    const bool streamable = page_pool.index != k_invalid_index && creation.mip_level_count <= k_max_resident_texture_mips &&
+                            properties.mip_tail_first < creation.mip_level_count && properties.page_size == residency.page_size &&
+                            residency.add_texture( texture->handle.index, creation.width, creation.height, creation.mip_level_count, properties.mip_tail_first,
+                                                   properties.mip_tail_page_count, properties.page_width, properties.page_height );
+    if ( !streamable ) {
+        renderer->destroy_texture( texture );
+
+        texture = renderer->create_texture( creation );
+        if ( texture != nullptr ) {
+            async_loader->request_texture_data( path, texture->handle );
+        }
+        return texture;
+    }
+
+    while ( texture->handle.index >= streamed_textures.size ) {
+        StreamedTexture empty_texture{ };
+        streamed_textures.push( empty_texture );
+    }
+
+    StreamedTexture& streamed_texture = streamed_textures[ texture->handle.index ];
+    strcpy( streamed_texture.path, path );
+    streamed_texture.active = true;
+
+    return texture;
+}
+
+bool TextureStreamer::is_streamed( TextureHandle texture ) const {
+    return texture.index < streamed_textures.size && streamed_textures[ texture.index ].active;
+}
+
+void TextureStreamer::request_mip( TextureHandle texture, u32 mip ) {
+    if ( is_streamed( texture ) ) {
+        residency.request_mip( texture.index, mip, current_frame );
+    }
+}
+
+bool TextureStreamer::has_pending_requests() const {
+    return page_pool.index != k_invalid_index && residency.has_pending_requests();
+}
+
+void TextureStreamer::update( u64 frame ) {
+    current_frame = frame;
+
+    if ( page_pool.index == k_invalid_index ) {
+        return;
+    }
+
+    GpuDevice* gpu = renderer->gpu;
+
+    streamed_updates.clear();
+    renderer->get_streamed_texture_updates( streamed_updates );
+    for ( u32 i = 0; i < streamed_updates.size; ++i ) {
+        const TextureUpdate& texture_update = streamed_updates[ i ];
+        residency.on_mips_streamed( texture_update.texture.index, texture_update.first_mip );
+        streamed_mips += texture_update.mip_count;
+    }
+
+    residency_updates.clear();
+    residency.update( frame, residency_updates );
+
+    for ( u32 i = 0; i < residency_updates.size; ++i ) {
+        const TextureResidencyUpdate& update = residency_updates[ i ];
+        const TextureHandle texture{ update.texture };
+        const ResidentTexture& resident_texture = residency.textures[ update.texture ];
+
+        switch ( update.action ) {
+            case TextureResidencyAction::Bind:
+            case TextureResidencyAction::Unbind:
+            {
+                // The page table holds the new bindings: none for evicted mips.
+                if ( update.mip >= resident_texture.mip_tail_first ) {
+                    u32 page_count = 0;
+                    const u32* pages = residency.get_mip_tail_pages( update.texture, page_count );
+                    gpu->bind_texture_mip_tail( page_pool, texture, pages, page_count );
+                } else {
+                    u32 page_count_x = 0, page_count_y = 0;
+                    const u32* pages = residency.get_mip_pages( update.texture, update.mip, page_count_x, page_count_y );
+
+                    // A mip bound again in the same update replaces the old pages, it does not need the unbind.
+                    if ( update.action == TextureResidencyAction::Unbind && pages[ 0 ] != k_invalid_residency_page ) {
+                        break;
+                    }
+                    gpu->bind_texture_mip_pages( page_pool, texture, update.mip, pages, page_count_x, page_count_y );
+                }
+
+                if ( update.action == TextureResidencyAction::Bind ) {
+                    ++bound_mips;
+                } else {
+                    ++unbound_mips;
+                }
+                break;
+            }
+
+            case TextureResidencyAction::Stream:
+            {
+                async_loader->request_texture_mips( streamed_textures[ update.texture ].path, texture, update.mip, update.mip_count );
+                break;
+            }
+
+            case TextureResidencyAction::SetBaseMip:
+            {
+                gpu->set_texture_base_mip( texture, update.mip );
+                break;
+            }
+
+            default:
+            {
+                RASSERT( false );
+                break;
+            }
+        }
+    }
+}
+
+void TextureStreamer::imgui_draw() {
+    if ( page_pool.index == k_invalid_index ) {
+        ImGui::Text( "No streamed textures" );
+        return;
+    }
+
+    const f64 megabytes_per_page = residency.page_size / ( 1024.0 * 1024.0 );
+    ImGui::Text( "Pages %u / %u, %.2f MB, releasing %u", residency.used_pages, residency.budget_pages, residency.used_pages * megabytes_per_page,
+                 residency.releasing_pages );
+    ImGui::Text( "Bound mips %u, unbound %u, streamed %u", bound_mips, unbound_mips, streamed_mips );
+
+    i32 budget = ( i32 )residency.budget_pages;
+    if ( ImGui::SliderInt( "Page budget", &budget, 1, ( i32 )residency.page_count ) ) {
+        residency.set_budget( ( u32 )budget );
+    }
+}
+
+} // namespace raptor
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "foundation/array.hpp"
+#include "foundation/platform.hpp"
+
+#include "graphics/gpu_resources.hpp"
+#include "graphics/renderer.hpp"
+#include "graphics/texture_residency.hpp"
+
+namespace raptor {
+
+struct Allocator;
+struct AsynchronousLoader;
+
+//
+// Source file of a streamed texture.
+struct StreamedTexture {
+
+    char                path[ 512 ];
+    bool                active          = false;
+}; // struct StreamedTexture
+
+//
+// Streams the mips of sparse textures. The pages chosen by the residency are bound from a single pool, the mips are
+// uploaded by the asynchronous loader and sampling is clamped to the resident mips. Runs on the main thread.
+struct TextureStreamer {
+
+    void                init( Renderer* renderer, AsynchronousLoader* async_loader, Allocator* allocator, u32 budget_pages );
+    void                shutdown();
+
+    // Creates a sparse texture streamed from path. Textures that cannot be sparse are created as usual and loaded at once.
+    TextureResource*    create_texture( const TextureCreation& creation, cstring path );
+    bool                is_streamed( TextureHandle texture ) const;
+
+    // LOD feedback for this frame, see TextureResidency::request_mip.
+    void                request_mip( TextureHandle texture, u32 mip );
+    // Streamed textures still missing the mips last requested.
+    bool                has_pending_requests() const;
+
+    // Applies the binds, streams and evictions of this frame. Call before present, that flushes the binds.
+    void                update( u64 frame );
+
+    void                imgui_draw();
+
+    TextureResidency    residency;
+
+    Array<StreamedTexture>  streamed_textures;     // Indexed by texture handle index.
+    Array<TextureResidencyUpdate> residency_updates;
+    Array<TextureUpdate>    streamed_updates;
+
+    Renderer*           renderer        = nullptr;
+    AsynchronousLoader* async_loader    = nullptr;
+    Allocator*          allocator       = nullptr;
+
+    // Created with the first sparse texture, all of them share the format and the page size.
+    PagePoolHandle      page_pool       = k_invalid_page_pool;
+    u32                 budget_pages    = 0;
+    u64                 current_frame   = 0;
+
+    u32                 bound_mips      = 0;
+    u32                 unbound_mips    = 0;
+    u32                 streamed_mips   = 0;
+
+}; // struct TextureStreamer
+
+} // namespace raptor
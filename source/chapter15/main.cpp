@@ -15,6 +15,7 @@
 #include "graphics/obj_scene.hpp"
 #include "graphics/frame_graph.hpp"
 #include "graphics/asynchronous_loader.hpp"
+#include "graphics/texture_streamer.hpp"
 #include "graphics/scene_graph.hpp"
 #include "graphics/render_resources_loader.hpp"
 
@@ -39,6 +40,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 ///////////////////////////////////////
 
@@ -671,6 +673,11 @@ int main( int argc, char** argv ) {
     AsynchronousLoader async_loader;
     async_loader.init( &renderer, &task_scheduler, allocator );
 
+    // Sparse textures share a pool of 64k pages.
+    const u32 k_texture_streaming_pages = 2048;
+    TextureStreamer texture_streamer;
+    texture_streamer.init( &renderer, &async_loader, allocator, k_texture_streaming_pages );
+
     Directory cwd{ };
     directory_current(&cwd);
 
@@ -691,6 +698,13 @@ int main( int argc, char** argv ) {
 
         char* file_extension = file_extension_from_path( file_name );
 
+        // Scene files packed by RaptorPacker in a pack named after the scene, read instead of the loose files.
+        char pack_name[ 512 ]{ };
+        snprintf( pack_name, 512, "%.*s%s", ( int )( file_extension - 1 - file_name ), file_name, k_vfs_pack_extension );
+        if ( file_exists( pack_name ) ) {
+            vfs_mount( pack_name, "." );
+        }
+
         if ( scene == nullptr ) {
             // TODO(marco): further refactor to allow different formats
             if ( strcmp( file_extension, "gltf" ) == 0 ) {
@@ -701,6 +715,7 @@ int main( int argc, char** argv ) {
             scene->init( &scene_graph, allocator, &renderer );
             scene->use_meshlets = gpu.mesh_shaders_extension_present;
             scene->use_meshlets_emulation = !scene->use_meshlets;
+            scene->texture_streamer = &texture_streamer;
         }
 
         scene->add_mesh( file_name, file_base_path, &scratch_allocator, &async_loader );
@@ -764,6 +779,19 @@ int main( int argc, char** argv ) {
         }
     };
 
+    // Cache frame graph resources in scene, their textures change every time the frame graph does
+    auto cache_frame_graph_resources = [ & ]() {
+        FrameGraphResource* resource = frame_graph.get_resource( "motion_vectors" );
+        if ( resource ) {
+            scene->motion_vector_texture = resource->resource_info.texture.handle;
+        }
+
+        resource = frame_graph.get_resource( "visibility_motion_vectors" );
+        if ( resource ) {
+            scene->visibility_motion_vector_texture = resource->resource_info.texture.handle;
+        }
+    };
+
     TextureResource* dither_texture = nullptr;
     TextureResource* blue_noise_128_rg_texture = nullptr;
     SamplerHandle repeat_sampler, repeat_nearest_sampler;
@@ -772,6 +800,16 @@ int main( int argc, char** argv ) {
         cstring frame_graph_path = temporary_name_buffer.append_use_f( "%s/%s", RAPTOR_WORKING_FOLDER, "graph_ray_tracing.json" );
 
         frame_graph.parse( frame_graph_path, &scratch_allocator );
+
+        // Read below through the scene and the lighting constants, not as inputs of the nodes.
+        frame_graph.add_external_read( "depth" );
+        frame_graph.add_external_read( "motion_vectors" );
+        frame_graph.add_external_read( "visibility_motion_vectors" );
+        frame_graph.add_external_read( "shadow_visibility" );
+        frame_graph.add_external_read( "indirect_lighting" );
+        frame_graph.add_external_read( "bilateral_weights" );
+        frame_graph.add_external_read( "svgf_output" );
+
         frame_graph.compile();
 
         // TODO: improve
@@ -784,16 +822,7 @@ int main( int argc, char** argv ) {
             }
         }
 
-        // Cache frame graph resources in scene
-        FrameGraphResource* resource = frame_graph.get_resource( "motion_vectors" );
-        if ( resource ) {
-            scene->motion_vector_texture = resource->resource_info.texture.handle;
-        }
-
-        resource = frame_graph.get_resource( "visibility_motion_vectors" );
-        if ( resource ) {
-            scene->visibility_motion_vector_texture = resource->resource_info.texture.handle;
-        }
+        cache_frame_graph_resources();
 
         render_resources_loader.init( &renderer, &scratch_allocator, &frame_graph );
 
@@ -984,6 +1013,9 @@ int main( int argc, char** argv ) {
     i64 begin_frame_tick = time_now();
     i64 absolute_begin_frame_tick = begin_frame_tick;
 
+    // Camera of the last texture prioritization, streamed textures can need other mips only once it moves.
+    mat4s prioritized_view_projection{ };
+
     f32 spring_stiffness = 10000.0f;
     f32 spring_damping = 5000.0f;
     f32 air_density = 2.0f;
@@ -1014,7 +1046,7 @@ int main( int argc, char** argv ) {
             gpu.new_frame();
 
             static bool one_time_check = true;
-            if ( async_loader.file_load_requests.size == 0 && one_time_check ) {
+            if ( one_time_check && async_loader.get_file_request_count() == 0 ) {
                 one_time_check = false;
                 rprint( "Finished uploading textures in %f seconds\n", time_from_seconds( absolute_begin_frame_tick ) );
             }
@@ -1027,6 +1059,7 @@ int main( int argc, char** argv ) {
             renderer.resize_swapchain( window.width, window.height );
             window.resized = false;
             frame_graph.on_resize( gpu, window.width, window.height );
+            cache_frame_graph_resources();
             scene->on_resize( gpu, &frame_graph, window.width, window.height );
             frame_renderer.update_dependent_resources();
 
@@ -1170,6 +1203,8 @@ int main( int argc, char** argv ) {
                     ImGui::Checkbox( "Use meshlets", &enable_meshlets );
                     scene->use_meshlets = enable_meshlets;
                     ImGui::Checkbox( "Use meshlets emulation", &scene->use_meshlets_emulation );
+                    ImGui::Checkbox( "Use mesh lods", &scene->use_mesh_lods );
+                    ImGui::SliderFloat( "Lod pixel error threshold", &scene->lod_pixel_error_threshold, 0.1f, 16.0f );
                     ImGui::Checkbox( "Use frustum cull for meshes", &enable_frustum_cull_meshes );
                     ImGui::Checkbox( "Use frustum cull for meshlets", &enable_frustum_cull_meshlets );
                     ImGui::Checkbox( "Use occlusion cull for meshes", &enable_occlusion_cull_meshes );
@@ -1352,7 +1387,12 @@ int main( int argc, char** argv ) {
 
                 ImGui::Checkbox( "Show Debug GPU Draws", &scene->show_debug_gpu_draws );
                 ImGui::Checkbox( "Dynamically recreate descriptor sets", &recreate_per_thread_descriptors );
-                ImGui::Checkbox( "Use secondary command buffers", &use_secondary_command_buffers );
+                if ( gpu.async_compute_supported() ) {
+                    ImGui::Checkbox( "Async compute", &frame_graph.async_compute );
+                }
+                if ( gpu.synchronization2_extension_present ) {
+                    ImGui::Checkbox( "Split barriers", &frame_graph.split_barriers );
+                }
                 ImGui::Separator();
                 ImGui::SliderFloat( "Animation Speed Multiplier", &animation_speed_multiplier, 0.0f, 10.0f );
                 ImGui::Separator();
@@ -1405,6 +1445,14 @@ int main( int argc, char** argv ) {
             }
             ImGui::End();
 
+            if ( ImGui::Begin( "Asynchronous Loader" ) ) {
+                async_loader.telemetry.imgui_draw();
+
+                ImGui::Separator();
+                texture_streamer.imgui_draw();
+            }
+            ImGui::End();
+
             if ( ImGui::Begin( "GPU Profiler" ) ) {
                 ImGui::Text( "Cpu Time %fms", delta_time * 1000.f );
                 gpu_profiler.imgui_draw();
@@ -1489,6 +1537,23 @@ int main( int argc, char** argv ) {
             ZoneScopedN( "JointsUpdate" );
             scene->update_joints();
         }
+        // Stream the textures of what the camera sees first: while loads are queued, while streamed textures miss
+        // the mips they requested, and when the camera moves.
+        const bool camera_moved = texture_streamer.page_pool.index != k_invalid_index &&
+                                  memcmp( &prioritized_view_projection, &game_camera.camera.view_projection, sizeof( mat4s ) ) != 0;
+        if ( async_loader.get_file_request_count() || texture_streamer.has_pending_requests() || camera_moved ) {
+            scene->prioritize_texture_loads( game_camera.camera, &async_loader, &scratch_allocator );
+            prioritized_view_projection = game_camera.camera.view_projection;
+        }
+        if ( scene->use_mesh_lods ) {
+            scene->select_mesh_instance_lods( game_camera.camera );
+        }
+
+        // Passes enabled or disabled this frame change the frame graph.
+        if ( frame_graph.compile() ) {
+            cache_frame_graph_resources();
+            frame_renderer.update_dependent_resources();
+        }
 
         {
             ZoneScopedN( "Gpu Buffers Update" );
@@ -1546,6 +1611,8 @@ int main( int argc, char** argv ) {
             scene_data.set_shadow_meshlets_cone_cull( shadow_meshlets_cone_cull );
             scene_data.set_shadow_meshlets_sphere_cull( shadow_meshlets_sphere_cull );
             scene_data.set_shadow_meshlets_cubemap_face_cull( shadow_meshlets_cubemap_face_cull );
+            scene_data.set_mesh_lods( scene->use_mesh_lods );
+            scene_data.lod_pixel_error_threshold = scene->lod_pixel_error_threshold;
 
             scene_data.resolution_x = gpu.swapchain_width * 1.f;
             scene_data.resolution_y = gpu.swapchain_height * 1.f;
@@ -1678,6 +1745,9 @@ int main( int argc, char** argv ) {
 
             task_scheduler.WaitforTaskSet( &draw_task );
 
+            // Mips acquired in the previous frames become visible, new binds are flushed by present.
+            texture_streamer.update( gpu.absolute_frame );
+
             // Avoid using the same command buffer
             renderer.add_texture_update_commands( ( draw_task.thread_id + 1 ) % task_scheduler.GetNumTaskThreads() );
             gpu.present( async_compute_command_buffer );
@@ -1699,6 +1769,7 @@ int main( int argc, char** argv ) {
 
     vkDeviceWaitIdle( gpu.vulkan_device );
 
+    texture_streamer.shutdown();
     async_loader.shutdown();
 
     // Destroy resources built here.
@@ -1724,6 +1795,8 @@ int main( int argc, char** argv ) {
     rm.shutdown();
     renderer.shutdown();
 
+    vfs_unmount_all();
+
     delete scene;
 
     input.shutdown();
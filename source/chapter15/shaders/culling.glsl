@@ -102,6 +102,14 @@ void main() {
 
 		occlusion_visible = occlusion_visible || disable_occlusion_cull_meshes();
 
+	    // Select the level of detail from the simplification error projected on screen.
+	    MeshLod mesh_lod = mesh_draw.lods[0];
+	    if ( !disable_mesh_lods() ) {
+	    	float lod_distance = length( (world_to_camera * world_bounding_center).xyz ) - bounding_sphere.w * scale;
+	    	uint lod_index = select_mesh_lod( mesh_draw, lod_distance, scale, projection_11, resolution.y, lod_pixel_error_threshold );
+	    	mesh_lod = mesh_draw.lods[lod_index];
+	    }
+
 	    uint flags = mesh_draw.flags;
 	    if ( frustum_visible && occlusion_visible ) {
 	    	// Add opaque draws
@@ -115,14 +123,14 @@ void main() {
 				draw_commands[draw_index].vertexOffset = mesh_draw.vertexOffset;
 				draw_commands[draw_index].firstInstance = 0;
 
-				uint task_count = (mesh_draw.meshlet_count + 31) / 32;
+				uint task_count = (mesh_lod.meshlet_count + 31) / 32;
 				draw_commands[draw_index].taskCount = task_count;
-				draw_commands[draw_index].firstTask = mesh_draw.meshlet_offset / 32;
+				draw_commands[draw_index].firstTask = mesh_lod.meshlet_offset / 32;
 
 				// TODO: add optional flags for dispatch of task shaders emulation
 				//atomicAdd( dispatch_task_x, task_count );
 
-				draw_commands[draw_index].indexCount = mesh_draw.meshlet_index_count;
+				draw_commands[draw_index].indexCount = mesh_lod.meshlet_index_count;
 			}
 			else {
 				// Transparent draws are written after total_count commands in the same buffer.
@@ -134,8 +142,8 @@ void main() {
 				draw_commands[draw_index].firstIndex = 0;
 				draw_commands[draw_index].vertexOffset = mesh_draw.vertexOffset;
 				draw_commands[draw_index].firstInstance = 0;
-				draw_commands[draw_index].taskCount = (mesh_draw.meshlet_count + 31) / 32;
-				draw_commands[draw_index].firstTask = mesh_draw.meshlet_offset / 32;
+				draw_commands[draw_index].taskCount = (mesh_lod.meshlet_count + 31) / 32;
+				draw_commands[draw_index].firstTask = mesh_lod.meshlet_offset / 32;
 			}
 	    } else if ( late_flag == 0 ) {
 			// Add culled object for re-test
@@ -143,8 +151,8 @@ void main() {
 				uint draw_index = atomicAdd( opaque_mesh_culled_count, 1 );
 
 				draw_late_commands[draw_index].drawId = mesh_instance_index;
-				draw_late_commands[draw_index].taskCount = (mesh_draw.meshlet_count + 31) / 32;
-				draw_late_commands[draw_index].firstTask = mesh_draw.meshlet_offset / 32;
+				draw_late_commands[draw_index].taskCount = (mesh_lod.meshlet_count + 31) / 32;
+				draw_late_commands[draw_index].firstTask = mesh_lod.meshlet_offset / 32;
 			}
 		}
 	}
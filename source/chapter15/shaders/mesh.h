@@ -30,6 +30,16 @@ layout(buffer_reference, std430, buffer_reference_align = 2) buffer int_array_ty
     uint16_t v;
 };
 
+// NOTE: needs to be kept in sync with k_max_mesh_lods
+#define MAX_MESH_LODS 4
+
+struct MeshLod {
+    uint        meshlet_offset;
+    uint        meshlet_count;
+    uint        meshlet_index_count;
+    float       error;
+};
+
 struct MeshDraw {
 
     // x = diffuse index, y = roughness index, z = normal index, w = occlusion index.
@@ -47,12 +57,18 @@ struct MeshDraw {
     uint        meshlet_offset;
     uint        meshlet_count;
     uint        meshlet_index_count;
-    uint        pad001;
+    uint        lod_count;
 
     uint64_t    position_buffer;
     uint64_t    uv_buffer;
     uint64_t    index_buffer;
     uint64_t    normals_buffer;
+
+    MeshLod     lods[MAX_MESH_LODS];
+
+    // Meshlet vertex position dequantization, xyz only.
+    vec4        meshlet_position_offset;
+    vec4        meshlet_position_scale;
 };
 
 struct MeshInstanceDraw {
@@ -96,6 +112,20 @@ layout ( std430, set = MATERIAL_SET, binding = 12 ) readonly buffer MeshBounds {
     vec4        mesh_bounds[];
 };
 
+// Coarsest lod whose error, projected at distance from the camera, is below the pixel threshold.
+// NOTE: must be in sync with select_mesh_lod in render_scene.cpp
+uint select_mesh_lod( MeshDraw mesh_draw, float distance, float scale, float projection_11, float resolution_y, float pixel_error_threshold ) {
+    const float error_to_pixels = scale * projection_11 * resolution_y * 0.5 / max( distance, 1.192092896e-07 );
+
+    for ( uint l = mesh_draw.lod_count; l > 1; --l ) {
+        if ( mesh_draw.lods[l - 1].error * error_to_pixels <= pixel_error_threshold ) {
+            return l - 1;
+        }
+    }
+
+    return 0;
+}
+
 // Material calculations /////////////////////////////////////////////////
 vec4 compute_diffuse_color(inout vec4 base_color, uint albedo_texture, vec2 uv) {
     if (albedo_texture != INVALID_TEXTURE_INDEX) {
@@ -342,8 +342,6 @@ void main()
     bool has_normals = (mesh_draw.flags & DrawFlags_HasNormals) != 0;
     bool has_tangents = (mesh_draw.flags & DrawFlags_HasTangents) != 0;
 
-    float i8_inverse = 1.0 / 127.0;
-
 #if defined(MESH_TRANSPARENT_NO_CULL)
     uint mesh_instance_index = draw_commands[gl_DrawIDARB + total_count].drawId;
 #else
@@ -363,18 +361,18 @@ void main()
     {
         uint vi = meshletData[vertexOffset + i];// + mesh_draw.vertexOffset;
 
-        vec3 position = vec3(vertex_positions[vi].v.x, vertex_positions[vi].v.y, vertex_positions[vi].v.z);
+        vec3 position = decode_meshlet_position( vertex_positions[vi], mesh_draw.meshlet_position_offset.xyz, mesh_draw.meshlet_position_scale.xyz );
 
         if ( has_normals ) {
-            vec3 normal = vec3(int(vertex_data[vi].nx), int(vertex_data[vi].ny), int(vertex_data[vi].nz)) * i8_inverse - 1.0;
+            vec3 normal = decode_meshlet_normal( vertex_data[vi].normal );
             vNormal_BiTanX[ i ].xyz = normalize( mat3(model_inverse) * normal );
         }
 
         if ( has_tangents ) {
-            vec3 tangent = vec3(int(vertex_data[vi].tx), int(vertex_data[vi].ty), int(vertex_data[vi].tz)) * i8_inverse - 1.0;
+            vec4 tangent = decode_meshlet_tangent( vertex_data[vi].tangent );
             vTangent_BiTanY[ i ].xyz = normalize( mat3(model) * tangent.xyz );
 
-            vec3 bitangent = cross( vNormal_BiTanX[ i ].xyz, tangent.xyz ) * ( int(vertex_data[vi].tw) * i8_inverse  - 1.0 );
+            vec3 bitangent = cross( vNormal_BiTanX[ i ].xyz, tangent.xyz ) * tangent.w;
             vNormal_BiTanX[ i ].w = bitangent.x;
             vTangent_BiTanY[ i ].w = bitangent.y;
             vPosition_BiTanZ[ i ].w = bitangent.z;
@@ -518,7 +516,7 @@ void main()
     {
         uint vi = meshletData[vertexOffset + i];// + mesh_draw.vertexOffset;
 
-        vec3 position = vec3(vertex_positions[vi].v.x, vertex_positions[vi].v.y, vertex_positions[vi].v.z);
+        vec3 position = decode_meshlet_position( vertex_positions[vi], mesh_draw.meshlet_position_offset.xyz, mesh_draw.meshlet_position_scale.xyz );
 #if defined(MESH_DEPTH_CUBEMAP)
         gl_MeshVerticesNV[ i ].gl_Position = view_projections[layer_index] * (model * vec4(position, 1));
 #elif defined(MESH_DEPTH_TETRAHEDRON)
@@ -1275,26 +1273,24 @@ void main() {
 
     uint vi = meshletData[vertex_offset + meshlet_vertex_index];
 
-    vec3 position = vec3(vertex_positions[vi].v.x, vertex_positions[vi].v.y, vertex_positions[vi].v.z);
+    vec3 position = decode_meshlet_position( vertex_positions[vi], mesh_draw.meshlet_position_offset.xyz, mesh_draw.meshlet_position_scale.xyz );
 
     gl_Position = view_projection * (model * vec4(position, 1));
 
     bool has_normals = (mesh_draw.flags & DrawFlags_HasNormals) != 0;
     bool has_tangents = (mesh_draw.flags & DrawFlags_HasTangents) != 0;
 
-    float i8_inverse = 1.0 / 127.0;
-
     if ( has_normals ) {
         mat4 model_inverse = mesh_instance_draws[mesh_instance_index].model_inverse;
-        vec3 normal = vec3(int(vertex_data[vi].nx), int(vertex_data[vi].ny), int(vertex_data[vi].nz)) * i8_inverse - 1.0;
+        vec3 normal = decode_meshlet_normal( vertex_data[vi].normal );
         vNormal_BiTanX.xyz = normalize( mat3(model_inverse) * normal );
     }
 
     if ( has_tangents ) {
-        vec3 tangent = vec3(int(vertex_data[vi].tx), int(vertex_data[vi].ty), int(vertex_data[vi].tz)) * i8_inverse - 1.0;
+        vec4 tangent = decode_meshlet_tangent( vertex_data[vi].tangent );
         vTangent_BiTanY.xyz = normalize( mat3(model) * tangent.xyz );
 
-        vec3 bitangent = cross( vNormal_BiTanX.xyz, tangent.xyz ) * ( int(vertex_data[vi].tw) * i8_inverse  - 1.0 );
+        vec3 bitangent = cross( vNormal_BiTanX.xyz, tangent.xyz ) * tangent.w;
         vNormal_BiTanX.w = bitangent.x;
         vTangent_BiTanY.w = bitangent.y;
         vPosition_BiTanZ.w = bitangent.z;
@@ -21,18 +21,42 @@
 // Common data
 struct VertexExtraData
 {
-    uint8_t     nx, ny, nz, nw; // normal
-    uint8_t     tx, ty, tz, tw; // tangent
+    uint        normal;         // octahedral, 2 x snorm16
+    uint        tangent;        // octahedral, snorm16 x, snorm15 y, bitangent sign in the top bit
     float16_t   tu, tv;         // tex coords
-    float       padding;
 };
 
 struct VertexPosition
 {
-    vec3    v;
-    float   padding;
+    uint16_t    x, y, z;        // unorm16 inside the mesh bounding box
+    uint16_t    padding;
 };
 
+// NOTE: must be in sync with the vertex compression functions in numerics.cpp
+vec3 decode_meshlet_position( VertexPosition p, vec3 offset, vec3 scale ) {
+    return offset + vec3( uint(p.x), uint(p.y), uint(p.z) ) * ( 1.0 / 65535.0 ) * scale;
+}
+
+vec3 octahedral_decode( vec2 e ) {
+    vec3 v = vec3( e.xy, 1.0 - abs( e.x ) - abs( e.y ) );
+    float t = max( -v.z, 0.0 );
+    v.x += v.x >= 0.0 ? -t : t;
+    v.y += v.y >= 0.0 ? -t : t;
+    return normalize( v );
+}
+
+vec3 decode_meshlet_normal( uint packed ) {
+    return octahedral_decode( unpackSnorm2x16( packed ) );
+}
+
+// xyz tangent, w bitangent sign.
+vec4 decode_meshlet_tangent( uint packed ) {
+    // Sign extend both fields.
+    float x = max( float( int( packed << 16 ) >> 16 ) / 32767.0, -1.0 );
+    float y = max( float( int( packed << 1 ) >> 17 ) / 16383.0, -1.0 );
+    return vec4( octahedral_decode( vec2( x, y ) ), ( packed >> 31 ) != 0 ? -1.0 : 1.0 );
+}
+
 struct Meshlet
 {
     vec3    center;
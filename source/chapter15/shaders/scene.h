@@ -45,6 +45,11 @@ layout ( std140, set = MATERIAL_SET, binding = 0 ) uniform SceneConstants {
     uint        volumetric_fog_application_options;
 
     vec4        frustum_planes[6];
+
+    float       lod_pixel_error_threshold;
+    uint        pad000_lod;
+    uint        pad001_lod;
+    uint        pad002_lod;
 };
 
 bool enable_volumetric_fog_opacity_anti_aliasing() {
@@ -92,6 +97,10 @@ bool disable_shadow_meshes_sphere_cull() {
     return ( culling_options & 256 ) != 256;
 }
 
+bool disable_mesh_lods() {
+    return ( culling_options & 512 ) != 512;
+}
+
 // Utility methods ///////////////////////////////////////////////////////
 float dither(vec2 screen_pixel_position, float value)
 {
@@ -0,0 +1,217 @@
+// Builds the cluster hierarchy of a closed mesh and checks the properties cut selection relies on:
+// errors and bounds grow from children to parents, and every cut is watertight.
+
+#include "graphics/cluster_lod.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include "tests/test.hpp"
+
+#include "external/cglm/struct/vec3.h"
+#include "external/meshoptimizer/meshoptimizer.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace raptor;
+
+// Cube subdivided in a grid on each face, projected on a bumpy sphere. Vertices come from integer
+// lattice coordinates, so the edges shared by two faces weld exactly.
+static void create_bumpy_sphere( u32 subdivisions, Allocator* allocator, Array<f32>& positions, Array<u32>& indices ) {
+    const i32 half = ( i32 )subdivisions / 2;
+
+    Array<f32> face_positions;
+    face_positions.init( allocator, 6 * ( subdivisions + 1 ) * ( subdivisions + 1 ) * 3 );
+    Array<u32> face_indices;
+    face_indices.init( allocator, 6 * subdivisions * subdivisions * 6 );
+
+    for ( u32 face = 0; face < 6; ++face ) {
+        const u32 axis = face / 2;
+        const i32 sign = ( face & 1 ) ? -1 : 1;
+        const u32 base_vertex = face_positions.size / 3;
+
+        for ( u32 v = 0; v <= subdivisions; ++v ) {
+            for ( u32 u = 0; u <= subdivisions; ++u ) {
+                i32 lattice[ 3 ];
+                lattice[ axis ] = sign * half;
+                lattice[ ( axis + 1 ) % 3 ] = ( ( i32 )u - half ) * sign;
+                lattice[ ( axis + 2 ) % 3 ] = ( i32 )v - half;
+
+                vec3s direction = glms_vec3_normalize( vec3s{ ( f32 )lattice[ 0 ], ( f32 )lattice[ 1 ], ( f32 )lattice[ 2 ] } );
+                const f32 radius = 1.0f + 0.05f * sinf( direction.x * 9.0f ) * cosf( direction.y * 7.0f ) * sinf( direction.z * 5.0f + 1.0f );
+
+                face_positions.push( direction.x * radius );
+                face_positions.push( direction.y * radius );
+                face_positions.push( direction.z * radius );
+            }
+        }
+
+        for ( u32 v = 0; v < subdivisions; ++v ) {
+            for ( u32 u = 0; u < subdivisions; ++u ) {
+                const u32 i0 = base_vertex + v * ( subdivisions + 1 ) + u;
+                const u32 i1 = i0 + 1;
+                const u32 i2 = i0 + subdivisions + 1;
+                const u32 i3 = i2 + 1;
+
+                face_indices.push( i0 ); face_indices.push( i1 ); face_indices.push( i3 );
+                face_indices.push( i0 ); face_indices.push( i3 ); face_indices.push( i2 );
+            }
+        }
+    }
+
+    const u32 face_vertex_count = face_positions.size / 3;
+    Array<u32> remap;
+    remap.init( allocator, face_vertex_count, face_vertex_count );
+
+    const u32 vertex_count = ( u32 )meshopt_generateVertexRemap( remap.data, face_indices.data, face_indices.size, face_positions.data, face_vertex_count, sizeof( f32 ) * 3 );
+
+    positions.init( allocator, vertex_count * 3, vertex_count * 3 );
+    indices.init( allocator, face_indices.size, face_indices.size );
+    meshopt_remapVertexBuffer( positions.data, face_positions.data, face_vertex_count, sizeof( f32 ) * 3, remap.data );
+    meshopt_remapIndexBuffer( indices.data, face_indices.data, face_indices.size, remap.data );
+
+    remap.shutdown();
+    face_indices.shutdown();
+    face_positions.shutdown();
+}
+
+static bool sphere_encloses( const vec4s& outer, const vec4s& inner ) {
+    const f32 distance = glms_vec3_distance( vec3s{ outer.x, outer.y, outer.z }, vec3s{ inner.x, inner.y, inner.z } );
+    return distance + inner.w <= outer.w * 1.0001f + 1e-5f;
+}
+
+static int compare_edges( const void* a, const void* b ) {
+    const u64 edge_a = *( const u64* )a;
+    const u64 edge_b = *( const u64* )b;
+    return edge_a < edge_b ? -1 : ( edge_a > edge_b ? 1 : 0 );
+}
+
+// Watertight: every edge of the cut is used by a triangle in each direction, as in the closed source mesh.
+static bool is_cut_watertight( const ClusterLod& cluster_lod, const Array<u32>& cut, u32 vertex_count, Allocator* allocator ) {
+    Array<u64> edges;
+    edges.init( allocator, 1024 );
+
+    for ( u32 c = 0; c < cut.size; ++c ) {
+        const ClusterLodCluster& cluster = cluster_lod.clusters[ cut[ c ] ];
+        for ( u32 i = 0; i < cluster.index_count; i += 3 ) {
+            const u32* triangle = cluster_lod.indices.data + cluster.index_offset + i;
+            for ( u32 e = 0; e < 3; ++e ) {
+                edges.push( ( u64 )triangle[ e ] * vertex_count + triangle[ ( e + 1 ) % 3 ] );
+            }
+        }
+    }
+
+    // Sort and look for the reverse of each edge.
+    qsort( edges.data, edges.size, sizeof( u64 ), compare_edges );
+
+    bool watertight = edges.size > 0;
+    for ( u32 i = 0; i < edges.size && watertight; ++i ) {
+        const u64 reverse_edge = ( edges[ i ] % vertex_count ) * vertex_count + edges[ i ] / vertex_count;
+
+        u32 low = 0, high = edges.size;
+        while ( low < high ) {
+            const u32 middle = ( low + high ) / 2;
+            if ( edges[ middle ] < reverse_edge ) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        watertight = low < edges.size && edges[ low ] == reverse_edge;
+    }
+
+    edges.shutdown();
+    return watertight;
+}
+
+int main( int argc, char** argv ) {
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    Array<f32> positions;
+    Array<u32> indices;
+    create_bumpy_sphere( 48, allocator, positions, indices );
+    const u32 vertex_count = positions.size / 3;
+
+    ClusterLod cluster_lod;
+    cluster_lod.init( allocator, indices.size );
+    cluster_lod.build( positions.data, vertex_count, sizeof( f32 ) * 3, indices.data, indices.size );
+
+    RTEST_CHECK( cluster_lod.level_count > 2 );
+    RTEST_CHECK( cluster_lod.groups.size > 0 );
+    RTEST_CHECK( cluster_lod.root_count > 0 );
+
+    // Parents have an error and bounds at least as big as the ones of their children.
+    for ( u32 c = 0; c < cluster_lod.clusters.size; ++c ) {
+        const ClusterLodCluster& cluster = cluster_lod.clusters[ c ];
+        if ( cluster.group_index == u32_max ) {
+            continue;
+        }
+
+        const ClusterLodGroup& group = cluster_lod.groups[ cluster.group_index ];
+        RTEST_CHECK( cluster.parent_error >= cluster.error );
+        RTEST_CHECK( group.error >= cluster.error );
+        RTEST_CHECK( sphere_encloses( cluster.parent_bounds, cluster.bounds ) );
+        RTEST_CHECK( sphere_encloses( group.bounds, cluster.bounds ) );
+    }
+
+    for ( u32 g = 0; g < cluster_lod.groups.size; ++g ) {
+        const ClusterLodGroup& group = cluster_lod.groups[ g ];
+        for ( u32 c = group.cluster_offset; c < group.cluster_offset + group.cluster_count; ++c ) {
+            const ClusterLodCluster& cluster = cluster_lod.clusters[ c ];
+            RTEST_CHECK( cluster.error == group.error );
+            RTEST_CHECK( cluster.level == group.level + 1 );
+
+            // Triangles of generated clusters stay inside the bounds they share with their siblings.
+            for ( u32 i = 0; i < cluster.index_count; ++i ) {
+                const f32* position = positions.data + cluster_lod.indices[ cluster.index_offset + i ] * 3;
+                RTEST_CHECK( sphere_encloses( cluster.bounds, vec4s{ position[ 0 ], position[ 1 ], position[ 2 ], 0.0f } ) );
+            }
+        }
+    }
+
+    // Cuts from different distances and thresholds cover the whole closed surface without cracks.
+    Array<u32> cut;
+    cut.init( allocator, cluster_lod.clusters.size );
+
+    const vec3s camera_positions[] = { { 0.0f, 0.0f, 1.5f }, { 3.0f, 1.0f, 0.0f }, { 0.0f, -20.0f, 0.0f }, { 200.0f, 0.0f, 0.0f } };
+    const f32 thresholds[] = { 0.5f, 1.0f, 4.0f, 32.0f };
+    const f32 error_to_pixels = 1.0f * 1080.0f * 0.5f;
+
+    u32 min_triangles = u32_max, max_triangles = 0;
+    for ( u32 p = 0; p < ArraySize( camera_positions ); ++p ) {
+        for ( u32 t = 0; t < ArraySize( thresholds ); ++t ) {
+            cut.clear();
+            const u32 triangle_count = cluster_lod.select_cut( camera_positions[ p ], error_to_pixels, thresholds[ t ], cut );
+
+            RTEST_CHECK( triangle_count > 0 );
+            RTEST_CHECK( is_cut_watertight( cluster_lod, cut, vertex_count, allocator ) );
+
+            min_triangles = raptor::min( min_triangles, triangle_count );
+            max_triangles = raptor::max( max_triangles, triangle_count );
+        }
+    }
+
+    // Far cuts use the simplified levels.
+    RTEST_CHECK( min_triangles < max_triangles );
+    RTEST_CHECK( max_triangles <= indices.size / 3 );
+
+    // A cut at full detail is the source mesh.
+    cut.clear();
+    RTEST_CHECK( cluster_lod.select_cut( camera_positions[ 0 ], error_to_pixels, 0.0f, cut ) == indices.size / 3 );
+
+    rprint( "Cluster lod: %u clusters, %u groups, %u levels, cuts from %u to %u of %u triangles\n", cluster_lod.clusters.size, cluster_lod.groups.size,
+            cluster_lod.level_count, min_triangles, max_triangles, indices.size / 3 );
+
+    cut.shutdown();
+    cluster_lod.shutdown();
+    indices.shutdown();
+    positions.shutdown();
+
+    MemoryService::instance()->shutdown();
+
+    return test::result( "cluster_lod_test" );
+}
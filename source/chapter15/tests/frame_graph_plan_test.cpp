@@ -0,0 +1,817 @@
+// Sorts made up frame graph plans: producers before consumers whatever the order nodes are added in,
+// culling from the final resources, exported and disabled nodes, loaded and referenced resources.
+// Replays the planned barriers frame after frame against the transitions rendering used to issue for each use.
+// Places textures by lifetime: final outputs and resources read outside the graph never share memory.
+// Schedules an async compute branch: submissions, their semaphore waits and the queue ownership transfers.
+
+#include "graphics/frame_graph_plan.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include "tests/test.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+static const u32        k_not_sorted        = u32_max;
+
+static u32 sorted_position( const Array<u32>& sorted_nodes, u32 node ) {
+    for ( u32 i = 0; i < sorted_nodes.size; ++i ) {
+        if ( sorted_nodes[ i ] == node ) {
+            return i;
+        }
+    }
+    return k_not_sorted;
+}
+
+static void test_chain_added_backwards( Allocator* allocator ) {
+    FrameGraphPlan plan;
+    plan.init( allocator, 3, 3 );
+
+    // Resource r is created by the node that has it as output r.
+    plan.add_node( true, false );   // 0: reads 1, writes 2
+    plan.add_use( 1, FrameGraphUseType::Read );
+    plan.add_use( 2, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 1: reads 0, writes 1
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 2: writes 0
+    plan.add_use( 0, FrameGraphUseType::Write );
+
+    Array<u32> final_resources;
+    final_resources.init( allocator, 1 );
+    final_resources.push( 2 );
+
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, 3 );
+
+    frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+    RTEST_CHECK( sorted_nodes.size == 3 );
+    RTEST_CHECK( sorted_nodes.size == 3 && sorted_nodes[ 0 ] == 2 && sorted_nodes[ 1 ] == 1 && sorted_nodes[ 2 ] == 0 );
+
+    sorted_nodes.shutdown();
+    final_resources.shutdown();
+    plan.shutdown();
+}
+
+static void test_culling( Allocator* allocator ) {
+    FrameGraphPlan plan;
+    plan.init( allocator, 6, 6 );
+
+    plan.add_node( true, false );   // 0: writes 0
+    plan.add_use( 0, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 1: reads 0, writes 1, the final resource
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 2: reads 0, writes 2 that nobody reads
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 2, FrameGraphUseType::Write );
+    plan.add_node( true, true );    // 3: reads 2 and exports
+    plan.add_use( 2, FrameGraphUseType::Read );
+    plan.add_node( false, false );  // 4: disabled, reads 1 and writes 4
+    plan.add_use( 1, FrameGraphUseType::Read );
+    plan.add_use( 4, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 5: writes 5 that nobody reads
+    plan.add_use( 5, FrameGraphUseType::Write );
+
+    Array<u32> final_resources;
+    final_resources.init( allocator, 1 );
+    final_resources.push( 1 );
+
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, 6 );
+
+    frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+
+    // The exporting node keeps the node it reads from.
+    RTEST_CHECK( sorted_nodes.size == 4 );
+    RTEST_CHECK( sorted_position( sorted_nodes, 0 ) < sorted_position( sorted_nodes, 1 ) );
+    RTEST_CHECK( sorted_position( sorted_nodes, 2 ) < sorted_position( sorted_nodes, 3 ) );
+    RTEST_CHECK( sorted_position( sorted_nodes, 3 ) != k_not_sorted );
+    RTEST_CHECK( sorted_position( sorted_nodes, 4 ) == k_not_sorted );
+    RTEST_CHECK( sorted_position( sorted_nodes, 5 ) == k_not_sorted );
+
+    // Without final resources all enabled nodes run.
+    final_resources.clear();
+    frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+    RTEST_CHECK( sorted_nodes.size == 5 );
+    RTEST_CHECK( sorted_position( sorted_nodes, 4 ) == k_not_sorted );
+    RTEST_CHECK( sorted_position( sorted_nodes, 5 ) != k_not_sorted );
+
+    sorted_nodes.shutdown();
+    final_resources.shutdown();
+    plan.shutdown();
+}
+
+static void test_load_and_reference( Allocator* allocator ) {
+    FrameGraphPlan plan;
+    plan.init( allocator, 4, 4 );
+
+    // Like the transparent pass drawing on the lit image, then read by the antialiasing.
+    plan.add_node( true, false );   // 0: reads 0 written by 2, writes 1 the final resource
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 1: loads 0 and references it
+    plan.add_use( 0, FrameGraphUseType::Load );
+    plan.add_use( 0, FrameGraphUseType::Reference );
+    plan.add_node( true, false );   // 2: writes 0
+    plan.add_use( 0, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 3: loads 0 without referencing it, nobody reads after it
+    plan.add_use( 0, FrameGraphUseType::Load );
+
+    Array<u32> final_resources;
+    final_resources.init( allocator, 1 );
+    final_resources.push( 1 );
+
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, 4 );
+
+    frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+
+    // A loaded attachment is also written: loading a needed resource keeps the node.
+    RTEST_CHECK( sorted_nodes.size == 4 );
+    RTEST_CHECK( sorted_position( sorted_nodes, 2 ) < sorted_position( sorted_nodes, 1 ) );
+    RTEST_CHECK( sorted_position( sorted_nodes, 1 ) < sorted_position( sorted_nodes, 0 ) );
+    RTEST_CHECK( sorted_position( sorted_nodes, 2 ) < sorted_position( sorted_nodes, 3 ) );
+
+    sorted_nodes.shutdown();
+    final_resources.shutdown();
+    plan.shutdown();
+}
+
+static void test_random_graphs( Allocator* allocator ) {
+    static const u32 k_node_count = 64;
+
+    srand( 4321 );
+
+    FrameGraphPlan plan;
+    Array<u32> final_resources;
+    final_resources.init( allocator, 4 );
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, k_node_count );
+
+    u32 order[ k_node_count ];
+    u32 node_of_order[ k_node_count ];
+
+    for ( u32 graph = 0; graph < 200; ++graph ) {
+        // Node at position p of a valid order writes resource p, and reads some of the resources before it.
+        for ( u32 p = 0; p < k_node_count; ++p ) {
+            order[ p ] = p;
+        }
+        for ( u32 p = k_node_count - 1; p > 0; --p ) {
+            const u32 other = rand() % ( p + 1 );
+            const u32 swap = order[ p ];
+            order[ p ] = order[ other ];
+            order[ other ] = swap;
+        }
+
+        plan.init( allocator, k_node_count, k_node_count );
+        for ( u32 n = 0; n < k_node_count; ++n ) {
+            const u32 p = order[ n ];
+            node_of_order[ p ] = n;
+
+            plan.add_node( rand() % 8 != 0, rand() % 16 == 0 );
+
+            const u32 read_count = p > 0 ? rand() % 4 : 0;
+            for ( u32 r = 0; r < read_count; ++r ) {
+                plan.add_use( rand() % p, FrameGraphUseType::Read );
+            }
+            plan.add_use( p, FrameGraphUseType::Write );
+        }
+
+        final_resources.clear();
+        final_resources.push( k_node_count - 1 );
+        final_resources.push( rand() % k_node_count );
+
+        frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+
+        bool valid = true;
+        for ( u32 i = 0; i < sorted_nodes.size; ++i ) {
+            const FrameGraphPlanNode& node = plan.nodes[ sorted_nodes[ i ] ];
+            valid &= node.enabled;
+            valid &= sorted_position( sorted_nodes, sorted_nodes[ i ] ) == i;
+
+            // Enabled writers of what the node reads run before it.
+            for ( u32 u = node.first_use; u < node.first_use + node.use_count; ++u ) {
+                const FrameGraphPlanUse& use = plan.uses[ u ];
+                if ( use.type != FrameGraphUseType::Read ) {
+                    continue;
+                }
+
+                const u32 writer = node_of_order[ use.resource ];
+                if ( plan.nodes[ writer ].enabled ) {
+                    valid &= sorted_position( sorted_nodes, writer ) < i;
+                }
+            }
+        }
+        RTEST_CHECK( valid );
+
+        // Enabled writers of the final resources are needed.
+        for ( u32 f = 0; f < final_resources.size; ++f ) {
+            const u32 writer = node_of_order[ final_resources[ f ] ];
+            RTEST_CHECK( !plan.nodes[ writer ].enabled || sorted_position( sorted_nodes, writer ) != k_not_sorted );
+        }
+
+        plan.shutdown();
+    }
+
+    sorted_nodes.shutdown();
+    final_resources.shutdown();
+}
+
+static const u32        k_barrier_node_count        = 24;
+static const u32        k_barrier_resource_count    = 12;
+
+// States compute_barriers requests: sampled textures, loaded attachments, attachments written and buffers.
+static ResourceState random_state( bool compute, bool buffer, bool depth, bool input ) {
+    if ( buffer ) {
+        return input ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_UNORDERED_ACCESS;
+    }
+
+    const ResourceState write_state = compute ? RESOURCE_STATE_UNORDERED_ACCESS : depth ? RESOURCE_STATE_DEPTH_WRITE : RESOURCE_STATE_RENDER_TARGET;
+    if ( input && ( compute || rand() % 3 != 0 ) ) {
+        return compute ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    }
+    return write_state;
+}
+
+// State of a resource while the node runs: the first state that allows writes, else the last read.
+static ResourceState expected_node_state( const Array<FrameGraphStateRequest>& requests, u32 first_request, u32 last_request, u32 resource ) {
+    ResourceState state = RESOURCE_STATE_UNDEFINED;
+    for ( u32 r = first_request; r < last_request; ++r ) {
+        if ( requests[ r ].resource != resource ) {
+            continue;
+        }
+
+        if ( state == RESOURCE_STATE_UNDEFINED || frame_graph_is_read_only_state( state ) ) {
+            state = requests[ r ].state;
+        }
+    }
+    return state;
+}
+
+static void test_barriers_against_node_transitions( Allocator* allocator ) {
+    srand( 2468 );
+
+    Array<FrameGraphStateRequest> requests;
+    requests.init( allocator, k_barrier_node_count * 6 );
+    Array<u32> node_requests;
+    node_requests.init( allocator, k_barrier_node_count + 1 );
+    Array<FrameGraphBarrier> barriers;
+    barriers.init( allocator, 64 );
+    Array<u32> node_barriers;
+    node_barriers.init( allocator, k_barrier_node_count + 1 );
+
+    bool buffers[ k_barrier_resource_count ];
+    bool depths[ k_barrier_resource_count ];
+    bool written[ k_barrier_resource_count ];
+
+    // Textures as the node transitions left them, and as the planned barriers do.
+    ResourceState node_transition_states[ k_barrier_resource_count ];
+    ResourceState planned_states[ k_barrier_resource_count ];
+
+    u32 node_transition_count = 0;
+    u32 planned_barrier_count = 0;
+
+    for ( u32 graph = 0; graph < 500; ++graph ) {
+        for ( u32 r = 0; r < k_barrier_resource_count; ++r ) {
+            buffers[ r ] = rand() % 4 == 0;
+            depths[ r ] = rand() % 4 == 0;
+            written[ r ] = false;
+            node_transition_states[ r ] = RESOURCE_STATE_UNDEFINED;
+            planned_states[ r ] = RESOURCE_STATE_UNDEFINED;
+        }
+
+        // Inputs first, then outputs, as compute_barriers requests them. Some nodes, like ray tracing ones, request nothing.
+        requests.clear();
+        node_requests.clear();
+        for ( u32 n = 0; n < k_barrier_node_count; ++n ) {
+            node_requests.push( requests.size );
+
+            const bool compute = rand() % 3 == 0;
+            const u32 input_count = rand() % 4;
+            const u32 output_count = rand() % 3;
+            for ( u32 u = 0; u < input_count + output_count; ++u ) {
+                const u32 resource = rand() % k_barrier_resource_count;
+                // Compute nodes do not write depth.
+                if ( compute && depths[ resource ] && !buffers[ resource ] && u >= input_count ) {
+                    continue;
+                }
+                requests.push( { resource, random_state( compute, buffers[ resource ], depths[ resource ], u < input_count ), buffers[ resource ] } );
+                written[ resource ] |= !frame_graph_is_read_only_state( requests.back().state );
+            }
+        }
+        node_requests.push( requests.size );
+
+        frame_graph_plan_barriers( requests, node_requests, k_barrier_resource_count, barriers, node_barriers, allocator );
+        RTEST_CHECK( node_barriers.size == k_barrier_node_count + 1 );
+
+        bool sources_predicted = true;
+        bool states_match = true;
+        bool barriers_requested = true;
+
+        for ( u32 frame = 0; frame < 3; ++frame ) {
+            for ( u32 n = 0; n < k_barrier_node_count; ++n ) {
+                const u32 first_request = node_requests[ n ];
+                const u32 last_request = node_requests[ n + 1 ];
+
+                // Rendering used to transition textures for each use, from the state they track. Buffers had no barriers.
+                for ( u32 r = first_request; r < last_request; ++r ) {
+                    const FrameGraphStateRequest& request = requests[ r ];
+                    if ( !request.buffer ) {
+                        node_transition_states[ request.resource ] = request.state;
+                        node_transition_count += frame > 0 ? 1 : 0;
+                    }
+                }
+
+                // Same replay as issue_node_barriers.
+                for ( u32 b = node_barriers[ n ]; b < node_barriers[ n + 1 ]; ++b ) {
+                    const FrameGraphBarrier& barrier = barriers[ b ];
+                    ResourceState& state = planned_states[ barrier.resource ];
+
+                    // The first frame starts from undefined states, the predictions are for the frames after it.
+                    if ( frame > 0 ) {
+                        sources_predicted &= barrier.source_state == state;
+                    }
+
+                    bool requested = false;
+                    for ( u32 r = first_request; r < last_request; ++r ) {
+                        requested |= requests[ r ].resource == barrier.resource && requests[ r ].buffer == barrier.buffer;
+                    }
+                    barriers_requested &= requested;
+
+                    if ( !barrier.buffer && state == barrier.destination_state && frame_graph_is_read_only_state( barrier.destination_state ) ) {
+                        continue;
+                    }
+
+                    state = barrier.destination_state;
+                    planned_barrier_count += frame > 0 && !barrier.buffer ? 1 : 0;
+                }
+
+                if ( frame == 0 ) {
+                    continue;
+                }
+
+                // Every resource the node uses is in the state it needs. Textures are where the node transitions left
+                // them, unless the node read a texture after writing it: it keeps the state that allows writes.
+                // Buffers have no layout, the ones the graph only reads need no barrier.
+                for ( u32 r = first_request; r < last_request; ++r ) {
+                    const u32 resource = requests[ r ].resource;
+                    const ResourceState expected_state = expected_node_state( requests, first_request, last_request, resource );
+
+                    if ( buffers[ resource ] ) {
+                        states_match &= planned_states[ resource ] == ( written[ resource ] ? expected_state : RESOURCE_STATE_UNDEFINED );
+                    } else {
+                        states_match &= planned_states[ resource ] == expected_state;
+                        const bool read_after_write = !frame_graph_is_read_only_state( expected_state ) && frame_graph_is_read_only_state( node_transition_states[ resource ] );
+                        states_match &= read_after_write || node_transition_states[ resource ] == expected_state;
+                    }
+                }
+            }
+        }
+
+        RTEST_CHECK( sources_predicted );
+        RTEST_CHECK( states_match );
+        RTEST_CHECK( barriers_requested );
+    }
+
+    // Redundant reads and textures used twice by a node do not get barriers.
+    RTEST_CHECK( planned_barrier_count < node_transition_count );
+    rprint( "Texture barriers in the frames after the first: %u planned, %u node transitions\n", planned_barrier_count, node_transition_count );
+
+    node_barriers.shutdown();
+    barriers.shutdown();
+    node_requests.shutdown();
+    requests.shutdown();
+}
+
+static void test_buffer_read_barriers( Allocator* allocator ) {
+    // A buffer written by node 0 and read by nodes 1 and 2: the second read does not need a barrier.
+    Array<FrameGraphStateRequest> requests;
+    requests.init( allocator, 4 );
+    requests.push( { 0, RESOURCE_STATE_UNORDERED_ACCESS, true } );
+    requests.push( { 0, RESOURCE_STATE_SHADER_RESOURCE, true } );
+    requests.push( { 0, RESOURCE_STATE_SHADER_RESOURCE, true } );
+
+    Array<u32> node_requests;
+    node_requests.init( allocator, 4 );
+    for ( u32 n = 0; n <= 3; ++n ) {
+        node_requests.push( n );
+    }
+
+    Array<FrameGraphBarrier> barriers;
+    barriers.init( allocator, 4 );
+    Array<u32> node_barriers;
+    node_barriers.init( allocator, 4 );
+
+    frame_graph_plan_barriers( requests, node_requests, 1, barriers, node_barriers, allocator );
+
+    RTEST_CHECK( barriers.size == 2 );
+    RTEST_CHECK( node_barriers.size == 4 && node_barriers[ 1 ] == 1 && node_barriers[ 2 ] == 2 && node_barriers[ 3 ] == 2 );
+    // The write of the next frame waits for the reads of this one.
+    RTEST_CHECK( barriers.size == 2 && barriers[ 0 ].source_state == RESOURCE_STATE_SHADER_RESOURCE && barriers[ 0 ].destination_state == RESOURCE_STATE_UNORDERED_ACCESS );
+    RTEST_CHECK( barriers.size == 2 && barriers[ 1 ].source_state == RESOURCE_STATE_UNORDERED_ACCESS && barriers[ 1 ].destination_state == RESOURCE_STATE_SHADER_RESOURCE );
+    // The write is the first use of the frame, the reads wait for it.
+    RTEST_CHECK( barriers.size == 2 && barriers[ 0 ].release_node == u32_max && barriers[ 1 ].release_node == 0 );
+
+    node_barriers.shutdown();
+    barriers.shutdown();
+    node_requests.shutdown();
+    requests.shutdown();
+}
+
+static const FrameGraphBarrier* find_barrier( const Array<FrameGraphBarrier>& barriers, const Array<u32>& node_barriers, u32 node, u32 resource ) {
+    for ( u32 b = node_barriers[ node ]; b < node_barriers[ node + 1 ]; ++b ) {
+        if ( barriers[ b ].resource == resource ) {
+            return &barriers[ b ];
+        }
+    }
+    return nullptr;
+}
+
+static void test_split_barriers( Allocator* allocator ) {
+    const u32 node_count = 7;
+
+    Array<FrameGraphStateRequest> requests;
+    requests.init( allocator, 16 );
+
+    Array<u32> node_requests;
+    node_requests.init( allocator, node_count + 1 );
+
+    node_requests.push( requests.size );   // 0: writes 0 and 2
+    requests.push( { 0, RESOURCE_STATE_RENDER_TARGET, false } );
+    requests.push( { 2, RESOURCE_STATE_RENDER_TARGET, false } );
+    node_requests.push( requests.size );   // 1: writes 1
+    requests.push( { 1, RESOURCE_STATE_RENDER_TARGET, false } );
+    node_requests.push( requests.size );   // 2: reads 1 right after it is written, writes 4
+    requests.push( { 1, RESOURCE_STATE_PIXEL_SHADER_RESOURCE, false } );
+    requests.push( { 4, RESOURCE_STATE_RENDER_TARGET, false } );
+    node_requests.push( requests.size );   // 3: reads 0 and 2, writes buffer 3
+    requests.push( { 0, RESOURCE_STATE_PIXEL_SHADER_RESOURCE, false } );
+    requests.push( { 2, RESOURCE_STATE_PIXEL_SHADER_RESOURCE, false } );
+    requests.push( { 3, RESOURCE_STATE_UNORDERED_ACCESS, true } );
+    node_requests.push( requests.size );   // 4: transitions its resources itself, writes 5
+    requests.push( { 5, RESOURCE_STATE_RENDER_TARGET, false } );
+    node_requests.push( requests.size );   // 5: in another submission, reads buffer 3
+    requests.push( { 3, RESOURCE_STATE_SHADER_RESOURCE, true } );
+    node_requests.push( requests.size );   // 6: reads 4, after node 4
+    requests.push( { 4, RESOURCE_STATE_PIXEL_SHADER_RESOURCE, false } );
+    node_requests.push( requests.size );
+
+    Array<u32> node_submissions;
+    node_submissions.init( allocator, node_count );
+    Array<u8> split_nodes;
+    split_nodes.init( allocator, node_count );
+    for ( u32 n = 0; n < node_count; ++n ) {
+        node_submissions.push( n == 5 ? 1 : 0 );
+        split_nodes.push( n == 4 ? 0 : 1 );
+    }
+
+    Array<FrameGraphBarrier> barriers;
+    barriers.init( allocator, 16 );
+    Array<u32> node_barriers;
+    node_barriers.init( allocator, node_count + 1 );
+    Array<FrameGraphSplitEvent> events;
+    events.init( allocator, 4 );
+
+    frame_graph_plan_barriers( requests, node_requests, 6, barriers, node_barriers, allocator );
+
+    const FrameGraphBarrier* read_0 = find_barrier( barriers, node_barriers, 3, 0 );
+    const FrameGraphBarrier* read_2 = find_barrier( barriers, node_barriers, 3, 2 );
+    RTEST_CHECK( read_0 != nullptr && read_0->release_node == 0 );
+    RTEST_CHECK( read_2 != nullptr && read_2->release_node == 0 );
+    RTEST_CHECK( find_barrier( barriers, node_barriers, 0, 0 )->release_node == u32_max );
+
+    frame_graph_split_barriers( barriers, node_barriers, node_submissions, split_nodes, 2, 8, events, allocator );
+
+    // Only the reads of node 3 are far enough from their release node, they share an event.
+    RTEST_CHECK( events.size == 1 && events[ 0 ].release_node == 0 && events[ 0 ].acquire_node == 3 );
+    RTEST_CHECK( read_0 != nullptr && read_0->event == 0 );
+    RTEST_CHECK( read_2 != nullptr && read_2->event == 0 );
+    // Too close, in another submission, across a node that transitions its own resources.
+    RTEST_CHECK( find_barrier( barriers, node_barriers, 2, 1 )->event == u32_max );
+    RTEST_CHECK( find_barrier( barriers, node_barriers, 5, 3 )->event == u32_max );
+    RTEST_CHECK( find_barrier( barriers, node_barriers, 6, 4 )->event == u32_max );
+
+    u32 split_count = 0;
+    for ( u32 b = 0; b < barriers.size; ++b ) {
+        split_count += barriers[ b ].event != u32_max ? 1 : 0;
+    }
+    RTEST_CHECK( split_count == 2 );
+
+    // The barriers that do not fit in the event are issued before the node.
+    frame_graph_split_barriers( barriers, node_barriers, node_submissions, split_nodes, 2, 1, events, allocator );
+    RTEST_CHECK( events.size == 1 && read_0->event == 0 && read_2->event == u32_max );
+
+    // A discard is not split, the other barrier still is.
+    barriers[ read_0 - barriers.data ].discard = true;
+    frame_graph_split_barriers( barriers, node_barriers, node_submissions, split_nodes, 2, 8, events, allocator );
+    RTEST_CHECK( events.size == 1 && read_0->event == u32_max && read_2->event == 0 );
+
+    // No release node is that far from the nodes that need its resources.
+    frame_graph_split_barriers( barriers, node_barriers, node_submissions, split_nodes, node_count, 8, events, allocator );
+    RTEST_CHECK( events.size == 0 && read_2->event == u32_max );
+
+    events.shutdown();
+    node_barriers.shutdown();
+    barriers.shutdown();
+    split_nodes.shutdown();
+    node_submissions.shutdown();
+    node_requests.shutdown();
+    requests.shutdown();
+}
+
+static void test_final_output_lifetime( Allocator* allocator ) {
+    FrameGraphPlan plan;
+    plan.init( allocator, 5, 5 );
+
+    // Like the final texture of the demo: read by the antialiasing, then loaded by the transparent and debug passes.
+    plan.add_node( true, false );   // 0: writes 0, the lit image
+    plan.add_use( 0, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 1: reads 0, writes 1 the final texture
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 2: reads 1, writes 2
+    plan.add_use( 1, FrameGraphUseType::Read );
+    plan.add_use( 2, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 3: loads 1 and reads 2
+    plan.add_use( 1, FrameGraphUseType::Load );
+    plan.add_use( 2, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Reference );
+    plan.add_node( true, false );   // 4: loads 1
+    plan.add_use( 1, FrameGraphUseType::Load );
+    plan.add_use( 1, FrameGraphUseType::Reference );
+
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, 5 );
+    for ( u32 n = 0; n < 5; ++n ) {
+        sorted_nodes.push( n );
+    }
+
+    Array<u32> kept_resources;
+    kept_resources.init( allocator, 1 );
+
+    Array<FrameGraphLifetime> lifetimes;
+    lifetimes.init( allocator, 5 );
+
+    frame_graph_compute_lifetimes( plan, sorted_nodes, kept_resources, lifetimes, allocator );
+    RTEST_CHECK( lifetimes.size == 5 );
+    RTEST_CHECK( lifetimes[ 0 ].first_node == 0 && lifetimes[ 0 ].last_node == 1 );
+    RTEST_CHECK( lifetimes[ 2 ].first_node == 2 && lifetimes[ 2 ].last_node == 3 );
+    // Loaded last, it is written after the last read.
+    RTEST_CHECK( lifetimes[ 1 ].first_node == 1 && lifetimes[ 1 ].last_node == 5 );
+    RTEST_CHECK( lifetimes[ 3 ].first_node == u32_max );
+
+    // Kept, it is alive before its producer too.
+    kept_resources.push( 1 );
+    kept_resources.push( 2 );
+    frame_graph_compute_lifetimes( plan, sorted_nodes, kept_resources, lifetimes, allocator );
+    RTEST_CHECK( lifetimes[ 1 ].first_node == 0 && lifetimes[ 1 ].last_node == 5 );
+    RTEST_CHECK( lifetimes[ 2 ].first_node == 0 && lifetimes[ 2 ].last_node == 5 );
+    RTEST_CHECK( lifetimes[ 0 ].first_node == 0 && lifetimes[ 0 ].last_node == 1 );
+
+    lifetimes.shutdown();
+    kept_resources.shutdown();
+    sorted_nodes.shutdown();
+    plan.shutdown();
+}
+
+static bool memory_overlaps( const FrameGraphPlacement& a, const FrameGraphPlacement& b ) {
+    return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+static void test_placement_keeps_final_outputs( Allocator* allocator ) {
+    static const u32 k_node_count = 32;
+
+    srand( 1357 );
+
+    FrameGraphPlan plan;
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, k_node_count );
+    Array<u32> kept_resources;
+    kept_resources.init( allocator, 4 );
+    Array<FrameGraphLifetime> lifetimes;
+    lifetimes.init( allocator, k_node_count );
+    Array<FrameGraphPlacement> placements;
+    placements.init( allocator, k_node_count );
+    u32 placement_resources[ k_node_count ];
+
+    u32 aliased_count = 0;
+
+    for ( u32 graph = 0; graph < 300; ++graph ) {
+        // Sorted chain: node n writes resource n, reads and loads resources written before it.
+        plan.init( allocator, k_node_count, k_node_count );
+        sorted_nodes.clear();
+        for ( u32 n = 0; n < k_node_count; ++n ) {
+            plan.add_node( true, false );
+            sorted_nodes.push( n );
+
+            const u32 read_count = n > 0 ? rand() % 3 : 0;
+            for ( u32 r = 0; r < read_count; ++r ) {
+                plan.add_use( n - 1 - rand() % raptor::min( n, 4u ), rand() % 4 == 0 ? FrameGraphUseType::Load : FrameGraphUseType::Read );
+            }
+            plan.add_use( n, FrameGraphUseType::Write );
+        }
+
+        kept_resources.clear();
+        const u32 kept_count = 1 + rand() % 3;
+        for ( u32 k = 0; k < kept_count; ++k ) {
+            kept_resources.push( rand() % k_node_count );
+        }
+
+        frame_graph_compute_lifetimes( plan, sorted_nodes, kept_resources, lifetimes, allocator );
+
+        // Some outputs are buffers or external, they are not placed.
+        placements.clear();
+        for ( u32 r = 0; r < k_node_count; ++r ) {
+            if ( rand() % 5 == 0 ) {
+                continue;
+            }
+
+            const sizet alignment = ( sizet )1 << ( 8 + rand() % 4 );
+            placement_resources[ placements.size ] = r;
+            placements.push( { lifetimes[ r ].first_node, lifetimes[ r ].last_node, alignment * ( 1 + rand() % 16 ), alignment, 0, false } );
+        }
+
+        const sizet heap_size = frame_graph_place_textures( placements, allocator );
+
+        bool kept_alone = true;
+        bool alive_apart = true;
+        bool placed_in_heap = true;
+        for ( u32 a = 0; a < placements.size; ++a ) {
+            const FrameGraphPlacement& placement_a = placements[ a ];
+            placed_in_heap &= ( placement_a.offset % placement_a.alignment ) == 0 && placement_a.offset + placement_a.size <= heap_size;
+            aliased_count += placement_a.aliased ? 1 : 0;
+
+            bool kept = false;
+            for ( u32 k = 0; k < kept_resources.size; ++k ) {
+                kept |= kept_resources[ k ] == placement_resources[ a ];
+            }
+            kept_alone &= !kept || !placement_a.aliased;
+
+            for ( u32 b = 0; b < placements.size; ++b ) {
+                const FrameGraphPlacement& placement_b = placements[ b ];
+                if ( a == b || !memory_overlaps( placement_a, placement_b ) ) {
+                    continue;
+                }
+
+                kept_alone &= !kept;
+                alive_apart &= placement_a.last_node < placement_b.first_node || placement_b.last_node < placement_a.first_node;
+            }
+        }
+
+        RTEST_CHECK( kept_alone );
+        RTEST_CHECK( alive_apart );
+        RTEST_CHECK( placed_in_heap );
+
+        plan.shutdown();
+    }
+
+    // Other textures still share memory.
+    RTEST_CHECK( aliased_count > 0 );
+
+    placements.shutdown();
+    lifetimes.shutdown();
+    kept_resources.shutdown();
+    sorted_nodes.shutdown();
+}
+
+static bool has_queue_transfer( const Array<FrameGraphQueueTransfer>& transfers, u32 resource, u32 release_node, u32 acquire_node, QueueType::Enum source_queue ) {
+    for ( u32 t = 0; t < transfers.size; ++t ) {
+        const FrameGraphQueueTransfer& transfer = transfers[ t ];
+        if ( transfer.resource == resource && transfer.release_node == release_node && transfer.acquire_node == acquire_node &&
+             transfer.source_queue == source_queue && transfer.destination_queue != source_queue ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_async_compute_schedule( Allocator* allocator ) {
+    FrameGraphPlan plan;
+    plan.init( allocator, 6, 6 );
+
+    // Like the demo with async compute: ambient occlusion depends on the gbuffer, the fog noise on nothing.
+    plan.add_node( true, false );   // 0: graphics, writes 0 the gbuffer
+    plan.add_use( 0, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 1: compute, reads 0, writes 2 the occlusion
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 2, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 2: compute, writes 4 the noise
+    plan.add_use( 4, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 3: graphics, writes 5 the shadows
+    plan.add_use( 5, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 4: graphics, reads 0, 2, 4 and 5, writes 1 the lit image
+    plan.add_use( 0, FrameGraphUseType::Read );
+    plan.add_use( 2, FrameGraphUseType::Read );
+    plan.add_use( 4, FrameGraphUseType::Read );
+    plan.add_use( 5, FrameGraphUseType::Read );
+    plan.add_use( 1, FrameGraphUseType::Write );
+    plan.add_node( true, false );   // 5: graphics, reads 1, writes 3 the final texture
+    plan.add_use( 1, FrameGraphUseType::Read );
+    plan.add_use( 3, FrameGraphUseType::Write );
+
+    Array<u32> sorted_nodes;
+    sorted_nodes.init( allocator, 6 );
+
+    Array<u8> node_queues;
+    node_queues.init( allocator, 6 );
+    for ( u32 n = 0; n < 6; ++n ) {
+        sorted_nodes.push( n );
+        node_queues.push( ( n == 1 || n == 2 ) ? QueueType::Compute : QueueType::Graphics );
+    }
+
+    Array<FrameGraphSubmission> submissions;
+    submissions.init( allocator, 8 );
+    Array<u32> submission_nodes;
+    submission_nodes.init( allocator, 6 );
+    Array<u32> node_submissions;
+    node_submissions.init( allocator, 6 );
+    Array<FrameGraphQueueTransfer> transfers;
+    transfers.init( allocator, 8 );
+
+    frame_graph_schedule_queues( plan, sorted_nodes, node_queues, submissions, submission_nodes, node_submissions, transfers, allocator );
+
+    // Graphics 0, compute 1 waiting for it, graphics 2 with the shadows, graphics 3 waiting for the compute work.
+    RTEST_CHECK( submissions.size == 4 );
+    if ( submissions.size == 4 ) {
+        RTEST_CHECK( submissions[ 0 ].queue == QueueType::Graphics && submissions[ 0 ].wait_submission == u32_max && submissions[ 0 ].signal );
+        RTEST_CHECK( submissions[ 1 ].queue == QueueType::Compute && submissions[ 1 ].wait_submission == 0 && submissions[ 1 ].signal );
+        RTEST_CHECK( submissions[ 2 ].queue == QueueType::Graphics && submissions[ 2 ].wait_submission == u32_max && !submissions[ 2 ].signal );
+        RTEST_CHECK( submissions[ 3 ].queue == QueueType::Graphics && submissions[ 3 ].wait_submission == 1 && !submissions[ 3 ].signal );
+
+        RTEST_CHECK( node_submissions.size == 6 );
+        RTEST_CHECK( node_submissions[ 0 ] == 0 && node_submissions[ 1 ] == 1 && node_submissions[ 2 ] == 1 );
+        RTEST_CHECK( node_submissions[ 3 ] == 2 && node_submissions[ 4 ] == 3 && node_submissions[ 5 ] == 3 );
+
+        // The independent branch joins the compute submission, the shadows overlap it on the graphics queue.
+        RTEST_CHECK( submissions[ 1 ].node_count == 2 && submission_nodes[ submissions[ 1 ].first_node ] == 1 );
+        RTEST_CHECK( submissions[ 2 ].node_count == 1 && submission_nodes[ submissions[ 2 ].first_node ] == 3 );
+        RTEST_CHECK( submissions[ 2 ].wait_submission == u32_max && submissions[ 1 ].wait_submission < 2 && submissions[ 3 ].wait_submission >= 1 );
+    }
+
+    // Each resource used by both queues goes to compute and back, the first release is in the previous frame.
+    RTEST_CHECK( transfers.size == 6 );
+    RTEST_CHECK( has_queue_transfer( transfers, 0, 0, 1, QueueType::Graphics ) );
+    RTEST_CHECK( has_queue_transfer( transfers, 0, 1, 4, QueueType::Compute ) );
+    RTEST_CHECK( has_queue_transfer( transfers, 2, 4, 1, QueueType::Graphics ) );
+    RTEST_CHECK( has_queue_transfer( transfers, 2, 1, 4, QueueType::Compute ) );
+    RTEST_CHECK( has_queue_transfer( transfers, 4, 4, 2, QueueType::Graphics ) );
+    RTEST_CHECK( has_queue_transfer( transfers, 4, 2, 4, QueueType::Compute ) );
+
+    // Releases in the same frame are ordered before their acquire by a semaphore: the acquiring submission waits for
+    // the releasing one, or a later one of the same queue, which signals.
+    for ( u32 t = 0; t < transfers.size && node_submissions.size == 6; ++t ) {
+        const FrameGraphQueueTransfer& transfer = transfers[ t ];
+        RTEST_CHECK( node_queues[ transfer.release_node ] == transfer.source_queue && node_queues[ transfer.acquire_node ] == transfer.destination_queue );
+
+        if ( transfer.release_node < transfer.acquire_node ) {
+            const u32 release_submission = node_submissions[ transfer.release_node ];
+            const u32 wait_submission = submissions[ node_submissions[ transfer.acquire_node ] ].wait_submission;
+            RTEST_CHECK( wait_submission != u32_max && wait_submission >= release_submission && submissions[ wait_submission ].signal );
+            RTEST_CHECK( wait_submission < submissions.size && submissions[ wait_submission ].queue == transfer.source_queue );
+        }
+    }
+
+    // Without async compute everything is one graphics submission.
+    for ( u32 n = 0; n < 6; ++n ) {
+        node_queues[ n ] = QueueType::Graphics;
+    }
+
+    frame_graph_schedule_queues( plan, sorted_nodes, node_queues, submissions, submission_nodes, node_submissions, transfers, allocator );
+    RTEST_CHECK( submissions.size == 1 && submissions[ 0 ].node_count == 6 && !submissions[ 0 ].signal );
+    RTEST_CHECK( transfers.size == 0 );
+
+    transfers.shutdown();
+    node_submissions.shutdown();
+    submission_nodes.shutdown();
+    submissions.shutdown();
+    node_queues.shutdown();
+    sorted_nodes.shutdown();
+    plan.shutdown();
+}
+
+int main( int argc, char** argv ) {
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    test_chain_added_backwards( allocator );
+    test_culling( allocator );
+    test_load_and_reference( allocator );
+    test_random_graphs( allocator );
+    test_barriers_against_node_transitions( allocator );
+    test_buffer_read_barriers( allocator );
+    test_split_barriers( allocator );
+    test_final_output_lifetime( allocator );
+    test_placement_keeps_final_outputs( allocator );
+    test_async_compute_schedule( allocator );
+
+    MemoryService::instance()->shutdown();
+
+    return test::result( "frame_graph_plan_test" );
+}
@@ -0,0 +1,289 @@
+// Encodes a made up glTF buffer in a geometry sidecar and decodes it back: vertex, index and raw regions, the gaps
+// between buffer views, stale and truncated sidecars, corrupted regions and the fallback to the source buffer.
+
+#include "graphics/geometry_codec.hpp"
+
+#include "foundation/file.hpp"
+#include "foundation/gltf.hpp"
+#include "foundation/memory.hpp"
+
+#include "tests/test.hpp"
+
+#include <string.h>
+
+using namespace raptor;
+
+static cstring          k_source_path       = "geometry_codec_test.bin";
+static cstring          k_sidecar_path      = "geometry_codec_test.bin.meshopt";
+static const u64        k_write_time        = 1234;
+
+// Vertices, then two index regions, then raw bytes no accessor reads, with gaps between and after the views.
+static const u32        k_vertex_count      = 100;
+static const u32        k_index_count       = 3 * 20000;
+static const u32        k_raw_size          = 37;
+static const u32        k_vertices_offset   = 0;
+static const u32        k_indices_offset    = k_vertices_offset + k_vertex_count * 12 + 16;
+static const u32        k_raw_offset        = k_indices_offset + k_index_count * 2 + 8;
+static const u32        k_buffer_size       = k_raw_offset + k_raw_size + 11;
+
+//
+//
+struct TestScene {
+
+    void                init();
+
+    glTF::glTF          gltf;
+    glTF::Buffer        buffer;
+    glTF::BufferView    buffer_views[ 3 ];
+    glTF::Accessor      accessors[ 2 ];
+    glTF::Mesh          mesh;
+    glTF::MeshPrimitive primitive;
+
+    u8                  data[ k_buffer_size ];
+
+}; // struct TestScene
+
+void TestScene::init() {
+    memset( ( void* )this, 0, sizeof( TestScene ) );
+
+    // The gaps hold bytes that the loader does not keep.
+    for ( u32 i = 0; i < k_buffer_size; ++i ) {
+        data[ i ] = ( u8 )( i * 7 + 3 );
+    }
+
+    f32* positions = ( f32* )( data + k_vertices_offset );
+    for ( u32 v = 0; v < k_vertex_count; ++v ) {
+        positions[ v * 3 + 0 ] = ( f32 )( v % 10 );
+        positions[ v * 3 + 1 ] = ( f32 )( v / 10 );
+        positions[ v * 3 + 2 ] = 0.5f * v;
+    }
+
+    u16* indices = ( u16* )( data + k_indices_offset );
+    for ( u32 i = 0; i < k_index_count; ++i ) {
+        indices[ i ] = ( u16 )( ( i / 3 + i % 3 ) % k_vertex_count );
+    }
+
+    buffer.byte_length = k_buffer_size;
+
+    buffer_views[ 0 ] = { 0, ( i32 )( k_vertex_count * 12 ), ( i32 )k_vertices_offset, glTF::INVALID_INT_VALUE, glTF::INVALID_INT_VALUE };
+    buffer_views[ 1 ] = { 0, ( i32 )( k_index_count * 2 ), ( i32 )k_indices_offset, glTF::INVALID_INT_VALUE, glTF::INVALID_INT_VALUE };
+    buffer_views[ 2 ] = { 0, ( i32 )k_raw_size, ( i32 )k_raw_offset, glTF::INVALID_INT_VALUE, glTF::INVALID_INT_VALUE };
+
+    accessors[ 0 ].buffer_view = 0;
+    accessors[ 0 ].byte_offset = glTF::INVALID_INT_VALUE;
+    accessors[ 0 ].component_type = glTF::Accessor::FLOAT;
+    accessors[ 0 ].count = k_vertex_count;
+    accessors[ 0 ].type = glTF::Accessor::Vec3;
+
+    accessors[ 1 ].buffer_view = 1;
+    accessors[ 1 ].byte_offset = glTF::INVALID_INT_VALUE;
+    accessors[ 1 ].component_type = glTF::Accessor::UNSIGNED_SHORT;
+    accessors[ 1 ].count = k_index_count;
+    accessors[ 1 ].type = glTF::Accessor::Scalar;
+
+    primitive.indices = 1;
+    primitive.mode = glTF::INVALID_INT_VALUE;
+    mesh.primitives_count = 1;
+    mesh.primitives = &primitive;
+
+    gltf.buffers_count = 1;
+    gltf.buffers = &buffer;
+    gltf.buffer_views_count = ArraySize( buffer_views );
+    gltf.buffer_views = buffer_views;
+    gltf.accessors_count = ArraySize( accessors );
+    gltf.accessors = accessors;
+    gltf.meshes_count = 1;
+    gltf.meshes = &mesh;
+}
+
+static bool is_gap( u32 offset ) {
+    return ( offset >= k_vertices_offset + k_vertex_count * 12 && offset < k_indices_offset ) ||
+           ( offset >= k_indices_offset + k_index_count * 2 && offset < k_raw_offset ) || offset >= k_raw_offset + k_raw_size;
+}
+
+static void write_file( cstring path, const u8* data, sizet size ) {
+    FileHandle file;
+    file_open( path, "wb", &file );
+    RTEST_CHECK( file != nullptr );
+    if ( file ) {
+        file_write( ( u8* )data, 1, ( u32 )size, file );
+        file_close( file );
+    }
+}
+
+// Decodes all the regions like the loader does, returns false when one fails.
+static bool decode_sidecar( const u8* sidecar_data, const GeometryCodecRegion* regions, u32 region_count, u8* buffer_data ) {
+    memset( buffer_data, 0xcd, k_buffer_size );
+    geometry_codec_clear_gaps( regions, region_count, k_buffer_size, buffer_data );
+
+    bool decoded = true;
+    for ( u32 r = 0; r < region_count; ++r ) {
+        decoded = geometry_codec_decode_region( sidecar_data, regions[ r ], buffer_data ) && decoded;
+    }
+    return decoded;
+}
+
+static void test_round_trip( const TestScene& scene, const u8* sidecar_data, sizet sidecar_size, u8* buffer_data ) {
+    u32 region_count = 0;
+    const GeometryCodecRegion* regions = geometry_codec_get_regions( sidecar_data, sidecar_size, k_buffer_size, k_write_time, region_count );
+    RTEST_CHECK( regions != nullptr );
+    if ( regions == nullptr ) {
+        return;
+    }
+
+    // The index view is split in two regions, the raw view is copied.
+    RTEST_CHECK( region_count == 4 );
+    RTEST_CHECK( regions[ 0 ].mode == GeometryCodecMode::Vertex && regions[ 0 ].element_size == 12 );
+    RTEST_CHECK( regions[ 1 ].mode == GeometryCodecMode::Index && regions[ 2 ].mode == GeometryCodecMode::Index );
+    RTEST_CHECK( regions[ 1 ].element_count + regions[ 2 ].element_count == k_index_count );
+    RTEST_CHECK( regions[ 3 ].mode == GeometryCodecMode::Raw && regions[ 3 ].byte_length == k_raw_size );
+    for ( u32 r = 1; r < region_count; ++r ) {
+        RTEST_CHECK( regions[ r ].byte_offset >= regions[ r - 1 ].byte_offset + regions[ r - 1 ].byte_length );
+    }
+
+    // Encoded geometry is smaller than the buffer.
+    RTEST_CHECK( sidecar_size < k_buffer_size );
+
+    RTEST_CHECK( decode_sidecar( sidecar_data, regions, region_count, buffer_data ) );
+
+    // The index codec can rotate the vertices of a triangle, keeping its winding.
+    u32 mismatches = 0;
+    for ( u32 i = 0; i < k_buffer_size; ++i ) {
+        const bool index = i >= k_indices_offset && i < k_indices_offset + k_index_count * 2;
+        mismatches += !index && buffer_data[ i ] != ( is_gap( i ) ? 0 : scene.data[ i ] ) ? 1 : 0;
+    }
+    RTEST_CHECK( mismatches == 0 );
+
+    const u16* source_indices = ( const u16* )( scene.data + k_indices_offset );
+    const u16* decoded_indices = ( const u16* )( buffer_data + k_indices_offset );
+    u32 triangle_mismatches = 0;
+    for ( u32 t = 0; t < k_index_count; t += 3 ) {
+        bool same = false;
+        for ( u32 rotation = 0; rotation < 3; ++rotation ) {
+            same = same || ( decoded_indices[ t ] == source_indices[ t + rotation ] && decoded_indices[ t + 1 ] == source_indices[ t + ( rotation + 1 ) % 3 ] &&
+                             decoded_indices[ t + 2 ] == source_indices[ t + ( rotation + 2 ) % 3 ] );
+        }
+        triangle_mismatches += same ? 0 : 1;
+    }
+    RTEST_CHECK( triangle_mismatches == 0 );
+}
+
+static void test_stale_and_truncated( const u8* sidecar_data, sizet sidecar_size ) {
+    u32 region_count = 0;
+
+    // Written for another version of the buffer.
+    RTEST_CHECK( geometry_codec_get_regions( sidecar_data, sidecar_size, k_buffer_size, k_write_time + 1, region_count ) == nullptr );
+    RTEST_CHECK( region_count == 0 );
+    RTEST_CHECK( geometry_codec_get_regions( sidecar_data, sidecar_size, k_buffer_size + 4, k_write_time, region_count ) == nullptr );
+
+    // Truncated in the header, in the regions and in the encoded data.
+    const GeometryCodecHeader* header = ( const GeometryCodecHeader* )sidecar_data;
+    const sizet regions_end = sizeof( GeometryCodecHeader ) + header->region_count * sizeof( GeometryCodecRegion );
+    RTEST_CHECK( geometry_codec_get_regions( sidecar_data, sizeof( GeometryCodecHeader ) - 1, k_buffer_size, k_write_time, region_count ) == nullptr );
+    RTEST_CHECK( geometry_codec_get_regions( sidecar_data, regions_end - 1, k_buffer_size, k_write_time, region_count ) == nullptr );
+    RTEST_CHECK( geometry_codec_get_regions( sidecar_data, sidecar_size - 1, k_buffer_size, k_write_time, region_count ) == nullptr );
+    RTEST_CHECK( geometry_codec_get_regions( nullptr, 0, k_buffer_size, k_write_time, region_count ) == nullptr );
+
+    // Another file.
+    u8 other[ sizeof( GeometryCodecHeader ) ];
+    memcpy( other, sidecar_data, sizeof( other ) );
+    other[ 0 ] ^= 0xff;
+    RTEST_CHECK( geometry_codec_get_regions( other, sizeof( other ), k_buffer_size, k_write_time, region_count ) == nullptr );
+}
+
+// A sidecar that passes the header checks but does not decode: the loader reads the source buffer instead.
+static void test_corrupted_fallback( const TestScene& scene, const u8* sidecar_data, sizet sidecar_size, u8* buffer_data, Allocator* allocator ) {
+    u8* corrupted = ( u8* )ralloca( sidecar_size, allocator );
+    memcpy( corrupted, sidecar_data, sidecar_size );
+
+    u32 region_count = 0;
+    const GeometryCodecRegion* regions = geometry_codec_get_regions( corrupted, sidecar_size, k_buffer_size, k_write_time, region_count );
+    RTEST_CHECK( regions != nullptr );
+    if ( regions == nullptr ) {
+        rfree( corrupted, allocator );
+        return;
+    }
+
+    // Bad codec headers of the vertex and of an index region, and a raw region of the wrong size.
+    corrupted[ regions[ 0 ].data_offset ] = 0;
+    RTEST_CHECK( !decode_sidecar( corrupted, regions, region_count, buffer_data ) );
+    corrupted[ regions[ 0 ].data_offset ] = sidecar_data[ regions[ 0 ].data_offset ];
+
+    corrupted[ regions[ 2 ].data_offset ] = 0;
+    RTEST_CHECK( !decode_sidecar( corrupted, regions, region_count, buffer_data ) );
+    corrupted[ regions[ 2 ].data_offset ] = sidecar_data[ regions[ 2 ].data_offset ];
+
+    GeometryCodecRegion raw_region = regions[ 3 ];
+    raw_region.data_size -= 1;
+    RTEST_CHECK( !geometry_codec_decode_region( corrupted, raw_region, buffer_data ) );
+
+    RTEST_CHECK( decode_sidecar( corrupted, regions, region_count, buffer_data ) );
+
+    // The source buffer replaces all of the decoded data, gaps included.
+    write_file( k_source_path, scene.data, k_buffer_size );
+    memset( buffer_data, 0xcd, k_buffer_size );
+    RTEST_CHECK( geometry_codec_read_source( k_source_path, k_buffer_size, buffer_data, allocator ) );
+    RTEST_CHECK( memcmp( buffer_data, scene.data, k_buffer_size ) == 0 );
+
+    // A short or missing source file leaves zeroes, nothing past the end of the file is read.
+    write_file( k_source_path, scene.data, k_buffer_size / 2 );
+    memset( buffer_data, 0xcd, k_buffer_size );
+    RTEST_CHECK( !geometry_codec_read_source( k_source_path, k_buffer_size, buffer_data, allocator ) );
+
+    u32 non_zero = 0;
+    for ( u32 i = 0; i < k_buffer_size; ++i ) {
+        non_zero += buffer_data[ i ] != 0 ? 1 : 0;
+    }
+    RTEST_CHECK( non_zero == 0 );
+
+    file_delete( k_source_path );
+    buffer_data[ 0 ] = 0xcd;
+    RTEST_CHECK( !geometry_codec_read_source( k_source_path, k_buffer_size, buffer_data, allocator ) );
+    RTEST_CHECK( buffer_data[ 0 ] == 0 );
+
+    rfree( corrupted, allocator );
+}
+
+// Views sharing bytes cannot be decoded concurrently, no sidecar is written for them.
+static void test_overlapping_views( TestScene& scene, Allocator* allocator ) {
+    scene.buffer_views[ 2 ].byte_offset = k_indices_offset + 4;
+    RTEST_CHECK( geometry_codec_write_sidecar( scene.gltf, 0, scene.data, k_write_time, k_sidecar_path, allocator ) == 0 );
+    scene.buffer_views[ 2 ].byte_offset = k_raw_offset;
+}
+
+int main( int argc, char** argv ) {
+
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    TestScene* scene = ( TestScene* )ralloca( sizeof( TestScene ), allocator );
+    scene->init();
+
+    u8* buffer_data = ( u8* )ralloca( k_buffer_size, allocator );
+
+    const sizet written_size = geometry_codec_write_sidecar( scene->gltf, 0, scene->data, k_write_time, k_sidecar_path, allocator );
+    RTEST_CHECK( written_size > 0 );
+
+    FileSpan sidecar = file_map( k_sidecar_path, allocator );
+    RTEST_CHECK( sidecar.data != nullptr && sidecar.size == written_size );
+
+    if ( sidecar.data != nullptr ) {
+        test_round_trip( *scene, sidecar.data, sidecar.size, buffer_data );
+        test_stale_and_truncated( sidecar.data, sidecar.size );
+        test_corrupted_fallback( *scene, sidecar.data, sidecar.size, buffer_data, allocator );
+    }
+
+    file_unmap( sidecar );
+    file_delete( k_sidecar_path );
+
+    test_overlapping_views( *scene, allocator );
+    file_delete( k_sidecar_path );
+
+    rfree( buffer_data, allocator );
+    rfree( scene, allocator );
+
+    MemoryService::instance()->shutdown();
+
+    return test::result( "geometry_codec_test" );
+}
@@ -0,0 +1,372 @@
+// Drives the staging ring with a fake completion source in place of the transfer timeline:
+// wraparound, release in allocation order, a full ring, pending regions and the loader recording order.
+
+#include "graphics/staging_ring.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#include "tests/test.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+//
+// Stands for the transfer queue: each submit signals the next value, completed later in order.
+struct FakeTimeline {
+
+    u64                 submit()                { return ++submitted_value; }
+    void                complete( u64 value )   { completed_value = value; }
+
+    u64                 submitted_value     = 0;
+    u64                 completed_value     = 0;
+
+}; // struct FakeTimeline
+
+static const sizet      k_capacity          = 1024;
+static const sizet      k_alignment         = 16;
+
+static void test_alignment_and_full_ring( Allocator* allocator ) {
+    StagingRing ring;
+    ring.init( allocator, k_capacity, k_alignment );
+    FakeTimeline timeline;
+
+    RTEST_CHECK( ring.get_max_allocation_size() == k_capacity );
+
+    // Sizes are aligned up.
+    sizet offset = 0;
+    RTEST_CHECK( ring.allocate( 1, timeline.submit(), offset ) && offset == 0 );
+    RTEST_CHECK( ring.allocate( 17, timeline.submit(), offset ) && offset == 16 );
+    RTEST_CHECK( ring.used_size == 48 );
+
+    // Fill the rest exactly: nothing fits anymore, not even the smallest allocation.
+    RTEST_CHECK( ring.allocate( k_capacity - 48, timeline.submit(), offset ) && offset == 48 );
+    RTEST_CHECK( ring.used_size == k_capacity );
+    RTEST_CHECK( ring.get_max_allocation_size() == 0 );
+    RTEST_CHECK( !ring.allocate( 1, timeline.submit(), offset ) );
+
+    // Bigger than the whole ring or empty never fits.
+    ring.release( timeline.submitted_value );
+    RTEST_CHECK( ring.used_size == 0 );
+    RTEST_CHECK( !ring.allocate( k_capacity + 1, 0, offset ) );
+    RTEST_CHECK( !ring.allocate( 0, 0, offset ) );
+
+    ring.shutdown();
+}
+
+static void test_wraparound( Allocator* allocator ) {
+    StagingRing ring;
+    ring.init( allocator, k_capacity, k_alignment );
+    FakeTimeline timeline;
+
+    sizet offset_a = 0, offset_b = 0, offset_c = 0, offset_d = 0;
+    const u64 value_a = timeline.submit();
+    const u64 value_b = timeline.submit();
+    const u64 value_c = timeline.submit();
+    RTEST_CHECK( ring.allocate( 400, value_a, offset_a ) && offset_a == 0 );
+    RTEST_CHECK( ring.allocate( 400, value_b, offset_b ) && offset_b == 400 );
+
+    // 224 bytes left at the end, [0, 400) is still in use.
+    RTEST_CHECK( ring.get_max_allocation_size() == k_capacity - 800 );
+    RTEST_CHECK( !ring.allocate( 256, value_c, offset_c ) );
+
+    // Once a is released, 256 bytes wrap around to the start and the end of the buffer is padding.
+    timeline.complete( value_a );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.get_max_allocation_size() == 400 );
+    RTEST_CHECK( ring.allocate( 256, value_c, offset_c ) && offset_c == 0 );
+    RTEST_CHECK( ring.used_size == 400 + ( k_capacity - 800 ) + 256 );
+
+    // Free space is now between the head and b.
+    RTEST_CHECK( ring.get_max_allocation_size() == 400 - 256 );
+    RTEST_CHECK( !ring.allocate( 400 - 256 + 16, timeline.submit(), offset_d ) );
+    RTEST_CHECK( ring.allocate( 400 - 256, timeline.submitted_value, offset_d ) && offset_d == 256 );
+    RTEST_CHECK( ring.get_max_allocation_size() == 0 );
+
+    // Releasing b also releases the padding reserved with c.
+    timeline.complete( value_b );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.used_size == ( k_capacity - 800 ) + 256 + 144 );
+    // Free space is between d and the padding before c.
+    RTEST_CHECK( ring.get_max_allocation_size() == 800 - 400 );
+
+    timeline.complete( timeline.submitted_value );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.used_size == 0 );
+    RTEST_CHECK( ring.regions.size == 0 );
+
+    ring.shutdown();
+}
+
+static void test_in_order_release( Allocator* allocator ) {
+    StagingRing ring;
+    ring.init( allocator, k_capacity, k_alignment );
+
+    // The first region waits for a later value than the second one: it holds it.
+    sizet offset = 0;
+    RTEST_CHECK( ring.allocate( 256, 2, offset ) );
+    RTEST_CHECK( ring.allocate( 256, 1, offset ) );
+
+    ring.release( 1 );
+    RTEST_CHECK( ring.used_size == 512 );
+    RTEST_CHECK( ring.tail == 0 );
+
+    ring.release( 2 );
+    RTEST_CHECK( ring.used_size == 0 );
+
+    // Pending regions hold the following ones until their completion value is set and reached.
+    sizet pending_offset = 0;
+    RTEST_CHECK( ring.allocate( 128, 3, offset ) );
+    RTEST_CHECK( ring.allocate( 128, k_staging_ring_pending, pending_offset ) );
+    RTEST_CHECK( ring.allocate( 128, 3, offset ) );
+
+    ring.release( 3 );
+    RTEST_CHECK( ring.used_size == 256 );
+    RTEST_CHECK( ring.tail == pending_offset );
+
+    ring.set_completion_value( pending_offset, 4 );
+    ring.release( 3 );
+    RTEST_CHECK( ring.used_size == 256 );
+    ring.release( 4 );
+    RTEST_CHECK( ring.used_size == 0 );
+
+    ring.shutdown();
+}
+
+// Random sizes and completion delays: live regions never overlap, allocate agrees with the maximum
+// allocation size, and used_size matches the live regions.
+static void test_random_traffic( Allocator* allocator ) {
+    StagingRing ring;
+    ring.init( allocator, k_capacity, k_alignment );
+    FakeTimeline timeline;
+
+    // Owner value of each byte, 0 when free.
+    u64 owners[ k_capacity ];
+    memset( owners, 0, sizeof( owners ) );
+
+    srand( 1234 );
+
+    u32 allocations_count = 0;
+    u32 wrapped_count = 0;
+    sizet previous_offset = 0;
+
+    for ( u32 step = 0; step < 20000; ++step ) {
+        if ( rand() % 3 == 0 && timeline.completed_value < timeline.submitted_value ) {
+            // Complete a few submits, always in order like a queue.
+            const u64 completed = timeline.completed_value + 1 + rand() % 3;
+            timeline.complete( completed < timeline.submitted_value ? completed : timeline.submitted_value );
+            ring.release( timeline.completed_value );
+
+            for ( sizet b = 0; b < k_capacity; ++b ) {
+                if ( owners[ b ] != 0 && owners[ b ] <= timeline.completed_value ) {
+                    owners[ b ] = 0;
+                }
+            }
+            continue;
+        }
+
+        const sizet size = 1 + rand() % 300;
+        const sizet aligned_size = memory_align( size, k_alignment );
+        const sizet max_size = ring.get_max_allocation_size();
+
+        sizet offset = 0;
+        const u64 value = timeline.submitted_value + 1;
+        const bool allocated = ring.allocate( size, value, offset );
+        RTEST_CHECK( allocated == ( aligned_size <= max_size ) );
+        if ( !allocated ) {
+            continue;
+        }
+        timeline.submit();
+        ++allocations_count;
+
+        RTEST_CHECK( ( offset % k_alignment ) == 0 );
+        RTEST_CHECK( offset + aligned_size <= k_capacity );
+        if ( offset < previous_offset ) {
+            ++wrapped_count;
+        }
+        previous_offset = offset;
+
+        bool overlaps = false;
+        for ( sizet b = offset; b < offset + aligned_size; ++b ) {
+            overlaps |= owners[ b ] != 0;
+            owners[ b ] = value;
+        }
+        RTEST_CHECK( !overlaps );
+
+        sizet live_size = 0;
+        for ( u32 r = ring.first_region; r < ring.regions.size; ++r ) {
+            live_size += ring.regions[ r ].size;
+        }
+        RTEST_CHECK( live_size == ring.used_size );
+        RTEST_CHECK( ring.used_size <= k_capacity );
+    }
+
+    RTEST_CHECK( allocations_count > 1000 );
+    RTEST_CHECK( wrapped_count > 100 );
+
+    timeline.complete( timeline.submitted_value );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.used_size == 0 );
+
+    ring.shutdown();
+}
+
+//
+// Upload request of the loader: decoded in a pending staging region, or on the heap and copied in chunks.
+struct FakeUpload {
+
+    bool                staged          = false;
+    sizet               staging_offset  = 0;
+    sizet               size            = 0;
+    sizet               uploaded        = 0;
+    u64                 completion_value = 0;
+
+}; // struct FakeUpload
+
+//
+// Records like the loader does, without a command buffer.
+struct FakeUploadRecorder {
+
+    bool                holds_staging( const FakeUpload& upload ) const { return upload.staged; }
+
+    bool                record( FakeUpload& upload ) {
+        if ( upload.staged ) {
+            ring->set_completion_value( upload.staging_offset, completion_value );
+            upload.uploaded = upload.size;
+        }
+
+        while ( upload.uploaded < upload.size ) {
+            const sizet chunk_size = raptor::min( upload.size - upload.uploaded, ring->get_max_allocation_size() );
+            if ( chunk_size == 0 ) {
+                return false;
+            }
+
+            sizet offset = 0;
+            RTEST_CHECK( ring->allocate( chunk_size, completion_value, offset ) );
+            upload.uploaded += chunk_size;
+            recorded = true;
+        }
+
+        upload.completion_value = completion_value;
+        recorded = true;
+        ++recorded_count;
+        return true;
+    }
+
+    StagingRing*        ring            = nullptr;
+    u64                 completion_value = 0;
+    bool                recorded        = false;
+    u32                 recorded_count  = 0;
+
+}; // struct FakeUploadRecorder
+
+// One loader update: release what the transfers read, record the queue and submit if anything was recorded.
+static u32 record_fake_uploads( StagingRing& ring, FakeTimeline& timeline, Array<FakeUpload>& uploads ) {
+    ring.release( timeline.completed_value );
+
+    FakeUploadRecorder recorder;
+    recorder.ring = &ring;
+    recorder.completion_value = timeline.submitted_value + 1;
+    staging_ring_record_requests( uploads, recorder );
+
+    if ( recorder.recorded ) {
+        timeline.submit();
+    }
+    return recorder.recorded_count;
+}
+
+// A heap decoded image bigger than the ring is copied in chunks while an image decoded in a pending region waits
+// behind it in the queue. The chunks fill the ring up to the pending region, which is released only in order:
+// the staged upload must still be recorded, otherwise neither request ever completes.
+static void test_chunked_upload_behind_pending_region( Allocator* allocator ) {
+    StagingRing ring;
+    ring.init( allocator, k_capacity, k_alignment );
+    FakeTimeline timeline;
+
+    Array<FakeUpload> uploads;
+    uploads.init( allocator, 8 );
+
+    // A decode reserved its region before the chunked request was queued.
+    FakeUpload staged_upload;
+    staged_upload.staged = true;
+    staged_upload.size = 256;
+    RTEST_CHECK( ring.allocate( staged_upload.size, k_staging_ring_pending, staged_upload.staging_offset ) );
+
+    FakeUpload chunked_upload;
+    chunked_upload.size = 4 * k_capacity;
+    uploads.push( chunked_upload );
+    uploads.push( staged_upload );
+
+    // The first update fills the rest of the ring with a chunk, and records the staged upload behind it.
+    RTEST_CHECK( record_fake_uploads( ring, timeline, uploads ) == 1 );
+    RTEST_CHECK( uploads.size == 1 && !uploads[ 0 ].staged );
+    RTEST_CHECK( uploads[ 0 ].uploaded == k_capacity - staged_upload.size );
+    RTEST_CHECK( ring.get_max_allocation_size() == 0 );
+
+    // Transfers complete one update later: the chunked request progresses until it is done.
+    u32 updates = 0;
+    while ( uploads.size && updates < 16 ) {
+        timeline.complete( timeline.submitted_value );
+        record_fake_uploads( ring, timeline, uploads );
+        ++updates;
+    }
+    RTEST_CHECK( uploads.size == 0 );
+    RTEST_CHECK( updates <= 5 );
+
+    timeline.complete( timeline.submitted_value );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.used_size == 0 );
+
+    // Random mix of both kinds of uploads, with new reservations made while chunks are waiting.
+    srand( 4321 );
+
+    u32 queued_count = 0;
+    u32 completed_count = 0;
+    for ( u32 step = 0; step < 2000; ++step ) {
+        const bool staged = rand() % 2 == 0;
+
+        FakeUpload upload;
+        upload.staged = staged;
+        upload.size = staged ? memory_align( 16 + rand() % 400, k_alignment ) : 16 + rand() % ( 3 * k_capacity );
+        if ( !staged || ring.allocate( upload.size, k_staging_ring_pending, upload.staging_offset ) ) {
+            uploads.push( upload );
+            ++queued_count;
+        }
+
+        timeline.complete( timeline.submitted_value );
+        completed_count += record_fake_uploads( ring, timeline, uploads );
+    }
+
+    for ( u32 update = 0; update < 64 && uploads.size; ++update ) {
+        timeline.complete( timeline.submitted_value );
+        completed_count += record_fake_uploads( ring, timeline, uploads );
+    }
+    RTEST_CHECK( uploads.size == 0 );
+    RTEST_CHECK( completed_count == queued_count );
+
+    timeline.complete( timeline.submitted_value );
+    ring.release( timeline.completed_value );
+    RTEST_CHECK( ring.used_size == 0 );
+
+    uploads.shutdown();
+    ring.shutdown();
+}
+
+int main( int argc, char** argv ) {
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    test_alignment_and_full_ring( allocator );
+    test_wraparound( allocator );
+    test_in_order_release( allocator );
+    test_random_traffic( allocator );
+    test_chunked_upload_behind_pending_region( allocator );
+
+    MemoryService::instance()->shutdown();
+
+    return test::result( "staging_ring_test" );
+}
@@ -0,0 +1,333 @@
+// Drives the texture residency like the streamer does, without a gpu: binds from the tail to the requested mip,
+// streaming once binds complete, eviction of the least recently used mips within the budget and delayed page reuse.
+
+#include "graphics/texture_residency.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/memory.hpp"
+
+#include "tests/test.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+// 1024x1024 textures in 128x128 pages: mips 0 to 3 have 64, 16, 4 and 1 pages, mips 4 and below are a 1 page tail.
+static const u32        k_texture_size          = 1024;
+static const u32        k_page_texels           = 128;
+static const u32        k_mip_count             = 11;
+static const u32        k_mip_tail_first        = 4;
+static const u32        k_mip_tail_page_count   = 1;
+static const u32        k_texture_pages         = 64 + 16 + 4 + 1 + k_mip_tail_page_count;
+static const u32        k_latency_frames        = 2;
+
+static const u32 k_mip_pages[ k_mip_tail_first ] = { 64, 16, 4, 1 };
+
+//
+// Stands for the streamer: applies the updates of each frame, uploads complete the frame after their request.
+struct ResidencyHarness {
+
+    void                init( Allocator* allocator, u32 page_count ) {
+        residency.init( allocator, page_count, 65536, k_latency_frames );
+        updates.init( allocator, 64 );
+        streams.init( allocator, 16 );
+        memset( binds, 0, sizeof( binds ) );
+        memset( unbinds, 0, sizeof( unbinds ) );
+    }
+
+    void                shutdown() {
+        streams.shutdown();
+        updates.shutdown();
+        residency.shutdown();
+    }
+
+    void                add_texture( u32 texture ) {
+        RTEST_CHECK( residency.add_texture( texture, k_texture_size, k_texture_size, k_mip_count, k_mip_tail_first, k_mip_tail_page_count,
+                                            k_page_texels, k_page_texels ) );
+    }
+
+    void                update() {
+        ++frame;
+
+        // Uploads requested in the previous frame are done.
+        for ( u32 s = 0; s < streams.size; ++s ) {
+            residency.on_mips_streamed( streams[ s ].texture, streams[ s ].mip );
+        }
+        streams.clear();
+
+        updates.clear();
+        residency.update( frame, updates );
+
+        bool bound = false;
+        for ( u32 u = 0; u < updates.size; ++u ) {
+            const TextureResidencyUpdate& update = updates[ u ];
+            switch ( update.action ) {
+                case TextureResidencyAction::Bind:
+                    ++binds[ update.texture ][ update.mip ];
+                    bound = true;
+                    break;
+                case TextureResidencyAction::Unbind:
+                    ++unbinds[ update.texture ][ update.mip ];
+                    break;
+                case TextureResidencyAction::Stream:
+                    // Streamed mips go from the first bound mip to the resident one.
+                    RTEST_CHECK( update.mip == residency.textures[ update.texture ].bound_mip );
+                    streams.push( update );
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Pages are bound only within the budget, including the ones not released yet. Mips being streamed and tails
+        // are not evicted, so a lowered budget can be exceeded until then.
+        RTEST_CHECK( !bound || residency.used_pages <= residency.budget_pages );
+        check_pages();
+    }
+
+    void                run( u32 frames ) {
+        for ( u32 f = 0; f < frames; ++f ) {
+            update();
+        }
+    }
+
+    // Every page is free, bound to exactly one texture page or waiting for its release.
+    void                check_pages() {
+        const u32 page_count = residency.page_count;
+        u32 owners[ 1024 ];
+        RTEST_CHECK( page_count <= ArraySize( owners ) );
+        memset( owners, 0, sizeof( owners ) );
+
+        for ( u32 p = 0; p < residency.free_pages.size; ++p ) {
+            ++owners[ residency.free_pages[ p ] ];
+        }
+        for ( u32 p = 0; p < residency.releasing_page_list.size; ++p ) {
+            ++owners[ residency.releasing_page_list[ p ] ];
+        }
+
+        u32 bound_pages = 0;
+        for ( u32 t = 0; t < residency.textures.size; ++t ) {
+            const ResidentTexture& texture = residency.textures[ t ];
+            if ( !texture.active ) {
+                continue;
+            }
+
+            const u32 table_size = texture.mip_page_offsets[ texture.mip_tail_first ] + texture.mip_tail_page_count;
+            for ( u32 p = 0; p < table_size; ++p ) {
+                if ( texture.page_table[ p ] != k_invalid_residency_page ) {
+                    ++owners[ texture.page_table[ p ] ];
+                    ++bound_pages;
+                }
+            }
+        }
+
+        bool single_owner = true;
+        for ( u32 p = 0; p < page_count; ++p ) {
+            single_owner = single_owner && owners[ p ] == 1;
+        }
+        RTEST_CHECK( single_owner );
+        RTEST_CHECK( residency.used_pages == bound_pages + residency.releasing_pages );
+        RTEST_CHECK( residency.releasing_pages == residency.releasing_page_list.size );
+    }
+
+    TextureResidency    residency;
+    Array<TextureResidencyUpdate> updates;
+    Array<TextureResidencyUpdate> streams;
+
+    u32                 binds[ 8 ][ k_mip_count ];
+    u32                 unbinds[ 8 ][ k_mip_count ];
+    u64                 frame               = 0;
+
+}; // struct ResidencyHarness
+
+static u32 get_chain_pages( u32 first_mip ) {
+    u32 pages = k_mip_tail_page_count;
+    for ( u32 mip = first_mip; mip < k_mip_tail_first; ++mip ) {
+        pages += k_mip_pages[ mip ];
+    }
+    return pages;
+}
+
+static void test_stream_to_requested_mip( Allocator* allocator ) {
+    ResidencyHarness harness;
+    harness.init( allocator, 256 );
+    TextureResidency& residency = harness.residency;
+
+    harness.add_texture( 0 );
+    RTEST_CHECK( residency.has_pending_requests() );
+
+    // The tail is bound first, streamed once its bind completed, then sampled.
+    harness.update();
+    RTEST_CHECK( harness.binds[ 0 ][ k_mip_tail_first ] == 1 );
+    RTEST_CHECK( residency.used_pages == k_mip_tail_page_count );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == k_mip_count );
+
+    harness.run( k_latency_frames + 1 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == k_mip_tail_first );
+    RTEST_CHECK( !residency.has_pending_requests() );
+
+    // Requesting mip 1 binds mips 3 to 1, in that order, and streams them together.
+    residency.request_mip( 0, 1, harness.frame + 1 );
+    RTEST_CHECK( residency.has_pending_requests() );
+    harness.update();
+    RTEST_CHECK( harness.binds[ 0 ][ 3 ] == 1 && harness.binds[ 0 ][ 2 ] == 1 && harness.binds[ 0 ][ 1 ] == 1 && harness.binds[ 0 ][ 0 ] == 0 );
+    RTEST_CHECK( residency.used_pages == get_chain_pages( 1 ) );
+
+    // Nothing is sampled from the new mips before the binds completed and the stream finished.
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == k_mip_tail_first );
+    harness.run( k_latency_frames + 1 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 1 );
+    RTEST_CHECK( !residency.has_pending_requests() );
+
+    // Requests past the last mip are clamped, and a coarser request evicts nothing while the budget holds.
+    residency.request_mip( 0, 100, harness.frame + 1 );
+    harness.run( 4 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 1 );
+    RTEST_CHECK( residency.used_pages == get_chain_pages( 1 ) );
+
+    harness.shutdown();
+}
+
+static void test_lru_eviction( Allocator* allocator ) {
+    // One full chain and the tail of a second texture.
+    ResidencyHarness harness;
+    harness.init( allocator, k_texture_pages + k_mip_tail_page_count );
+    TextureResidency& residency = harness.residency;
+
+    harness.add_texture( 0 );
+    harness.add_texture( 1 );
+    harness.run( k_latency_frames + 1 );
+
+    residency.request_mip( 0, 0, harness.frame + 1 );
+    harness.run( k_latency_frames + 2 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 0 );
+    RTEST_CHECK( residency.used_pages == residency.page_count );
+
+    // Texture 1 is used more recently: texture 0 loses its finest mip first. The pages are reused only once the
+    // unbind completed, so texture 1 waits for them.
+    residency.request_mip( 1, 2, harness.frame + 1 );
+    harness.update();
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 1 );
+    RTEST_CHECK( residency.releasing_pages == k_mip_pages[ 0 ] );
+    RTEST_CHECK( harness.unbinds[ 0 ][ 0 ] == 0 );
+    RTEST_CHECK( residency.textures[ 1 ].bound_mip == k_mip_tail_first );
+
+    harness.run( k_latency_frames - 1 );
+    RTEST_CHECK( harness.unbinds[ 0 ][ 0 ] == 0 );
+    RTEST_CHECK( residency.textures[ 1 ].bound_mip == k_mip_tail_first );
+
+    harness.update();
+    RTEST_CHECK( harness.unbinds[ 0 ][ 0 ] == 1 );
+    RTEST_CHECK( residency.textures[ 1 ].bound_mip == 2 );
+
+    harness.run( k_latency_frames + 1 );
+    RTEST_CHECK( residency.textures[ 1 ].resident_mip == 2 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 1 );
+
+    // A texture used in the same frame as the requester is not evicted for it: texture 1 gets mip 1 from the free
+    // pages, but not mip 0.
+    residency.request_mip( 0, 1, harness.frame + 1 );
+    residency.request_mip( 1, 0, harness.frame + 1 );
+    harness.run( k_latency_frames * 3 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == 1 );
+    RTEST_CHECK( residency.textures[ 1 ].resident_mip == 1 );
+    RTEST_CHECK( residency.has_pending_requests() );
+
+    // Once texture 0 is not requested anymore, its mips go.
+    residency.request_mip( 0, k_mip_tail_first, harness.frame + 1 );
+    residency.request_mip( 1, 0, harness.frame + 1 );
+    harness.run( k_latency_frames * 4 );
+    RTEST_CHECK( residency.textures[ 1 ].resident_mip == 0 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == k_mip_tail_first );
+
+    harness.shutdown();
+}
+
+static void test_budget_and_removal( Allocator* allocator ) {
+    ResidencyHarness harness;
+    harness.init( allocator, 256 );
+    TextureResidency& residency = harness.residency;
+
+    harness.add_texture( 0 );
+    harness.add_texture( 1 );
+    harness.run( k_latency_frames + 1 );
+    residency.request_mip( 0, 0, harness.frame + 1 );
+    residency.request_mip( 1, 1, harness.frame + 1 );
+    harness.run( k_latency_frames + 2 );
+    RTEST_CHECK( residency.used_pages == get_chain_pages( 0 ) + get_chain_pages( 1 ) );
+
+    // Lowering the budget evicts the finest mips, least recently used first, until what stays bound fits.
+    residency.request_mip( 1, 1, harness.frame + 1 );
+    residency.set_budget( get_chain_pages( 1 ) + get_chain_pages( 2 ) );
+    harness.update();
+    RTEST_CHECK( residency.used_pages - residency.releasing_pages <= residency.budget_pages );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip >= 1 );
+
+    // The tail never goes, the budget cannot hold a texture without room for it.
+    residency.set_budget( 0 );
+    harness.run( k_latency_frames + 1 );
+    RTEST_CHECK( residency.textures[ 0 ].resident_mip == k_mip_tail_first && residency.textures[ 1 ].resident_mip == k_mip_tail_first );
+    RTEST_CHECK( !residency.add_texture( 2, k_texture_size, k_texture_size, k_mip_count, k_mip_tail_first, k_mip_tail_page_count, k_page_texels, k_page_texels ) );
+
+    // Removed textures release their pages after the latency, without unbinds.
+    residency.set_budget( 256 );
+    const u32 unbinds_before = harness.unbinds[ 0 ][ k_mip_tail_first ];
+    residency.remove_texture( 0, harness.frame );
+    RTEST_CHECK( residency.releasing_pages == k_mip_tail_page_count );
+    harness.run( k_latency_frames + 1 );
+    RTEST_CHECK( residency.releasing_pages == 0 );
+    RTEST_CHECK( harness.unbinds[ 0 ][ k_mip_tail_first ] == unbinds_before );
+    // Texture 1 is still requested at mip 1 and binds it again.
+    RTEST_CHECK( residency.used_pages == get_chain_pages( 1 ) );
+
+    harness.shutdown();
+}
+
+// Random requests on a few textures with a tight budget: the page checks run after every update.
+static void test_random_requests( Allocator* allocator ) {
+    ResidencyHarness harness;
+    harness.init( allocator, 160 );
+    TextureResidency& residency = harness.residency;
+
+    for ( u32 t = 0; t < 6; ++t ) {
+        harness.add_texture( t );
+    }
+
+    srand( 99 );
+    for ( u32 f = 0; f < 2000; ++f ) {
+        const u32 request_count = rand() % 3;
+        for ( u32 r = 0; r < request_count; ++r ) {
+            residency.request_mip( rand() % 6, rand() % k_mip_count, harness.frame + 1 );
+        }
+        if ( rand() % 200 == 0 ) {
+            residency.set_budget( 40 + rand() % 121 );
+        }
+        harness.update();
+    }
+
+    // Without requests everything settles.
+    residency.set_budget( 160 );
+    for ( u32 t = 0; t < 6; ++t ) {
+        residency.request_mip( t, k_mip_tail_first, harness.frame + 1 );
+    }
+    harness.run( k_latency_frames * 4 );
+    RTEST_CHECK( !residency.has_pending_requests() );
+
+    harness.shutdown();
+}
+
+int main( int argc, char** argv ) {
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    test_stream_to_requested_mip( allocator );
+    test_lru_eviction( allocator );
+    test_budget_and_removal( allocator );
+    test_random_requests( allocator );
+
+    MemoryService::instance()->shutdown();
+
+    return test::result( "texture_residency_test" );
+}
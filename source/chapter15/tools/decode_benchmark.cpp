@@ -0,0 +1,327 @@
+// Decodes all the images of a directory like the asynchronous loader does, and compares the throughput of:
+// - serial: one image after the other on a single thread, copied to staging memory, as the loader thread did,
+// - task sets: one task set per image, at most 16 in flight, decoded on the heap then copied to staging memory,
+// - in place: the same task sets, decoded straight into their staging memory through the image_decode hooks.
+
+#include "graphics/image_decode.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/file.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+#include "foundation/string.hpp"
+#include "foundation/time.hpp"
+
+#include "external/enkiTS/TaskScheduler.h"
+
+// Same allocation hooks as the renderer build of stb_image.
+#define STBI_MALLOC( size )                                 raptor::image_decode_malloc( size )
+#define STBI_REALLOC_SIZED( pointer, old_size, new_size )   raptor::image_decode_realloc( pointer, old_size, new_size )
+#define STBI_FREE( pointer )                                raptor::image_decode_free( pointer )
+#define STB_IMAGE_IMPLEMENTATION
+#include "external/stb_image.h"
+
+#if defined(_WIN64)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+// Decode task sets of the asynchronous loader.
+static const u32            k_max_decode_tasks      = 16;
+static const sizet          k_staging_alignment     = 16;
+
+//
+//
+struct BenchmarkResult {
+    cstring                 name;
+    u32                     image_count;
+    u32                     failed_count;
+    u32                     in_place_count;
+    sizet                   file_size;
+    sizet                   decoded_size;
+    f64                     seconds;
+}; // struct BenchmarkResult
+
+//
+// Same work as the loader TextureDecodeTask: map the file, decode it to rgba8 and get it to its staging memory.
+struct DecodeTask : public enki::ITaskSet {
+
+    void ExecuteRange( enki::TaskSetPartition range_, uint32_t threadnum_ ) override {
+        decoded_size = 0;
+        file_size = 0;
+        decoded_in_place = false;
+
+        FileSpan file = file_map( path, file_allocator );
+        if ( file.data == nullptr ) {
+            return;
+        }
+        file_size = file.size;
+
+        // The loader knows the size from the texture, here it is read from the header.
+        int x, y, comp;
+        const sizet image_size = stbi_info_from_memory( file.data, ( int )file.size, &x, &y, &comp ) ? ( sizet )x * y * 4 : 0;
+
+        image_decode_set_target( in_place ? staging_data : nullptr, image_size );
+        u8* pixels = stbi_load_from_memory( file.data, ( int )file.size, &x, &y, &comp, 4 );
+        image_decode_set_target( nullptr, 0 );
+
+        if ( pixels ) {
+            decoded_size = ( sizet )x * y * 4;
+            decoded_in_place = pixels == staging_data;
+
+            if ( !decoded_in_place ) {
+                memcpy( staging_data, pixels, decoded_size );
+                stbi_image_free( pixels );
+            }
+        }
+
+        file_unmap( file );
+    }
+
+    cstring                 path            = nullptr;
+    Allocator*              file_allocator  = nullptr;
+    u8*                     staging_data    = nullptr;     // Big enough for any image of the set.
+    bool                    in_place        = false;
+    bool                    decoded_in_place = false;
+    sizet                   file_size       = 0;
+    sizet                   decoded_size    = 0;
+
+}; // struct DecodeTask
+
+static bool has_image_extension( cstring name ) {
+    cstring extension = strrchr( name, '.' );
+    if ( extension == nullptr ) {
+        return false;
+    }
+    static const char* const k_extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".PNG", ".JPG", ".JPEG", ".TGA", ".BMP" };
+    for ( u32 e = 0; e < ArraySize( k_extensions ); ++e ) {
+        if ( strcmp( extension, k_extensions[ e ] ) == 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Appends the paths of all images below directory.
+static void find_images_recursive( cstring directory_path, StringBuffer& paths_buffer, Array<cstring>& paths ) {
+#if defined(_WIN64)
+    char search_pattern[ k_max_path ];
+    snprintf( search_pattern, k_max_path, "%s/*", directory_path );
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA( search_pattern, &find_data );
+    if ( find_handle == INVALID_HANDLE_VALUE ) {
+        return;
+    }
+
+    do {
+        cstring name = find_data.cFileName;
+        const bool is_directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+#else
+    DIR* directory = opendir( directory_path );
+    if ( directory == nullptr ) {
+        return;
+    }
+
+    while ( dirent* directory_entry = readdir( directory ) ) {
+        cstring name = directory_entry->d_name;
+
+        char entry_path[ k_max_path ];
+        snprintf( entry_path, k_max_path, "%s/%s", directory_path, name );
+
+        struct stat entry_stat { };
+        if ( stat( entry_path, &entry_stat ) != 0 ) {
+            continue;
+        }
+        const bool is_directory = S_ISDIR( entry_stat.st_mode );
+#endif // _WIN64
+
+        if ( strcmp( name, "." ) != 0 && strcmp( name, ".." ) != 0 ) {
+            if ( is_directory ) {
+                find_images_recursive( paths_buffer.append_use_f( "%s/%s", directory_path, name ), paths_buffer, paths );
+            } else if ( has_image_extension( name ) ) {
+                paths.push( paths_buffer.append_use_f( "%s/%s", directory_path, name ) );
+            }
+        }
+
+#if defined(_WIN64)
+    } while ( FindNextFileA( find_handle, &find_data ) != 0 );
+
+    FindClose( find_handle );
+#else
+    }
+
+    closedir( directory );
+#endif // _WIN64
+}
+
+static void add_task_result( BenchmarkResult& result, const DecodeTask& task ) {
+    ++result.image_count;
+    result.file_size += task.file_size;
+    result.decoded_size += task.decoded_size;
+    result.failed_count += task.decoded_size == 0 ? 1 : 0;
+    result.in_place_count += task.decoded_in_place ? 1 : 0;
+}
+
+// The loader thread before task sets: one image after the other.
+static BenchmarkResult run_serial( const Array<cstring>& paths, u8* staging_data, Allocator* file_allocator ) {
+    BenchmarkResult result{ "serial" };
+
+    const i64 start_time = time_now();
+    for ( u32 p = 0; p < paths.size; ++p ) {
+        DecodeTask task;
+        task.path = paths[ p ];
+        task.file_allocator = file_allocator;
+        task.staging_data = staging_data;
+        task.ExecuteRange( { 0, 1 }, 0 );
+
+        add_task_result( result, task );
+    }
+    result.seconds = time_from_seconds( start_time );
+
+    return result;
+}
+
+// One task set per image, polled like the loader update does. Each task set has its own staging memory.
+static BenchmarkResult run_task_sets( cstring name, const Array<cstring>& paths, bool in_place, enki::TaskScheduler& task_scheduler, u8* staging_data,
+                                      sizet staging_slot_size, Allocator* file_allocator ) {
+    BenchmarkResult result{ name };
+
+    DecodeTask tasks[ k_max_decode_tasks ];
+    bool active[ k_max_decode_tasks ]{ };
+    u32 next_path = 0;
+
+    const i64 start_time = time_now();
+    while ( result.image_count < paths.size ) {
+        for ( u32 t = 0; t < k_max_decode_tasks; ++t ) {
+            if ( active[ t ] && tasks[ t ].GetIsComplete() ) {
+                add_task_result( result, tasks[ t ] );
+                active[ t ] = false;
+            }
+
+            if ( !active[ t ] && next_path < paths.size ) {
+                tasks[ t ].path = paths[ next_path++ ];
+                tasks[ t ].file_allocator = file_allocator;
+                tasks[ t ].staging_data = staging_data + staging_slot_size * t;
+                tasks[ t ].in_place = in_place;
+                task_scheduler.AddTaskSetToPipe( &tasks[ t ] );
+                active[ t ] = true;
+            }
+        }
+
+        // The loader thread sleeps between updates, here it helps with the decodes instead.
+        for ( u32 t = 0; t < k_max_decode_tasks; ++t ) {
+            if ( active[ t ] ) {
+                task_scheduler.WaitforTask( &tasks[ t ] );
+                break;
+            }
+        }
+    }
+    result.seconds = time_from_seconds( start_time );
+
+    return result;
+}
+
+static void print_result( const BenchmarkResult& result, const BenchmarkResult& baseline ) {
+    const f64 decoded_megabytes = result.decoded_size / ( 1024.0 * 1024.0 );
+    const f64 file_megabytes = result.file_size / ( 1024.0 * 1024.0 );
+    rprint( "%-10s %6u images %8.3f s %10.2f MB/s decoded %10.2f MB/s read %8.2fx %6u in place%s\n", result.name, result.image_count, result.seconds,
+            result.seconds > 0.0 ? decoded_megabytes / result.seconds : 0.0, result.seconds > 0.0 ? file_megabytes / result.seconds : 0.0,
+            result.seconds > 0.0 ? baseline.seconds / result.seconds : 0.0, result.in_place_count, result.failed_count ? "   (decode errors)" : "" );
+}
+
+int main( int argc, char** argv ) {
+
+    if ( argc < 2 ) {
+        printf( "Usage: Chapter15DecodeBenchmark [-t thread_count] [-r repeat_count] <directory>\n" );
+        printf( "\t-t\ttask threads, all hardware threads by default\n" );
+        printf( "\t-r\tdecodes of each image set, 3 by default\n" );
+        return 1;
+    }
+
+    enki::TaskSchedulerConfig config;
+    u32 repeat_count = 3;
+
+    for ( i32 a = 1; a < argc - 1; ++a ) {
+        if ( strcmp( argv[ a ], "-t" ) == 0 && a + 1 < argc - 1 ) {
+            // The calling thread also runs tasks.
+            config.numTaskThreadsToCreate = raptor::max( atoi( argv[ ++a ] ), 1 ) - 1;
+        } else if ( strcmp( argv[ a ], "-r" ) == 0 && a + 1 < argc - 1 ) {
+            repeat_count = raptor::max( atoi( argv[ ++a ] ), 1 );
+        }
+    }
+    cstring input_directory = argv[ argc - 1 ];
+
+    time_service_init();
+
+    MemoryServiceConfiguration memory_configuration;
+    memory_configuration.maximum_dynamic_size = rgiga( 2ull );
+
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    // Files are read on the task threads.
+    MallocAllocator file_allocator;
+
+    enki::TaskScheduler task_scheduler;
+    task_scheduler.Initialize( config );
+
+    StringBuffer paths_buffer;
+    paths_buffer.init( rmega( 1 ), allocator );
+
+    Array<cstring> image_paths;
+    image_paths.init( allocator, 256 );
+
+    find_images_recursive( input_directory, paths_buffer, image_paths );
+    if ( image_paths.size == 0 ) {
+        rprint( "No images in %s\n", input_directory );
+    }
+
+    // Staging memory of each task set fits the biggest image, with the byte decoders allocate past it.
+    sizet staging_slot_size = k_staging_alignment;
+    for ( u32 p = 0; p < image_paths.size; ++p ) {
+        int x = 0, y = 0, comp = 0;
+        if ( stbi_info( image_paths[ p ], &x, &y, &comp ) ) {
+            staging_slot_size = raptor::max( staging_slot_size, memory_align( ( sizet )x * y * 4 + 1, k_staging_alignment ) );
+        }
+    }
+    u8* staging_data = ( u8* )malloc( staging_slot_size * k_max_decode_tasks );
+
+    // Repeat the image set, so that short runs are not dominated by the timer resolution.
+    Array<cstring> paths;
+    paths.init( allocator, image_paths.size * repeat_count );
+    for ( u32 r = 0; r < repeat_count; ++r ) {
+        for ( u32 p = 0; p < image_paths.size; ++p ) {
+            paths.push( image_paths[ p ] );
+        }
+    }
+
+    rprint( "Decoding %u images %u times, %u threads, up to %u task sets in flight\n", image_paths.size, repeat_count, task_scheduler.GetNumTaskThreads(),
+            k_max_decode_tasks );
+
+    // Warm the page cache and the staging memory, so that all runs measure decoding and not the disk.
+    run_task_sets( "warm up", image_paths, false, task_scheduler, staging_data, staging_slot_size, &file_allocator );
+
+    const BenchmarkResult serial_result = run_serial( paths, staging_data, &file_allocator );
+    print_result( serial_result, serial_result );
+    print_result( run_task_sets( "task sets", paths, false, task_scheduler, staging_data, staging_slot_size, &file_allocator ), serial_result );
+    print_result( run_task_sets( "in place", paths, true, task_scheduler, staging_data, staging_slot_size, &file_allocator ), serial_result );
+
+    free( staging_data );
+    paths.shutdown();
+    image_paths.shutdown();
+    paths_buffer.shutdown();
+
+    task_scheduler.WaitforAllAndShutdown();
+
+    MemoryService::instance()->shutdown();
+
+    return 0;
+}
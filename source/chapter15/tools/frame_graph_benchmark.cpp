@@ -0,0 +1,185 @@
+// Times the parts of the frame graph compile that do not depend on the gpu, on made up graphs of 128 to 1024 nodes:
+// building the plan of the nodes, sorting them, and placing the textures by lifetime. The graphs are layered like the ones of the demo, each node reading
+// a few resources of the layers before it, with some disabled, exported and loaded resources.
+// Creating the textures and the framebuffers is not measured, it depends on the driver.
+
+#include "graphics/frame_graph_plan.hpp"
+
+#include "foundation/array.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+#include "foundation/time.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+static const u32            k_nodes_per_layer       = 8;
+
+//
+//
+struct BenchmarkGraph {
+    u32                     node_count;
+    Array<u32>              order;              // Nodes are added in a shuffled order.
+    Array<u32>              reads;              // Four per node, u32_max when unused.
+    Array<u8>               flags;
+}; // struct BenchmarkGraph
+
+static const u8             k_node_disabled         = 1 << 0;
+static const u8             k_node_exports          = 1 << 1;
+static const u8             k_node_loads            = 1 << 2;
+
+static void make_graph( BenchmarkGraph& graph, u32 node_count, Allocator* allocator ) {
+    graph.node_count = node_count;
+    graph.order.init( allocator, node_count, node_count );
+    graph.reads.init( allocator, node_count * 4, node_count * 4 );
+    graph.flags.init( allocator, node_count, node_count );
+
+    srand( node_count );
+
+    for ( u32 n = 0; n < node_count; ++n ) {
+        graph.order[ n ] = n;
+
+        // Node n writes resource n and reads from the layers before its own.
+        const u32 layer_start = ( n / k_nodes_per_layer ) * k_nodes_per_layer;
+        for ( u32 r = 0; r < 4; ++r ) {
+            graph.reads[ n * 4 + r ] = layer_start > 0 && ( r == 0 || rand() % 2 ) ? rand() % layer_start : u32_max;
+        }
+
+        u8 flags = 0;
+        flags |= rand() % 32 == 0 ? k_node_disabled : 0;
+        flags |= rand() % 64 == 0 ? k_node_exports : 0;
+        flags |= rand() % 8 == 0 ? k_node_loads : 0;
+        graph.flags[ n ] = flags;
+    }
+
+    for ( u32 n = node_count - 1; n > 0; --n ) {
+        const u32 other = rand() % ( n + 1 );
+        const u32 swap = graph.order[ n ];
+        graph.order[ n ] = graph.order[ other ];
+        graph.order[ other ] = swap;
+    }
+}
+
+static void destroy_graph( BenchmarkGraph& graph ) {
+    graph.flags.shutdown();
+    graph.reads.shutdown();
+    graph.order.shutdown();
+}
+
+// Same work as the frame graph compile does for its nodes.
+static void build_plan( const BenchmarkGraph& graph, FrameGraphPlan& plan, Allocator* allocator ) {
+    plan.init( allocator, graph.node_count, graph.node_count );
+
+    for ( u32 i = 0; i < graph.node_count; ++i ) {
+        const u32 n = graph.order[ i ];
+        const u8 flags = graph.flags[ n ];
+
+        plan.add_node( ( flags & k_node_disabled ) == 0, ( flags & k_node_exports ) != 0 );
+
+        for ( u32 r = 0; r < 4; ++r ) {
+            const u32 resource = graph.reads[ n * 4 + r ];
+            if ( resource != u32_max ) {
+                plan.add_use( resource, r == 0 && ( flags & k_node_loads ) ? FrameGraphUseType::Load : FrameGraphUseType::Read );
+            }
+        }
+        plan.add_use( n, FrameGraphUseType::Write );
+    }
+}
+
+int main( int argc, char** argv ) {
+
+    u32 repeat_count = 1000;
+    for ( i32 a = 1; a < argc; ++a ) {
+        if ( strcmp( argv[ a ], "-r" ) == 0 && a + 1 < argc ) {
+            repeat_count = raptor::max( atoi( argv[ ++a ] ), 1 );
+        } else {
+            printf( "Usage: Chapter15FrameGraphBenchmark [-r repeat_count]\n" );
+            printf( "\t-r\tcompiles of each graph, 1000 by default\n" );
+            return 1;
+        }
+    }
+
+    time_service_init();
+
+    MemoryServiceConfiguration memory_configuration;
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    rprint( "Compiling each graph %u times\n", repeat_count );
+
+    static const u32 k_node_counts[] = { 128, 256, 512, 1024 };
+    for ( u32 g = 0; g < ArraySize( k_node_counts ); ++g ) {
+        BenchmarkGraph graph;
+        make_graph( graph, k_node_counts[ g ], allocator );
+
+        // The resources of the last layer are the outputs of the graph.
+        Array<u32> final_resources;
+        final_resources.init( allocator, k_nodes_per_layer );
+        for ( u32 n = graph.node_count - k_nodes_per_layer; n < graph.node_count; ++n ) {
+            final_resources.push( n );
+        }
+
+        Array<u32> sorted_nodes;
+        sorted_nodes.init( allocator, graph.node_count );
+
+        Array<FrameGraphLifetime> lifetimes;
+        lifetimes.init( allocator, graph.node_count );
+
+        Array<FrameGraphPlacement> placements;
+        placements.init( allocator, graph.node_count );
+
+        f64 plan_seconds = 0.0;
+        f64 sort_seconds = 0.0;
+        f64 place_seconds = 0.0;
+        u32 use_count = 0;
+        sizet heap_size = 0;
+
+        for ( u32 r = 0; r < repeat_count; ++r ) {
+            i64 start_time = time_now();
+
+            FrameGraphPlan plan;
+            build_plan( graph, plan, allocator );
+
+            plan_seconds += time_from_seconds( start_time );
+            start_time = time_now();
+
+            frame_graph_sort_nodes( plan, final_resources, sorted_nodes, allocator );
+
+            sort_seconds += time_from_seconds( start_time );
+            start_time = time_now();
+
+            // Textures of 1 to 16 MB, the size the demo uses at 1080p and up.
+            frame_graph_compute_lifetimes( plan, sorted_nodes, final_resources, lifetimes, allocator );
+            placements.clear();
+            for ( u32 i = 0; i < sorted_nodes.size; ++i ) {
+                // Each node of the plan writes the resource with the index of the node in the graph.
+                const u32 resource = graph.order[ sorted_nodes[ i ] ];
+                const sizet size = ( 1 + resource % 16 ) * rmega( 1 );
+                placements.push( { lifetimes[ resource ].first_node, lifetimes[ resource ].last_node, size, 65536, 0, false } );
+            }
+            heap_size = frame_graph_place_textures( placements, allocator );
+
+            place_seconds += time_from_seconds( start_time );
+            use_count = plan.uses.size;
+
+            plan.shutdown();
+        }
+
+        rprint( "%5u nodes %5u uses %5u sorted: plan %8.4f ms, sort %8.4f ms, place %8.4f ms, heap %6llu MB\n", graph.node_count, use_count,
+                sorted_nodes.size, plan_seconds * 1000.0 / repeat_count, sort_seconds * 1000.0 / repeat_count, place_seconds * 1000.0 / repeat_count,
+                ( u64 )( heap_size / rmega( 1 ) ) );
+
+        placements.shutdown();
+        lifetimes.shutdown();
+        sorted_nodes.shutdown();
+        final_resources.shutdown();
+        destroy_graph( graph );
+    }
+
+    MemoryService::instance()->shutdown();
+
+    return 0;
+}
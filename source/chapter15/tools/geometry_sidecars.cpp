@@ -0,0 +1,120 @@
+// Writes the geometry sidecars of glTF scenes, see graphics/geometry_codec.hpp: one next to each buffer of each scene,
+// encoded the way the scene loader decodes it. Sidecars store the write time of their buffer, so run it again after
+// changing the buffers. RaptorPacker packs the sidecars with the other files of the scene.
+
+#include "graphics/geometry_codec.hpp"
+
+#include "foundation/file.hpp"
+#include "foundation/gltf.hpp"
+#include "foundation/log.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/time.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace raptor;
+
+int main( int argc, char** argv ) {
+
+    if ( argc < 2 ) {
+        printf( "Usage: Chapter15GeometrySidecars <scene.gltf> [<scene.gltf> ...]\n" );
+        return 1;
+    }
+
+    time_service_init();
+
+    MemoryServiceConfiguration memory_configuration;
+    memory_configuration.maximum_dynamic_size = rgiga( 2ull );
+
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    Directory cwd{ };
+    directory_current( &cwd );
+
+    u32 failed_count = 0;
+
+    for ( i32 a = 1; a < argc; ++a ) {
+        // Buffer uris are relative to the scene, like when the scene loader reads them.
+        cstring scene_path = argv[ a ];
+        const sizet length = strlen( scene_path );
+        if ( length < 5 || strcmp( scene_path + length - 5, ".gltf" ) != 0 ) {
+            rprint( "Not a glTF scene %s\n", scene_path );
+            ++failed_count;
+            continue;
+        }
+
+        // The path helpers need a directory in the path.
+        const bool has_directory = strchr( scene_path, '/' ) != nullptr || strchr( scene_path, '\\' ) != nullptr;
+
+        char scene_directory[ k_max_path ]{ };
+        char scene_name[ k_max_path ]{ };
+        const int scene_path_length = snprintf( scene_directory, k_max_path, "%s%s", has_directory ? "" : "./", scene_path );
+        if ( scene_path_length < 0 || scene_path_length >= ( int )k_max_path ) {
+            rprint( "Path too long %s\n", scene_path );
+            ++failed_count;
+            continue;
+        }
+        memcpy( scene_name, scene_directory, scene_path_length );
+        file_directory_from_path( scene_directory );
+        file_name_from_path( scene_name );
+
+        directory_change( scene_directory );
+
+        if ( !file_exists( scene_name ) ) {
+            rprint( "Cannot find scene %s\n", scene_path );
+            directory_change( cwd.path );
+            ++failed_count;
+            continue;
+        }
+
+        i64 start_time = time_now();
+
+        glTF::glTF gltf = gltf_load_file( scene_name );
+
+        sizet buffers_size = 0;
+        sizet sidecars_size = 0;
+
+        for ( u32 b = 0; b < gltf.buffers_count; ++b ) {
+            const glTF::Buffer& buffer = gltf.buffers[ b ];
+            if ( buffer.uri.data == nullptr ) {
+                continue;
+            }
+
+            FileSpan buffer_file = file_map( buffer.uri.data, allocator );
+            if ( buffer_file.data == nullptr || buffer_file.size < ( sizet )buffer.byte_length ) {
+                rprint( "Cannot read %d bytes from %s\n", buffer.byte_length, buffer.uri.data );
+                file_unmap( buffer_file );
+                ++failed_count;
+                continue;
+            }
+
+            char sidecar_path[ k_max_path ];
+            const int sidecar_path_length = snprintf( sidecar_path, k_max_path, "%s%s", buffer.uri.data, k_geometry_codec_extension );
+
+            const sizet sidecar_size = sidecar_path_length > 0 && sidecar_path_length < ( int )k_max_path ?
+                geometry_codec_write_sidecar( gltf, b, buffer_file.data, file_modification_time( buffer.uri.data ), sidecar_path, allocator ) : 0;
+            if ( sidecar_size == 0 ) {
+                // Buffers with overlapping views cannot be encoded, the loader reads them from the source file.
+                rprint( "No sidecar written for %s\n", buffer.uri.data );
+            } else {
+                buffers_size += buffer.byte_length;
+                sidecars_size += sidecar_size;
+            }
+
+            file_unmap( buffer_file );
+        }
+
+        rprint( "%s: %f MB of buffers -> %f MB of sidecars in %f seconds\n", scene_path, buffers_size / ( 1024.0 * 1024.0 ), sidecars_size / ( 1024.0 * 1024.0 ),
+                time_from_seconds( start_time ) );
+
+        gltf_free( gltf );
+
+        directory_change( cwd.path );
+    }
+
+    MemoryService::instance()->shutdown();
+
+    return failed_count == 0 ? 0 : 1;
+}
@@ -3,21 +3,31 @@
 #include "foundation/memory.hpp"
 #include "foundation/assert.hpp"
 #include "foundation/string.hpp"
+#include "foundation/hash_map.hpp"
+#include "foundation/numerics.hpp"
+
+#include "external/tracy/common/tracy_lz4.hpp"
 
 #if defined(_WIN64)
 #include <windows.h>
 #else
 #define MAX_PATH 65536
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #endif
 
+#include <atomic>
+#include <ctype.h>
 #include <string.h>
 
 namespace raptor {
 
 
+static bool vfs_read( cstring filename, Allocator* allocator, bool null_terminate, char** out_data, sizet* out_size );
+
 void file_open( cstring filename, cstring mode, FileHandle* file ) {
 #if defined(_WIN64)
     fopen_s( file, filename, mode );
@@ -108,6 +118,10 @@ char* file_extension_from_path( char* path ) {
 }
 
 bool file_exists( cstring path ) {
+    if ( vfs_find( path, nullptr ) != nullptr ) {
+        return true;
+    }
+
 #if defined(_WIN64)
     WIN32_FILE_ATTRIBUTE_DATA unused;
     return GetFileAttributesExA( path, GetFileExInfoStandard, &unused );
@@ -117,6 +131,22 @@ bool file_exists( cstring path ) {
 #endif // _WIN64
 }
 
+u64 file_modification_time( cstring path ) {
+#if defined(_WIN64)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if ( !GetFileAttributesExA( path, GetFileExInfoStandard, &data ) ) {
+        return 0;
+    }
+    return ( ( u64 )data.ftLastWriteTime.dwHighDateTime << 32 ) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat file_stat;
+    if ( stat( path, &file_stat ) != 0 ) {
+        return 0;
+    }
+    return ( u64 )file_stat.st_mtim.tv_sec * 1000000000ull + ( u64 )file_stat.st_mtim.tv_nsec;
+#endif // _WIN64
+}
+
 bool file_delete( cstring path ) {
 #if defined(_WIN64)
     int result = remove( path );
@@ -342,6 +372,10 @@ void environment_variable_get( cstring name, char* output, u32 output_size ) {
 char* file_read_binary( cstring filename, Allocator* allocator, sizet* size ) {
     char* out_data = 0;
 
+    if ( vfs_read( filename, allocator, true, &out_data, size ) ) {
+        return out_data;
+    }
+
     FILE* file = fopen( filename, "rb" );
 
     if ( file ) {
@@ -365,6 +399,10 @@ char* file_read_binary( cstring filename, Allocator* allocator, sizet* size ) {
 char* file_read_text( cstring filename, Allocator* allocator, sizet* size ) {
     char* text = 0;
 
+    if ( vfs_read( filename, allocator, true, &text, size ) ) {
+        return text;
+    }
+
     FILE* file = fopen( filename, "r" );
 
     if ( file ) {
@@ -389,6 +427,10 @@ char* file_read_text( cstring filename, Allocator* allocator, sizet* size ) {
 FileReadResult file_read_binary( cstring filename, Allocator* allocator ) {
     FileReadResult result { nullptr, 0 };
 
+    if ( vfs_read( filename, allocator, false, &result.data, &result.size ) ) {
+        return result;
+    }
+
     FILE* file = fopen( filename, "rb" );
 
     if ( file ) {
@@ -410,6 +452,10 @@ FileReadResult file_read_binary( cstring filename, Allocator* allocator ) {
 FileReadResult file_read_text( cstring filename, Allocator* allocator ) {
     FileReadResult result{ nullptr, 0 };
 
+    if ( vfs_read( filename, allocator, true, &result.data, &result.size ) ) {
+        return result;
+    }
+
     FILE* file = fopen( filename, "r" );
 
     if ( file ) {
@@ -436,6 +482,333 @@ void file_write_binary( cstring filename, void* memory, sizet size ) {
     fclose( file );
 }
 
+// Virtual file system ////////////////////////////////////////////////////////
+
+//
+//
+struct VfsPack {
+    const u8*                   data;
+    sizet                       size;
+    const VfsPackEntry*         entries;
+    u32                         entry_count;
+
+    char                        root[ k_max_path ];     // Absolute, normalized and ending with a separator.
+    u32                         root_length;
+
+#if defined(_WIN64)
+    HANDLE                      file_handle;
+    HANDLE                      mapping_handle;
+#endif
+}; // struct VfsPack
+
+// Packs are only appended while mounted, the count is published after the pack is filled.
+static VfsPack                  vfs_packs[ k_vfs_max_packs ];
+static std::atomic<u32>         vfs_pack_count{ 0 };
+
+// Absolute path with '/' separators and without '.' or '..' components. Lower case on Windows, where paths are case insensitive.
+static bool vfs_normalize_path( cstring path, char* out_path, u32 max_size ) {
+    char joined_path[ k_max_path * 2 ];
+
+    const bool absolute = path[ 0 ] == '/' || path[ 0 ] == '\\' || ( path[ 0 ] != 0 && path[ 1 ] == ':' );
+    if ( absolute ) {
+        snprintf( joined_path, ArraySize( joined_path ), "%s", path );
+    } else {
+        Directory current_directory;
+        directory_current( &current_directory );
+        snprintf( joined_path, ArraySize( joined_path ), "%s/%s", current_directory.path, path );
+    }
+
+    u32 length = 0;
+    cstring component = joined_path;
+    while ( *component ) {
+        cstring component_end = component;
+        while ( *component_end != 0 && *component_end != '/' && *component_end != '\\' ) {
+            ++component_end;
+        }
+
+        const u32 component_length = ( u32 )( component_end - component );
+        if ( component_length == 2 && component[ 0 ] == '.' && component[ 1 ] == '.' ) {
+            while ( length > 0 && out_path[ length - 1 ] != '/' ) {
+                --length;
+            }
+            length = length > 0 ? length - 1 : 0;
+        } else if ( component_length > 0 && !( component_length == 1 && component[ 0 ] == '.' ) ) {
+            if ( length + component_length + 2 > max_size ) {
+                return false;
+            }
+
+            out_path[ length++ ] = '/';
+            for ( u32 c = 0; c < component_length; ++c ) {
+#if defined(_WIN64)
+                out_path[ length++ ] = ( char )tolower( component[ c ] );
+#else
+                out_path[ length++ ] = component[ c ];
+#endif
+            }
+        }
+
+        component = *component_end ? component_end + 1 : component_end;
+    }
+
+    out_path[ length ] = 0;
+    return true;
+}
+
+static void vfs_unmap_pack( VfsPack& pack ) {
+#if defined(_WIN64)
+    if ( pack.data ) {
+        UnmapViewOfFile( pack.data );
+    }
+    if ( pack.mapping_handle ) {
+        CloseHandle( pack.mapping_handle );
+    }
+    if ( pack.file_handle && pack.file_handle != INVALID_HANDLE_VALUE ) {
+        CloseHandle( pack.file_handle );
+    }
+#else
+    if ( pack.data ) {
+        munmap( ( void* )pack.data, pack.size );
+    }
+#endif // _WIN64
+
+    pack = { };
+}
+
+bool vfs_mount( cstring pack_path, cstring root_directory ) {
+    const u32 pack_index = vfs_pack_count.load( std::memory_order_relaxed );
+    if ( pack_index >= k_vfs_max_packs ) {
+        rprint( "Cannot mount pack %s, %u packs are already mounted\n", pack_path, k_vfs_max_packs );
+        return false;
+    }
+
+    VfsPack& pack = vfs_packs[ pack_index ];
+    pack = { };
+
+#if defined(_WIN64)
+    pack.file_handle = CreateFileA( pack_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    LARGE_INTEGER file_size{ };
+    if ( pack.file_handle != INVALID_HANDLE_VALUE && GetFileSizeEx( pack.file_handle, &file_size ) && file_size.QuadPart > 0 ) {
+        pack.mapping_handle = CreateFileMappingA( pack.file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if ( pack.mapping_handle ) {
+            pack.data = ( const u8* )MapViewOfFile( pack.mapping_handle, FILE_MAP_READ, 0, 0, 0 );
+            pack.size = pack.data ? ( sizet )file_size.QuadPart : 0;
+        }
+    }
+#else
+    int file_descriptor = open( pack_path, O_RDONLY );
+    struct stat file_stat { };
+    if ( file_descriptor >= 0 && fstat( file_descriptor, &file_stat ) == 0 && file_stat.st_size > 0 ) {
+        void* mapped_data = mmap( nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0 );
+        if ( mapped_data != MAP_FAILED ) {
+            pack.data = ( const u8* )mapped_data;
+            pack.size = file_stat.st_size;
+        }
+    }
+    // The mapping keeps the file alive.
+    if ( file_descriptor >= 0 ) {
+        close( file_descriptor );
+    }
+#endif // _WIN64
+
+    bool valid = pack.data != nullptr && pack.size >= sizeof( VfsPackHeader );
+    if ( valid ) {
+        const VfsPackHeader* header = ( const VfsPackHeader* )pack.data;
+        valid = header->magic == k_vfs_pack_magic && header->version == k_vfs_pack_version &&
+                sizeof( VfsPackHeader ) + ( sizet )header->entry_count * sizeof( VfsPackEntry ) <= pack.size;
+
+        pack.entries = ( const VfsPackEntry* )( pack.data + sizeof( VfsPackHeader ) );
+        pack.entry_count = valid ? header->entry_count : 0;
+
+        for ( u32 e = 0; e < pack.entry_count && valid; ++e ) {
+            const VfsPackEntry& entry = pack.entries[ e ];
+            valid = entry.data_offset <= pack.size && entry.stored_size <= pack.size - entry.data_offset &&
+                    entry.path_offset <= pack.size && entry.path_length <= pack.size - entry.path_offset &&
+                    ( entry.compression == VfsCompression::Lz4 || ( entry.compression == VfsCompression::None && entry.stored_size == entry.size ) ) &&
+                    ( e == 0 || pack.entries[ e - 1 ].path_hash <= entry.path_hash );
+        }
+    }
+
+    valid = valid && vfs_normalize_path( root_directory, pack.root, k_max_path - 1 );
+    if ( !valid ) {
+        rprint( "Cannot mount pack %s\n", pack_path );
+        vfs_unmap_pack( pack );
+        return false;
+    }
+
+    pack.root_length = ( u32 )strlen( pack.root );
+    pack.root[ pack.root_length++ ] = '/';
+    pack.root[ pack.root_length ] = 0;
+
+    vfs_pack_count.store( pack_index + 1, std::memory_order_release );
+
+    rprint( "Mounted pack %s: %u files in %s\n", pack_path, pack.entry_count, pack.root );
+    return true;
+}
+
+void vfs_unmount_all() {
+    const u32 pack_count = vfs_pack_count.load( std::memory_order_acquire );
+    vfs_pack_count.store( 0, std::memory_order_release );
+
+    for ( u32 p = 0; p < pack_count; ++p ) {
+        vfs_unmap_pack( vfs_packs[ p ] );
+    }
+}
+
+u32 vfs_canonical_path( cstring relative_path, char* out_path, u32 max_size ) {
+    while ( *relative_path == '/' || *relative_path == '\\' || ( relative_path[ 0 ] == '.' && ( relative_path[ 1 ] == '/' || relative_path[ 1 ] == '\\' ) ) ) {
+        relative_path += relative_path[ 0 ] == '.' ? 2 : 1;
+    }
+
+    u32 length = 0;
+    for ( ; relative_path[ length ] != 0 && length < max_size - 1; ++length ) {
+        const char c = relative_path[ length ];
+#if defined(_WIN64)
+        out_path[ length ] = c == '\\' ? '/' : ( char )tolower( c );
+#else
+        out_path[ length ] = c == '\\' ? '/' : c;
+#endif
+    }
+
+    out_path[ length ] = 0;
+    return length;
+}
+
+u64 vfs_hash_path( cstring relative_path ) {
+    char path[ k_max_path ];
+    const u32 length = vfs_canonical_path( relative_path, path, k_max_path );
+
+    return hash_bytes( path, length );
+}
+
+const VfsPackEntry* vfs_find( cstring path, const u8** out_pack_data ) {
+    const u32 pack_count = vfs_pack_count.load( std::memory_order_acquire );
+    if ( pack_count == 0 ) {
+        return nullptr;
+    }
+
+    char normalized_path[ k_max_path ];
+    if ( !vfs_normalize_path( path, normalized_path, k_max_path ) ) {
+        return nullptr;
+    }
+
+    for ( u32 p = pack_count; p-- > 0; ) {
+        const VfsPack& pack = vfs_packs[ p ];
+        if ( strncmp( normalized_path, pack.root, pack.root_length ) != 0 ) {
+            continue;
+        }
+
+        char relative_path[ k_max_path ];
+        const u32 path_length = vfs_canonical_path( normalized_path + pack.root_length, relative_path, k_max_path );
+        const u64 path_hash = hash_bytes( relative_path, path_length );
+
+        // Entries are sorted by hash.
+        u32 first = 0;
+        u32 last = pack.entry_count;
+        while ( first < last ) {
+            const u32 middle = ( first + last ) / 2;
+            if ( pack.entries[ middle ].path_hash < path_hash ) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+
+        // Paths with the same hash follow each other.
+        for ( u32 e = first; e < pack.entry_count && pack.entries[ e ].path_hash == path_hash; ++e ) {
+            const VfsPackEntry& entry = pack.entries[ e ];
+            if ( entry.path_length == path_length && memcmp( pack.data + entry.path_offset, relative_path, path_length ) == 0 ) {
+                if ( out_pack_data ) {
+                    *out_pack_data = pack.data;
+                }
+                return &entry;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// Compressed entries are LZ4 blocks, using the LZ4 vendored with Tracy.
+sizet vfs_compress_bound( sizet size ) {
+    return size <= LZ4_MAX_INPUT_SIZE ? ( sizet )tracy::LZ4_compressBound( ( int )size ) : 0;
+}
+
+sizet vfs_compress( const u8* source, sizet source_size, u8* destination, sizet destination_capacity ) {
+    if ( source_size > LZ4_MAX_INPUT_SIZE ) {
+        return 0;
+    }
+    const int capacity = ( int )raptor::min<sizet>( destination_capacity, i32_max );
+    const int compressed_size = tracy::LZ4_compress_default( ( const char* )source, ( char* )destination, ( int )source_size, capacity );
+    return compressed_size > 0 ? ( sizet )compressed_size : 0;
+}
+
+bool vfs_decompress( const u8* source, sizet source_size, u8* destination, sizet destination_size ) {
+    if ( source_size > i32_max || destination_size > i32_max ) {
+        return false;
+    }
+    const int decompressed_size = tracy::LZ4_decompress_safe( ( const char* )source, ( char* )destination, ( int )source_size, ( int )destination_size );
+    return decompressed_size >= 0 && ( sizet )decompressed_size == destination_size;
+}
+
+static bool vfs_read( cstring filename, Allocator* allocator, bool null_terminate, char** out_data, sizet* out_size ) {
+    const u8* pack_data = nullptr;
+    const VfsPackEntry* entry = vfs_find( filename, &pack_data );
+    if ( entry == nullptr ) {
+        return false;
+    }
+
+    // One more byte so that empty entries still get memory.
+    char* data = ( char* )ralloca( entry->size + 1, allocator );
+    const u8* stored_data = pack_data + entry->data_offset;
+
+    if ( entry->compression == VfsCompression::None ) {
+        memcpy( data, stored_data, entry->size );
+    } else if ( !vfs_decompress( stored_data, entry->stored_size, ( u8* )data, entry->size ) ) {
+        rprint( "Corrupted pack entry for %s\n", filename );
+        rfree( data, allocator );
+        return false;
+    }
+
+    if ( null_terminate ) {
+        data[ entry->size ] = 0;
+    }
+
+    *out_data = data;
+    if ( out_size ) {
+        *out_size = entry->size;
+    }
+    return true;
+}
+
+FileSpan file_map( cstring path, Allocator* allocator ) {
+    FileSpan span{ };
+
+    const u8* pack_data = nullptr;
+    const VfsPackEntry* entry = vfs_find( path, &pack_data );
+    if ( entry != nullptr && entry->compression == VfsCompression::None ) {
+        span.data = pack_data + entry->data_offset;
+        span.size = entry->size;
+        return span;
+    }
+
+    FileReadResult read_result = file_read_binary( path, allocator );
+    if ( read_result.data != nullptr ) {
+        span.data = ( const u8* )read_result.data;
+        span.size = read_result.size;
+        span.allocator = allocator;
+    }
+
+    return span;
+}
+
+void file_unmap( FileSpan& span ) {
+    if ( span.allocator != nullptr && span.data != nullptr ) {
+        rfree( ( void* )span.data, span.allocator );
+    }
+
+    span = { };
+}
+
 // Scoped file //////////////////////////////////////////////////////////////////
 ScopedFile::ScopedFile( cstring filename, cstring mode ) {
     file_open( filename, mode, &file );
@@ -57,6 +57,8 @@ namespace raptor {
 #if defined(_WIN64)
     FileTime                        file_last_write_time( cstring filename );
 #endif
+    // Last write time of a file on disk in an os specific unit, 0 when it does not exist or is in a pack.
+    u64                             file_modification_time( cstring path );
 
     // Try to resolve path to non-relative version.
     u32                             file_resolve_to_full_path( cstring path, char* out_full_path, u32 max_size );
@@ -86,6 +88,73 @@ namespace raptor {
     // TODO: move
     void                            environment_variable_get( cstring name, char* output, u32 output_size );
 
+    // Virtual file system /////////////////////////////////////////////////
+
+    // Pack file: a VfsPackHeader, the VfsPackEntry table sorted by path hash, the paths, then the entries data.
+    // Paths are relative to the packed directory, see vfs_canonical_path. Entries are found by the hash of their path,
+    // then the path is compared, so that two paths with the same hash are told apart.
+    static const u32                k_vfs_pack_magic        = 0x4b415052;   // RPAK
+    static const u32                k_vfs_pack_version      = 3;
+    static const u32                k_vfs_pack_alignment    = 64;           // Of each entry data.
+    static const u32                k_vfs_max_packs         = 16;
+    static const char* const        k_vfs_pack_extension    = ".rpak";
+
+    //
+    //
+    struct VfsCompression {
+        enum Enum {
+            None = 0, Lz4
+        };
+    }; // struct VfsCompression
+
+    //
+    //
+    struct VfsPackHeader {
+        u32                         magic;
+        u32                         version;
+        u32                         entry_count;
+        u32                         padding;
+    }; // struct VfsPackHeader
+
+    //
+    //
+    struct VfsPackEntry {
+        u64                         path_hash;
+        u64                         path_offset;        // From the start of the pack, the canonical path is not null terminated.
+        u64                         data_offset;        // From the start of the pack.
+        u64                         size;
+        u64                         stored_size;        // Equal to size when not compressed.
+        u32                         path_length;
+        u32                         compression;        // VfsCompression
+    }; // struct VfsPackEntry
+
+    //
+    // Content of a file: a view into a mounted pack, or memory owned by allocator when it had to be read or decompressed.
+    struct FileSpan {
+        const u8*                   data        = nullptr;
+        sizet                       size        = 0;
+        Allocator*                  allocator   = nullptr;
+    }; // struct FileSpan
+
+    // Maps a pack in memory: paths inside root_directory then resolve to its entries before the disk. Later mounts take precedence.
+    // Mounts must happen from a single thread, but can run while other threads read files. Unmount when no other thread reads files.
+    bool                            vfs_mount( cstring pack_path, cstring root_directory );
+    void                            vfs_unmount_all();
+
+    // Relative path without leading separators or './', with '/' separators and lower case on Windows. Returns its length.
+    u32                             vfs_canonical_path( cstring relative_path, char* out_path, u32 max_size );
+    u64                             vfs_hash_path( cstring relative_path );
+    const VfsPackEntry*             vfs_find( cstring path, const u8** out_pack_data );
+
+    // LZ4 block codec used by compressed entries. Compression returns 0 when the result does not fit in destination_capacity.
+    sizet                           vfs_compress_bound( sizet size );
+    sizet                           vfs_compress( const u8* source, sizet source_size, u8* destination, sizet destination_capacity );
+    bool                            vfs_decompress( const u8* source, sizet source_size, u8* destination, sizet destination_size );
+
+    // No copy for uncompressed pack entries. The functions reading files above also look into mounted packs first.
+    FileSpan                        file_map( cstring path, Allocator* allocator );
+    void                            file_unmap( FileSpan& span );
+
     struct ScopedFile {
         ScopedFile( cstring filename, cstring mode );
         ~ScopedFile();
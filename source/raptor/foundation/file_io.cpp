@@ -0,0 +1,630 @@
+#include "foundation/file_io.hpp"
+
+#include "foundation/assert.hpp"
+#include "foundation/log.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+
+#if defined(_WIN64)
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define RAPTOR_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+namespace raptor {
+
+cstring FileIoBackend::names[ Count ] = { "thread_pool", "io_uring" };
+
+// Direct io needs the buffers, offsets and sizes aligned to the logical block size, at most a page.
+static const sizet          k_direct_io_alignment   = 4096;
+static const sizet          k_max_read_size         = 1u << 30;
+
+static sizet align_direct_io( sizet size ) {
+    return ( size + k_direct_io_alignment - 1 ) & ~( k_direct_io_alignment - 1 );
+}
+
+static u8* io_buffer_allocate( sizet size ) {
+#if defined(_WIN64)
+    return ( u8* )_aligned_malloc( size, k_direct_io_alignment );
+#else
+    void* buffer = nullptr;
+    return posix_memalign( &buffer, k_direct_io_alignment, size ) == 0 ? ( u8* )buffer : nullptr;
+#endif
+}
+
+static void io_buffer_free( u8* buffer ) {
+#if defined(_WIN64)
+    _aligned_free( buffer );
+#else
+    free( buffer );
+#endif
+}
+
+// Opens the file and chooses where it is read: the request buffer when it fits, the heap otherwise.
+static bool open_request( FileIoRequest& request, u8* request_buffer, sizet buffer_size, bool direct_io ) {
+#if defined(_WIN64)
+    file_open( request.path, "rb", &request.file );
+    if ( request.file == nullptr ) {
+        return false;
+    }
+
+    _fseeki64( request.file, 0, SEEK_END );
+    request.size = ( sizet )_ftelli64( request.file );
+    _fseeki64( request.file, 0, SEEK_SET );
+    request.direct = false;
+#else
+    request.fd = -1;
+    request.direct = false;
+
+#if defined(O_DIRECT)
+    if ( direct_io ) {
+        request.fd = open( request.path, O_RDONLY | O_DIRECT );
+        request.direct = request.fd >= 0;
+    }
+#endif
+    if ( request.fd < 0 ) {
+        request.fd = open( request.path, O_RDONLY );
+    }
+    if ( request.fd < 0 ) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if ( fstat( request.fd, &file_stat ) != 0 ) {
+        return false;
+    }
+    request.size = ( sizet )file_stat.st_size;
+#endif // _WIN64
+
+    request.capacity = align_direct_io( request.size + 1 );
+    request.heap = request.capacity > buffer_size;
+    request.data = request.heap ? io_buffer_allocate( request.capacity ) : request_buffer;
+    return request.data != nullptr;
+}
+
+static void close_request( FileIoRequest& request ) {
+#if defined(_WIN64)
+    if ( request.file != nullptr ) {
+        file_close( request.file );
+        request.file = nullptr;
+    }
+#else
+    if ( request.fd >= 0 ) {
+        close( request.fd );
+        request.fd = -1;
+    }
+#endif
+}
+
+#if !defined(_WIN64)
+// Some file systems refuse direct io, they fail the first read.
+static bool reopen_buffered( FileIoRequest& request ) {
+    close( request.fd );
+    request.fd = open( request.path, O_RDONLY );
+    request.direct = false;
+    return request.fd >= 0;
+}
+#endif
+
+// Whole read in the calling thread, used by the thread pool.
+static void read_request( FileIoRequest& request ) {
+#if defined(_WIN64)
+    request.offset = fread( request.data, 1, request.size, request.file );
+#else
+    while ( request.offset < request.size ) {
+        const sizet read_size = raptor::min( request.capacity - request.offset, k_max_read_size );
+        const ssize_t result = pread( request.fd, request.data + request.offset, read_size, ( off_t )request.offset );
+        if ( result < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( result < 0 && errno == EINVAL && request.direct && reopen_buffered( request ) ) {
+            continue;
+        }
+        if ( result <= 0 ) {
+            break;
+        }
+        request.offset += ( sizet )result;
+    }
+#endif // _WIN64
+
+    request.success = request.offset >= request.size;
+}
+
+// Thread pool ////////////////////////////////////////////////////////////
+
+//
+//
+struct FileIoThreadPool {
+
+    Array<u32>                  queued_requests;
+    std::condition_variable     queued_condition;
+    std::thread*                threads         = nullptr;
+    u32                         thread_count    = 0;
+    bool                        stop            = false;
+}; // struct FileIoThreadPool
+
+static void thread_pool_run( FileIo* file_io ) {
+    FileIoThreadPool* thread_pool = file_io->thread_pool;
+
+    for ( ;; ) {
+        u32 request_index = u32_max;
+        {
+            std::unique_lock<std::mutex> lock( file_io->mutex );
+            file_io->thread_pool->queued_condition.wait( lock, [ thread_pool ]() { return thread_pool->stop || thread_pool->queued_requests.size > 0; } );
+            if ( thread_pool->queued_requests.size == 0 ) {
+                return;
+            }
+
+            // In submit order.
+            request_index = thread_pool->queued_requests[ 0 ];
+            memmove( thread_pool->queued_requests.data, thread_pool->queued_requests.data + 1, sizeof( u32 ) * ( thread_pool->queued_requests.size - 1 ) );
+            thread_pool->queued_requests.pop();
+        }
+
+        FileIoRequest& request = file_io->requests[ request_index ];
+        if ( open_request( request, file_io->buffers + ( sizet )request_index * file_io->buffer_size, file_io->buffer_size, file_io->direct_io ) ) {
+            read_request( request );
+        }
+        close_request( request );
+
+        file_io->complete_request( request_index );
+    }
+}
+
+// io_uring ///////////////////////////////////////////////////////////////
+
+#if defined(RAPTOR_IO_URING)
+
+//
+// Submission and completion queues shared with the kernel.
+struct FileIoRing {
+
+    i32                         fd              = -1;
+
+    u32*                        sq_head         = nullptr;
+    u32*                        sq_tail         = nullptr;
+    u32*                        sq_mask         = nullptr;
+    u32*                        sq_array        = nullptr;
+    io_uring_sqe*               sqes            = nullptr;
+
+    u32*                        cq_head         = nullptr;
+    u32*                        cq_tail         = nullptr;
+    u32*                        cq_mask         = nullptr;
+    io_uring_cqe*               cqes            = nullptr;
+
+    void*                       sq_ring         = nullptr;
+    void*                       cq_ring         = nullptr;
+    sizet                       sq_ring_size    = 0;
+    sizet                       cq_ring_size    = 0;
+    sizet                       sqes_size       = 0;
+
+    Array<iovec>                read_vectors;   // One per request for the reads outside the registered buffers.
+    u32                         entries         = 0;
+    u32                         unsubmitted     = 0;
+    bool                        registered_buffers = false;
+}; // struct FileIoRing
+
+static u32 load_acquire( u32* value ) {
+    return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+}
+
+static void store_release( u32* value, u32 new_value ) {
+    __atomic_store_n( value, new_value, __ATOMIC_RELEASE );
+}
+
+static i32 io_uring_enter( i32 fd, u32 to_submit, u32 min_complete, u32 flags ) {
+    return ( i32 )syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0 );
+}
+
+static bool ring_init( FileIoRing& ring, Allocator* allocator, u32 entries, u8* buffers, u32 buffer_size, u32 buffer_count ) {
+    io_uring_params params;
+    memset( &params, 0, sizeof( params ) );
+
+    ring.fd = ( i32 )syscall( __NR_io_uring_setup, entries, &params );
+    if ( ring.fd < 0 ) {
+        return false;
+    }
+
+    ring.entries = params.sq_entries;
+    ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof( u32 );
+    ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+    ring.sqes_size = params.sq_entries * sizeof( io_uring_sqe );
+
+    // Both rings share a mapping in recent kernels.
+    const bool single_mmap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if ( single_mmap ) {
+        ring.sq_ring_size = raptor::max( ring.sq_ring_size, ring.cq_ring_size );
+        ring.cq_ring_size = ring.sq_ring_size;
+    }
+
+    ring.sq_ring = mmap( nullptr, ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING );
+    ring.cq_ring = single_mmap ? ring.sq_ring : mmap( nullptr, ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING );
+    ring.sqes = ( io_uring_sqe* )mmap( nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES );
+    if ( ring.sq_ring == MAP_FAILED || ring.cq_ring == MAP_FAILED || ring.sqes == MAP_FAILED ) {
+        return false;
+    }
+
+    u8* sq_ring = ( u8* )ring.sq_ring;
+    ring.sq_head = ( u32* )( sq_ring + params.sq_off.head );
+    ring.sq_tail = ( u32* )( sq_ring + params.sq_off.tail );
+    ring.sq_mask = ( u32* )( sq_ring + params.sq_off.ring_mask );
+    ring.sq_array = ( u32* )( sq_ring + params.sq_off.array );
+
+    u8* cq_ring = ( u8* )ring.cq_ring;
+    ring.cq_head = ( u32* )( cq_ring + params.cq_off.head );
+    ring.cq_tail = ( u32* )( cq_ring + params.cq_off.tail );
+    ring.cq_mask = ( u32* )( cq_ring + params.cq_off.ring_mask );
+    ring.cqes = ( io_uring_cqe* )( cq_ring + params.cq_off.cqes );
+
+    ring.read_vectors.init( allocator, buffer_count, buffer_count );
+    for ( u32 b = 0; b < buffer_count; ++b ) {
+        ring.read_vectors[ b ].iov_base = buffers + ( sizet )b * buffer_size;
+        ring.read_vectors[ b ].iov_len = buffer_size;
+    }
+
+    // Pinned once, the kernel skips mapping the pages of each read. It fails over the locked memory limit.
+    ring.registered_buffers = syscall( __NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, ring.read_vectors.data, buffer_count ) == 0;
+    ring.unsubmitted = 0;
+
+    return true;
+}
+
+static void ring_shutdown( FileIoRing& ring ) {
+    if ( ring.sqes != nullptr && ring.sqes != MAP_FAILED ) {
+        munmap( ring.sqes, ring.sqes_size );
+    }
+    if ( ring.cq_ring != nullptr && ring.cq_ring != MAP_FAILED && ring.cq_ring != ring.sq_ring ) {
+        munmap( ring.cq_ring, ring.cq_ring_size );
+    }
+    if ( ring.sq_ring != nullptr && ring.sq_ring != MAP_FAILED ) {
+        munmap( ring.sq_ring, ring.sq_ring_size );
+    }
+    if ( ring.fd >= 0 ) {
+        close( ring.fd );
+    }
+
+    ring.read_vectors.shutdown();
+}
+
+// Queues the read of the rest of the file, submitted with the next poll or wait.
+static void ring_queue_read( FileIoRing& ring, FileIoRequest& request, u32 request_index ) {
+    const u32 tail = *ring.sq_tail;
+    RASSERT( tail - load_acquire( ring.sq_head ) < ring.entries );
+
+    const u32 sqe_index = tail & *ring.sq_mask;
+    io_uring_sqe* sqe = &ring.sqes[ sqe_index ];
+    memset( sqe, 0, sizeof( io_uring_sqe ) );
+
+    const sizet read_size = raptor::min( request.capacity - request.offset, k_max_read_size );
+    sqe->fd = request.fd;
+    sqe->off = request.offset;
+    sqe->user_data = request_index;
+
+    if ( !request.heap && ring.registered_buffers ) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = ( u64 )( request.data + request.offset );
+        sqe->len = ( u32 )read_size;
+        sqe->buf_index = ( u16 )request_index;
+    } else {
+        iovec& read_vector = ring.read_vectors[ request_index ];
+        read_vector.iov_base = request.data + request.offset;
+        read_vector.iov_len = read_size;
+
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = ( u64 )&read_vector;
+        sqe->len = 1;
+    }
+
+    ring.sq_array[ sqe_index ] = sqe_index;
+    store_release( ring.sq_tail, tail + 1 );
+    ++ring.unsubmitted;
+}
+
+static void ring_submit( FileIoRing& ring, u32 min_complete ) {
+    const u32 to_submit = ring.unsubmitted;
+    if ( to_submit == 0 && min_complete == 0 ) {
+        return;
+    }
+
+    const i32 result = io_uring_enter( ring.fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0 );
+    if ( result > 0 ) {
+        ring.unsubmitted -= raptor::min( ( u32 )result, to_submit );
+    }
+}
+
+// Reads continue until the end of the file, the request completes on errors.
+static void ring_process_completions( FileIo& file_io, FileIoRing& ring ) {
+    u32 head = *ring.cq_head;
+    const u32 tail = load_acquire( ring.cq_tail );
+
+    for ( ; head != tail; ++head ) {
+        const io_uring_cqe& cqe = ring.cqes[ head & *ring.cq_mask ];
+        const u32 request_index = ( u32 )cqe.user_data;
+        const i32 result = cqe.res;
+
+        FileIoRequest& request = file_io.requests[ request_index ];
+
+        bool retry = result == -EINTR || result == -EAGAIN;
+        if ( result == -EINVAL && request.direct ) {
+            retry = reopen_buffered( request );
+        }
+
+        if ( result > 0 ) {
+            request.offset += ( sizet )result;
+            retry = request.offset < request.size;
+        }
+
+        if ( retry ) {
+            ring_queue_read( ring, request, request_index );
+            continue;
+        }
+
+        request.success = request.offset >= request.size;
+        close_request( request );
+        file_io.complete_request( request_index );
+    }
+
+    store_release( ring.cq_head, head );
+}
+
+#else
+
+struct FileIoRing {
+}; // struct FileIoRing
+
+#endif // RAPTOR_IO_URING
+
+// FileIo /////////////////////////////////////////////////////////////////
+
+void FileIo::init( const FileIoCreation& creation ) {
+    allocator = creation.allocator;
+    queue_depth = creation.queue_depth;
+    buffer_size = ( u32 )align_direct_io( creation.buffer_size );
+    direct_io = creation.direct_io;
+    in_flight = 0;
+
+    requests.init( allocator, queue_depth, queue_depth );
+    free_requests.init( allocator, queue_depth );
+    completed_requests.init( allocator, queue_depth );
+    for ( u32 r = queue_depth; r > 0; --r ) {
+        free_requests.push( r - 1 );
+    }
+
+    buffers = io_buffer_allocate( ( sizet )buffer_size * queue_depth );
+    RASSERT( buffers != nullptr );
+
+    backend = FileIoBackend::ThreadPool;
+
+#if defined(RAPTOR_IO_URING)
+    if ( creation.backend == FileIoBackend::IoUring ) {
+        ring = ( FileIoRing* )ralloca( sizeof( FileIoRing ), allocator );
+        new ( ring ) FileIoRing();
+
+        if ( ring_init( *ring, allocator, queue_depth, buffers, buffer_size, queue_depth ) ) {
+            backend = FileIoBackend::IoUring;
+        } else {
+            rprint( "io_uring is not available, file reads use a thread pool\n" );
+            ring_shutdown( *ring );
+            rfree( ring, allocator );
+            ring = nullptr;
+        }
+    }
+#endif // RAPTOR_IO_URING
+
+    if ( backend == FileIoBackend::ThreadPool ) {
+        thread_pool = ( FileIoThreadPool* )ralloca( sizeof( FileIoThreadPool ), allocator );
+        new ( thread_pool ) FileIoThreadPool();
+
+        thread_pool->queued_requests.init( allocator, queue_depth );
+        thread_pool->thread_count = raptor::max( creation.thread_count, 1u );
+        thread_pool->threads = ( std::thread* )ralloca( sizeof( std::thread ) * thread_pool->thread_count, allocator );
+        for ( u32 t = 0; t < thread_pool->thread_count; ++t ) {
+            new ( &thread_pool->threads[ t ] ) std::thread( thread_pool_run, this );
+        }
+    }
+}
+
+void FileIo::shutdown() {
+    // Nothing can write to the buffers once released.
+    FileIoCompletion completions[ 16 ];
+    while ( in_flight > 0 ) {
+        const u32 completion_count = wait( completions, ArraySize( completions ) );
+        for ( u32 c = 0; c < completion_count; ++c ) {
+            release( completions[ c ] );
+        }
+    }
+
+    if ( thread_pool != nullptr ) {
+        {
+            std::lock_guard<std::mutex> guard( mutex );
+            thread_pool->stop = true;
+        }
+        thread_pool->queued_condition.notify_all();
+
+        for ( u32 t = 0; t < thread_pool->thread_count; ++t ) {
+            thread_pool->threads[ t ].join();
+            thread_pool->threads[ t ].~thread();
+        }
+        rfree( thread_pool->threads, allocator );
+
+        thread_pool->queued_requests.shutdown();
+        thread_pool->~FileIoThreadPool();
+        rfree( thread_pool, allocator );
+        thread_pool = nullptr;
+    }
+
+#if defined(RAPTOR_IO_URING)
+    if ( ring != nullptr ) {
+        ring_shutdown( *ring );
+        ring->~FileIoRing();
+        rfree( ring, allocator );
+        ring = nullptr;
+    }
+#endif // RAPTOR_IO_URING
+
+    io_buffer_free( buffers );
+    buffers = nullptr;
+
+    requests.shutdown();
+    free_requests.shutdown();
+    completed_requests.shutdown();
+}
+
+bool FileIo::can_read() {
+    std::lock_guard<std::mutex> guard( mutex );
+    return free_requests.size > 0;
+}
+
+bool FileIo::read( cstring path, void* user_data ) {
+    u32 request_index = u32_max;
+    {
+        std::lock_guard<std::mutex> guard( mutex );
+        if ( free_requests.size == 0 ) {
+            return false;
+        }
+
+        request_index = free_requests.back();
+        free_requests.pop();
+    }
+
+    FileIoRequest& request = requests[ request_index ];
+    request = FileIoRequest{ };
+    strncpy( request.path, path, k_max_path - 1 );
+    request.path[ k_max_path - 1 ] = 0;
+    request.user_data = user_data;
+
+    ++in_flight;
+
+    // Files in mounted packs are already in memory.
+    const u8* pack_data = nullptr;
+    if ( vfs_find( path, &pack_data ) != nullptr ) {
+        request.span = file_map( path, allocator );
+        request.data = ( u8* )request.span.data;
+        request.size = request.span.size;
+        request.offset = request.size;
+        request.success = request.data != nullptr;
+
+        complete_request( request_index );
+        return true;
+    }
+
+#if defined(RAPTOR_IO_URING)
+    if ( ring != nullptr ) {
+        // Opened here, only the reads are asynchronous.
+        if ( !open_request( request, buffers + ( sizet )request_index * buffer_size, buffer_size, direct_io ) || request.size == 0 ) {
+            request.success = request.data != nullptr && request.size == 0;
+            close_request( request );
+            complete_request( request_index );
+            return true;
+        }
+
+        ring_queue_read( *ring, request, request_index );
+        return true;
+    }
+#endif // RAPTOR_IO_URING
+
+    {
+        std::lock_guard<std::mutex> guard( mutex );
+        thread_pool->queued_requests.push( request_index );
+    }
+    thread_pool->queued_condition.notify_one();
+
+    return true;
+}
+
+void FileIo::complete_request( u32 request_index ) {
+    {
+        std::lock_guard<std::mutex> guard( mutex );
+        completed_requests.push( request_index );
+    }
+    completed_condition.notify_one();
+}
+
+u32 FileIo::get_completions( FileIoCompletion* completions, u32 max_completions ) {
+    std::lock_guard<std::mutex> guard( mutex );
+
+    u32 completion_count = 0;
+    for ( ; completion_count < max_completions && completion_count < completed_requests.size; ++completion_count ) {
+        const u32 request_index = completed_requests[ completion_count ];
+        const FileIoRequest& request = requests[ request_index ];
+
+        FileIoCompletion& completion = completions[ completion_count ];
+        completion.user_data = request.user_data;
+        completion.data = request.success ? request.data : nullptr;
+        completion.size = request.success ? request.size : 0;
+        completion.request = request_index;
+        completion.success = request.success;
+    }
+
+    // Keep the order of the remaining ones.
+    memmove( completed_requests.data, completed_requests.data + completion_count, sizeof( u32 ) * ( completed_requests.size - completion_count ) );
+    completed_requests.set_size( completed_requests.size - completion_count );
+
+    in_flight -= completion_count;
+    return completion_count;
+}
+
+u32 FileIo::poll( FileIoCompletion* completions, u32 max_completions ) {
+#if defined(RAPTOR_IO_URING)
+    if ( ring != nullptr ) {
+        ring_submit( *ring, 0 );
+        ring_process_completions( *this, *ring );
+        ring_submit( *ring, 0 );
+    }
+#endif // RAPTOR_IO_URING
+
+    return get_completions( completions, max_completions );
+}
+
+u32 FileIo::wait( FileIoCompletion* completions, u32 max_completions ) {
+    u32 completion_count = poll( completions, max_completions );
+
+    while ( completion_count == 0 && in_flight > 0 ) {
+#if defined(RAPTOR_IO_URING)
+        if ( ring != nullptr ) {
+            ring_submit( *ring, 1 );
+        }
+#endif // RAPTOR_IO_URING
+
+        if ( thread_pool != nullptr ) {
+            std::unique_lock<std::mutex> lock( mutex );
+            completed_condition.wait( lock, [ this ]() { return completed_requests.size > 0; } );
+        }
+
+        completion_count = poll( completions, max_completions );
+    }
+
+    return completion_count;
+}
+
+void FileIo::release( const FileIoCompletion& completion ) {
+    FileIoRequest& request = requests[ completion.request ];
+
+    if ( request.span.data != nullptr ) {
+        file_unmap( request.span );
+    } else if ( request.heap ) {
+        io_buffer_free( request.data );
+    }
+    request.data = nullptr;
+
+    std::lock_guard<std::mutex> guard( mutex );
+    free_requests.push( completion.request );
+}
+
+} // namespace raptor
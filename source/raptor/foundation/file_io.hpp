@@ -0,0 +1,114 @@
+#pragma once
+
+#include "foundation/array.hpp"
+#include "foundation/file.hpp"
+#include "foundation/platform.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace raptor {
+
+    struct Allocator;
+    struct FileIoRing;
+    struct FileIoThreadPool;
+
+    // Asynchronous file reads ////////////////////////////////////////////
+
+    //
+    //
+    struct FileIoBackend {
+        enum Enum {
+            ThreadPool = 0, IoUring, Count
+        };
+
+        static cstring              names[ Count ];
+    }; // struct FileIoBackend
+
+    //
+    //
+    struct FileIoCreation {
+
+        Allocator*                  allocator       = nullptr;
+        FileIoBackend::Enum         backend         = FileIoBackend::IoUring;  // Falls back to the thread pool where io_uring is not available.
+        u32                         queue_depth     = 32;           // Reads in flight or not yet released.
+        u32                         thread_count    = 4;            // Of the thread pool backend.
+        u32                         buffer_size     = 512 * 1024;   // Files up to this size are read in buffers allocated once, registered with io_uring.
+        bool                        direct_io       = true;         // Bypass the page cache where the file system allows it.
+    }; // struct FileIoCreation
+
+    //
+    // A finished read. data stays valid until the completion is released.
+    struct FileIoCompletion {
+
+        void*                       user_data       = nullptr;
+        const u8*                   data            = nullptr;
+        sizet                       size            = 0;
+        u32                         request         = u32_max;
+        bool                        success         = false;
+    }; // struct FileIoCompletion
+
+    //
+    //
+    struct FileIoRequest {
+
+        char                        path[ k_max_path ];
+        void*                       user_data       = nullptr;
+
+        u8*                         data            = nullptr;
+        sizet                       size            = 0;
+        sizet                       capacity        = 0;    // Of data, rounded up to the direct io alignment.
+        sizet                       offset          = 0;    // Bytes read.
+        FileSpan                    span;                   // Pack entries are mapped, not read.
+
+        i32                         fd              = -1;
+        FileHandle                  file            = nullptr;  // Used where there are no file descriptors.
+        bool                        heap            = false;    // data is not the request buffer.
+        bool                        direct          = false;
+        bool                        success         = false;
+    }; // struct FileIoRequest
+
+    //
+    // Reads whole files asynchronously, from the mounted packs or from the disk through io_uring or a pool of threads.
+    // Reads are submitted and polled from a single thread, completions can be released from any thread.
+    struct FileIo {
+
+        void                        init( const FileIoCreation& creation );
+        // Waits for the reads in flight, completions not released are lost.
+        void                        shutdown();
+
+        // Returns false when queue_depth reads are in flight or not released.
+        bool                        read( cstring path, void* user_data );
+        bool                        can_read();
+
+        // Returns the finished reads, at most max_completions.
+        u32                         poll( FileIoCompletion* completions, u32 max_completions );
+        // As poll, but blocks until at least one read finishes if any is in flight.
+        u32                         wait( FileIoCompletion* completions, u32 max_completions );
+        void                        release( const FileIoCompletion& completion );
+
+        void                        complete_request( u32 request_index );
+        u32                         get_completions( FileIoCompletion* completions, u32 max_completions );
+
+        Array<FileIoRequest>        requests;
+        Array<u32>                  free_requests;
+        Array<u32>                  completed_requests;
+
+        std::mutex                  mutex;          // Guards free_requests and completed_requests.
+        std::condition_variable     completed_condition;
+
+        Allocator*                  allocator       = nullptr;
+        u8*                         buffers         = nullptr;  // buffer_size bytes for each request.
+
+        FileIoRing*                 ring            = nullptr;
+        FileIoThreadPool*           thread_pool     = nullptr;
+
+        FileIoBackend::Enum         backend         = FileIoBackend::ThreadPool;
+        u32                         queue_depth     = 0;
+        u32                         buffer_size     = 0;
+        u32                         in_flight       = 0;    // Submitted and not yet returned by poll.
+        bool                        direct_io       = false;
+
+    }; // struct FileIo
+
+} // namespace raptor
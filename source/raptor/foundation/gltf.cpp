@@ -4,6 +4,7 @@
 
 #include "assert.hpp"
 #include "file.hpp"
+#include "numerics.hpp"
 
 using json = nlohmann::json;
 
@@ -273,12 +274,35 @@ static void load_meshes( json& json_data, glTF::glTF& gltf_data, Allocator* allo
     }
 }
 
+static void try_load_AccessorSparse( json& json_data, cstring key, glTF::AccessorSparse** accessor_sparse, Allocator* allocator ) {
+    auto it = json_data.find( key );
+    if ( it == json_data.end() ) {
+        *accessor_sparse = nullptr;
+        return;
+    }
+
+    glTF::AccessorSparse* as = ( glTF::AccessorSparse* ) allocate_and_zero( allocator, sizeof( glTF::AccessorSparse ) );
+
+    try_load_int( *it, "count", as->count );
+
+    json& indices = ( *it )[ "indices" ];
+    try_load_int( indices, "bufferView", as->indices.buffer_view );
+    try_load_int( indices, "byteOffset", as->indices.byte_offset );
+    try_load_int( indices, "componentType", as->indices.component_type );
+
+    json& values = ( *it )[ "values" ];
+    try_load_int( values, "bufferView", as->values.buffer_view );
+    try_load_int( values, "byteOffset", as->values.byte_offset );
+
+    *accessor_sparse = as;
+}
+
 static void load_accessor( json& json_data, glTF::Accessor& accessor, Allocator* allocator ) {
     try_load_int( json_data, "bufferView", accessor.buffer_view );
     try_load_int( json_data, "byteOffset", accessor.byte_offset );
     try_load_int( json_data, "componentType", accessor.component_type );
     try_load_int( json_data, "count", accessor.count );
-    try_load_int( json_data, "sparse", accessor.sparse );
+    try_load_AccessorSparse( json_data, "sparse", &accessor.sparse, allocator );
     try_load_float_array( json_data, "max", accessor.max_count, &accessor.max, allocator );
     try_load_float_array( json_data, "min", accessor.min_count, &accessor.min, allocator );
     try_load_bool( json_data, "normalized", accessor.normalized );
@@ -615,6 +639,237 @@ i32 gltf_get_attribute_accessor_index( glTF::MeshPrimitive::Attribute* attribute
     return -1;
 }
 
+// Accessor decoding //////////////////////////////////////////////////////
+
+// Convert a single component to float.
+template<typename T>
+static inline f32 decode_component( const u8* source ) {
+    T value;
+    memcpy( &value, source, sizeof( T ) );
+    return ( f32 )value;
+}
+
+// Normalized integers follow the glTF rules: unsigned values map to [0, 1], signed ones to [-1, 1]
+// with the minimum value clamped. Integers that are not normalized are converted as they are.
+template<typename T>
+static void decode_elements( const u8* source, u32 source_stride, u32 count, u32 component_count, bool normalized, f32 scale,
+                             f32* output, u32 output_component_count, u32 output_stride ) {
+    const u32 components_to_write = raptor::min( component_count, output_component_count );
+    u8* output_bytes = ( u8* )output;
+
+    for ( u32 e = 0; e < count; ++e ) {
+        const u8* element = source + e * source_stride;
+        f32* output_element = ( f32* )( output_bytes + e * output_stride );
+
+        for ( u32 c = 0; c < components_to_write; ++c ) {
+            const f32 value = decode_component<T>( element + c * sizeof( T ) );
+            output_element[ c ] = normalized ? raptor::max( value * scale, -1.0f ) : value;
+        }
+    }
+}
+
+static void decode_elements( i32 component_type, bool normalized, const u8* source, u32 source_stride, u32 count, u32 component_count,
+                             f32* output, u32 output_component_count, u32 output_stride ) {
+    switch ( component_type ) {
+        case glTF::Accessor::FLOAT:
+        {
+            // Fast path: tightly packed floats with matching layout are a single copy.
+            const u32 element_size = sizeof( f32 ) * component_count;
+            if ( component_count == output_component_count && source_stride == element_size && output_stride == element_size ) {
+                memcpy( output, source, ( sizet )element_size * count );
+                return;
+            }
+            decode_elements<f32>( source, source_stride, count, component_count, false, 1.0f, output, output_component_count, output_stride );
+            break;
+        }
+        case glTF::Accessor::BYTE:
+            decode_elements<i8>( source, source_stride, count, component_count, normalized, 1.0f / 127.0f, output, output_component_count, output_stride );
+            break;
+        case glTF::Accessor::UNSIGNED_BYTE:
+            decode_elements<u8>( source, source_stride, count, component_count, normalized, 1.0f / 255.0f, output, output_component_count, output_stride );
+            break;
+        case glTF::Accessor::SHORT:
+            decode_elements<i16>( source, source_stride, count, component_count, normalized, 1.0f / 32767.0f, output, output_component_count, output_stride );
+            break;
+        case glTF::Accessor::UNSIGNED_SHORT:
+            decode_elements<u16>( source, source_stride, count, component_count, normalized, 1.0f / 65535.0f, output, output_component_count, output_stride );
+            break;
+        case glTF::Accessor::UNSIGNED_INT:
+            decode_elements<u32>( source, source_stride, count, component_count, normalized, 1.0f / 4294967295.0f, output, output_component_count, output_stride );
+            break;
+        default:
+            RASSERTM( false, "Unsupported accessor component type %d", component_type );
+            break;
+    }
+}
+
+static u32 decode_index( const u8* source, i32 component_type ) {
+    switch ( component_type ) {
+        case glTF::Accessor::UNSIGNED_BYTE:
+            return *source;
+        case glTF::Accessor::UNSIGNED_SHORT:
+        {
+            u16 value;
+            memcpy( &value, source, sizeof( u16 ) );
+            return value;
+        }
+        case glTF::Accessor::UNSIGNED_INT:
+        {
+            u32 value;
+            memcpy( &value, source, sizeof( u32 ) );
+            return value;
+        }
+        default:
+            RASSERTM( false, "Unsupported index component type %d", component_type );
+            return 0;
+    }
+}
+
+// Returns start of accessor data and its stride, or nullptr if the accessor has no buffer view.
+static const u8* get_accessor_data( glTF::glTF& gltf, void** buffers_data, glTF::Accessor& accessor, u32& out_stride ) {
+    const u32 element_size = glTF::get_component_size( accessor.component_type ) * glTF::get_component_count( accessor.type );
+    out_stride = element_size;
+
+    if ( accessor.buffer_view == glTF::INVALID_INT_VALUE ) {
+        return nullptr;
+    }
+
+    glTF::BufferView& buffer_view = gltf.buffer_views[ accessor.buffer_view ];
+    if ( buffer_view.byte_stride != glTF::INVALID_INT_VALUE && buffer_view.byte_stride != 0 ) {
+        out_stride = buffer_view.byte_stride;
+    }
+
+    const i32 data_offset = glTF::get_data_offset( accessor.byte_offset, buffer_view.byte_offset );
+    return ( const u8* )buffers_data[ buffer_view.buffer ] + data_offset;
+}
+
+static const u8* get_buffer_view_data( glTF::glTF& gltf, void** buffers_data, i32 buffer_view_index, i32 byte_offset ) {
+    glTF::BufferView& buffer_view = gltf.buffer_views[ buffer_view_index ];
+    return ( const u8* )buffers_data[ buffer_view.buffer ] + glTF::get_data_offset( byte_offset, buffer_view.byte_offset );
+}
+
+bool gltf_accessor_is_packed_float( glTF::glTF& gltf, i32 accessor_index ) {
+    glTF::Accessor& accessor = gltf.accessors[ accessor_index ];
+    if ( accessor.component_type != glTF::Accessor::FLOAT || accessor.sparse != nullptr || accessor.buffer_view == glTF::INVALID_INT_VALUE ) {
+        return false;
+    }
+
+    glTF::BufferView& buffer_view = gltf.buffer_views[ accessor.buffer_view ];
+    const i32 element_size = sizeof( f32 ) * glTF::get_component_count( accessor.type );
+    return buffer_view.byte_stride == glTF::INVALID_INT_VALUE || buffer_view.byte_stride == 0 || buffer_view.byte_stride == element_size;
+}
+
+bool gltf_accessor_is_packed_index( glTF::glTF& gltf, i32 accessor_index ) {
+    glTF::Accessor& accessor = gltf.accessors[ accessor_index ];
+    // NOTE: 8 bit indices would need VK_EXT_index_type_uint8, so they are always decoded.
+    if ( ( accessor.component_type != glTF::Accessor::UNSIGNED_SHORT && accessor.component_type != glTF::Accessor::UNSIGNED_INT ) ||
+         accessor.sparse != nullptr || accessor.buffer_view == glTF::INVALID_INT_VALUE ) {
+        return false;
+    }
+
+    glTF::BufferView& buffer_view = gltf.buffer_views[ accessor.buffer_view ];
+    const i32 element_size = glTF::get_component_size( accessor.component_type );
+    return buffer_view.byte_stride == glTF::INVALID_INT_VALUE || buffer_view.byte_stride == 0 || buffer_view.byte_stride == element_size;
+}
+
+void gltf_decode_accessor_floats( glTF::glTF& gltf, void** buffers_data, i32 accessor_index, f32* output, u32 output_component_count, u32 output_stride ) {
+    glTF::Accessor& accessor = gltf.accessors[ accessor_index ];
+    const u32 component_count = glTF::get_component_count( accessor.type );
+
+    u32 source_stride = 0;
+    const u8* source = get_accessor_data( gltf, buffers_data, accessor, source_stride );
+
+    if ( source ) {
+        decode_elements( accessor.component_type, accessor.normalized, source, source_stride, accessor.count, component_count, output, output_component_count, output_stride );
+    } else {
+        // Accessors without buffer view are initialized with zeros.
+        const u32 components_to_write = raptor::min( component_count, output_component_count );
+        for ( i32 e = 0; e < accessor.count; ++e ) {
+            memset( ( u8* )output + e * output_stride, 0, sizeof( f32 ) * components_to_write );
+        }
+    }
+
+    if ( accessor.sparse == nullptr ) {
+        return;
+    }
+
+    // Apply sparse substitution: values are tightly packed and have the same layout as the accessor.
+    glTF::AccessorSparse& sparse = *accessor.sparse;
+    const u8* sparse_indices = get_buffer_view_data( gltf, buffers_data, sparse.indices.buffer_view, sparse.indices.byte_offset );
+    const u8* sparse_values = get_buffer_view_data( gltf, buffers_data, sparse.values.buffer_view, sparse.values.byte_offset );
+    const u32 index_size = glTF::get_component_size( sparse.indices.component_type );
+    const u32 element_size = glTF::get_component_size( accessor.component_type ) * component_count;
+
+    for ( i32 i = 0; i < sparse.count; ++i ) {
+        const u32 target = decode_index( sparse_indices + i * index_size, sparse.indices.component_type );
+        RASSERT( target < ( u32 )accessor.count );
+
+        f32* output_element = ( f32* )( ( u8* )output + ( sizet )target * output_stride );
+        decode_elements( accessor.component_type, accessor.normalized, sparse_values + i * element_size, element_size, 1, component_count, output_element, output_component_count, output_stride );
+    }
+}
+
+void gltf_decode_accessor_indices( glTF::glTF& gltf, void** buffers_data, i32 accessor_index, u32* output ) {
+    glTF::Accessor& accessor = gltf.accessors[ accessor_index ];
+    RASSERT( accessor.type == glTF::Accessor::Scalar );
+
+    u32 source_stride = 0;
+    const u8* source = get_accessor_data( gltf, buffers_data, accessor, source_stride );
+
+    if ( source ) {
+        switch ( accessor.component_type ) {
+            case glTF::Accessor::UNSIGNED_BYTE:
+                for ( i32 i = 0; i < accessor.count; ++i ) {
+                    output[ i ] = source[ i * source_stride ];
+                }
+                break;
+            case glTF::Accessor::UNSIGNED_SHORT:
+                if ( source_stride == sizeof( u16 ) ) {
+                    const u16* source_u16 = ( const u16* )source;
+                    for ( i32 i = 0; i < accessor.count; ++i ) {
+                        output[ i ] = source_u16[ i ];
+                    }
+                } else {
+                    for ( i32 i = 0; i < accessor.count; ++i ) {
+                        output[ i ] = decode_index( source + i * source_stride, accessor.component_type );
+                    }
+                }
+                break;
+            case glTF::Accessor::UNSIGNED_INT:
+                if ( source_stride == sizeof( u32 ) ) {
+                    memcpy( output, source, sizeof( u32 ) * accessor.count );
+                } else {
+                    for ( i32 i = 0; i < accessor.count; ++i ) {
+                        output[ i ] = decode_index( source + i * source_stride, accessor.component_type );
+                    }
+                }
+                break;
+            default:
+                RASSERTM( false, "Unsupported index component type %d", accessor.component_type );
+                break;
+        }
+    } else {
+        memset( output, 0, sizeof( u32 ) * accessor.count );
+    }
+
+    if ( accessor.sparse == nullptr ) {
+        return;
+    }
+
+    glTF::AccessorSparse& sparse = *accessor.sparse;
+    const u8* sparse_indices = get_buffer_view_data( gltf, buffers_data, sparse.indices.buffer_view, sparse.indices.byte_offset );
+    const u8* sparse_values = get_buffer_view_data( gltf, buffers_data, sparse.values.buffer_view, sparse.values.byte_offset );
+    const u32 index_size = glTF::get_component_size( sparse.indices.component_type );
+    const u32 value_size = glTF::get_component_size( accessor.component_type );
+
+    for ( i32 i = 0; i < sparse.count; ++i ) {
+        const u32 target = decode_index( sparse_indices + i * index_size, sparse.indices.component_type );
+        RASSERT( target < ( u32 )accessor.count );
+
+        output[ target ] = decode_index( sparse_values + i * value_size, accessor.component_type );
+    }
+}
+
 } // namespace raptor
 
 i32 raptor::glTF::get_data_offset( i32 accessor_offset, i32 buffer_view_offset ) {
@@ -623,3 +878,41 @@ i32 raptor::glTF::get_data_offset( i32 accessor_offset, i32 buffer_view_offset )
     byte_offset += accessor_offset == INVALID_INT_VALUE ? 0 : accessor_offset;
     return byte_offset;
 }
+
+u32 raptor::glTF::get_component_size( i32 component_type ) {
+    switch ( component_type ) {
+        case Accessor::BYTE:
+        case Accessor::UNSIGNED_BYTE:
+            return 1;
+        case Accessor::SHORT:
+        case Accessor::UNSIGNED_SHORT:
+            return 2;
+        case Accessor::UNSIGNED_INT:
+        case Accessor::FLOAT:
+            return 4;
+        default:
+            RASSERT( false );
+            return 0;
+    }
+}
+
+u32 raptor::glTF::get_component_count( Accessor::Type type ) {
+    switch ( type ) {
+        case Accessor::Scalar:
+            return 1;
+        case Accessor::Vec2:
+            return 2;
+        case Accessor::Vec3:
+            return 3;
+        case Accessor::Vec4:
+        case Accessor::Mat2:
+            return 4;
+        case Accessor::Mat3:
+            return 9;
+        case Accessor::Mat4:
+            return 16;
+        default:
+            RASSERT( false );
+            return 0;
+    }
+}
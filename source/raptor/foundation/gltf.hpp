@@ -36,12 +36,6 @@ namespace glTF {
         f32                         znear;
     };
 
-    struct AccessorSparse {
-        i32                         count;
-        i32                         indices;
-        i32                         values;
-    };
-
     struct Camera {
         i32                         orthographic;
         i32                         perspective;
@@ -166,6 +160,17 @@ namespace glTF {
         i32                         component_type;
     };
 
+    struct AccessorSparseValues {
+        i32                         buffer_view;
+        i32                         byte_offset;
+    };
+
+    struct AccessorSparse {
+        i32                         count;
+        AccessorSparseIndices       indices;
+        AccessorSparseValues        values;
+    };
+
     struct Accessor {
         enum ComponentType {
             BYTE = 5120, UNSIGNED_BYTE = 5121, SHORT = 5122, UNSIGNED_SHORT = 5123, UNSIGNED_INT = 5125, FLOAT = 5126
@@ -185,7 +190,7 @@ namespace glTF {
         u32                         min_count;
         f32*                        min;
         bool                        normalized;
-        i32                         sparse;
+        AccessorSparse*             sparse;     // nullptr when the accessor is not sparse.
         Type                        type;
     };
 
@@ -251,11 +256,6 @@ namespace glTF {
         AnimationSampler*           samplers;
     };
 
-    struct AccessorSparseValues {
-        i32                         bufferView;
-        i32                         byteOffset;
-    };
-
     struct Scene {
         u32                         nodes_count;
         i32*                        nodes;
@@ -315,6 +315,9 @@ namespace glTF {
 
     i32                             get_data_offset( i32 accessor_offset, i32 buffer_view_offset );
 
+    u32                             get_component_size( i32 component_type );
+    u32                             get_component_count( Accessor::Type type );
+
 } // namespace glTF
 
     glTF::glTF                      gltf_load_file( cstring file_path );
@@ -323,4 +326,19 @@ namespace glTF {
 
     i32                             gltf_get_attribute_accessor_index( glTF::MeshPrimitive::Attribute* attributes, u32 attribute_count, cstring attribute_name );
 
+    // Accessor decoding.
+    // buffers_data contains the loaded content of each glTF buffer, indexed like gltf.buffers.
+    // All component types, buffer view strides, normalized integers and sparse substitution are handled.
+    // Output is written with a user defined stride, so it can go straight into packed vertex structs.
+
+    // Returns true if the accessor can be read as-is from the source buffer as tightly packed floats.
+    bool                            gltf_accessor_is_packed_float( glTF::glTF& gltf, i32 accessor_index );
+    bool                            gltf_accessor_is_packed_index( glTF::glTF& gltf, i32 accessor_index );
+
+    // Decode accessor into floats. output_component_count can be less than the accessor ones (extra components are dropped)
+    // or more (missing components are left untouched). output_stride is in bytes.
+    void                            gltf_decode_accessor_floats( glTF::glTF& gltf, void** buffers_data, i32 accessor_index, f32* output, u32 output_component_count, u32 output_stride );
+    // Decode scalar integer accessor (indices) into u32.
+    void                            gltf_decode_accessor_indices( glTF::glTF& gltf, void** buffers_data, i32 accessor_index, u32* output );
+
 } // namespace raptor
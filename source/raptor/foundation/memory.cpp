@@ -278,7 +278,7 @@ void LinearAllocator::clear() {
 }
 
 // Memory Methods /////////////////////////////////////////////////////////
-void memory_copy( void* destination, void* source, sizet size ) {
+void memory_copy( void* destination, const void* source, sizet size ) {
     memcpy( destination, source, size );
 }
 
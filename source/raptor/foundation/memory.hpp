@@ -8,7 +8,7 @@
 namespace raptor {
 
     // Memory Methods /////////////////////////////////////////////////////
-    void            memory_copy( void* destination, void* source, sizet size );
+    void            memory_copy( void* destination, const void* source, sizet size );
 
     //
     //  Calculate aligned memory size.
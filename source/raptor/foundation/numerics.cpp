@@ -84,4 +84,87 @@ f32 get_random_value( f32 min, f32 max ) {
     return rnd;
 }
 
+// Vertex compression /////////////////////////////////////////////////////////////////////////////
+static f32 sign_not_zero( f32 value ) {
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static void octahedral_encode( f32 x, f32 y, f32 z, f32& u, f32& v ) {
+    const f32 l1_norm = fabsf( x ) + fabsf( y ) + fabsf( z );
+    if ( l1_norm == 0.0f ) {
+        u = v = 0.0f;
+        return;
+    }
+
+    const f32 inv_l1_norm = 1.0f / l1_norm;
+    u = x * inv_l1_norm;
+    v = y * inv_l1_norm;
+
+    // Fold the lower hemisphere over the diagonals.
+    if ( z < 0.0f ) {
+        const f32 folded_u = ( 1.0f - fabsf( v ) ) * sign_not_zero( u );
+        v = ( 1.0f - fabsf( u ) ) * sign_not_zero( v );
+        u = folded_u;
+    }
+}
+
+static void octahedral_decode( f32 u, f32 v, f32* out_xyz ) {
+    f32 x = u;
+    f32 y = v;
+    const f32 z = 1.0f - fabsf( u ) - fabsf( v );
+    const f32 t = raptor::max( -z, 0.0f );
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    const f32 inv_length = 1.0f / sqrtf( x * x + y * y + z * z );
+    out_xyz[ 0 ] = x * inv_length;
+    out_xyz[ 1 ] = y * inv_length;
+    out_xyz[ 2 ] = z * inv_length;
+}
+
+static u32 encode_snorm( f32 value, u32 bits ) {
+    const f32 max_value = ( f32 )( ( 1u << ( bits - 1 ) ) - 1 );
+    const i32 quantized = ( i32 )roundf( raptor::clamp( value, -1.0f, 1.0f ) * max_value );
+    return ( u32 )quantized & ( ( 1u << bits ) - 1 );
+}
+
+static f32 decode_snorm( u32 packed, u32 bits ) {
+    const f32 max_value = ( f32 )( ( 1u << ( bits - 1 ) ) - 1 );
+    // Sign extend from the top bit of the field.
+    const i32 value = ( i32 )( packed << ( 32 - bits ) ) >> ( 32 - bits );
+    return raptor::max( ( f32 )value / max_value, -1.0f );
+}
+
+u32 octahedral_encode_snorm16( f32 x, f32 y, f32 z ) {
+    f32 u, v;
+    octahedral_encode( x, y, z, u, v );
+
+    return encode_snorm( u, 16 ) | ( encode_snorm( v, 16 ) << 16 );
+}
+
+void octahedral_decode_snorm16( u32 packed, f32* out_xyz ) {
+    octahedral_decode( decode_snorm( packed & 0xffff, 16 ), decode_snorm( packed >> 16, 16 ), out_xyz );
+}
+
+u32 octahedral_encode_tangent( f32 x, f32 y, f32 z, f32 w ) {
+    f32 u, v;
+    octahedral_encode( x, y, z, u, v );
+
+    const u32 sign_bit = w < 0.0f ? ( 1u << 31 ) : 0;
+    return encode_snorm( u, 16 ) | ( encode_snorm( v, 15 ) << 16 ) | sign_bit;
+}
+
+void octahedral_decode_tangent( u32 packed, f32* out_xyzw ) {
+    octahedral_decode( decode_snorm( packed & 0xffff, 16 ), decode_snorm( ( packed >> 16 ) & 0x7fff, 15 ), out_xyzw );
+    out_xyzw[ 3 ] = ( packed >> 31 ) != 0 ? -1.0f : 1.0f;
+}
+
+u16 quantize_unorm16( f32 value ) {
+    return ( u16 )( raptor::clamp( value, 0.0f, 1.0f ) * 65535.0f + 0.5f );
+}
+
+f32 dequantize_unorm16( u16 value ) {
+    return ( f32 )value / 65535.0f;
+}
+
 } // namespace raptor
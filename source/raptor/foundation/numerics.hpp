@@ -62,6 +62,20 @@ namespace raptor {
 
     f32 get_random_value( f32 min, f32 max );
 
+    // Vertex compression /////////////////////////////////////////////////////////////////////////
+    // Unit vectors are mapped on an octahedron and unfolded on a square, then stored as two snorm.
+    // NOTE: decoding must be in sync with the functions in meshlet.h
+    u32                             octahedral_encode_snorm16( f32 x, f32 y, f32 z );
+    void                            octahedral_decode_snorm16( u32 packed, f32* out_xyz );
+
+    // Tangent with the bitangent sign in w: x uses 16 bits, y 15 bits and the sign the top bit.
+    u32                             octahedral_encode_tangent( f32 x, f32 y, f32 z, f32 w );
+    void                            octahedral_decode_tangent( u32 packed, f32* out_xyzw );
+
+    // Value in [0, 1].
+    u16                             quantize_unorm16( f32 value );
+    f32                             dequantize_unorm16( u16 value );
+
     const f32 rpi = 3.1415926538f;
     const f32 rpi_2 = 1.57079632679f;
 } // namespace raptor
@@ -0,0 +1,284 @@
+// Decodes hand built accessors with gltf_decode_accessor_floats and gltf_decode_accessor_indices
+// and compares them with the values expected by the glTF specification.
+
+#include "foundation/gltf.hpp"
+
+#include "tests/test.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+using namespace raptor;
+
+//
+//
+struct AccessorTestScene {
+    glTF::glTF                      gltf;
+    glTF::BufferView                buffer_views[ 4 ];
+    glTF::Accessor                  accessor;
+    glTF::AccessorSparse            sparse;
+    void*                           buffers_data[ 1 ];
+
+    void                            init( void* buffer_data, glTF::Accessor::Type type, i32 component_type, i32 count, bool normalized );
+    i32                             add_buffer_view( i32 byte_offset, i32 byte_length, i32 byte_stride );
+}; // struct AccessorTestScene
+
+void AccessorTestScene::init( void* buffer_data, glTF::Accessor::Type type, i32 component_type, i32 count, bool normalized ) {
+    memset( ( void* )this, 0, sizeof( AccessorTestScene ) );
+
+    buffers_data[ 0 ] = buffer_data;
+
+    accessor.buffer_view = glTF::INVALID_INT_VALUE;
+    accessor.byte_offset = glTF::INVALID_INT_VALUE;
+    accessor.component_type = component_type;
+    accessor.count = count;
+    accessor.normalized = normalized;
+    accessor.sparse = nullptr;
+    accessor.type = type;
+
+    gltf.buffer_views = buffer_views;
+    gltf.accessors = &accessor;
+    gltf.accessors_count = 1;
+}
+
+i32 AccessorTestScene::add_buffer_view( i32 byte_offset, i32 byte_length, i32 byte_stride ) {
+    glTF::BufferView& buffer_view = buffer_views[ gltf.buffer_views_count ];
+    buffer_view.buffer = 0;
+    buffer_view.byte_offset = byte_offset;
+    buffer_view.byte_length = byte_length;
+    buffer_view.byte_stride = byte_stride;
+    buffer_view.target = glTF::INVALID_INT_VALUE;
+
+    return gltf.buffer_views_count++;
+}
+
+// Integers that are not normalized keep their value, negative ones included.
+static void test_integers_not_normalized() {
+    AccessorTestScene scene;
+
+    i16 shorts[] = { -300, 5, -2, 32767, -32768, 0 };
+    scene.init( shorts, glTF::Accessor::Vec3, glTF::Accessor::SHORT, 2, false );
+    scene.accessor.buffer_view = scene.add_buffer_view( 0, sizeof( shorts ), glTF::INVALID_INT_VALUE );
+
+    f32 output[ 6 ];
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output, 3, sizeof( f32 ) * 3 );
+
+    for ( u32 i = 0; i < ArraySize( shorts ); ++i ) {
+        RTEST_CHECK( output[ i ] == ( f32 )shorts[ i ] );
+    }
+
+    i8 bytes[] = { -128, -1, 127, 64 };
+    scene.init( bytes, glTF::Accessor::Scalar, glTF::Accessor::BYTE, 4, false );
+    scene.accessor.buffer_view = scene.add_buffer_view( 0, sizeof( bytes ), glTF::INVALID_INT_VALUE );
+
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output, 1, sizeof( f32 ) );
+
+    for ( u32 i = 0; i < ArraySize( bytes ); ++i ) {
+        RTEST_CHECK( output[ i ] == ( f32 )bytes[ i ] );
+    }
+}
+
+// Normalized integers map to [0, 1] or [-1, 1], the minimum signed value is clamped to -1.
+static void test_integers_normalized() {
+    AccessorTestScene scene;
+
+    i8 bytes[] = { -128, -127, 0, 127 };
+    scene.init( bytes, glTF::Accessor::Scalar, glTF::Accessor::BYTE, 4, true );
+    scene.accessor.buffer_view = scene.add_buffer_view( 0, sizeof( bytes ), glTF::INVALID_INT_VALUE );
+
+    f32 output[ 4 ];
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output, 1, sizeof( f32 ) );
+
+    RTEST_CHECK( output[ 0 ] == -1.0f );
+    RTEST_CHECK( output[ 1 ] == -1.0f );
+    RTEST_CHECK( output[ 2 ] == 0.0f );
+    RTEST_CHECK( output[ 3 ] == 1.0f );
+
+    u8 unsigned_bytes[] = { 0, 51, 255, 128 };
+    scene.init( unsigned_bytes, glTF::Accessor::Scalar, glTF::Accessor::UNSIGNED_BYTE, 4, true );
+    scene.accessor.buffer_view = scene.add_buffer_view( 0, sizeof( unsigned_bytes ), glTF::INVALID_INT_VALUE );
+
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output, 1, sizeof( f32 ) );
+
+    RTEST_CHECK( output[ 0 ] == 0.0f );
+    RTEST_CHECK_NEAR( output[ 1 ], 0.2f, 1e-6f );
+    RTEST_CHECK( output[ 2 ] == 1.0f );
+    RTEST_CHECK_NEAR( output[ 3 ], 128.0f / 255.0f, 1e-6f );
+
+    i16 shorts[] = { -32768, -16384, 32767, 0 };
+    scene.init( shorts, glTF::Accessor::Vec2, glTF::Accessor::SHORT, 2, true );
+    scene.accessor.buffer_view = scene.add_buffer_view( 0, sizeof( shorts ), glTF::INVALID_INT_VALUE );
+
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output, 2, sizeof( f32 ) * 2 );
+
+    RTEST_CHECK( output[ 0 ] == -1.0f );
+    RTEST_CHECK_NEAR( output[ 1 ], -16384.0f / 32767.0f, 1e-6f );
+    RTEST_CHECK( output[ 2 ] == 1.0f );
+    RTEST_CHECK( output[ 3 ] == 0.0f );
+}
+
+// Quantized vertices (KHR_mesh_quantization): interleaved positions as shorts, normals as normalized
+// bytes and texture coordinates as normalized unsigned shorts, with padding to keep 4 byte alignment.
+static void test_quantized_interleaved() {
+    struct QuantizedVertex {
+        i16                         position[ 3 ];
+        i16                         position_padding;
+        i8                          normal[ 3 ];
+        i8                          normal_padding;
+        u16                         uv[ 2 ];
+    };
+    static_assert( sizeof( QuantizedVertex ) == 16, "Quantized vertex layout" );
+
+    QuantizedVertex vertices[ 3 ] = {
+        { { 1, -2, 3 }, 0, { 127, 0, -127 }, 0, { 0, 65535 } },
+        { { -1000, 2000, -30000 }, 0, { -128, 127, 0 }, 0, { 32768, 13107 } },
+        { { 0, 0, 0 }, 0, { 0, 0, 127 }, 0, { 65535, 0 } },
+    };
+
+    f32 expected_normals[ 3 ][ 3 ] = { { 1.0f, 0.0f, -1.0f }, { -1.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    f32 expected_uvs[ 3 ][ 2 ] = { { 0.0f, 1.0f }, { 32768.0f / 65535.0f, 0.2f }, { 1.0f, 0.0f } };
+
+    AccessorTestScene scene;
+    scene.init( vertices, glTF::Accessor::Vec3, glTF::Accessor::SHORT, 3, false );
+    const i32 buffer_view = scene.add_buffer_view( 0, sizeof( vertices ), sizeof( QuantizedVertex ) );
+
+    // Decode to an interleaved float layout with one extra component, left untouched.
+    struct DecodedVertex {
+        f32                         position[ 4 ];
+    };
+    DecodedVertex decoded[ 3 ];
+    for ( u32 v = 0; v < 3; ++v ) {
+        decoded[ v ].position[ 3 ] = 42.0f;
+    }
+
+    scene.accessor.buffer_view = buffer_view;
+    scene.accessor.byte_offset = 0;
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, decoded[ 0 ].position, 3, sizeof( DecodedVertex ) );
+
+    for ( u32 v = 0; v < 3; ++v ) {
+        for ( u32 c = 0; c < 3; ++c ) {
+            RTEST_CHECK( decoded[ v ].position[ c ] == ( f32 )vertices[ v ].position[ c ] );
+        }
+        RTEST_CHECK( decoded[ v ].position[ 3 ] == 42.0f );
+    }
+
+    f32 normals[ 3 ][ 3 ];
+    scene.accessor.component_type = glTF::Accessor::BYTE;
+    scene.accessor.normalized = true;
+    scene.accessor.byte_offset = offsetof( QuantizedVertex, normal );
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, normals[ 0 ], 3, sizeof( f32 ) * 3 );
+
+    f32 uvs[ 3 ][ 2 ];
+    scene.accessor.type = glTF::Accessor::Vec2;
+    scene.accessor.component_type = glTF::Accessor::UNSIGNED_SHORT;
+    scene.accessor.byte_offset = offsetof( QuantizedVertex, uv );
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, uvs[ 0 ], 2, sizeof( f32 ) * 2 );
+
+    for ( u32 v = 0; v < 3; ++v ) {
+        for ( u32 c = 0; c < 3; ++c ) {
+            RTEST_CHECK_NEAR( normals[ v ][ c ], expected_normals[ v ][ c ], 1e-6f );
+        }
+        for ( u32 c = 0; c < 2; ++c ) {
+            RTEST_CHECK_NEAR( uvs[ v ][ c ], expected_uvs[ v ][ c ], 1e-6f );
+        }
+    }
+}
+
+// Sparse accessors replace some elements of the base data, or of zeros when there is no buffer view.
+// Sparse values have the component type of the accessor, so they are normalized the same way.
+static void test_sparse() {
+    struct SparseData {
+        i8                          base[ 4 ][ 2 ];
+        u16                         indices[ 2 ];
+        i8                          values[ 2 ][ 2 ];
+    };
+
+    SparseData data = {
+        { { 127, 0 }, { 0, 127 }, { -127, 0 }, { 0, -127 } },
+        { 3, 1 },
+        { { -128, 127 }, { 64, -64 } },
+    };
+
+    AccessorTestScene scene;
+    scene.init( &data, glTF::Accessor::Vec2, glTF::Accessor::BYTE, 4, true );
+    scene.accessor.buffer_view = scene.add_buffer_view( offsetof( SparseData, base ), sizeof( data.base ), glTF::INVALID_INT_VALUE );
+
+    scene.sparse.count = 2;
+    scene.sparse.indices.buffer_view = scene.add_buffer_view( offsetof( SparseData, indices ), sizeof( data.indices ), glTF::INVALID_INT_VALUE );
+    scene.sparse.indices.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.sparse.indices.component_type = glTF::Accessor::UNSIGNED_SHORT;
+    scene.sparse.values.buffer_view = scene.add_buffer_view( offsetof( SparseData, values ), sizeof( data.values ), glTF::INVALID_INT_VALUE );
+    scene.sparse.values.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.accessor.sparse = &scene.sparse;
+
+    f32 output[ 4 ][ 2 ];
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, output[ 0 ], 2, sizeof( f32 ) * 2 );
+
+    const f32 expected[ 4 ][ 2 ] = { { 1.0f, 0.0f }, { 64.0f / 127.0f, -64.0f / 127.0f }, { -1.0f, 0.0f }, { -1.0f, 1.0f } };
+    for ( u32 e = 0; e < 4; ++e ) {
+        RTEST_CHECK_NEAR( output[ e ][ 0 ], expected[ e ][ 0 ], 1e-6f );
+        RTEST_CHECK_NEAR( output[ e ][ 1 ], expected[ e ][ 1 ], 1e-6f );
+    }
+
+    // Without a buffer view the elements that are not substituted are zero.
+    struct FloatSparseData {
+        u8                          indices[ 4 ];
+        f32                         values[ 2 ];
+    };
+
+    FloatSparseData float_data = { { 2, 0, 0, 0 }, { 5.0f, -6.0f } };
+
+    scene.init( &float_data, glTF::Accessor::Scalar, glTF::Accessor::FLOAT, 3, false );
+    scene.sparse.count = 2;
+    scene.sparse.indices.buffer_view = scene.add_buffer_view( offsetof( FloatSparseData, indices ), sizeof( float_data.indices ), glTF::INVALID_INT_VALUE );
+    scene.sparse.indices.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.sparse.indices.component_type = glTF::Accessor::UNSIGNED_BYTE;
+    scene.sparse.values.buffer_view = scene.add_buffer_view( offsetof( FloatSparseData, values ), sizeof( float_data.values ), glTF::INVALID_INT_VALUE );
+    scene.sparse.values.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.accessor.sparse = &scene.sparse;
+
+    f32 float_output[ 3 ] = { 1.0f, 1.0f, 1.0f };
+    gltf_decode_accessor_floats( scene.gltf, scene.buffers_data, 0, float_output, 1, sizeof( f32 ) );
+
+    RTEST_CHECK( float_output[ 0 ] == -6.0f );
+    RTEST_CHECK( float_output[ 1 ] == 0.0f );
+    RTEST_CHECK( float_output[ 2 ] == 5.0f );
+
+    // Sparse indices.
+    struct IndexSparseData {
+        u16                         base[ 4 ];
+        u8                          indices[ 2 ];
+        u16                         values[ 1 ];
+    };
+
+    IndexSparseData index_data = { { 0, 1, 2, 3 }, { 1, 0 }, { 60000 } };
+
+    scene.init( &index_data, glTF::Accessor::Scalar, glTF::Accessor::UNSIGNED_SHORT, 4, false );
+    scene.accessor.buffer_view = scene.add_buffer_view( offsetof( IndexSparseData, base ), sizeof( index_data.base ), glTF::INVALID_INT_VALUE );
+    scene.sparse.count = 1;
+    scene.sparse.indices.buffer_view = scene.add_buffer_view( offsetof( IndexSparseData, indices ), sizeof( index_data.indices ), glTF::INVALID_INT_VALUE );
+    scene.sparse.indices.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.sparse.indices.component_type = glTF::Accessor::UNSIGNED_BYTE;
+    scene.sparse.values.buffer_view = scene.add_buffer_view( offsetof( IndexSparseData, values ), sizeof( index_data.values ), glTF::INVALID_INT_VALUE );
+    scene.sparse.values.byte_offset = glTF::INVALID_INT_VALUE;
+    scene.accessor.sparse = &scene.sparse;
+
+    RTEST_CHECK( !gltf_accessor_is_packed_index( scene.gltf, 0 ) );
+
+    u32 indices[ 4 ];
+    gltf_decode_accessor_indices( scene.gltf, scene.buffers_data, 0, indices );
+
+    RTEST_CHECK( indices[ 0 ] == 0 );
+    RTEST_CHECK( indices[ 1 ] == 60000 );
+    RTEST_CHECK( indices[ 2 ] == 2 );
+    RTEST_CHECK( indices[ 3 ] == 3 );
+}
+
+int main( int argc, char** argv ) {
+    test_integers_not_normalized();
+    test_integers_normalized();
+    test_quantized_interleaved();
+    test_sparse();
+
+    return test::result( "gltf_accessor_test" );
+}
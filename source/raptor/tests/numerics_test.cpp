@@ -0,0 +1,151 @@
+// Round trips of the vertex attribute quantization functions, checked against their error bounds.
+
+#include "foundation/numerics.hpp"
+
+#include "tests/test.hpp"
+
+#include <float.h>
+#include <math.h>
+
+using namespace raptor;
+
+// Largest angle between a unit vector and its decoded octahedral encoding, in radians.
+// Half a step of the 16 bit snorm grid is 1.5e-5 on the octahedron, and projecting it on the sphere
+// stretches it up to about 3 times: the measured maxima are 6.4e-5 and, with one bit less on the
+// second tangent component, 9.7e-5. The bounds leave some margin over them.
+static const f32    k_octahedral_snorm16_max_error  = 8.0e-5f;
+static const f32    k_octahedral_tangent_max_error  = 1.2e-4f;
+
+// Deterministic and uniform over the sphere: a Fibonacci spiral, plus the axes, the diagonals
+// and the octahedron edges where the encoding folds.
+static u32 get_test_direction( u32 index, u32 count, f32* out_xyz ) {
+    static const f32 k_special_directions[][ 3 ] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { 1, 1, 1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, -1, 1 }, { 1, 1, 0 }, { -1, 0, 1 },
+        { 0, -1, -1 }, { 1, 0, -1e-7f }, { 0.5f, -0.5f, -1e-7f }, { -0.3f, -0.7f, -1e-6f },
+    };
+    const u32 special_count = ArraySize( k_special_directions );
+
+    f32 x, y, z;
+    if ( index < special_count ) {
+        x = k_special_directions[ index ][ 0 ];
+        y = k_special_directions[ index ][ 1 ];
+        z = k_special_directions[ index ][ 2 ];
+    } else {
+        const f32 golden_angle = 2.39996323f;
+        const u32 i = index - special_count;
+        z = 1.0f - 2.0f * ( i + 0.5f ) / count;
+        const f32 radius = sqrtf( 1.0f - z * z );
+        x = cosf( golden_angle * i ) * radius;
+        y = sinf( golden_angle * i ) * radius;
+    }
+
+    const f32 inv_length = 1.0f / sqrtf( x * x + y * y + z * z );
+    out_xyz[ 0 ] = x * inv_length;
+    out_xyz[ 1 ] = y * inv_length;
+    out_xyz[ 2 ] = z * inv_length;
+
+    return special_count;
+}
+
+static f32 angle_between( const f32* a, const f32* b ) {
+    const f32 dot = a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ];
+    // acos loses precision close to 1: use the length of the cross product instead.
+    const f32 cross_x = a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ];
+    const f32 cross_y = a[ 2 ] * b[ 0 ] - a[ 0 ] * b[ 2 ];
+    const f32 cross_z = a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ];
+    return atan2f( sqrtf( cross_x * cross_x + cross_y * cross_y + cross_z * cross_z ), dot );
+}
+
+static void test_octahedral_snorm16() {
+    const u32 direction_count = 100000;
+    f32 max_error = 0.0f;
+
+    for ( u32 d = 0; d < direction_count; ++d ) {
+        f32 direction[ 3 ];
+        get_test_direction( d, direction_count, direction );
+
+        f32 decoded[ 3 ];
+        octahedral_decode_snorm16( octahedral_encode_snorm16( direction[ 0 ], direction[ 1 ], direction[ 2 ] ), decoded );
+
+        const f32 error = angle_between( direction, decoded );
+        max_error = raptor::max( max_error, error );
+
+        RTEST_CHECK( error <= k_octahedral_snorm16_max_error );
+        RTEST_CHECK_NEAR( decoded[ 0 ] * decoded[ 0 ] + decoded[ 1 ] * decoded[ 1 ] + decoded[ 2 ] * decoded[ 2 ], 1.0f, 1e-5f );
+
+        // Encoding a decoded direction again does not drift further.
+        const u32 packed = octahedral_encode_snorm16( decoded[ 0 ], decoded[ 1 ], decoded[ 2 ] );
+        f32 decoded_again[ 3 ];
+        octahedral_decode_snorm16( packed, decoded_again );
+        RTEST_CHECK( angle_between( decoded, decoded_again ) <= k_octahedral_snorm16_max_error );
+    }
+
+    // Axes are exact.
+    f32 decoded[ 3 ];
+    octahedral_decode_snorm16( octahedral_encode_snorm16( 0.0f, 0.0f, -1.0f ), decoded );
+    RTEST_CHECK( decoded[ 0 ] == 0.0f && decoded[ 1 ] == 0.0f && decoded[ 2 ] == -1.0f );
+    octahedral_decode_snorm16( octahedral_encode_snorm16( 0.0f, 1.0f, 0.0f ), decoded );
+    RTEST_CHECK( decoded[ 0 ] == 0.0f && decoded[ 1 ] == 1.0f && decoded[ 2 ] == 0.0f );
+
+    printf( "Octahedral snorm16: max error %g radians, bound %g\n", max_error, k_octahedral_snorm16_max_error );
+}
+
+static void test_octahedral_tangent() {
+    const u32 direction_count = 100000;
+    f32 max_error = 0.0f;
+
+    for ( u32 d = 0; d < direction_count; ++d ) {
+        f32 direction[ 3 ];
+        get_test_direction( d, direction_count, direction );
+
+        const f32 sign = ( d & 1 ) ? -1.0f : 1.0f;
+
+        f32 decoded[ 4 ];
+        octahedral_decode_tangent( octahedral_encode_tangent( direction[ 0 ], direction[ 1 ], direction[ 2 ], sign ), decoded );
+
+        const f32 error = angle_between( direction, decoded );
+        max_error = raptor::max( max_error, error );
+
+        RTEST_CHECK( error <= k_octahedral_tangent_max_error );
+        RTEST_CHECK( decoded[ 3 ] == sign );
+    }
+
+    printf( "Octahedral tangent: max error %g radians, bound %g\n", max_error, k_octahedral_tangent_max_error );
+}
+
+static void test_unorm16() {
+    // Every quantized value survives the round trip.
+    for ( u32 value = 0; value <= 65535; ++value ) {
+        RTEST_CHECK( quantize_unorm16( dequantize_unorm16( ( u16 )value ) ) == value );
+    }
+
+    // Values in [0, 1] are at most half a step away once decoded, plus the f32 rounding of the scaling.
+    const f32 half_step = 0.5f / 65535.0f;
+    f32 max_error = 0.0f;
+
+    const u32 sample_count = 1000000;
+    for ( u32 s = 0; s <= sample_count; ++s ) {
+        const f32 value = ( f32 )s / sample_count;
+        const f32 error = fabsf( dequantize_unorm16( quantize_unorm16( value ) ) - value );
+        max_error = raptor::max( max_error, error );
+
+        RTEST_CHECK( error <= half_step + FLT_EPSILON );
+    }
+
+    // Values outside are clamped.
+    RTEST_CHECK( quantize_unorm16( -0.5f ) == 0 );
+    RTEST_CHECK( quantize_unorm16( 1.5f ) == 65535 );
+    RTEST_CHECK( dequantize_unorm16( 0 ) == 0.0f );
+    RTEST_CHECK( dequantize_unorm16( 65535 ) == 1.0f );
+
+    printf( "Unorm16: max error %g, bound %g\n", max_error, half_step + FLT_EPSILON );
+}
+
+int main( int argc, char** argv ) {
+    test_octahedral_snorm16();
+    test_octahedral_tangent();
+    test_unorm16();
+
+    return test::result( "numerics_test" );
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "foundation/platform.hpp"
+
+#include <math.h>
+#include <stdio.h>
+
+// Checks for the standalone test executables. A failed check prints its location and
+// makes test_result return a non zero exit code, which is what ctest reports.
+
+namespace raptor {
+namespace test {
+
+    inline u32                      checks_count = 0;
+    inline u32                      failed_checks_count = 0;
+
+    inline bool check( bool condition, cstring expression, cstring file, i32 line ) {
+        ++checks_count;
+        if ( !condition ) {
+            ++failed_checks_count;
+            printf( "%s(%d) : check failed: %s\n", file, line, expression );
+        }
+        return condition;
+    }
+
+    inline i32 result( cstring test_name ) {
+        printf( "%s: %u checks, %u failed\n", test_name, checks_count, failed_checks_count );
+        return failed_checks_count == 0 ? 0 : 1;
+    }
+
+} // namespace test
+} // namespace raptor
+
+#define RTEST_CHECK( condition )                    raptor::test::check( ( condition ), #condition, __FILE__, __LINE__ )
+#define RTEST_CHECK_NEAR( a, b, epsilon )           raptor::test::check( fabs( ( double )( a ) - ( double )( b ) ) <= ( double )( epsilon ), #a " ~= " #b, __FILE__, __LINE__ )
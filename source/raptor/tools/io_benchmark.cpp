@@ -0,0 +1,274 @@
+// Reads all the files of a directory with blocking reads and with each FileIo backend, and compares their throughput.
+
+#include "foundation/array.hpp"
+#include "foundation/file.hpp"
+#include "foundation/file_io.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/numerics.hpp"
+#include "foundation/string.hpp"
+#include "foundation/time.hpp"
+
+#if defined(_WIN64)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+//
+//
+struct BenchmarkFile {
+    char*                   path;
+    i64                     submit_time;
+}; // struct BenchmarkFile
+
+//
+//
+struct BenchmarkResult {
+    cstring                 name;
+    u32                     file_count;
+    u32                     failed_count;
+    sizet                   total_size;
+    f64                     seconds;
+    f64                     p50_milliseconds;
+    f64                     p99_milliseconds;
+}; // struct BenchmarkResult
+
+// Appends the paths of all files below directory.
+static void find_files_recursive( cstring directory_path, StringBuffer& paths_buffer, Array<BenchmarkFile>& files ) {
+#if defined(_WIN64)
+    char search_pattern[ k_max_path ];
+    snprintf( search_pattern, k_max_path, "%s/*", directory_path );
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA( search_pattern, &find_data );
+    if ( find_handle == INVALID_HANDLE_VALUE ) {
+        return;
+    }
+
+    do {
+        cstring name = find_data.cFileName;
+        const bool is_directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+#else
+    DIR* directory = opendir( directory_path );
+    if ( directory == nullptr ) {
+        return;
+    }
+
+    while ( dirent* directory_entry = readdir( directory ) ) {
+        cstring name = directory_entry->d_name;
+
+        char entry_path[ k_max_path ];
+        snprintf( entry_path, k_max_path, "%s/%s", directory_path, name );
+
+        struct stat entry_stat { };
+        if ( stat( entry_path, &entry_stat ) != 0 ) {
+            continue;
+        }
+        const bool is_directory = S_ISDIR( entry_stat.st_mode );
+#endif // _WIN64
+
+        if ( strcmp( name, "." ) != 0 && strcmp( name, ".." ) != 0 ) {
+            char* path = paths_buffer.append_use_f( "%s/%s", directory_path, name );
+
+            if ( is_directory ) {
+                find_files_recursive( path, paths_buffer, files );
+            } else {
+                BenchmarkFile file{ };
+                file.path = path;
+                files.push( file );
+            }
+        }
+
+#if defined(_WIN64)
+    } while ( FindNextFileA( find_handle, &find_data ) != 0 );
+
+    FindClose( find_handle );
+#else
+    }
+
+    closedir( directory );
+#endif // _WIN64
+}
+
+// Drops the files from the page cache, so that each run reads them from the disk.
+static void evict_files( const Array<BenchmarkFile>& files ) {
+#if defined(__linux__)
+    for ( u32 f = 0; f < files.size; ++f ) {
+        const int fd = open( files[ f ].path, O_RDONLY );
+        if ( fd >= 0 ) {
+            fdatasync( fd );
+            posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+            close( fd );
+        }
+    }
+#endif // __linux__
+}
+
+static int compare_latencies( const void* a, const void* b ) {
+    const f64 latency_a = *( const f64* )a;
+    const f64 latency_b = *( const f64* )b;
+    return latency_a < latency_b ? -1 : ( latency_a > latency_b ? 1 : 0 );
+}
+
+static void set_latency_percentiles( BenchmarkResult& result, f64* latencies, u32 count ) {
+    if ( count == 0 ) {
+        return;
+    }
+
+    qsort( latencies, count, sizeof( f64 ), compare_latencies );
+    result.p50_milliseconds = latencies[ ( count - 1 ) * 50 / 100 ];
+    result.p99_milliseconds = latencies[ ( count - 1 ) * 99 / 100 ];
+}
+
+// The loader before FileIo: one blocking read at a time.
+static BenchmarkResult run_blocking( Array<BenchmarkFile>& files, Allocator* allocator, f64* latencies ) {
+    BenchmarkResult result{ "blocking" };
+
+    const i64 start_time = time_now();
+    for ( u32 f = 0; f < files.size; ++f ) {
+        const i64 read_start_time = time_now();
+
+        FileReadResult read_result = file_read_binary( files[ f ].path, allocator );
+        if ( read_result.data != nullptr ) {
+            result.total_size += read_result.size;
+            rfree( read_result.data, allocator );
+        } else {
+            ++result.failed_count;
+        }
+
+        latencies[ result.file_count++ ] = time_delta_milliseconds( read_start_time, time_now() );
+    }
+    result.seconds = time_from_seconds( start_time );
+
+    set_latency_percentiles( result, latencies, result.file_count );
+    return result;
+}
+
+static BenchmarkResult run_file_io( Array<BenchmarkFile>& files, const FileIoCreation& creation, f64* latencies ) {
+    FileIo file_io;
+    file_io.init( creation );
+
+    BenchmarkResult result{ FileIoBackend::names[ file_io.backend ] };
+
+    // Keeps the queue full.
+    FileIoCompletion completions[ 64 ];
+    u32 next_file = 0;
+
+    const i64 start_time = time_now();
+    while ( result.file_count < files.size ) {
+        while ( next_file < files.size && file_io.can_read() ) {
+            files[ next_file ].submit_time = time_now();
+            file_io.read( files[ next_file ].path, &files[ next_file ] );
+            ++next_file;
+        }
+
+        const u32 completion_count = file_io.wait( completions, ArraySize( completions ) );
+        const i64 completion_time = time_now();
+
+        for ( u32 c = 0; c < completion_count; ++c ) {
+            const FileIoCompletion& completion = completions[ c ];
+            const BenchmarkFile* file = ( const BenchmarkFile* )completion.user_data;
+
+            if ( completion.success ) {
+                result.total_size += completion.size;
+            } else {
+                ++result.failed_count;
+            }
+
+            latencies[ result.file_count++ ] = time_delta_milliseconds( file->submit_time, completion_time );
+            file_io.release( completion );
+        }
+    }
+    result.seconds = time_from_seconds( start_time );
+
+    file_io.shutdown();
+
+    set_latency_percentiles( result, latencies, result.file_count );
+    return result;
+}
+
+static void print_result( const BenchmarkResult& result ) {
+    const f64 megabytes = result.total_size / ( 1024.0 * 1024.0 );
+    rprint( "%-12s %8u files %10.2f MB %8.3f s %10.2f MB/s %10.1f files/s   p50 %8.3f ms   p99 %8.3f ms%s\n", result.name, result.file_count, megabytes,
+            result.seconds, result.seconds > 0.0 ? megabytes / result.seconds : 0.0, result.seconds > 0.0 ? result.file_count / result.seconds : 0.0,
+            result.p50_milliseconds, result.p99_milliseconds, result.failed_count ? "   (read errors)" : "" );
+}
+
+int main( int argc, char** argv ) {
+
+    if ( argc < 2 ) {
+        printf( "Usage: RaptorIoBenchmark [-b] [-q queue_depth] [-t thread_count] <directory>\n" );
+        printf( "\t-b\tbuffered reads, through the page cache\n" );
+        printf( "\t-q\treads in flight, 64 by default\n" );
+        printf( "\t-t\tthreads of the thread pool backend, 4 by default\n" );
+        return 1;
+    }
+
+    FileIoCreation creation;
+    creation.queue_depth = 64;
+
+    for ( i32 a = 1; a < argc - 1; ++a ) {
+        if ( strcmp( argv[ a ], "-b" ) == 0 ) {
+            creation.direct_io = false;
+        } else if ( strcmp( argv[ a ], "-q" ) == 0 && a + 1 < argc - 1 ) {
+            creation.queue_depth = ( u32 )atoi( argv[ ++a ] );
+        } else if ( strcmp( argv[ a ], "-t" ) == 0 && a + 1 < argc - 1 ) {
+            creation.thread_count = ( u32 )atoi( argv[ ++a ] );
+        }
+    }
+    cstring input_directory = argv[ argc - 1 ];
+
+    time_service_init();
+
+    MemoryServiceConfiguration memory_configuration;
+    memory_configuration.maximum_dynamic_size = rgiga( 2ull );
+
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    // Reads may run on other threads.
+    MallocAllocator file_allocator;
+    creation.allocator = &file_allocator;
+
+    StringBuffer paths_buffer;
+    paths_buffer.init( rmega( 1 ), allocator );
+
+    Array<BenchmarkFile> files;
+    files.init( allocator, 256 );
+
+    find_files_recursive( input_directory, paths_buffer, files );
+    if ( files.size == 0 ) {
+        rprint( "No files in %s\n", input_directory );
+    }
+
+    f64* latencies = ( f64* )ralloca( sizeof( f64 ) * raptor::max( files.size, 1u ), allocator );
+
+    rprint( "Reading %u files, queue depth %u, %u threads, %s io\n", files.size, creation.queue_depth, creation.thread_count, creation.direct_io ? "direct" : "buffered" );
+
+    evict_files( files );
+    print_result( run_blocking( files, &file_allocator, latencies ) );
+
+    creation.backend = FileIoBackend::ThreadPool;
+    evict_files( files );
+    print_result( run_file_io( files, creation, latencies ) );
+
+    creation.backend = FileIoBackend::IoUring;
+    evict_files( files );
+    print_result( run_file_io( files, creation, latencies ) );
+
+    rfree( latencies, allocator );
+    files.shutdown();
+    paths_buffer.shutdown();
+
+    MemoryService::instance()->shutdown();
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+// Packs all the files of a directory in a single file, read through the virtual file system in foundation/file.hpp.
+
+#include "foundation/array.hpp"
+#include "foundation/file.hpp"
+#include "foundation/memory.hpp"
+#include "foundation/string.hpp"
+#include "foundation/time.hpp"
+
+#if defined(_WIN64)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace raptor;
+
+// Compressed entries are kept only if they save at least this fraction of the file.
+static const f32            k_min_compression_saving    = 0.1f;
+
+//
+//
+struct PackedFile {
+    char*                   path;           // Relative to the packed directory.
+    VfsPackEntry            entry;
+}; // struct PackedFile
+
+// Appends the paths of all files below directory, relative to the packed directory.
+static void find_files_recursive( cstring root_directory, cstring relative_directory, StringBuffer& paths_buffer, Array<PackedFile>& files ) {
+    char directory_path[ k_max_path ];
+    const int directory_path_length = snprintf( directory_path, k_max_path, "%s/%s", root_directory, relative_directory );
+    if ( directory_path_length < 0 || directory_path_length >= ( int )k_max_path ) {
+        rprint( "Path too long, skipping %s/%s\n", root_directory, relative_directory );
+        return;
+    }
+
+#if defined(_WIN64)
+    char search_pattern[ k_max_path ];
+    const int search_pattern_length = snprintf( search_pattern, k_max_path, "%s/*", directory_path );
+    if ( search_pattern_length < 0 || search_pattern_length >= ( int )k_max_path ) {
+        rprint( "Path too long, skipping %s\n", directory_path );
+        return;
+    }
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA( search_pattern, &find_data );
+    if ( find_handle == INVALID_HANDLE_VALUE ) {
+        return;
+    }
+
+    do {
+        cstring name = find_data.cFileName;
+        const bool is_directory = ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+#else
+    DIR* directory = opendir( directory_path );
+    if ( directory == nullptr ) {
+        return;
+    }
+
+    while ( dirent* directory_entry = readdir( directory ) ) {
+        cstring name = directory_entry->d_name;
+
+        char entry_path[ k_max_path ];
+        const int entry_path_length = snprintf( entry_path, k_max_path, "%s/%s", directory_path, name );
+        if ( entry_path_length < 0 || entry_path_length >= ( int )k_max_path ) {
+            rprint( "Path too long, skipping %s/%s\n", directory_path, name );
+            continue;
+        }
+
+        struct stat entry_stat { };
+        if ( stat( entry_path, &entry_stat ) != 0 ) {
+            continue;
+        }
+        const bool is_directory = S_ISDIR( entry_stat.st_mode );
+#endif // _WIN64
+
+        if ( strcmp( name, "." ) != 0 && strcmp( name, ".." ) != 0 ) {
+            char* relative_path = relative_directory[ 0 ] ? paths_buffer.append_use_f( "%s/%s", relative_directory, name ) : paths_buffer.append_use( name );
+
+            const sizet name_length = strlen( name );
+            const sizet extension_length = strlen( k_vfs_pack_extension );
+            const bool is_pack = name_length > extension_length && strcmp( name + name_length - extension_length, k_vfs_pack_extension ) == 0;
+
+            if ( is_directory ) {
+                find_files_recursive( root_directory, relative_path, paths_buffer, files );
+            } else if ( !is_pack ) {
+                PackedFile file{ };
+                file.path = relative_path;
+                files.push( file );
+            }
+        }
+
+#if defined(_WIN64)
+    } while ( FindNextFileA( find_handle, &find_data ) != 0 );
+
+    FindClose( find_handle );
+#else
+    }
+
+    closedir( directory );
+#endif // _WIN64
+}
+
+// Paths with the same hash are sorted by path, so that packs of the same files are the same.
+static int compare_packed_files( const void* a, const void* b ) {
+    const PackedFile* file_a = ( const PackedFile* )a;
+    const PackedFile* file_b = ( const PackedFile* )b;
+    const u64 hash_a = file_a->entry.path_hash;
+    const u64 hash_b = file_b->entry.path_hash;
+    return hash_a < hash_b ? -1 : ( hash_a > hash_b ? 1 : strcmp( file_a->path, file_b->path ) );
+}
+
+int main( int argc, char** argv ) {
+
+    if ( argc < 3 ) {
+        printf( "Usage: RaptorPacker [-c] <input directory> <output pack>\n" );
+        printf( "\t-c\tcompress files that benefit from it\n" );
+        return 1;
+    }
+
+    const bool compress = argc > 3 && strcmp( argv[ 1 ], "-c" ) == 0;
+    cstring input_directory = argv[ argc - 2 ];
+    cstring output_path = argv[ argc - 1 ];
+
+    time_service_init();
+
+    MemoryServiceConfiguration memory_configuration;
+    memory_configuration.maximum_dynamic_size = rgiga( 2ull );
+
+    MemoryService::instance()->init( &memory_configuration );
+    Allocator* allocator = &MemoryService::instance()->system_allocator;
+
+    i64 start_packing = time_now();
+
+    StringBuffer paths_buffer;
+    paths_buffer.init( rmega( 1 ), allocator );
+
+    Array<PackedFile> files;
+    files.init( allocator, 256 );
+
+    find_files_recursive( input_directory, "", paths_buffer, files );
+
+    FileHandle pack_file;
+    file_open( output_path, "wb", &pack_file );
+    if ( pack_file == nullptr ) {
+        rprint( "Cannot open %s\n", output_path );
+        return 1;
+    }
+
+    // Paths are stored in their canonical form, the one the lookups compare with.
+    sizet paths_offset = sizeof( VfsPackHeader ) + sizeof( VfsPackEntry ) * files.size;
+    sizet paths_size = 0;
+    for ( u32 f = 0; f < files.size; ++f ) {
+        PackedFile& file = files[ f ];
+        file.entry.path_length = vfs_canonical_path( file.path, file.path, ( u32 )strlen( file.path ) + 1 );
+        file.entry.path_hash = vfs_hash_path( file.path );
+        file.entry.path_offset = paths_offset + paths_size;
+        paths_size += file.entry.path_length;
+    }
+
+    // The table is written last, once the entries are sorted by hash.
+    VfsPackHeader header{ k_vfs_pack_magic, k_vfs_pack_version, files.size, 0 };
+    sizet pack_size = memory_align( paths_offset + paths_size, k_vfs_pack_alignment );
+    fseek( pack_file, ( long )pack_size, SEEK_SET );
+
+    static const u8 padding[ k_vfs_pack_alignment ]{ };
+
+    sizet total_size = 0;
+    u32 compressed_count = 0;
+    bool valid = true;
+
+    for ( u32 f = 0; f < files.size && valid; ++f ) {
+        PackedFile& file = files[ f ];
+
+        char file_path[ k_max_path ];
+        const int file_path_length = snprintf( file_path, k_max_path, "%s/%s", input_directory, file.path );
+        if ( file_path_length < 0 || file_path_length >= ( int )k_max_path ) {
+            rprint( "Path too long %s/%s\n", input_directory, file.path );
+            valid = false;
+            break;
+        }
+
+        // This version allocates one more byte, so empty files still get memory.
+        FileReadResult read_result{ };
+        read_result.data = file_read_binary( file_path, allocator, &read_result.size );
+        if ( read_result.data == nullptr ) {
+            rprint( "Cannot read %s\n", file_path );
+            valid = false;
+            break;
+        }
+
+        VfsPackEntry& entry = file.entry;
+        entry.data_offset = pack_size;
+        entry.size = read_result.size;
+        entry.stored_size = read_result.size;
+        entry.compression = VfsCompression::None;
+
+        const u8* stored_data = ( const u8* )read_result.data;
+
+        u8* compressed_data = nullptr;
+        if ( compress && read_result.size > 0 ) {
+            const sizet capacity = ( sizet )( read_result.size * ( 1.0f - k_min_compression_saving ) );
+            compressed_data = ( u8* )ralloca( vfs_compress_bound( read_result.size ), allocator );
+
+            const sizet compressed_size = vfs_compress( ( const u8* )read_result.data, read_result.size, compressed_data, capacity );
+            if ( compressed_size > 0 ) {
+                entry.stored_size = compressed_size;
+                entry.compression = VfsCompression::Lz4;
+                stored_data = compressed_data;
+                ++compressed_count;
+            }
+        }
+
+        file_write( ( u8* )stored_data, 1, ( u32 )entry.stored_size, pack_file );
+
+        const sizet aligned_size = memory_align( entry.stored_size, k_vfs_pack_alignment );
+        file_write( ( u8* )padding, 1, ( u32 )( aligned_size - entry.stored_size ), pack_file );
+
+        pack_size += aligned_size;
+        total_size += entry.size;
+
+        if ( compressed_data ) {
+            rfree( compressed_data, allocator );
+        }
+        rfree( read_result.data, allocator );
+    }
+
+    if ( valid ) {
+        // Paths go in the order of the files, their offsets are already in the entries.
+        fseek( pack_file, ( long )paths_offset, SEEK_SET );
+        for ( u32 f = 0; f < files.size; ++f ) {
+            file_write( ( u8* )files[ f ].path, 1, files[ f ].entry.path_length, pack_file );
+        }
+
+        qsort( files.data, files.size, sizeof( PackedFile ), compare_packed_files );
+
+        fseek( pack_file, 0, SEEK_SET );
+        file_write( ( u8* )&header, sizeof( VfsPackHeader ), 1, pack_file );
+        for ( u32 f = 0; f < files.size; ++f ) {
+            file_write( ( u8* )&files[ f ].entry, sizeof( VfsPackEntry ), 1, pack_file );
+        }
+    }
+
+    file_close( pack_file );
+
+    if ( valid ) {
+        rprint( "Packed %u files, %u compressed, %f MB -> %f MB in %f seconds\n", files.size, compressed_count, total_size / ( 1024.0 * 1024.0 ),
+                pack_size / ( 1024.0 * 1024.0 ), time_from_seconds( start_packing ) );
+    } else {
+        file_delete( output_path );
+    }
+
+    files.shutdown();
+    paths_buffer.shutdown();
+
+    MemoryService::instance()->shutdown();
+
+    return valid ? 0 : 1;
+}